@@ -0,0 +1,336 @@
+#pragma once
+#include <dirent.h>
+#include <ifaddrs.h>
+#include <limits.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// CPU placement (--affinity)
+// On a multi-socket host every NVMe drive and NIC hangs off one NUMA
+// node's PCIe root. A worker scheduled on the other node pays a remote hop
+// for each completion it reaps and each buffer it touches, and the kernel
+// is free to move it there at any time. --affinity pins each worker (and
+// its SQPOLL thread) to its own CPU of the device's node and faults its
+// pool pages in from there, so the first-touch policy puts them on that
+// node too. Locality comes from sysfs: a device's numa_node, found by
+// walking up from its /sys/dev/block entry (through a device-mapper
+// volume's slaves), and for the network the NIC behind the socket's local
+// address plus the CPU its packets arrive on (SO_INCOMING_CPU).
+//
+// The sysfs root is a parameter so tests can point it at a fake tree.
+
+// ============================================================
+// sysfs
+// ============================================================
+
+// First line of a sysfs file, "" if it can't be read
+inline std::string read_sysfs(const std::string& path) {
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+inline std::string resolve_path(const std::string& path) {
+    char buf[PATH_MAX];
+    return realpath(path.c_str(), buf) ? std::string(buf) : std::string();
+}
+
+// "0-3,8,10-11" → {0, 1, 2, 3, 8, 10, 11}; malformed parts are skipped
+inline std::vector<int> parse_cpu_list(const std::string& text) {
+    std::vector<int> cpus;
+    std::stringstream ss(text);
+    std::string part;
+    while (std::getline(ss, part, ',')) {
+        char* end;
+        long lo = std::strtol(part.c_str(), &end, 10);
+        if (end == part.c_str() || lo < 0) continue;
+        long hi = lo;
+        if (*end == '-') {
+            const char* from = end + 1;
+            hi = std::strtol(from, &end, 10);
+            if (end == from || hi < lo) continue;
+        }
+        for (long cpu = lo; cpu <= hi && cpu < CPU_SETSIZE; cpu++) {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+// numa_node of the device at dir (a resolved path under <sysfs>/devices)
+// or of its nearest parent that has one. -1 if none does, or if the
+// platform doesn't know (non-NUMA hosts report -1 themselves).
+inline int sysfs_device_node(std::string dir, const std::string& sysfs = "/sys") {
+    const std::string top = resolve_path(sysfs) + "/devices";
+    while (dir.size() > top.size() && dir.compare(0, top.size(), top) == 0) {
+        std::string value = read_sysfs(dir + "/numa_node");
+        if (!value.empty()) return std::atoi(value.c_str());
+        dir.erase(dir.rfind('/'));
+    }
+    return -1;
+}
+
+// NUMA node of a block device. A device-mapper or md volume has no node
+// of its own: it takes the node of its first slave.
+inline int block_device_node(dev_t dev, const std::string& sysfs = "/sys", int depth = 0) {
+    std::string dir = resolve_path(sysfs + "/dev/block/" + std::to_string(major(dev)) + ":" +
+                                   std::to_string(minor(dev)));
+    if (dir.empty()) return -1;
+
+    for (;;) {
+        int node = sysfs_device_node(dir, sysfs);
+        if (node >= 0 || depth >= 4) return node;
+
+        DIR* slaves = opendir((dir + "/slaves").c_str());
+        if (!slaves) return node;
+        std::string next;
+        while (struct dirent* entry = readdir(slaves)) {
+            if (entry->d_name[0] == '.') continue;
+            next = resolve_path(dir + "/slaves/" + entry->d_name);
+            break;
+        }
+        closedir(slaves);
+        if (next.empty()) return node;
+        dir = next;
+        depth++;
+    }
+}
+
+// Block device behind an anonymous st_dev (btrfs, overlay on a disk): the
+// source of the mount with that device number, 0 if it isn't a /dev node
+inline dev_t mount_source_dev(dev_t dev) {
+    std::ifstream in("/proc/self/mountinfo");
+    std::string line;
+    std::string want = std::to_string(major(dev)) + ":" + std::to_string(minor(dev));
+    while (std::getline(in, line)) {
+        // id parent maj:min root mountpoint options [optional...] - type source super
+        std::istringstream ss(line);
+        std::string id, parent, devno;
+        ss >> id >> parent >> devno;
+        if (devno != want) continue;
+        size_t dash = line.find(" - ");
+        if (dash == std::string::npos) continue;
+        std::istringstream tail(line.substr(dash + 3));
+        std::string type, source;
+        tail >> type >> source;
+        struct stat st;
+        if (source.compare(0, 5, "/dev/") == 0 && stat(source.c_str(), &st) == 0 &&
+            S_ISBLK(st.st_mode)) {
+            return st.st_rdev;
+        }
+    }
+    return 0;
+}
+
+// NUMA node of the device holding path, or of its nearest existing parent
+// (a destination that isn't there yet). -1 if unknown: tmpfs, network
+// filesystems, non-NUMA hosts.
+inline int path_node(std::string path, const std::string& sysfs = "/sys") {
+    struct stat st;
+    while (stat(path.c_str(), &st) != 0) {
+        std::string parent = std::filesystem::path(path).parent_path().string();
+        if (parent.empty()) parent = ".";
+        if (parent == path) return -1;
+        path = parent;
+    }
+    dev_t dev = st.st_dev;
+    if (major(dev) == 0) dev = mount_source_dev(dev);
+    return dev == 0 ? -1 : block_device_node(dev, sysfs);
+}
+
+// CPUs of a NUMA node, empty if it isn't there
+inline std::vector<int> node_cpus(int node, const std::string& sysfs = "/sys") {
+    if (node < 0) return {};
+    return parse_cpu_list(
+        read_sysfs(sysfs + "/devices/system/node/node" + std::to_string(node) + "/cpulist"));
+}
+
+// NUMA node of a CPU (the nodeN link in its sysfs directory), -1 if unknown
+inline int cpu_node(int cpu, const std::string& sysfs = "/sys") {
+    DIR* dir = opendir((sysfs + "/devices/system/cpu/cpu" + std::to_string(cpu)).c_str());
+    if (!dir) return -1;
+    int node = -1;
+    while (struct dirent* entry = readdir(dir)) {
+        if (std::strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' &&
+            entry->d_name[4] <= '9') {
+            node = std::atoi(entry->d_name + 4);
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+// NUMA node of a network interface. Bonds, bridges and VLANs have no
+// device of their own: they take the node of their first lower link.
+inline int interface_node(const std::string& ifname, const std::string& sysfs = "/sys",
+                          int depth = 0) {
+    std::string dir = sysfs + "/class/net/" + ifname;
+    std::string value = read_sysfs(dir + "/device/numa_node");
+    if (!value.empty()) return std::atoi(value.c_str());
+    if (depth >= 4) return -1;
+
+    DIR* links = opendir(dir.c_str());
+    if (!links) return -1;
+    std::string lower;
+    while (struct dirent* entry = readdir(links)) {
+        if (std::strncmp(entry->d_name, "lower_", 6) == 0) {
+            lower = entry->d_name + 6;
+            break;
+        }
+    }
+    closedir(links);
+    return lower.empty() ? -1 : interface_node(lower, sysfs, depth + 1);
+}
+
+// ============================================================
+// Sockets
+// ============================================================
+
+// NUMA node of the NIC a connected socket runs over: the interface that
+// holds its local address. -1 if unknown (loopback, a wildcard address).
+inline int socket_nic_node(int sockfd, const std::string& sysfs = "/sys") {
+    struct sockaddr_storage local;
+    socklen_t len = sizeof(local);
+    if (getsockname(sockfd, reinterpret_cast<struct sockaddr*>(&local), &len) != 0) return -1;
+
+    struct ifaddrs* addrs;
+    if (getifaddrs(&addrs) != 0) return -1;
+    std::string ifname;
+    for (struct ifaddrs* ifa = addrs; ifa && ifname.empty(); ifa = ifa->ifa_next) {
+        if (!ifa->ifa_addr || ifa->ifa_addr->sa_family != local.ss_family) continue;
+        if (local.ss_family == AF_INET) {
+            auto* a = reinterpret_cast<struct sockaddr_in*>(ifa->ifa_addr);
+            auto* b = reinterpret_cast<struct sockaddr_in*>(&local);
+            if (a->sin_addr.s_addr == b->sin_addr.s_addr) ifname = ifa->ifa_name;
+        } else if (local.ss_family == AF_INET6) {
+            auto* a = reinterpret_cast<struct sockaddr_in6*>(ifa->ifa_addr);
+            auto* b = reinterpret_cast<struct sockaddr_in6*>(&local);
+            if (std::memcmp(&a->sin6_addr, &b->sin6_addr, sizeof(a->sin6_addr)) == 0) {
+                ifname = ifa->ifa_name;
+            }
+        }
+    }
+    freeifaddrs(addrs);
+    return ifname.empty() ? -1 : interface_node(ifname, sysfs);
+}
+
+// CPU the socket's packets were last processed on (its RX queue's IRQ
+// CPU under RSS), -1 if unknown or nothing has arrived yet
+inline int socket_rx_cpu(int sockfd) {
+    int cpu = -1;
+    socklen_t len = sizeof(cpu);
+    if (getsockopt(sockfd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) != 0) return -1;
+    return cpu;
+}
+
+// ============================================================
+// Placement
+// ============================================================
+
+// CPUs this process may run on (its cpuset or taskset)
+inline std::vector<int> allowed_cpus() {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    std::vector<int> cpus;
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) return cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+// Restrict the calling thread to cpus. Threads it creates afterwards (an
+// io_uring SQPOLL thread) start with the same mask.
+inline bool pin_thread(const std::vector<int>& cpus) {
+    if (cpus.empty()) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+struct Placement {
+    int node = -1;                  // -1: locality unknown
+    std::vector<int> cpus;          // CPUs workers are spread over
+    std::vector<int> worker_cpu;    // One per worker; empty: nothing is pinned
+    std::vector<int> sqpoll_cpu;    // One per worker with SQPOLL, else empty
+};
+
+// Spread workers over cpus, one CPU each. With SQPOLL each worker's
+// kernel poller gets the CPU next to it, so the two never share one while
+// there are enough CPUs. More workers than CPUs wrap around.
+inline Placement plan_placement(int node, std::vector<int> cpus, int workers, bool sqpoll) {
+    Placement p;
+    p.node = node;
+    p.cpus = std::move(cpus);
+    size_t n = p.cpus.size();
+    if (n == 0 || workers <= 0) return p;
+    bool pair = sqpoll && n >= 2;
+    for (int i = 0; i < workers; i++) {
+        size_t slot = pair ? 2 * static_cast<size_t>(i) : static_cast<size_t>(i);
+        p.worker_cpu.push_back(p.cpus[slot % n]);
+        if (sqpoll) p.sqpoll_cpu.push_back(p.cpus[(pair ? slot + 1 : slot) % n]);
+    }
+    return p;
+}
+
+// CPUs to place work for NUMA node `node` on: its CPUs this process may
+// use. Every allowed CPU when the node is unknown or the cpuset leaves
+// none of its CPUs.
+inline std::vector<int> placement_cpus(int node, const std::string& sysfs = "/sys") {
+    std::vector<int> allowed = allowed_cpus();
+    std::vector<int> local;
+    for (int cpu : node_cpus(node, sysfs)) {
+        if (std::binary_search(allowed.begin(), allowed.end(), cpu)) local.push_back(cpu);
+    }
+    return local.empty() ? allowed : local;
+}
+
+// Where a network stream runs: the node of the NIC behind its socket, or
+// failing that the node of the CPU its packets arrive on
+struct StreamPlacement {
+    int node = -1;
+    int rx_cpu = -1;
+    std::vector<int> cpus;          // The node's CPUs; empty: left unpinned
+};
+
+inline StreamPlacement plan_stream(int sockfd, const std::string& sysfs = "/sys") {
+    StreamPlacement p;
+    p.rx_cpu = socket_rx_cpu(sockfd);
+    p.node = socket_nic_node(sockfd, sysfs);
+    if (p.node < 0 && p.rx_cpu >= 0) p.node = cpu_node(p.rx_cpu, sysfs);
+    if (p.node >= 0) p.cpus = placement_cpus(p.node, sysfs);
+    return p;
+}
+
+// "0-3,8": the short form of a CPU list for log lines
+inline std::string format_cpu_list(const std::vector<int>& cpus) {
+    std::string out;
+    for (size_t i = 0; i < cpus.size();) {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) j++;
+        if (!out.empty()) out += ',';
+        out += std::to_string(cpus[i]);
+        if (j > i) out += '-' + std::to_string(cpus[j]);
+        i = j + 1;
+    }
+    return out;
+}
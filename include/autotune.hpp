@@ -0,0 +1,212 @@
+#pragma once
+#include <sys/vfs.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <string>
+
+// Adaptive tuning (--autotune)
+// The engine is picked once from the filesystems involved: network
+// filesystems do better with blocking I/O on many threads than with
+// io_uring, whose requests on them end up in kernel worker threads anyway.
+// On the io_uring engine a controller then sets each worker's in-flight
+// depth (AIMD on completion latency) and the read/splice chunk (hill
+// climbing on throughput) from what the workers complete per window.
+
+// ============================================================
+// Filesystem Classes
+// ============================================================
+
+enum class FsClass : uint8_t { LOCAL, NETWORK, FUSE };
+
+namespace fs_magic {
+constexpr unsigned long NFS  = 0x6969;
+constexpr unsigned long SMB  = 0x517b;
+constexpr unsigned long CIFS = 0xff534d42;
+constexpr unsigned long SMB2 = 0xfe534d42;
+constexpr unsigned long CEPH = 0x00c36400;
+constexpr unsigned long V9FS = 0x01021997;
+constexpr unsigned long AFS  = 0x5346414f;
+constexpr unsigned long FUSE = 0x65735546;
+}  // namespace fs_magic
+
+inline FsClass fs_class(unsigned long f_type) {
+    switch (f_type) {
+        case fs_magic::NFS:
+        case fs_magic::SMB:
+        case fs_magic::CIFS:
+        case fs_magic::SMB2:
+        case fs_magic::CEPH:
+        case fs_magic::V9FS:
+        case fs_magic::AFS:
+            return FsClass::NETWORK;
+        case fs_magic::FUSE:
+            return FsClass::FUSE;
+        default:
+            return FsClass::LOCAL;
+    }
+}
+
+inline const char* fs_class_name(FsClass c) {
+    switch (c) {
+        case FsClass::NETWORK: return "network";
+        case FsClass::FUSE:    return "fuse";
+        default:               return "local";
+    }
+}
+
+// Class of the filesystem path is on, or will be created on: a missing
+// path is looked up through its nearest existing parent. LOCAL if unknown.
+inline FsClass probe_fs_class(const std::string& path) {
+    std::string p = path.empty() ? "." : path;
+    struct statfs st;
+    while (statfs(p.c_str(), &st) != 0) {
+        if (errno != ENOENT || p == "." || p == "/") return FsClass::LOCAL;
+        size_t slash = p.find_last_of('/');
+        p = slash == std::string::npos ? "." : slash == 0 ? "/" : p.substr(0, slash);
+    }
+    return fs_class(st.f_type);
+}
+
+// ============================================================
+// Online Controller
+// ============================================================
+
+// Published by the controller, read by the workers between files and ops
+struct TuneKnobs {
+    std::atomic<unsigned> depth{0};     // Files in flight per worker
+    std::atomic<uint32_t> chunk{0};     // Bytes per read or splice
+};
+
+// What all workers completed in one window
+struct TuneWindow {
+    uint64_t bytes = 0;
+    uint64_t ops = 0;           // CQEs
+    double in_flight = 0;       // Mean files in flight, all workers
+    double seconds = 0;
+};
+
+// Latency is taken by Little's law (files in flight / completion rate), so
+// workers only count CQEs. Its floor is the device with no queue, which is
+// why depth starts small and doubles per window while that pays (slow
+// start) rather than starting at the maximum. Afterwards, while the
+// depth is in use and either latency stays near the floor or throughput
+// still rises, depth grows by DEPTH_STEP per window; once latency has
+// doubled without throughput to show for it, depth is cut by a quarter.
+// That finds the knee where a disk (or its IOPS quota) stops scaling. Every
+// FLOOR_EPOCH windows one window runs at half depth to measure the floor
+// afresh, so the knee is followed when it moves, e.g. when burst credits
+// run out. Every CHUNK_EVERY windows the chunk is doubled or halved for
+// one window, and kept if throughput rose.
+class AutoTuner {
+public:
+    static constexpr unsigned MIN_DEPTH = 4;
+    static constexpr unsigned START_DEPTH = 8;
+    static constexpr unsigned DEPTH_STEP = 2;
+    static constexpr uint32_t MIN_CHUNK = 64 * 1024;
+    static constexpr uint64_t MIN_OPS = 32;         // Fewer: idle or scan-bound window
+    static constexpr double LATENCY_LIMIT = 2.0;    // x floor: requests are queueing
+    static constexpr double GAIN = 1.05;            // Smallest throughput change that counts
+    static constexpr int FLOOR_EPOCH = 50;
+    static constexpr int CHUNK_EVERY = 10;
+
+    // The chunk moves between MIN_CHUNK and max_chunk (the buffer stride);
+    // max_chunk 0 pins it
+    AutoTuner(int workers, unsigned max_depth, uint32_t chunk, uint32_t max_chunk)
+        : workers_(std::max(workers, 1)), max_depth_(std::max(max_depth, 1u)),
+          depth_(std::min(START_DEPTH, max_depth_)),
+          chunk_(chunk), min_chunk_(max_chunk ? std::min(chunk, MIN_CHUNK) : chunk),
+          max_chunk_(std::max(chunk, max_chunk)) {}
+
+    unsigned depth() const { return depth_; }
+    uint32_t chunk() const { return chunk_; }
+    double latency_floor() const { return floor_; }
+
+    void update(const TuneWindow& w) {
+        if (w.ops < MIN_OPS || w.seconds <= 0) return;
+        double rate = w.bytes / w.seconds;
+        double latency = w.in_flight * w.seconds / w.ops;
+
+        // A probe restarts the floor; its throughput is not comparable
+        if (probing_) {
+            floor_ = latency;
+            depth_ = probe_restore_;
+            probing_ = false;
+            return;
+        }
+        floor_ = floor_ > 0 ? std::min(floor_, latency) : latency;
+
+        // Depth holds still while a chunk trial is measured
+        if (trial_) {
+            if (rate < trial_base_ * GAIN) {
+                chunk_ = trial_prev_;
+                grow_chunk_ = !grow_chunk_;
+            }
+            trial_ = false;
+            prev_rate_ = rate;
+            return;
+        }
+
+        bool queueing = latency > floor_ * LATENCY_LIMIT;
+        bool gaining = rate > prev_rate_ * GAIN;
+        bool bound = w.in_flight >= 0.75 * depth_ * workers_;
+        if (slow_start_) {
+            if (!bound) {
+                // Not enough work to tell yet
+            } else if (gaining && !queueing) {
+                depth_ = std::min(max_depth_, depth_ * 2);
+            } else {
+                slow_start_ = false;
+            }
+        } else if (queueing && !gaining) {
+            depth_ = std::max(std::min(MIN_DEPTH, max_depth_), depth_ * 3 / 4);
+        } else if (bound && (gaining || !queueing)) {
+            depth_ = std::min(max_depth_, depth_ + DEPTH_STEP);
+        }
+        prev_rate_ = rate;
+        if (slow_start_) return;
+
+        if (++since_probe_ >= FLOOR_EPOCH) {
+            since_probe_ = 0;
+            probe_restore_ = depth_;
+            depth_ = std::max(std::min(MIN_DEPTH, max_depth_), depth_ / 2);
+            probing_ = true;
+        } else if (++since_trial_ >= CHUNK_EVERY && max_chunk_ > min_chunk_) {
+            since_trial_ = 0;
+            uint64_t next = grow_chunk_ ? uint64_t{chunk_} * 2 : chunk_ / 2;
+            if (next > max_chunk_ || next < min_chunk_) {
+                grow_chunk_ = !grow_chunk_;
+                next = grow_chunk_ ? uint64_t{chunk_} * 2 : chunk_ / 2;
+            }
+            if (next <= max_chunk_ && next >= min_chunk_) {
+                trial_base_ = rate;
+                trial_prev_ = chunk_;
+                chunk_ = static_cast<uint32_t>(next);
+                trial_ = true;
+            }
+        }
+    }
+
+private:
+    int workers_;
+    unsigned max_depth_;
+    unsigned depth_;
+    uint32_t chunk_;
+    uint32_t min_chunk_;
+    uint32_t max_chunk_;
+
+    double floor_ = 0;          // Lowest latency (s) since the last probe
+    double prev_rate_ = 0;      // Bytes/s of the last window
+    bool slow_start_ = true;
+
+    bool probing_ = false;      // This window runs at half depth
+    int since_probe_ = 0;
+    unsigned probe_restore_ = 0;
+
+    bool trial_ = false;        // A chunk trial is being measured
+    bool grow_chunk_ = true;    // Direction of the next trial
+    int since_trial_ = 0;
+    double trial_base_ = 0;
+    uint32_t trial_prev_ = 0;
+};
@@ -0,0 +1,141 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+// CRC32C (Castagnoli) for --verify
+// Computed over each chunk while it is in a buffer anyway, so checking a
+// transfer costs no extra I/O. SSE4.2 has a crc32 instruction for exactly
+// this polynomial; without it a table is used.
+
+namespace crc32c_detail {
+
+constexpr uint32_t POLY = 0x82f63b78;   // Reflected
+
+struct Table {
+    uint32_t t[256];
+};
+
+constexpr Table make_table() {
+    Table table{};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? (c >> 1) ^ POLY : c >> 1;
+        table.t[i] = c;
+    }
+    return table;
+}
+
+inline constexpr Table TABLE = make_table();
+
+// a * b modulo the polynomial (bit 31 is x^0)
+constexpr uint32_t multmodp(uint32_t a, uint32_t b) {
+    uint32_t m = 1u << 31;
+    uint32_t p = 0;
+    while (true) {
+        if (a & m) {
+            p ^= b;
+            if ((a & (m - 1)) == 0) break;
+        }
+        m >>= 1;
+        b = (b & 1) ? (b >> 1) ^ POLY : b >> 1;
+    }
+    return p;
+}
+
+// x^(8n) modulo the polynomial: appending n zero bytes
+constexpr uint32_t x8nmodp(uint64_t n) {
+    uint32_t p = 1u << 31;
+    uint32_t sq = 1u << 23;     // x^8
+    while (n) {
+        if (n & 1) p = multmodp(sq, p);
+        sq = multmodp(sq, sq);
+        n >>= 1;
+    }
+    return p;
+}
+
+// Raw register state (no pre/post inversion) after n bytes
+inline uint32_t bytes_table(uint32_t s, const uint8_t* p, size_t n) {
+    for (size_t i = 0; i < n; i++) s = TABLE.t[(s ^ p[i]) & 0xff] ^ (s >> 8);
+    return s;
+}
+
+#ifdef __SSE4_2__
+inline uint64_t load64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t bytes_hw(uint32_t s, const uint8_t* p, size_t n) {
+    uint64_t c = s;
+    for (; n >= 8; p += 8, n -= 8) c = _mm_crc32_u64(c, load64(p));
+    s = static_cast<uint32_t>(c);
+    for (; n > 0; p++, n--) s = _mm_crc32_u8(s, *p);
+    return s;
+}
+
+// The instruction has a 3-cycle latency but issues every cycle, so three
+// independent lanes keep it busy. Lanes b and c start from zero and are
+// merged by shifting the earlier state past them.
+constexpr size_t LANE = 8192;
+constexpr uint32_t LANE_SHIFT = x8nmodp(LANE);
+
+inline uint32_t bytes_hw3(uint32_t s, const uint8_t* p, size_t n) {
+    for (; n >= 3 * LANE; p += 3 * LANE, n -= 3 * LANE) {
+        uint64_t a = s, b = 0, c = 0;
+        for (size_t i = 0; i < LANE; i += 8) {
+            a = _mm_crc32_u64(a, load64(p + i));
+            b = _mm_crc32_u64(b, load64(p + LANE + i));
+            c = _mm_crc32_u64(c, load64(p + 2 * LANE + i));
+        }
+        s = multmodp(LANE_SHIFT, multmodp(LANE_SHIFT, static_cast<uint32_t>(a)) ^
+                                     static_cast<uint32_t>(b)) ^
+            static_cast<uint32_t>(c);
+    }
+    return bytes_hw(s, p, n);
+}
+#endif
+
+}  // namespace crc32c_detail
+
+// Continue crc over data; start from 0. crc32c(0, "123456789") = 0xe3069283
+inline uint32_t crc32c(uint32_t crc, const void* data, size_t len) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+#ifdef __SSE4_2__
+    return ~crc32c_detail::bytes_hw3(~crc, p, len);
+#else
+    return ~crc32c_detail::bytes_table(~crc, p, len);
+#endif
+}
+
+// Table version, for checking the hardware path
+inline uint32_t crc32c_portable(uint32_t crc, const void* data, size_t len) {
+    return ~crc32c_detail::bytes_table(~crc, static_cast<const uint8_t*>(data), len);
+}
+
+// CRC of A followed by B, from crc(A), crc(B) and B's length
+inline uint32_t crc32c_combine(uint32_t crc_a, uint32_t crc_b, uint64_t len_b) {
+    return crc32c_detail::multmodp(crc32c_detail::x8nmodp(len_b), crc_a) ^ crc_b;
+}
+
+// Continue crc over n zero bytes without touching them (a sparse file's hole)
+inline uint32_t crc32c_zeros(uint32_t crc, uint64_t n) {
+    return ~crc32c_detail::multmodp(crc32c_detail::x8nmodp(n), ~crc);
+}
+
+// Sampled re-read (local --verify): which of a file's chunks are checked.
+// Every chunk when samples is 0 or covers the file; otherwise samples
+// chunks spread evenly, first and last included.
+inline bool sample_chunk(uint64_t index, uint64_t chunks, uint32_t samples) {
+    if (samples == 0 || chunks <= samples) return index < chunks;
+    if (samples == 1) return index == 0;
+    // Smallest i with i * (chunks - 1) / (samples - 1) >= index
+    uint64_t i = (index * (samples - 1) + chunks - 2) / (chunks - 1);
+    return i < samples && i * (chunks - 1) / (samples - 1) == index;
+}
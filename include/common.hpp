@@ -5,13 +5,27 @@
 #include <atomic>
 #include <mutex>
 #include <condition_variable>
-#include <queue>
+#include <deque>
+#include <memory>
+#include <utility>
+#include <cerrno>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <functional>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 #include <linux/stat.h>  // For struct statx
 
 // ============================================================
 // Operation Types
 // ============================================================
-enum class OpType {
+enum class OpType : uint8_t {
     // File operations
     OPEN_SRC,
     OPEN_DST,
@@ -19,6 +33,7 @@ enum class OpType {
     READ,
     WRITE,
     COPY_FILE_RANGE,  // Zero-copy kernel-to-kernel copy (5.19+)
+    CLONE,            // ioctl(FICLONE): reflink the whole file
     SPLICE_IN,        // splice: src_fd → pipe_write
     SPLICE_OUT,       // splice: pipe_read → dst_fd
     CLOSE_SRC,
@@ -33,80 +48,485 @@ enum class OpType {
 // ============================================================
 // File State Machine
 // ============================================================
-enum class FileState {
+enum class FileState : uint8_t {
     QUEUED,           // In work queue, not started
     OPENING_SRC,      // Waiting for source open
     STATING,          // Getting file metadata
     OPENING_DST,      // Waiting for dest open
-    READING,          // Reading chunk
-    WRITING,          // Writing chunk
-    COPYING,          // Using copy_file_range (zero-copy, 5.19+)
+    READING,          // Read/write pipeline: reads and writes in flight
+    WRITING,          // Read/write pipeline: all read, last writes in flight
+    CLONING,          // FICLONE on the helper thread
+    COPYING,          // copy_file_range steps on the helper thread
+    PROBING,          // statx by path: size unknown, small enough for a chain?
+    SMALL_CHAIN,      // Whole-file linked SQE chain in flight (small files)
+    SMALL_CLEANUP,    // Chain failed: releasing fixed-file slots before retry
     SPLICE_IN,        // Splicing: src_fd → pipe (zero-copy)
     SPLICE_OUT,       // Splicing: pipe → dst_fd (zero-copy)
     CLOSING_SRC,      // Closing source fd
     CLOSING_DST,      // Closing dest fd
+    VERIFYING,        // --verify re-read on the helper thread
     DONE,             // Complete
     FAILED            // Failed
 };
 
+// ============================================================
+// Copy Offload Cache - reflink / copy_file_range support per device pair
+// ============================================================
+// Probing FICLONE and copy_file_range costs a failed syscall each, so the
+// outcome is remembered per (src dev, dst dev). Entries live in a deque so
+// FileContext can hold a stable pointer to its pair.
+class CopyOffloadCache {
+public:
+    enum class Support : uint8_t { UNKNOWN, YES, NO };
+
+    struct Entry {
+        dev_t src_dev;
+        dev_t dst_dev;
+        Support clone = Support::UNKNOWN;       // ioctl(FICLONE)
+        Support copy_range = Support::UNKNOWN;  // copy_file_range()
+    };
+
+    Entry* lookup(dev_t src_dev, dev_t dst_dev) {
+        for (auto& e : entries_) {
+            if (e.src_dev == src_dev && e.dst_dev == dst_dev) return &e;
+        }
+        entries_.push_back({src_dev, dst_dev});
+        return &entries_.back();
+    }
+
+    size_t size() const { return entries_.size(); }
+
+    // Errors meaning "this device pair can't do it", as opposed to a real I/O failure
+    static bool is_unsupported(int err) {
+        return err == EXDEV || err == EOPNOTSUPP || err == EINVAL ||
+               err == ENOSYS || err == ENOTTY;
+    }
+
+private:
+    std::deque<Entry> entries_;
+};
+
+// ============================================================
+// Helper Thread - blocking calls off the ring thread
+// ============================================================
+// FICLONE and copy_file_range have no io_uring op, and --verify re-reads a
+// whole file with pread: all of them block the caller for as long as they
+// take. A worker hands them to its helper thread and waits for them like
+// for any other op: each context slot has an eventfd the ring holds an
+// 8-byte read on, and the helper adds the call's result to it. The counter
+// is the result biased by RESULT_BIAS (never 0), so nothing else is shared
+// but the job list. One call per slot at a time.
+class HelperThread {
+public:
+    using Call = std::function<int64_t()>;
+    static constexpr uint64_t RESULT_BIAS = 1ULL << 32;
+
+    explicit HelperThread(size_t slots) {
+        for (size_t i = 0; i < slots; i++) {
+            int fd = eventfd(0, EFD_CLOEXEC);
+            if (fd < 0) break;
+            fds_.push_back(fd);
+        }
+        if (fds_.size() == slots) thread_ = std::thread([this] { loop(); });
+    }
+
+    ~HelperThread() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_one();
+        if (thread_.joinable()) thread_.join();
+        for (int fd : fds_) close(fd);
+    }
+
+    // Non-copyable
+    HelperThread(const HelperThread&) = delete;
+    HelperThread& operator=(const HelperThread&) = delete;
+
+    // False if the eventfds could not be made: run the calls inline
+    bool ok() const { return thread_.joinable(); }
+
+    // The eventfd to read slot's result from
+    int fd(size_t slot) const { return fds_[slot]; }
+
+    void run(size_t slot, Call call) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            jobs_.push_back({slot, std::move(call)});
+        }
+        cv_.notify_one();
+    }
+
+    // What the 8-byte read of the slot's eventfd returned
+    static int64_t result(uint64_t word) { return static_cast<int64_t>(word - RESULT_BIAS); }
+
+private:
+    struct Job {
+        size_t slot;
+        Call call;
+    };
+
+    void loop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            cv_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+            if (jobs_.empty()) return;
+            Job job = std::move(jobs_.front());
+            jobs_.pop_front();
+            lock.unlock();
+            uint64_t word = static_cast<uint64_t>(job.call()) + RESULT_BIAS;
+            ssize_t n = write(fds_[job.slot], &word, sizeof(word));
+            (void)n;    // An eventfd write of a valid count can't fail
+            lock.lock();
+        }
+    }
+
+    std::vector<int> fds_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Job> jobs_;
+    bool stopping_ = false;
+    std::thread thread_;
+};
+
+// ============================================================
+// Free List - O(1) index stack shared by the pools
+// ============================================================
+// LIFO, so a just-released (cache-warm) slot is handed out next. Starts
+// with 0 on top: fresh acquires return 0, 1, 2, ...
+class FreeList {
+public:
+    explicit FreeList(size_t count) : in_use_(count, 0) {
+        stack_.reserve(count);
+        for (size_t i = count; i > 0; i--) {
+            stack_.push_back(static_cast<int>(i - 1));
+        }
+    }
+
+    // Returns -1 if empty
+    int pop() {
+        if (stack_.empty()) return -1;
+        int index = stack_.back();
+        stack_.pop_back();
+        in_use_[index] = 1;
+        return index;
+    }
+
+    // Out-of-range and already-free indices are ignored
+    void push(int index) {
+        if (index < 0 || index >= static_cast<int>(in_use_.size())) return;
+        if (!in_use_[index]) return;
+        in_use_[index] = 0;
+        stack_.push_back(index);
+    }
+
+    size_t available() const { return stack_.size(); }
+    size_t capacity() const { return in_use_.size(); }
+
+private:
+    std::vector<int> stack_;        // Free indices, top = back
+    std::vector<uint8_t> in_use_;   // Guards against double release
+};
+
 // ============================================================
 // File Context - tracks one file copy operation
 // ============================================================
-struct FileContext {
-    // Paths
-    std::string src_path;
-    std::string dst_path;
+// Split by access frequency: FileContext holds what the state machine
+// touches on every completion and fits one cache line; paths, statx and
+// other once-per-file data live in a parallel FileContextCold.
+// CRC32C of one chunk as it went through the copy buffer (--verify)
+struct ChunkCrc {
+    uint64_t offset;
+    uint32_t len;
+    uint32_t crc;
+};
 
-    // File descriptors
+// Large file copied as concurrent range segments (--split-size). Every
+// segment shares these fds: the first one to start opens them, the last
+// one to finish completes the file, and they close with the last reference.
+struct SplitFile {
+    uint64_t size = 0;                        // As scanned; segments cover it
+    struct timespec mtime = {0, UTIME_OMIT};  // Stamped by the last segment
+    std::atomic<uint32_t> segments_left{0};
+    std::atomic<bool> failed{false};
+    bool resumed = false;                     // Part of the copy is kept (--resume)
+    bool sparse = false;                      // Segments copy only their data runs
+    bool direct = false;                      // Fds are O_DIRECT: cut back to size at the end
+
+    std::mutex open_mutex;
+    bool opened = false;                      // Open attempted (under open_mutex)
     int src_fd = -1;
     int dst_fd = -1;
 
-    // State machine
-    FileState state = FileState::QUEUED;
-    OpType current_op;
+    SplitFile() = default;
+    ~SplitFile() {
+        if (src_fd >= 0) close(src_fd);
+        if (dst_fd >= 0) close(dst_fd);
+    }
+
+    // Non-copyable (owns fds)
+    SplitFile(const SplitFile&) = delete;
+    SplitFile& operator=(const SplitFile&) = delete;
+};
 
+// Monotonic nanoseconds, the clock of op timing (--metrics, --trace)
+inline uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Chunk buffers per file on the read/write path, at most (--pipeline)
+constexpr int MAX_PIPELINE = 4;
+
+// Ops of one context timed at once: one per completion tag value the
+// read/write pipeline uses (buffer index, plus 4 for writes)
+constexpr unsigned OP_CLOCK_SLOTS = 8;
+
+// A chunk's write on the read/write path: len bytes at pos, done of them
+// written so far (a short write is resubmitted for the rest)
+struct ChunkWrite {
+    uint64_t pos = 0;
+    uint32_t len = 0;
+    uint32_t done = 0;
+};
+
+struct FileContextCold {
+    // Paths (assigned into retained capacity - no malloc once warm)
+    std::string src_path;
+    std::string dst_path;
+
+    // For statx result
+    struct statx stx;
+    mode_t mode = 0644;
+
+    // Reflink/copy_file_range support for this file's device pair (nullptr = disabled)
+    CopyOffloadCache::Entry* offload = nullptr;
+    uint64_t helper_word = 0;    // Read from the helper's eventfd (HelperThread::result)
+
+    // Small-file linked chain: first error seen
+    int chain_error = 0;
+
+    // Source mtime to stamp on the copy; UTIME_OMIT unless incremental
+    struct timespec mtime = {0, UTIME_OMIT};
+
+    // --verify: sampled chunks hashed on the read/write path
+    std::vector<ChunkCrc> verify_crcs;
+
+    // Segment of a split file: [offset, file_size) of it (nullptr = whole file)
+    std::shared_ptr<SplitFile> split;
+    uint64_t split_offset = 0;                // Where the segment starts (--resume)
+
+    // Sparse file: the data runs of [offset, sparse_end), copied one after
+    // another as [offset, file_size); sparse_end is 0 for a linear copy
+    std::vector<std::pair<uint64_t, uint64_t>> extents;
+    size_t extent_index = 0;
+    uint64_t sparse_end = 0;
+
+    // O_DIRECT (--direct): the unaligned last chunk went out from buffer
+    // pad_buf, direct_pad bytes longer; the copy is cut back at the end
+    bool direct = false;
+    uint32_t direct_pad = 0;
+    int pad_buf = -1;
+
+    // Read/write pipeline: the write of each chunk buffer
+    ChunkWrite writes[MAX_PIPELINE];
+
+    // Op timing: when the op with each completion tag was prepared
+    uint64_t op_start[OP_CLOCK_SLOTS] = {};
+};
+
+struct alignas(64) FileContext {
     // File info (from statx)
     uint64_t file_size = 0;
     uint64_t offset = 0;          // Current read/write position
-    mode_t mode = 0644;
 
     // Buffer (assigned from pool) - used for read/write path
     char* buffer = nullptr;
-    int buffer_index = -1;        // Index in buffer pool
-    uint32_t last_read_size = 0;  // Bytes from last read
+
+    // Once-per-file data (owned by the slab)
+    FileContextCold* cold = nullptr;
+
+    // File descriptors
+    int src_fd = -1;
+    int dst_fd = -1;
 
     // Pipe (assigned from pool) - used for splice path
     int pipe_read_fd = -1;        // Read end of pipe
     int pipe_write_fd = -1;       // Write end of pipe
     int pipe_index = -1;          // Index in pipe pool
-    uint32_t splice_len = 0;      // Bytes in current splice operation
 
-    // For statx result
-    struct statx stx;
+    // A file is on either the read/write or the splice path at a time
+    union {
+        uint32_t read_ahead = 0;      // Bytes read past offset, not yet written
+        uint32_t splice_len;          // Bytes in current splice operation
+    };
+
+    int buffer_index = -1;        // Index in buffer pool
+
+    // State machine
+    FileState state = FileState::QUEUED;
+    OpType current_op = OpType::OPEN_SRC;
 
     // Use splice for this file
     bool use_splice = false;
+
+    union {
+        uint8_t chain_left = 0;       // Small-file linked chain: completions still expected
+        uint8_t io_busy;              // Read/write pipeline: buffers in use + read in flight
+    };
+};
+
+static_assert(sizeof(FileContext) == 64, "FileContext should stay one cache line");
+
+// ============================================================
+// File Context Slab - per-worker fixed-capacity context storage
+// ============================================================
+// Hot and cold halves in parallel arrays, O(1) acquire/release by index.
+// Replaces new/delete per file and the O(n) in-flight vector search.
+class FileContextSlab {
+public:
+    explicit FileContextSlab(size_t capacity)
+        : hot_(capacity), cold_(capacity), free_(capacity) {
+        for (size_t i = 0; i < capacity; i++) {
+            hot_[i].cold = &cold_[i];
+        }
+    }
+
+    // Non-copyable (hot_ points into cold_)
+    FileContextSlab(const FileContextSlab&) = delete;
+    FileContextSlab& operator=(const FileContextSlab&) = delete;
+
+    // Returns a reset context, or nullptr if all are in use.
+    // Cold paths keep their old contents until the caller assigns them.
+    FileContext* acquire() {
+        int index = free_.pop();
+        if (index < 0) return nullptr;
+
+        FileContextCold* cold = &cold_[index];
+        hot_[index] = FileContext{};
+        hot_[index].cold = cold;
+        cold->mode = 0644;
+        cold->offload = nullptr;
+        cold->chain_error = 0;
+        cold->sparse_end = 0;
+        cold->direct = false;
+        cold->direct_pad = 0;
+        cold->pad_buf = -1;
+        return &hot_[index];
+    }
+
+    void release(FileContext* ctx) {
+        free_.push(static_cast<int>(index_of(ctx)));
+    }
+
+    size_t index_of(const FileContext* ctx) const { return ctx - hot_.data(); }
+    size_t capacity() const { return hot_.size(); }
+    size_t in_use() const { return hot_.size() - free_.available(); }
+    bool empty() const { return in_use() == 0; }
+
+private:
+    std::vector<FileContext> hot_;
+    std::vector<FileContextCold> cold_;
+    FreeList free_;
+};
+
+// ============================================================
+// Huge Page Arena - one contiguous mapping for all pool buffers
+// ============================================================
+// Tries explicit 2MB huge pages first (MAP_HUGETLB, needs reserved
+// hugepages), then falls back to a 2MB-aligned normal mapping advised for
+// THP. Arenas under 2MB just use regular pages.
+// Contiguous so a single iovec can register the whole arena.
+class HugePageArena {
+public:
+    static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+    static constexpr size_t BASE_PAGE_SIZE = 4096;
+
+    explicit HugePageArena(size_t bytes) {
+        bytes = std::max<size_t>(bytes, 1);
+        if (bytes < HUGE_PAGE_SIZE) {
+            size_ = round_up(bytes, BASE_PAGE_SIZE);
+            base_ = map(size_, 0);
+            if (!base_) throw std::runtime_error("Failed to map buffer arena");
+            return;
+        }
+
+        size_ = round_up(bytes, HUGE_PAGE_SIZE);
+        base_ = map(size_, MAP_HUGETLB);
+        if (base_) {
+            huge_pages_ = true;
+            return;
+        }
+
+        // Over-map by one huge page and trim so the arena is 2MB-aligned,
+        // otherwise THP can't back its first/last extents
+        size_t padded = size_ + HUGE_PAGE_SIZE;
+        char* raw = map(padded, 0);
+        if (!raw) throw std::runtime_error("Failed to map buffer arena");
+        uintptr_t addr = reinterpret_cast<uintptr_t>(raw);
+        char* aligned = reinterpret_cast<char*>(round_up(addr, HUGE_PAGE_SIZE));
+        size_t head = aligned - raw;
+        if (head > 0) munmap(raw, head);
+        munmap(aligned + size_, padded - head - size_);
+        base_ = aligned;
+        madvise(base_, size_, MADV_HUGEPAGE);
+    }
+
+    ~HugePageArena() {
+        if (base_) munmap(base_, size_);
+    }
+
+    // Non-copyable
+    HugePageArena(const HugePageArena&) = delete;
+    HugePageArena& operator=(const HugePageArena&) = delete;
+
+    char* data() const { return base_; }
+    size_t size() const { return size_; }
+    bool huge_pages() const { return huge_pages_; }
+
+    // Fault every page in from the calling thread. Pages come from the
+    // node of the CPU that first touches them (see --affinity), and until
+    // now none has been.
+    void touch() {
+        size_t step = huge_pages_ ? HUGE_PAGE_SIZE : BASE_PAGE_SIZE;
+        for (size_t off = 0; off < size_; off += step) {
+            static_cast<volatile char*>(base_)[off] = 0;
+        }
+    }
+
+private:
+    static size_t round_up(size_t n, size_t align) {
+        return (n + align - 1) & ~(align - 1);
+    }
+
+    static char* map(size_t len, int extra_flags) {
+        void* p = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | extra_flags, -1, 0);
+        return p == MAP_FAILED ? nullptr : static_cast<char*>(p);
+    }
+
+    char* base_ = nullptr;
+    size_t size_ = 0;
+    bool huge_pages_ = false;   // MAP_HUGETLB succeeded (else THP-advised)
 };
 
 // ============================================================
 // Buffer Pool - pre-allocated buffers to avoid malloc per file
 // ============================================================
+// All buffers are carved from one HugePageArena; each slot is rounded
+// up to 4096 so every buffer stays O_DIRECT-aligned (see --direct below).
 class BufferPool {
 public:
+    static constexpr size_t ALIGNMENT = 4096;
+
     BufferPool(size_t count, size_t buffer_size)
-        : buffer_size_(buffer_size), count_(count) {
-        // Allocate all buffers upfront
+        : arena_(count * slot_size(buffer_size)), free_(count),
+          buffer_size_(buffer_size), count_(count) {
+        size_t stride = slot_size(buffer_size);
         buffers_.resize(count);
-        available_.resize(count, true);
         for (size_t i = 0; i < count; i++) {
-            // Aligned allocation for O_DIRECT compatibility
-            buffers_[i] = static_cast<char*>(aligned_alloc(4096, buffer_size));
-        }
-    }
-
-    ~BufferPool() {
-        for (auto* buf : buffers_) {
-            free(buf);
+            buffers_[i] = arena_.data() + i * stride;
         }
     }
 
@@ -116,39 +536,80 @@ public:
 
     // Acquire a buffer, returns {pointer, index} or {nullptr, -1} if none available
     std::pair<char*, int> acquire() {
-        for (size_t i = 0; i < count_; i++) {
-            if (available_[i]) {
-                available_[i] = false;
-                return {buffers_[i], static_cast<int>(i)};
-            }
-        }
-        return {nullptr, -1};
+        int index = free_.pop();
+        if (index < 0) return {nullptr, -1};
+        return {buffers_[index], index};
     }
 
     // Release a buffer back to the pool
     void release(int index) {
-        if (index >= 0 && index < static_cast<int>(count_)) {
-            available_[index] = true;
-        }
+        free_.push(index);
     }
 
     size_t buffer_size() const { return buffer_size_; }
-    size_t available_count() const {
-        size_t count = 0;
-        for (bool a : available_) if (a) count++;
-        return count;
-    }
+    size_t count() const { return count_; }
+    size_t available_count() const { return free_.available(); }
 
     // Expose buffers for io_uring registration
     const std::vector<char*>& buffers() const { return buffers_; }
 
+    // Whole arena, for registering as a single iovec
+    char* arena() const { return arena_.data(); }
+    size_t arena_size() const { return arena_.size(); }
+    bool huge_pages() const { return arena_.huge_pages(); }
+    void touch() { arena_.touch(); }
+
 private:
+    static size_t slot_size(size_t buffer_size) {
+        return (std::max<size_t>(buffer_size, 1) + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    }
+
+    HugePageArena arena_;
+    FreeList free_;
     std::vector<char*> buffers_;
-    std::vector<bool> available_;
     size_t buffer_size_;
     size_t count_;
 };
 
+// ============================================================
+// Direct I/O (--direct)
+// ============================================================
+// A large file streamed through the page cache evicts everything else
+// and leaves the kernel to write it all back. O_DIRECT skips the cache,
+// but the buffer, the file offset and the length must all be aligned.
+// Pool buffers and (checked) chunk sizes are, so only a file's last,
+// partial block is not: it is read rounded up, written padded with
+// zeros, and the copy is cut back to its size once every write is in.
+
+constexpr size_t DIRECT_ALIGN = BufferPool::ALIGNMENT;
+
+// Default --direct threshold: below it the cache costs little
+constexpr uint64_t DIRECT_MIN_SIZE = 8 * 1024 * 1024;
+
+inline bool direct_aligned(uint64_t value) {
+    return (value & (DIRECT_ALIGN - 1)) == 0;
+}
+
+inline uint64_t direct_round(uint64_t len) {
+    return (len + DIRECT_ALIGN - 1) & ~static_cast<uint64_t>(DIRECT_ALIGN - 1);
+}
+
+// Zero data[len, direct_round(len)) and return the padded length. The
+// buffer must have room: pool slots are rounded up to DIRECT_ALIGN.
+inline uint32_t pad_direct(char* data, uint32_t len) {
+    uint32_t padded = static_cast<uint32_t>(direct_round(len));
+    std::fill(data + len, data + padded, 0);
+    return padded;
+}
+
+// Switch an open fd to or from O_DIRECT. False if its filesystem has no
+// direct I/O (FUSE without it, tmpfs before 6.6)
+inline bool set_direct(int fd, bool on) {
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0) return false;
+    return fcntl(fd, F_SETFL, on ? flags | O_DIRECT : flags & ~O_DIRECT) == 0;
+}
+
 // ============================================================
 // Pipe Pool - pre-allocated pipes for splice operations
 // ============================================================
@@ -160,9 +621,8 @@ public:
         int write_fd = -1;
     };
 
-    explicit PipePool(size_t count, size_t pipe_size = 0) : count_(count) {
+    explicit PipePool(size_t count, size_t pipe_size = 0) : free_(count), count_(count) {
         pipes_.resize(count);
-        available_.resize(count, true);
         for (size_t i = 0; i < count; i++) {
             int fds[2];
             if (pipe(fds) < 0) {
@@ -201,32 +661,22 @@ public:
     };
 
     PipeHandle acquire() {
-        for (size_t i = 0; i < count_; i++) {
-            if (available_[i]) {
-                available_[i] = false;
-                return {pipes_[i].read_fd, pipes_[i].write_fd, static_cast<int>(i)};
-            }
-        }
-        return {-1, -1, -1};
+        int index = free_.pop();
+        if (index < 0) return {-1, -1, -1};
+        return {pipes_[index].read_fd, pipes_[index].write_fd, index};
     }
 
     // Release a pipe back to the pool
     void release(int index) {
-        if (index >= 0 && index < static_cast<int>(count_)) {
-            available_[index] = true;
-        }
+        free_.push(index);
     }
 
     size_t count() const { return count_; }
-    size_t available_count() const {
-        size_t c = 0;
-        for (bool a : available_) if (a) c++;
-        return c;
-    }
+    size_t available_count() const { return free_.available(); }
 
 private:
     std::vector<Pipe> pipes_;
-    std::vector<bool> available_;
+    FreeList free_;
     size_t count_;
 };
 
@@ -240,6 +690,16 @@ struct Stats {
     std::atomic<uint64_t> bytes_total{0};
     std::atomic<uint64_t> bytes_copied{0};
     std::atomic<uint64_t> dirs_created{0};
+    std::atomic<uint64_t> files_skipped{0};  // Unchanged (incremental)
+    std::atomic<uint64_t> files_verified{0}; // Sampled re-read matched (verify)
+    std::atomic<uint64_t> files_mismatched{0};
+    std::atomic<uint64_t> files_resumed{0};  // Split files picked up from the journal
+    std::atomic<uint64_t> bytes_resumed{0};  // Segments of them not copied again
+    std::atomic<uint64_t> bytes_sparse{0};   // Holes left unwritten
+    std::atomic<uint64_t> files_linked{0};   // Hardlinks recreated (--hardlinks)
+    std::atomic<uint64_t> files_direct{0};   // Copied with O_DIRECT (--direct)
+    std::atomic<uint64_t> ops_completed{0};  // CQEs (autotune)
+    std::atomic<uint32_t> files_in_flight{0};  // Started, not yet released (autotune)
 };
 
 // ============================================================
@@ -311,92 +771,32 @@ struct SizeStats {
     }
 };
 
-// ============================================================
-// Thread-Safe Work Queue
-// ============================================================
-template<typename T>
-class WorkQueue {
-public:
-    WorkQueue() = default;
-
-    // Non-copyable
-    WorkQueue(const WorkQueue&) = delete;
-    WorkQueue& operator=(const WorkQueue&) = delete;
-
-    // Push an item to the queue
-    void push(T item) {
-        {
-            std::lock_guard<std::mutex> lock(mutex_);
-            queue_.push(std::move(item));
-        }
-        cv_.notify_one();
-    }
-
-    // Push multiple items
-    void push_bulk(std::vector<T>& items) {
-        {
-            std::lock_guard<std::mutex> lock(mutex_);
-            for (auto& item : items) {
-                queue_.push(std::move(item));
-            }
-        }
-        cv_.notify_all();
-    }
-
-    // Try to pop an item (non-blocking)
-    bool try_pop(T& item) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (queue_.empty()) return false;
-        item = std::move(queue_.front());
-        queue_.pop();
-        return true;
-    }
-
-    // Pop with wait (blocking)
-    bool wait_pop(T& item) {
-        std::unique_lock<std::mutex> lock(mutex_);
-        cv_.wait(lock, [this] { return !queue_.empty() || done_; });
-        if (queue_.empty()) return false;
-        item = std::move(queue_.front());
-        queue_.pop();
-        return true;
-    }
-
-    // Signal that no more items will be added
-    void set_done() {
-        {
-            std::lock_guard<std::mutex> lock(mutex_);
-            done_ = true;
-        }
-        cv_.notify_all();
-    }
-
-    bool is_done() const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return done_ && queue_.empty();
-    }
-
-    size_t size() const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return queue_.size();
-    }
-
-private:
-    mutable std::mutex mutex_;
-    std::condition_variable cv_;
-    std::queue<T> queue_;
-    bool done_ = false;
-};
-
 // ============================================================
 // File Work Item - what gets passed to workers
 // ============================================================
 struct FileWorkItem {
+    static constexpr uint64_t UNKNOWN_SIZE = UINT64_MAX;
+
     std::string src_path;
     std::string dst_path;
     ino_t inode = 0;  // For sorting by disk location
+    uint64_t size = UNKNOWN_SIZE;  // Known from the scan (enables small-file chains)
+    mode_t mode = 0;
+    struct timespec mtime = {0, UTIME_OMIT};  // Stamped on the copy (incremental)
+    uint64_t extent = 0;  // First physical data byte (--extent-order), 0 = unknown
+
+    // Segment of a split file: range_len bytes at range_offset
+    std::shared_ptr<SplitFile> split = nullptr;
+    uint64_t range_offset = 0;
+    uint64_t range_len = 0;
 };
 
+// ============================================================
+// Split Work Items - large files as range segments
+// ============================================================
+// A multiple of every auto-tuned chunk size, so segment reads stay whole
+constexpr uint64_t SPLIT_SEGMENT = 8 * 1024 * 1024;
+
 // Legacy struct for backwards compatibility (single-file mode)
 struct RequestContext {
     OpType type;
@@ -0,0 +1,286 @@
+#pragma once
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <lz4.h>
+#include <zstd.h>
+
+#include "protocol.hpp"
+
+// Chunk compression for network transfers (--compress)
+// The sender compresses chunks on a thread pool so its ring loop never
+// blocks; the receiver decompresses inline (much cheaper than compressing).
+
+// ============================================================
+// Codecs
+// ============================================================
+
+// Levels run from fastest (min) to strongest (max). zstd levels are used
+// as-is; lz4 levels map to LZ4_compress_fast acceleration 8, 4, 2, 1.
+struct CodecLevels {
+    int min;
+    int max;
+    int initial;
+};
+
+inline CodecLevels codec_levels(protocol::Codec codec) {
+    if (codec == protocol::Codec::LZ4) return {1, 4, 4};
+    return {1, 9, 3};
+}
+
+inline const char* codec_name(protocol::Codec codec) {
+    switch (codec) {
+        case protocol::Codec::ZSTD: return "zstd";
+        case protocol::Codec::LZ4:  return "lz4";
+        default:                    return "none";
+    }
+}
+
+// Worst-case compressed size of len bytes
+inline size_t compress_bound(protocol::Codec codec, size_t len) {
+    if (codec == protocol::Codec::LZ4) return LZ4_compressBound(static_cast<int>(len));
+    return ZSTD_compressBound(len);
+}
+
+// Per-thread codec state (zstd contexts are reused across chunks)
+class ChunkCodec {
+public:
+    ChunkCodec() : cctx_(ZSTD_createCCtx()), dctx_(ZSTD_createDCtx()) {
+        if (!cctx_ || !dctx_) {
+            ZSTD_freeCCtx(cctx_);
+            ZSTD_freeDCtx(dctx_);
+            throw std::runtime_error("Failed to create zstd context");
+        }
+    }
+
+    ~ChunkCodec() {
+        ZSTD_freeCCtx(cctx_);
+        ZSTD_freeDCtx(dctx_);
+    }
+
+    ChunkCodec(const ChunkCodec&) = delete;
+    ChunkCodec& operator=(const ChunkCodec&) = delete;
+
+    // Returns the compressed size, or 0 if compression failed
+    size_t compress(protocol::Codec codec, int level, const uint8_t* src, size_t len,
+                    uint8_t* dst, size_t cap) {
+        if (codec == protocol::Codec::LZ4) {
+            int accel = 1 << (codec_levels(codec).max - level);
+            int n = LZ4_compress_fast(reinterpret_cast<const char*>(src),
+                                      reinterpret_cast<char*>(dst), static_cast<int>(len),
+                                      static_cast<int>(cap), accel);
+            return n > 0 ? n : 0;
+        }
+        size_t n = ZSTD_compressCCtx(cctx_, dst, cap, src, len, level);
+        return ZSTD_isError(n) ? 0 : n;
+    }
+
+    // Decompress exactly raw_len bytes; false on corrupt input
+    bool decompress(protocol::Codec codec, const uint8_t* src, size_t len,
+                    uint8_t* dst, size_t raw_len) {
+        if (codec == protocol::Codec::LZ4) {
+            int n = LZ4_decompress_safe(reinterpret_cast<const char*>(src),
+                                        reinterpret_cast<char*>(dst), static_cast<int>(len),
+                                        static_cast<int>(raw_len));
+            return n >= 0 && static_cast<size_t>(n) == raw_len;
+        }
+        size_t n = ZSTD_decompressDCtx(dctx_, dst, raw_len, src, len);
+        return !ZSTD_isError(n) && n == raw_len;
+    }
+
+private:
+    ZSTD_CCtx* cctx_;
+    ZSTD_DCtx* dctx_;
+};
+
+// ============================================================
+// Compression Thread Pool
+// ============================================================
+
+class CompressSink;
+
+struct CompressJob {
+    uint64_t seq = 0;               // Caller's id for the chunk
+    protocol::Codec codec = protocol::Codec::ZSTD;
+    int level = 1;
+    const uint8_t* src = nullptr;
+    uint32_t len = 0;
+    uint8_t* dst = nullptr;
+    size_t cap = 0;
+    CompressSink* sink = nullptr;
+
+    // Filled in by the worker
+    size_t out_len = 0;             // 0 = failed
+    double seconds = 0;             // Time spent compressing
+};
+
+// Finished jobs for one ring loop. Every push bumps the eventfd, which the
+// loop keeps a read posted on, so completions arrive as CQEs.
+class CompressSink {
+public:
+    CompressSink() : efd_(eventfd(0, EFD_CLOEXEC)) {
+        if (efd_ < 0) throw std::runtime_error("Failed to create eventfd");
+    }
+
+    ~CompressSink() { close(efd_); }
+
+    CompressSink(const CompressSink&) = delete;
+    CompressSink& operator=(const CompressSink&) = delete;
+
+    int fd() const { return efd_; }
+
+    void push(const CompressJob& job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_.push_back(job);
+        }
+        uint64_t one = 1;
+        ssize_t n = write(efd_, &one, sizeof(one));
+        (void)n;
+    }
+
+    // Move all finished jobs into out (cleared first)
+    void drain(std::vector<CompressJob>& out) {
+        out.clear();
+        std::lock_guard<std::mutex> lock(mutex_);
+        out.swap(done_);
+    }
+
+private:
+    int efd_;
+    std::mutex mutex_;
+    std::vector<CompressJob> done_;
+};
+
+// Shared by every stream of a transfer
+class CompressPool {
+public:
+    explicit CompressPool(size_t threads) {
+        threads = std::max<size_t>(threads, 1);
+        for (size_t i = 0; i < threads; i++) {
+            workers_.emplace_back([this] { worker(); });
+        }
+    }
+
+    ~CompressPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& t : workers_) t.join();
+    }
+
+    CompressPool(const CompressPool&) = delete;
+    CompressPool& operator=(const CompressPool&) = delete;
+
+    size_t threads() const { return workers_.size(); }
+
+    void submit(const CompressJob& job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            jobs_.push_back(job);
+        }
+        cv_.notify_one();
+    }
+
+private:
+    void worker() {
+        ChunkCodec codec;
+        while (true) {
+            CompressJob job;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+                if (jobs_.empty()) return;
+                job = jobs_.front();
+                jobs_.pop_front();
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            job.out_len = codec.compress(job.codec, job.level, job.src, job.len, job.dst, job.cap);
+            job.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            job.sink->push(job);
+        }
+    }
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<CompressJob> jobs_;
+    bool stop_ = false;
+};
+
+// ============================================================
+// Adaptive Level
+// ============================================================
+// Compares what the compressors can emit per second (compressed bytes per
+// busy second, times the threads this stream can use) with what the socket
+// drains per second while sending. A compressor slower than the socket
+// starves it, so the level drops; one with plenty of headroom can afford a
+// better ratio, which saves bandwidth on a slow link.
+
+class LevelController {
+public:
+    static constexpr size_t WINDOW_CHUNKS = 32;   // Chunks per decision
+    static constexpr double HEADROOM = 2.0;       // Raise only with this much spare
+
+    LevelController(protocol::Codec codec, double parallelism)
+        : levels_(codec_levels(codec)), level_(levels_.initial),
+          parallelism_(std::max(parallelism, 0.1)) {}
+
+    int level() const { return level_; }
+
+    void on_compressed(size_t out_bytes, double seconds) {
+        out_bytes_ += out_bytes;
+        compress_seconds_ += seconds;
+        if (++chunks_ >= WINDOW_CHUNKS) adapt();
+    }
+
+    // A send chain finished: bytes on the wire over the time it was in flight
+    void on_sent(size_t bytes, double seconds) {
+        sent_bytes_ += bytes;
+        send_seconds_ += seconds;
+    }
+
+    static int next_level(int level, double compress_bps, double socket_bps,
+                          const CodecLevels& levels) {
+        if (compress_bps <= 0 || socket_bps <= 0) return level;
+        if (compress_bps < socket_bps) return std::max(level - 1, levels.min);
+        if (compress_bps > socket_bps * HEADROOM) return std::min(level + 1, levels.max);
+        return level;
+    }
+
+private:
+    void adapt() {
+        if (compress_seconds_ > 0 && send_seconds_ > 0) {
+            double compress_bps = out_bytes_ / compress_seconds_ * parallelism_;
+            double socket_bps = sent_bytes_ / send_seconds_;
+            level_ = next_level(level_, compress_bps, socket_bps, levels_);
+        }
+        chunks_ = 0;
+        out_bytes_ = 0;
+        compress_seconds_ = 0;
+        sent_bytes_ = 0;
+        send_seconds_ = 0;
+    }
+
+    CodecLevels levels_;
+    int level_;
+    double parallelism_;
+
+    size_t chunks_ = 0;
+    double out_bytes_ = 0;
+    double compress_seconds_ = 0;
+    double sent_bytes_ = 0;
+    double send_seconds_ = 0;
+};
@@ -0,0 +1,192 @@
+#pragma once
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <istream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "protocol.hpp"
+
+// Receiver daemon (recv --daemon)
+// One long-running receiver serves many sender sessions at once. The
+// secret in a stream's HELLO picks its route: the destination root its
+// files land under. Routes come from a config file plus the command
+// line's <dest> and --secret. A session is the set of streams sharing a
+// session id under one route; it ends when all of them have finished.
+
+// ============================================================
+// Routes
+// ============================================================
+
+struct DaemonRoute {
+    std::string secret;             // Empty: any secret (no authentication)
+    std::string root;
+};
+
+// Parse a route config: one "<secret> <root>" per line, blank lines and
+// '#' comments skipped. The root is the rest of the line, so it may hold
+// spaces. False (with error set) on a malformed line or a repeated secret.
+inline bool parse_daemon_routes(std::istream& in, std::vector<DaemonRoute>& routes,
+                                std::string& error) {
+    std::string line;
+    for (size_t lineno = 1; std::getline(in, line); lineno++) {
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+        while (!line.empty() && isspace(static_cast<unsigned char>(line.back()))) line.pop_back();
+
+        std::istringstream fields(line);
+        DaemonRoute route;
+        if (!(fields >> route.secret)) continue;
+        std::getline(fields >> std::ws, route.root);
+
+        if (route.root.empty()) {
+            error = "line " + std::to_string(lineno) + ": expected <secret> <root>";
+            return false;
+        }
+        if (route.secret.size() > protocol::MAX_SECRET_LEN) {
+            error = "line " + std::to_string(lineno) + ": secret too long";
+            return false;
+        }
+        for (const auto& r : routes) {
+            if (r.secret == route.secret) {
+                error = "line " + std::to_string(lineno) + ": secret listed twice";
+                return false;
+            }
+        }
+        routes.push_back(std::move(route));
+    }
+    return true;
+}
+
+inline bool load_daemon_routes(const std::string& path, std::vector<DaemonRoute>& routes,
+                               std::string& error) {
+    std::ifstream in(path);
+    if (!in) {
+        error = "cannot open " + path;
+        return false;
+    }
+    return parse_daemon_routes(in, routes, error);
+}
+
+// The route of a HELLO's secret: an exact match, else a route without a
+// secret, else null
+inline const DaemonRoute* find_route(const std::vector<DaemonRoute>& routes,
+                                     const std::string& secret) {
+    const DaemonRoute* open = nullptr;
+    for (const auto& r : routes) {
+        if (r.secret.empty()) {
+            if (!open) open = &r;
+        } else if (r.secret == secret) {
+            return &r;
+        }
+    }
+    return open;
+}
+
+// ============================================================
+// Sessions
+// ============================================================
+
+// Streams of the sessions being received, keyed by (root, session id).
+// Called from every stream thread.
+class SessionTable {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Totals {
+        uint64_t id = 0;
+        std::string root;
+        uint16_t count = 0;             // Streams the sender announced
+        uint16_t joined = 0;
+        size_t received = 0;
+        size_t corrupt = 0;
+        size_t unwritten = 0;           // Files a disk error kept from landing
+        bool failed = false;
+        std::vector<std::pair<std::string, std::string>> links;    // FILE_LINKs, made at the end
+    };
+
+    enum class Join {
+        FIRST,      // Opened the session
+        JOINED,
+        REJECTED    // Another count, or this stream index already joined
+    };
+
+    Join join(const std::string& root, const protocol::SessionInfo& info, Clock::time_point now) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto [it, fresh] = sessions_.try_emplace({root, info.id});
+        Session& s = it->second;
+        if (fresh) {
+            s.totals.id = info.id;
+            s.totals.root = root;
+            s.totals.count = info.count;
+            s.joined.assign(info.count, 0);
+            s.started = now;
+        } else if (info.count != s.totals.count || s.joined[info.index]) {
+            return Join::REJECTED;
+        }
+        s.joined[info.index] = 1;
+        s.totals.joined++;
+        s.running++;
+        return fresh ? Join::FIRST : Join::JOINED;
+    }
+
+    // A joined stream ended, with the links it received; true (with the
+    // session's totals) if it was the session's last
+    bool finish(const std::string& root, uint64_t id, size_t received, size_t corrupt,
+                size_t unwritten, bool failed, Totals& out,
+                const std::vector<std::pair<std::string, std::string>>& links = {}) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = sessions_.find({root, id});
+        if (it == sessions_.end()) return false;
+        Session& s = it->second;
+        s.running--;
+        s.totals.received += received;
+        s.totals.corrupt += corrupt;
+        s.totals.unwritten += unwritten;
+        s.totals.failed = s.totals.failed || failed;
+        s.totals.links.insert(s.totals.links.end(), links.begin(), links.end());
+        if (s.running > 0 || s.totals.joined < s.totals.count) return false;
+        out = std::move(s.totals);
+        sessions_.erase(it);
+        return true;
+    }
+
+    // Remove sessions still short of streams after timeout, once none of
+    // their joined streams is running; a stream that turns up later
+    // starts a session of its own
+    std::vector<Totals> expire(Clock::time_point now, Clock::duration timeout) {
+        std::vector<Totals> out;
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = sessions_.begin(); it != sessions_.end();) {
+            if (it->second.running == 0 && now - it->second.started >= timeout) {
+                out.push_back(std::move(it->second.totals));
+                it = sessions_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        return out;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return sessions_.size();
+    }
+
+private:
+    struct Session {
+        Totals totals;
+        std::vector<char> joined;       // Per stream index
+        uint16_t running = 0;           // Joined streams not yet finished
+        Clock::time_point started;
+    };
+
+    mutable std::mutex mutex_;
+    std::map<std::pair<std::string, uint64_t>, Session> sessions_;
+};
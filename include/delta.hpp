@@ -0,0 +1,514 @@
+#pragma once
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include <liburing.h>
+#include <openssl/evp.h>
+
+#include "checksum.hpp"
+#include "common.hpp"
+#include "manifest.hpp"
+#include "protocol.hpp"
+
+// Block delta for changed files (--delta)
+// The receiver splits its copy into blocks and sends a weak rolling checksum
+// and a strong hash per block. The sender slides a window over the new
+// file; where the weak sum hits and the strong hash confirms, it sends a
+// block reference instead of the bytes. Everything else goes as literals.
+
+// Files smaller than this are cheaper to resend than to diff
+constexpr uint64_t DELTA_MIN_FILE_SIZE = 1024 * 1024;
+
+// ============================================================
+// Weak Checksum
+// ============================================================
+// rsync-style: a = sum of bytes, b = sum of (n - i) * byte. Both wrap mod
+// 2^32 and are packed mod 2^16. Sliding one byte is O(1):
+//   a' = a - out + in,  b' = b - n * out + a'
+
+inline uint32_t weak_pack(uint32_t a, uint32_t b) {
+    return (a & 0xffff) | (b << 16);
+}
+
+inline void weak_block_scalar(const uint8_t* p, size_t n, uint32_t& a, uint32_t& b) {
+    uint32_t sa = 0, sb = 0;
+    for (size_t i = 0; i < n; i++) {
+        sa += p[i];
+        sb += static_cast<uint32_t>(n - i) * p[i];
+    }
+    a = sa;
+    b = sb;
+}
+
+// Whole-block sums, 32 bytes per step with AVX2. Per chunk k (S_k its byte
+// sum, W_k the sum of j * byte_j within it), over K full chunks:
+//   b = (n - 32K) * A + 32 * sum_k (K - k) * S_k - sum_k W_k
+// and sum_k (K - k) * S_k is the sum of the running totals of S.
+inline void weak_block(const uint8_t* p, size_t n, uint32_t& a, uint32_t& b) {
+#ifdef __AVX2__
+    size_t chunks = n / 32;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi16(1);
+    const __m256i weights = _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+                                             16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28,
+                                             29, 30, 31);
+    __m256i vs = zero;      // Running byte sum (u64 lanes)
+    __m256i vps = zero;     // Sum of running sums
+    __m256i vw = zero;      // Position-weighted sums (i32 lanes)
+    for (size_t k = 0; k < chunks; k++) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32 * k));
+        vs = _mm256_add_epi64(vs, _mm256_sad_epu8(x, zero));
+        vps = _mm256_add_epi64(vps, vs);
+        vw = _mm256_add_epi32(vw, _mm256_madd_epi16(_mm256_maddubs_epi16(x, weights), ones));
+    }
+
+    alignas(32) uint64_t s[4], ps[4];
+    alignas(32) uint32_t w[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(s), vs);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(ps), vps);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(w), vw);
+    uint32_t sa = static_cast<uint32_t>(s[0] + s[1] + s[2] + s[3]);
+    uint32_t sps = static_cast<uint32_t>(ps[0] + ps[1] + ps[2] + ps[3]);
+    uint32_t sw = 0;
+    for (uint32_t v : w) sw += v;
+
+    size_t done = 32 * chunks;
+    uint32_t sb = static_cast<uint32_t>(n - done) * sa + 32 * sps - sw;
+    for (size_t i = done; i < n; i++) {
+        sa += p[i];
+        sb += static_cast<uint32_t>(n - i) * p[i];
+    }
+    a = sa;
+    b = sb;
+#else
+    weak_block_scalar(p, n, a, b);
+#endif
+}
+
+class RollingChecksum {
+public:
+    void reset(const uint8_t* p, size_t n) {
+        weak_block(p, n, a_, b_);
+        n_ = static_cast<uint32_t>(n);
+    }
+
+    void roll(uint8_t out, uint8_t in) {
+        a_ += static_cast<uint32_t>(in) - out;
+        b_ += a_ - n_ * out;
+    }
+
+    uint32_t value() const { return weak_pack(a_, b_); }
+
+private:
+    uint32_t a_ = 0;
+    uint32_t b_ = 0;
+    uint32_t n_ = 0;
+};
+
+// ============================================================
+// Strong Hash
+// ============================================================
+// SHA-256 truncated to 16 bytes; libcrypto picks the SHA-NI / AVX2 kernel
+
+class StrongHasher {
+public:
+    StrongHasher() : ctx_(EVP_MD_CTX_new()) {
+        if (!ctx_) throw std::runtime_error("Failed to create digest context");
+    }
+
+    ~StrongHasher() { EVP_MD_CTX_free(ctx_); }
+
+    StrongHasher(const StrongHasher&) = delete;
+    StrongHasher& operator=(const StrongHasher&) = delete;
+
+    void hash(const uint8_t* p, size_t n, uint8_t out[protocol::DELTA_STRONG_SIZE]) {
+        uint8_t digest[EVP_MAX_MD_SIZE];
+        unsigned int len = 0;
+        EVP_DigestInit_ex(ctx_, EVP_sha256(), nullptr);
+        EVP_DigestUpdate(ctx_, p, n);
+        EVP_DigestFinal_ex(ctx_, digest, &len);
+        memcpy(out, digest, protocol::DELTA_STRONG_SIZE);
+    }
+
+private:
+    EVP_MD_CTX* ctx_;
+};
+
+// ============================================================
+// Signatures (receiver)
+// ============================================================
+
+// About sqrt(size), as a power of two in 4KB..128KB; larger only to stay
+// under MAX_SIG_BLOCKS
+inline uint32_t choose_block_size(uint64_t file_size) {
+    uint32_t bs = 4096;
+    while (bs < 128 * 1024 && static_cast<uint64_t>(bs) * bs < file_size) bs *= 2;
+    while ((file_size + bs - 1) / bs > protocol::MAX_SIG_BLOCKS) bs *= 2;
+    return bs;
+}
+
+// Signature of an open file, read through io_uring with a few large reads
+// in flight. False if the file can't be read in full (e.g. it shrank).
+inline bool compute_signature(int fd, uint64_t file_size, protocol::Signature& out) {
+    constexpr unsigned QD = 4;
+    out.file_size = file_size;
+    out.block_size = choose_block_size(file_size);
+    out.blocks.clear();
+    if (file_size == 0) return true;
+
+    const uint32_t bs = out.block_size;
+    const size_t read_size = std::max<size_t>(1024 * 1024, bs);   // Whole blocks per read
+    const uint64_t segments = (file_size + read_size - 1) / read_size;
+    out.blocks.resize((file_size + bs - 1) / bs);
+
+    struct io_uring ring;
+    if (io_uring_queue_init(QD, &ring, 0) < 0) return false;
+    BufferPool buffers(QD, read_size);
+    StrongHasher hasher;
+
+    auto seg_len = [&](uint64_t seg) {
+        return std::min<uint64_t>(read_size, file_size - seg * read_size);
+    };
+    std::vector<int> result(QD, 0);
+    std::vector<char> ready(QD, 0);
+    uint64_t submitted = 0, processed = 0;
+    unsigned in_flight = 0;
+    bool ok = true;
+
+    while (ok && processed < segments) {
+        // Slots are reused in order, so at most QD segments are unprocessed
+        while (submitted < segments && submitted - processed < QD) {
+            struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+            unsigned slot = submitted % QD;
+            io_uring_prep_read(sqe, fd, buffers.buffers()[slot], seg_len(submitted),
+                               submitted * read_size);
+            io_uring_sqe_set_data64(sqe, submitted);
+            submitted++;
+            in_flight++;
+        }
+        io_uring_submit(&ring);
+
+        struct io_uring_cqe* cqe;
+        if (io_uring_wait_cqe(&ring, &cqe) < 0) {
+            ok = false;
+            break;
+        }
+        unsigned slot = io_uring_cqe_get_data64(cqe) % QD;
+        result[slot] = cqe->res;
+        ready[slot] = 1;
+        io_uring_cqe_seen(&ring, cqe);
+        in_flight--;
+
+        // Hash completed segments in file order
+        while (ok && processed < segments && ready[processed % QD]) {
+            unsigned s = processed % QD;
+            uint64_t len = seg_len(processed);
+            if (result[s] < 0 || static_cast<uint64_t>(result[s]) != len) {
+                ok = false;
+                break;
+            }
+            const uint8_t* data = reinterpret_cast<const uint8_t*>(buffers.buffers()[s]);
+            size_t first = processed * read_size / bs;
+            for (uint64_t off = 0; off < len; off += bs) {
+                size_t n = std::min<uint64_t>(bs, len - off);
+                protocol::BlockSig& sig = out.blocks[first + off / bs];
+                uint32_t a, b;
+                weak_block(data + off, n, a, b);
+                sig.weak = weak_pack(a, b);
+                hasher.hash(data + off, n, sig.strong);
+            }
+            ready[s] = 0;
+            processed++;
+        }
+    }
+
+    // Reap reads still in flight before their buffers go away
+    while (in_flight > 0) {
+        struct io_uring_cqe* cqe;
+        if (io_uring_wait_cqe(&ring, &cqe) < 0) break;
+        io_uring_cqe_seen(&ring, cqe);
+        in_flight--;
+    }
+    io_uring_queue_exit(&ring);
+    if (!ok) out.blocks.clear();
+    return ok;
+}
+
+// ============================================================
+// Matching (sender)
+// ============================================================
+
+// Blocks by weak sum, behind a 64K-bit tag table that rejects most
+// window positions with one load
+class DeltaIndex {
+public:
+    explicit DeltaIndex(const protocol::Signature& sig) : sig_(sig), tags_(TAG_WORDS, 0) {
+        order_.resize(sig.blocks.size());
+        for (uint32_t i = 0; i < order_.size(); i++) order_[i] = i;
+        std::sort(order_.begin(), order_.end(), [&sig](uint32_t x, uint32_t y) {
+            return sig.blocks[x].weak < sig.blocks[y].weak;
+        });
+        for (const auto& b : sig.blocks) {
+            uint32_t t = tag(b.weak);
+            tags_[t / 64] |= 1ULL << (t % 64);
+        }
+    }
+
+    // Block whose weak sum and strong hash match this window, or -1. The
+    // block after the previous match is tried first (runs of unchanged data).
+    int64_t find(uint32_t weak, const uint8_t* window, size_t len, StrongHasher& hasher,
+                 int64_t hint) const {
+        uint32_t t = tag(weak);
+        if (!(tags_[t / 64] & (1ULL << (t % 64)))) return -1;
+
+        uint8_t strong[protocol::DELTA_STRONG_SIZE];
+        bool hashed = false;
+        auto confirm = [&](uint32_t idx) {
+            if (block_len(idx) != len) return false;
+            if (!hashed) {
+                hasher.hash(window, len, strong);
+                hashed = true;
+            }
+            return memcmp(strong, sig_.blocks[idx].strong, sizeof(strong)) == 0;
+        };
+
+        if (hint >= 0 && hint < (int64_t)sig_.blocks.size() &&
+            sig_.blocks[hint].weak == weak && confirm(static_cast<uint32_t>(hint))) {
+            return hint;
+        }
+        auto it = std::lower_bound(order_.begin(), order_.end(), weak,
+                                   [this](uint32_t idx, uint32_t w) {
+                                       return sig_.blocks[idx].weak < w;
+                                   });
+        for (; it != order_.end() && sig_.blocks[*it].weak == weak; ++it) {
+            if (confirm(*it)) return *it;
+        }
+        return -1;
+    }
+
+    size_t block_len(uint32_t idx) const {
+        uint64_t off = static_cast<uint64_t>(idx) * sig_.block_size;
+        return static_cast<size_t>(std::min<uint64_t>(sig_.block_size, sig_.file_size - off));
+    }
+
+private:
+    static constexpr size_t TAG_WORDS = (1 << 16) / 64;
+
+    static uint32_t tag(uint32_t weak) {
+        return (weak * 0x9E3779B1u) >> 16;
+    }
+
+    const protocol::Signature& sig_;
+    std::vector<uint32_t> order_;
+    std::vector<uint64_t> tags_;
+};
+
+// Walk data against the signature, calling sink.literal(ptr, len) and
+// sink.copy(first_block, count) in file order. Adjacent block references
+// are merged into one copy.
+template <typename Sink>
+inline void encode_delta(const uint8_t* data, uint64_t size, const protocol::Signature& sig,
+                         Sink& sink) {
+    if (sig.blocks.empty() || sig.block_size == 0) {
+        if (size > 0) sink.literal(data, size);
+        return;
+    }
+
+    DeltaIndex index(sig);
+    StrongHasher hasher;
+    const uint64_t bs = sig.block_size;
+    const uint32_t last = static_cast<uint32_t>(sig.blocks.size() - 1);
+
+    uint64_t lit_start = 0;
+    int64_t run_first = -1;
+    uint32_t run_count = 0;
+
+    auto flush_run = [&] {
+        if (run_count > 0) sink.copy(static_cast<uint32_t>(run_first), run_count);
+        run_count = 0;
+    };
+    auto matched = [&](uint64_t pos, uint32_t block) {
+        if (pos > lit_start) {
+            flush_run();
+            sink.literal(data + lit_start, pos - lit_start);
+        }
+        if (run_count > 0 && block == run_first + run_count) {
+            run_count++;
+        } else {
+            flush_run();
+            run_first = block;
+            run_count = 1;
+        }
+        lit_start = pos + index.block_len(block);
+    };
+
+    uint64_t pos = 0;
+    int64_t hint = 0;
+    RollingChecksum roll;
+    if (size >= bs) roll.reset(data, bs);
+    while (pos + bs <= size) {
+        int64_t block = index.find(roll.value(), data + pos, bs, hasher, hint);
+        if (block >= 0) {
+            matched(pos, static_cast<uint32_t>(block));
+            hint = block + 1;
+            pos += bs;
+            if (pos + bs <= size) roll.reset(data + pos, bs);
+            continue;
+        }
+        if (pos + bs < size) roll.roll(data[pos], data[pos + bs]);
+        pos++;
+    }
+
+    // A short last block can only match the very end of the file
+    size_t tail = index.block_len(last);
+    if (tail < bs && size >= tail && size - tail >= lit_start) {
+        uint32_t a, b;
+        weak_block(data + size - tail, tail, a, b);
+        if (index.find(weak_pack(a, b), data + size - tail, tail, hasher, last) == last) {
+            matched(size - tail, last);
+        }
+    }
+
+    if (size > lit_start) {
+        flush_run();
+        sink.literal(data + lit_start, size - lit_start);
+    }
+    flush_run();
+}
+
+// ============================================================
+// Patching (receiver)
+// ============================================================
+// Rebuilds a file next to the old copy from block references and literals,
+// then renames it over the old one; nothing is lost if the transfer dies.
+
+class DeltaPatcher {
+public:
+    DeltaPatcher() = default;
+    ~DeltaPatcher() { abort(); }
+
+    DeltaPatcher(const DeltaPatcher&) = delete;
+    DeltaPatcher& operator=(const DeltaPatcher&) = delete;
+
+    bool open(const std::string& path, uint32_t mode, uint32_t block_size) {
+        abort();
+        path_ = path;
+        tmp_path_ = path + ".uring-sync.delta";
+        block_size_ = block_size;
+        offset_ = 0;
+        copied_ = 0;
+
+        old_fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (old_fd_ < 0 || fstat(old_fd_, &st) != 0 || !S_ISREG(st.st_mode)) return false;
+        old_size_ = st.st_size;
+        fd_ = ::open(tmp_path_.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, mode & 0777);
+        return fd_ >= 0;
+    }
+
+    // Blocks [first, first + count) of the old copy (the last may be short)
+    bool copy(uint32_t first, uint32_t count) {
+        uint64_t off = static_cast<uint64_t>(first) * block_size_;
+        if (count == 0 || off >= old_size_) return false;
+        uint64_t len = std::min<uint64_t>(static_cast<uint64_t>(count) * block_size_,
+                                          old_size_ - off);
+        loff_t in = off, out = offset_;
+        uint64_t left = len;
+        while (left > 0) {
+            ssize_t n = copy_file_range(old_fd_, &in, fd_, &out, left, 0);
+            if (n < 0 && (errno == EXDEV || errno == EINVAL || errno == ENOSYS ||
+                          errno == EOPNOTSUPP)) {
+                return copy_by_reading(in, out, left) && advance(len);
+            }
+            if (n <= 0) return false;
+            left -= n;
+        }
+        return advance(len);
+    }
+
+    bool write(const uint8_t* data, size_t len) {
+        if (pwrite(fd_, data, len, offset_) != (ssize_t)len) return false;
+        offset_ += len;
+        return true;
+    }
+
+    // CRC32C of the file as rebuilt so far (verify). Copied blocks never
+    // pass through userspace, so this reads the new file back.
+    bool checksum(uint32_t& crc) {
+        std::vector<uint8_t> buf(std::min<uint64_t>(std::max<uint64_t>(offset_, 1), 1024 * 1024));
+        crc = 0;
+        for (uint64_t off = 0; off < offset_;) {
+            size_t n = std::min<uint64_t>(offset_ - off, buf.size());
+            if (pread(fd_, buf.data(), n, off) != (ssize_t)n) return false;
+            crc = crc32c(crc, buf.data(), n);
+            off += n;
+        }
+        return true;
+    }
+
+    // Check the size, stamp the mtime and replace the old copy
+    bool finish(uint64_t size, int64_t mtime_ns) {
+        bool ok = offset_ == size && ftruncate(fd_, size) == 0;
+        if (ok) set_mtime(fd_, mtime_ns);
+        ok = ::close(fd_) == 0 && ok;
+        fd_ = -1;
+        if (ok) ok = rename(tmp_path_.c_str(), path_.c_str()) == 0;
+        abort();
+        return ok;
+    }
+
+    // Drop the partial file (no-op once finished)
+    void abort() {
+        if (old_fd_ >= 0) ::close(old_fd_);
+        old_fd_ = -1;
+        if (fd_ >= 0) {
+            ::close(fd_);
+            unlink(tmp_path_.c_str());
+        }
+        fd_ = -1;
+    }
+
+    uint64_t copied() const { return copied_; }
+
+private:
+    bool advance(uint64_t len) {
+        offset_ += len;
+        copied_ += len;
+        return true;
+    }
+
+    bool copy_by_reading(loff_t in, loff_t out, uint64_t left) {
+        std::vector<uint8_t> buf(std::min<uint64_t>(left, 1024 * 1024));
+        while (left > 0) {
+            size_t n = std::min<uint64_t>(left, buf.size());
+            if (pread(old_fd_, buf.data(), n, in) != (ssize_t)n) return false;
+            if (pwrite(fd_, buf.data(), n, out) != (ssize_t)n) return false;
+            in += n;
+            out += n;
+            left -= n;
+        }
+        return true;
+    }
+
+    std::string path_;
+    std::string tmp_path_;
+    int old_fd_ = -1;
+    int fd_ = -1;
+    uint64_t old_size_ = 0;
+    uint32_t block_size_ = 0;
+    uint64_t offset_ = 0;
+    uint64_t copied_ = 0;
+};
@@ -0,0 +1,128 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Disk side of the io_uring receiver: the parent directory cache, and the
+// ops a stream hands to its disk workers (recv --write-workers). The ring
+// work itself (prep, submit, doorbells) stays in net_uring.cpp.
+
+// ============================================================
+// Parent Directories
+// ============================================================
+// Files arrive mostly directory by directory, so each stream remembers
+// the directories it has seen made and asks only for the others, as
+// mkdirat ops hard-linked ahead of the file's open, outermost first.
+// EEXIST (a sibling's mkdirat, another stream, an old copy) does not
+// break the chain. A directory counts as made once its mkdirat
+// completes: until then each file below it chains its own, so no open
+// can overtake the mkdirat it depends on. Deeper runs than
+// MAX_DIR_CHAIN are made synchronously instead.
+
+constexpr size_t MAX_DIR_CHAIN = 8;
+
+class DirCache {
+public:
+    explicit DirCache(const std::string& root) : root_len_(root.size()) {
+        while (root_len_ > 1 && root[root_len_ - 1] == '/') root_len_--;
+    }
+
+    // Parents of path (below the root) not seen made, outermost first
+    void missing(const std::string& path, std::vector<std::string>& out) const {
+        out.clear();
+        for (size_t end = path.rfind('/'); end != std::string::npos && end > root_len_;
+             end = path.rfind('/', end - 1)) {
+            std::string dir = path.substr(0, end);
+            if (made_.count(dir)) break;
+            out.push_back(std::move(dir));
+        }
+        std::reverse(out.begin(), out.end());
+    }
+
+    void made(const std::string& dir) { made_.insert(dir); }
+
+private:
+    size_t root_len_;                           // The root itself exists
+    std::unordered_set<std::string> made_;
+};
+
+// ============================================================
+// Receiver Disk Workers
+// ============================================================
+// With write_workers, a stream's ring only receives and parses: every file
+// op goes to one of the stream's disk workers, each on its own ring, and
+// its result comes back to the stream's state machine as if the stream's
+// ring had run it. Ops of one file go to the same worker. Each direction
+// is a locked list plus an IORING_OP_MSG_RING doorbell (5.18+) into the
+// other side's ring, rung when the list goes from empty to non-empty, so
+// both sides wait only in io_uring_submit_and_wait.
+
+struct DiskOp {
+    enum Kind : uint8_t { OPEN, OPEN_DIRECT, MKDIR, WRITE, WRITE_FIXED, CLOSE, CLOSE_DIRECT };
+
+    Kind kind;
+    uint8_t sqe_flags = 0;          // IOSQE_IO_LINK or _HARDLINK: chained to the next op
+    int fd = -1;                    // Fixed-file slot for the _DIRECT and _FIXED kinds
+    uint32_t mode = 0;
+    const char* path = nullptr;     // Owned by the stream until the op completes
+    const void* buf = nullptr;
+    uint32_t len = 0;
+    uint64_t offset = 0;
+    uint64_t tag = 0;               // make_tag(RecvOp, index) of the stream
+    bool keep = false;              // OPEN: keep the bytes there (resumed file), no O_TRUNC
+    bool direct = false;            // OPEN: O_DIRECT (recv --direct)
+};
+
+struct DiskResult {
+    uint64_t tag;
+    int res;
+};
+
+// Ops queued for each worker until the stream posts them. A chain goes to
+// the worker of the file slot it belongs to, so a file's open, writes and
+// close run in order on one ring, where its fixed-file slot lives.
+class DiskOutbox {
+public:
+    void resize(size_t workers) { boxes_.assign(workers, {}); }
+    size_t workers() const { return boxes_.size(); }
+
+    static size_t worker_for(size_t slot, size_t workers) { return slot % workers; }
+
+    // Queue the chain of slot; there must be at least one worker
+    void add(size_t slot, const std::vector<DiskOp>& chain) {
+        auto& box = boxes_[worker_for(slot, boxes_.size())];
+        box.insert(box.end(), chain.begin(), chain.end());
+    }
+
+    std::vector<DiskOp>& operator[](size_t worker) { return boxes_[worker]; }
+
+private:
+    std::vector<std::vector<DiskOp>> boxes_;
+};
+
+// Locked hand-off list between two threads
+template<typename T>
+class Handoff {
+public:
+    // Append items (cleared); true if the list was empty, i.e. ring the doorbell
+    bool post(std::vector<T>& items) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bool was_empty = items_.empty();
+        items_.insert(items_.end(), items.begin(), items.end());
+        items.clear();
+        return was_empty;
+    }
+
+    void take(std::vector<T>& out) {
+        out.clear();
+        std::lock_guard<std::mutex> lock(mutex_);
+        out.swap(items_);
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<T> items_;
+};
@@ -0,0 +1,106 @@
+#pragma once
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Physical extent ordering (--extent-order)
+// Inode numbers only approximate where a file's data sits: ext4 and xfs
+// allocate data near the inode's group, but files that grew later,
+// were rewritten, or come from another directory land elsewhere. FIEMAP
+// names the first physical byte of the data, so files can be read in
+// the order the head (or the volume's backing blocks) passes them.
+
+// ============================================================
+// First Extent
+// ============================================================
+
+enum class ExtentLookup : uint8_t {
+    MAPPED,       // physical holds the first data byte's address
+    UNMAPPED,     // Empty, inline in the inode, or not yet allocated
+    UNSUPPORTED   // The filesystem has no FIEMAP (tmpfs, NFS, FUSE, ...)
+};
+
+inline ExtentLookup first_extent(int fd, uint64_t& physical) {
+    // One extent is all we ask for: the kernel stops mapping after it
+    alignas(struct fiemap) char buf[sizeof(struct fiemap) + sizeof(struct fiemap_extent)] = {};
+    auto* map = reinterpret_cast<struct fiemap*>(buf);
+    map->fm_start = 0;
+    map->fm_length = FIEMAP_MAX_OFFSET;
+    map->fm_extent_count = 1;
+
+    if (ioctl(fd, FS_IOC_FIEMAP, map) != 0) {
+        return (errno == EOPNOTSUPP || errno == ENOTTY) ? ExtentLookup::UNSUPPORTED
+                                                        : ExtentLookup::UNMAPPED;
+    }
+    const struct fiemap_extent& extent = map->fm_extents[0];
+    if (map->fm_mapped_extents == 0 ||
+        (extent.fe_flags & (FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DATA_INLINE))) {
+        return ExtentLookup::UNMAPPED;
+    }
+    physical = extent.fe_physical;
+    return ExtentLookup::MAPPED;
+}
+
+// ============================================================
+// Disk Order
+// ============================================================
+
+// Sort key for a file whose first data byte is at extent (0 = unknown).
+// Files without one come first, by inode: they are empty, inline, or on
+// a filesystem without FIEMAP, where inode order is the best guess left.
+// The rest follow by physical address.
+inline std::tuple<bool, uint64_t, ino_t> disk_order(uint64_t extent, ino_t inode) {
+    return {extent != 0, extent, inode};
+}
+
+// ============================================================
+// Sparse Files
+// ============================================================
+// A VM image or database file may hold far fewer blocks than its size.
+// Reading it linearly moves its holes as zeros; SEEK_DATA/SEEK_HOLE
+// name the runs that hold data, so only those are read and the holes
+// are left (or punched) on the destination.
+
+// Smaller files are copied linearly: the lseek round trips cost more
+// than the zeros would
+constexpr uint64_t SPARSE_MIN_SIZE = 1024 * 1024;
+
+// statx blocks (512-byte units) short of the size: some of it is a hole
+inline bool maybe_sparse(uint64_t size, uint64_t blocks) {
+    return size >= SPARSE_MIN_SIZE && blocks * 512 < size;
+}
+
+// The data runs (offset, length) of [start, end). False if the
+// filesystem cannot tell (then the whole range is data). A run may
+// hold zeros the filesystem keeps allocated; only holes are left out.
+inline bool data_runs(int fd, uint64_t start, uint64_t end,
+                      std::vector<std::pair<uint64_t, uint64_t>>& runs) {
+    runs.clear();
+    uint64_t pos = start;
+    while (pos < end) {
+        off_t data = lseek(fd, static_cast<off_t>(pos), SEEK_DATA);
+        if (data < 0) {
+            if (errno == ENXIO) break;      // Only a hole is left
+            runs.clear();
+            return false;
+        }
+        if (static_cast<uint64_t>(data) >= end) break;
+        off_t hole = lseek(fd, data, SEEK_HOLE);
+        if (hole < 0) {
+            runs.clear();
+            return false;
+        }
+        uint64_t run_end = std::min<uint64_t>(static_cast<uint64_t>(hole), end);
+        runs.emplace_back(static_cast<uint64_t>(data), run_end - static_cast<uint64_t>(data));
+        pos = run_end;
+    }
+    return true;
+}
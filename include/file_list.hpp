@@ -0,0 +1,176 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "extent.hpp"
+
+// ============================================================
+// Compact File List (send side)
+// ============================================================
+// The network sender holds every file of a transfer at once: the manifest
+// merge, the disk-order sort and the stream shards all need the whole
+// list. Paths are kept as (parent directory, name) with every name in one
+// shared string arena, so a file costs a 48-byte Entry plus its name
+// instead of two full path strings. Full paths are built only for the
+// files a stream currently has open.
+//
+// Directory 0 is the root the list was scanned from; rel_path() joins the
+// names below it, src_path() puts the root in front. Chains deeper than
+// MAX_DEPTH are refused when added, so every path can be built whole.
+
+class FileList {
+public:
+    // Deepest directory chain (PATH_MAX allows ~2048)
+    static constexpr size_t MAX_DEPTH = 2048;
+
+    // add_dir() result for a directory past MAX_DEPTH
+    static constexpr uint32_t TOO_DEEP = UINT32_MAX;
+
+    struct Entry {
+        uint64_t size = 0;              // From the scan; statx refreshes it when sent
+        int64_t mtime_ns = 0;
+        uint64_t inode = 0;
+        uint64_t extent = 0;            // First physical byte (extent order), 0 if unknown
+        uint64_t name = 0;              // Offset in the arena
+        uint32_t dir = 0;
+        uint16_t name_len = 0;
+    };
+
+    explicit FileList(std::string root = ".") { reset(std::move(root)); }
+
+    // Empty the list; paths are built under root from now on
+    void reset(std::string root) {
+        root_ = std::move(root);
+        if (root_.empty()) root_ = ".";
+        if (root_.back() != '/') root_ += '/';
+        arena_.clear();
+        dirs_.clear();
+        entries_.clear();
+        resume_.clear();
+        links_.clear();
+        dirs_.push_back({0, 0, 0, 0});
+    }
+
+    // A directory named `name` inside directory `parent`; returns its
+    // index, or TOO_DEEP (nothing added) below MAX_DEPTH levels
+    uint32_t add_dir(uint32_t parent, std::string_view name) {
+        uint16_t depth = dirs_[parent].depth + 1;
+        if (depth > MAX_DEPTH) return TOO_DEEP;
+        dirs_.push_back({intern(name), parent, static_cast<uint16_t>(name.size()), depth});
+        return static_cast<uint32_t>(dirs_.size() - 1);
+    }
+
+    Entry& add_file(uint32_t dir, std::string_view name) {
+        Entry e;
+        e.name = intern(name);
+        e.dir = dir;
+        e.name_len = static_cast<uint16_t>(name.size());
+        entries_.push_back(e);
+        return entries_.back();
+    }
+
+    size_t size() const { return entries_.size(); }
+    bool empty() const { return entries_.empty(); }
+    Entry& operator[](size_t i) { return entries_[i]; }
+    const Entry& operator[](size_t i) const { return entries_[i]; }
+
+    // For in-place filtering; the arena keeps the names of dropped entries
+    std::vector<Entry>& entries() { return entries_; }
+
+    // Path below the root ("a/b/file")
+    void rel_path(const Entry& e, std::string& out) const {
+        // Walk up to the root, then append the names top-down
+        uint32_t chain[MAX_DEPTH];
+        size_t depth = 0;
+        size_t len = e.name_len;
+        for (uint32_t d = e.dir; d != 0; d = dirs_[d].parent) {
+            chain[depth++] = d;
+            len += dirs_[d].name_len + 1;
+        }
+        out.clear();
+        out.reserve(len);
+        while (depth > 0) {
+            const Dir& d = dirs_[chain[--depth]];
+            out.append(arena_, d.name, d.name_len);
+            out += '/';
+        }
+        out.append(arena_, e.name, e.name_len);
+    }
+
+    std::string rel_path(const Entry& e) const {
+        std::string out;
+        rel_path(e, out);
+        return out;
+    }
+
+    std::string src_path(const Entry& e) const {
+        std::string rel;
+        rel_path(e, rel);
+        return root_ + rel;
+    }
+
+    // Bytes of the entry the receiver already has (--resume), 0 for none.
+    // Only a few files are partial, so this stays out of Entry.
+    void set_resume(const Entry& e, uint64_t offset) { resume_[e.name] = offset; }
+
+    uint64_t resume_offset(const Entry& e) const {
+        auto it = resume_.find(e.name);
+        return it == resume_.end() ? 0 : it->second;
+    }
+
+    // Another name of a file already in the list (--hardlinks): sent as a
+    // link to target's path instead of as data. Like resume offsets, these
+    // are few and stay out of the entries.
+    void add_link(const Entry& name, const Entry& target) { links_.push_back({name, target}); }
+
+    const std::vector<std::pair<Entry, Entry>>& links() const { return links_; }
+
+    // The peer can't make links: every name goes as a file after all
+    void restore_links() {
+        if (links_.empty()) return;
+        for (const auto& link : links_) entries_.push_back(link.first);
+        links_.clear();
+        sort_disk_order();
+    }
+
+    // Sort by first physical extent, else inode (see disk_order()). The
+    // records are sorted in place, so this needs no memory of its own.
+    void sort_disk_order() {
+        std::sort(entries_.begin(), entries_.end(), [](const Entry& a, const Entry& b) {
+            return disk_order(a.extent, a.inode) < disk_order(b.extent, b.inode);
+        });
+    }
+
+    // Heap held by the list
+    size_t memory_bytes() const {
+        return arena_.capacity() + dirs_.capacity() * sizeof(Dir) +
+               entries_.capacity() * sizeof(Entry) +
+               links_.capacity() * sizeof(std::pair<Entry, Entry>);
+    }
+
+private:
+    struct Dir {
+        uint64_t name;
+        uint32_t parent;
+        uint16_t name_len;
+        uint16_t depth;                 // Directories from the root, at most MAX_DEPTH
+    };
+
+    uint64_t intern(std::string_view name) {
+        uint64_t off = arena_.size();
+        arena_.append(name);
+        return off;
+    }
+
+    std::string root_;
+    std::string arena_;                 // Every name, back to back
+    std::vector<Dir> dirs_;
+    std::vector<Entry> entries_;
+    std::unordered_map<uint64_t, uint64_t> resume_;    // Arena offset of the name → offset
+    std::vector<std::pair<Entry, Entry>> links_;        // (name, target) with --hardlinks
+};
@@ -0,0 +1,406 @@
+#pragma once
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "manifest.hpp"
+
+// Checkpoint journal (--resume)
+// Records how far the large files of a transfer got, so an interrupted
+// run picks up where it stopped instead of starting over. The journal is
+// a text file next to the destination (.<name>.uring-sync-journal in its
+// parent directory, so it never shows up in the tree), one record a line:
+//
+//   R <size> <mtime_ns> <offset> <len> <path>    bytes [offset, offset + len)
+//                                                 of the copy are on disk
+//   F <path>                                      the copy is complete
+//
+// Paths are relative to the destination ("." when it is a file). A range
+// only holds for a copy of a source with that size and mtime. Copy threads
+// queue records; a writer thread appends them about once a second, after
+// an fdatasync of every file the batch names (leaving out the ranges of
+// one that fails), then fdatasyncs the journal, so a recorded range is
+// never ahead of its data. A torn last line (a
+// crash mid-append) is ignored. The journal is compacted when opened and
+// removed when closed with no partial copy left.
+
+class CheckpointJournal {
+public:
+    using Range = std::pair<uint64_t, uint64_t>;    // [first, end)
+
+    struct Progress {
+        uint64_t size = 0;
+        int64_t mtime_ns = 0;
+        std::vector<Range> ranges;                  // Sorted, apart (touching ones merge)
+
+        // Bytes on disk from the start of the copy
+        uint64_t prefix() const {
+            return !ranges.empty() && ranges[0].first == 0 ? ranges[0].second : 0;
+        }
+
+        uint64_t bytes() const {
+            uint64_t n = 0;
+            for (const auto& r : ranges) n += r.second - r.first;
+            return n;
+        }
+
+        bool covers(uint64_t offset, uint64_t len) const {
+            auto it = std::upper_bound(ranges.begin(), ranges.end(), offset,
+                                       [](uint64_t v, const Range& r) { return v < r.second; });
+            return it != ranges.end() && it->first <= offset && offset + len <= it->second;
+        }
+
+        void add(uint64_t first, uint64_t end) {
+            if (first >= end) return;
+            auto it = std::lower_bound(ranges.begin(), ranges.end(), first,
+                                       [](const Range& r, uint64_t v) { return r.second < v; });
+            auto last = it;
+            for (; last != ranges.end() && last->first <= end; ++last) {
+                first = std::min(first, last->first);
+                end = std::max(end, last->second);
+            }
+            it = ranges.erase(it, last);
+            ranges.insert(it, {first, end});
+        }
+    };
+
+    using State = std::map<std::string, Progress>;
+
+    static constexpr std::string_view HEADER = "uring-sync journal 1\n";
+    static constexpr auto FLUSH_INTERVAL = std::chrono::seconds(1);
+
+    CheckpointJournal() = default;
+    ~CheckpointJournal() { close(); }
+
+    CheckpointJournal(const CheckpointJournal&) = delete;
+    CheckpointJournal& operator=(const CheckpointJournal&) = delete;
+
+    // Journal file of destination dst
+    static std::string path_for(const std::string& dst) {
+        namespace fs = std::filesystem;
+        std::error_code ec;
+        fs::path p = fs::absolute(dst, ec).lexically_normal();
+        if (!p.has_filename()) p = p.parent_path();
+        return (p.parent_path() / ("." + p.filename().string() + ".uring-sync-journal")).string();
+    }
+
+    // Apply one record line (without its newline); false if malformed
+    static bool apply(State& state, std::string_view line) {
+        if (line.size() > 2 && line.substr(0, 2) == "F ") {
+            state.erase(std::string(line.substr(2)));
+            return true;
+        }
+        if (line.size() < 2 || line.substr(0, 2) != "R ") return false;
+        line.remove_prefix(2);
+
+        uint64_t size, offset, len;
+        int64_t mtime_ns;
+        if (!take_number(line, size) || !take_number(line, mtime_ns) ||
+            !take_number(line, offset) || !take_number(line, len) || line.empty() ||
+            offset > size || len > size - offset) {
+            return false;
+        }
+
+        // Another size or mtime: the source changed, earlier ranges are void
+        Progress& p = state[std::string(line)];
+        if (p.size != size || p.mtime_ns != mtime_ns) p = Progress{size, mtime_ns, {}};
+        p.add(offset, offset + len);
+        return true;
+    }
+
+    // Apply a journal's text. A last line without its newline is a torn
+    // append and skipped, as are malformed lines. False if the header is
+    // not ours (an empty text is an empty journal).
+    static bool parse(std::string_view text, State& state) {
+        if (text.empty()) return true;
+        if (text.substr(0, HEADER.size()) != HEADER) return false;
+        text.remove_prefix(HEADER.size());
+        for (size_t nl; (nl = text.find('\n')) != std::string_view::npos;) {
+            apply(state, text.substr(0, nl));
+            text.remove_prefix(nl + 1);
+        }
+        return true;
+    }
+
+    // Compacted text of state: the header and a line per range
+    static std::string format(const State& state) {
+        std::string out(HEADER);
+        for (const auto& [key, p] : state) {
+            for (const auto& r : p.ranges) out += range_line(key, p.size, p.mtime_ns, r.first, r.second - r.first);
+        }
+        return out;
+    }
+
+    // Load the journal of destination dst (if any), drop copies that no
+    // longer hold their ranges, compact it and start the writer. False
+    // (with error set) if it can't be read or written.
+    bool open(const std::string& dst, std::string& error) {
+        dst_ = dst;
+        while (dst_.size() > 1 && dst_.back() == '/') dst_.pop_back();
+        path_ = path_for(dst_);
+
+        std::string text;
+        if (!read_file(path_, text)) {
+            error = path_ + ": " + strerror(errno);
+            return false;
+        }
+        if (!parse(text, state_)) {
+            error = path_ + ": not a uring-sync journal";
+            return false;
+        }
+        for (auto it = state_.begin(); it != state_.end();) {
+            it = holds(it->first, it->second) ? std::next(it) : state_.erase(it);
+        }
+
+        // Swapped in whole, so a crash leaves the old journal or the new one
+        std::string tmp = path_ + ".tmp";
+        if (!write_file(tmp, format(state_)) || rename(tmp.c_str(), path_.c_str()) != 0) {
+            error = path_ + ": " + strerror(errno);
+            unlink(tmp.c_str());
+            return false;
+        }
+        fd_ = ::open(path_.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+        if (fd_ < 0) {
+            error = path_ + ": " + strerror(errno);
+            return false;
+        }
+        writer_ = std::thread(&CheckpointJournal::write_loop, this);
+        return true;
+    }
+
+    const std::string& path() const { return path_; }
+
+    // Record key of a file under the destination
+    std::string key(const std::string& path) const {
+        if (path == dst_) return ".";
+        if (path.size() > dst_.size() && path.compare(0, dst_.size(), dst_) == 0 &&
+            path[dst_.size()] == '/') {
+            size_t start = path.find_first_not_of('/', dst_.size());
+            return start == std::string::npos ? "." : path.substr(start);
+        }
+        return path;
+    }
+
+    // Progress of a copy that still holds its ranges (the file is at least
+    // as long as the last one); false if there is none
+    bool find(const std::string& key, Progress& out) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = state_.find(key);
+        if (it == state_.end() || !holds(key, it->second)) return false;
+        out = it->second;
+        return true;
+    }
+
+    // Every copy with progress that still holds its ranges
+    State partial() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        State out;
+        for (const auto& [key, p] : state_) {
+            if (holds(key, p)) out.emplace(key, p);
+        }
+        return out;
+    }
+
+    // Bytes [offset, offset + len) of the copy of a source with this size
+    // and mtime are written. Paths holding a newline are not journaled.
+    void range(const std::string& key, uint64_t size, int64_t mtime_ns, uint64_t offset,
+               uint64_t len) {
+        if (key.find('\n') != std::string::npos) return;
+        std::string line = range_line(key, size, mtime_ns, offset, len);
+        std::lock_guard<std::mutex> lock(mutex_);
+        apply(state_, std::string_view(line).substr(0, line.size() - 1));
+        pending_ += line;
+        dirty_.insert(key);
+    }
+
+    // The copy is complete: its ranges are dropped
+    void finish(const std::string& key) {
+        if (key.find('\n') != std::string::npos) return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (state_.erase(key) == 0) return;
+        pending_ += "F " + key + "\n";
+    }
+
+    // Write what is queued and stop; the file goes if no partial copy is left
+    void close() {
+        if (!writer_.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_one();
+        writer_.join();
+        ::close(fd_);
+        fd_ = -1;
+        if (state_.empty()) unlink(path_.c_str());
+    }
+
+private:
+    template<typename T>
+    static bool take_number(std::string_view& s, T& out) {
+        auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), out);
+        if (ec != std::errc() || end == s.data() + s.size() || *end != ' ') return false;
+        s.remove_prefix(end - s.data() + 1);
+        return true;
+    }
+
+    static std::string range_line(const std::string& key, uint64_t size, int64_t mtime_ns,
+                                  uint64_t offset, uint64_t len) {
+        return "R " + std::to_string(size) + " " + std::to_string(mtime_ns) + " " +
+               std::to_string(offset) + " " + std::to_string(len) + " " + key + "\n";
+    }
+
+    // A missing journal reads as empty
+    static bool read_file(const std::string& path, std::string& out) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return errno == ENOENT;
+        char buf[65536];
+        ssize_t n;
+        while ((n = read(fd, buf, sizeof(buf))) > 0) out.append(buf, n);
+        int err = errno;
+        ::close(fd);
+        errno = err;
+        return n == 0;
+    }
+
+    static bool write_all(int fd, std::string_view data) {
+        while (!data.empty()) {
+            ssize_t n = write(fd, data.data(), data.size());
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            data.remove_prefix(n);
+        }
+        return true;
+    }
+
+    static bool write_file(const std::string& path, std::string_view data) {
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) return false;
+        bool ok = write_all(fd, data) && fdatasync(fd) == 0;
+        int err = errno;
+        ::close(fd);
+        errno = err;
+        return ok;
+    }
+
+    std::string full_path(const std::string& key) const {
+        if (key == ".") return dst_;
+        return key[0] == '/' ? key : dst_ + "/" + key;
+    }
+
+    bool holds(const std::string& key, const Progress& p) const {
+        struct stat st;
+        return !p.ranges.empty() && stat(full_path(key).c_str(), &st) == 0 &&
+               S_ISREG(st.st_mode) && static_cast<uint64_t>(st.st_size) >= p.ranges.back().second;
+    }
+
+    void write_loop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            wake_.wait_for(lock, FLUSH_INTERVAL, [this] { return stopping_; });
+            std::string text;
+            std::set<std::string> dirty;
+            text.swap(pending_);
+            dirty.swap(dirty_);
+            bool stop = stopping_;
+            lock.unlock();
+            flush(text, dirty);
+            lock.lock();
+            if (stop) return;
+        }
+    }
+
+    // Key of a range line, empty for other records
+    static std::string_view range_key(std::string_view line) {
+        if (line.substr(0, 2) != "R ") return {};
+        size_t pos = 1;
+        for (int field = 0; field < 4 && pos != std::string_view::npos; field++) {
+            pos = line.find(' ', pos + 1);
+        }
+        if (pos == std::string_view::npos) return {};
+        line.remove_prefix(pos + 1);
+        if (!line.empty() && line.back() == '\n') line.remove_suffix(1);
+        return line;
+    }
+
+    // Data first, then the records that vouch for it. The ranges of a file
+    // whose data can't be synced (or opened) are dropped from this batch
+    // and a later run copies them again.
+    void flush(const std::string& text, const std::set<std::string>& dirty) {
+        if (text.empty()) return;
+        std::set<std::string, std::less<>> unsynced;
+        for (const auto& key : dirty) {
+            int fd = ::open(full_path(key).c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0 || fdatasync(fd) != 0) unsynced.insert(key);
+            if (fd >= 0) ::close(fd);
+        }
+
+        std::string kept;
+        std::string_view out = text;
+        if (!unsynced.empty()) {
+            for (size_t start = 0, nl; (nl = text.find('\n', start)) != std::string::npos; start = nl + 1) {
+                std::string_view line(text.data() + start, nl + 1 - start);
+                if (!unsynced.count(range_key(line))) kept += line;
+            }
+            out = kept;
+        }
+        if (!out.empty() && write_all(fd_, out)) fdatasync(fd_);
+    }
+
+    std::string dst_;
+    std::string path_;
+    int fd_ = -1;
+
+    mutable std::mutex mutex_;
+    State state_;
+    std::string pending_;                   // Lines not yet appended
+    std::set<std::string> dirty_;           // Files the pending ranges name
+    bool stopping_ = false;
+    std::condition_variable wake_;
+    std::thread writer_;
+};
+
+// Journals of several destinations (recv --daemon routes), opened on first
+// use and shared by every stream writing into one
+class JournalSet {
+public:
+    CheckpointJournal* open(const std::string& dst, std::string& error) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& journal = journals_[dst];
+        if (!journal) {
+            auto fresh = std::make_unique<CheckpointJournal>();
+            if (!fresh->open(dst, error)) return nullptr;
+            journal = std::move(fresh);
+        }
+        return journal.get();
+    }
+
+    void close_all() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& [dst, journal] : journals_) {
+            if (journal) journal->close();
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<CheckpointJournal>> journals_;
+};
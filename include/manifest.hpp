@@ -0,0 +1,140 @@
+#pragma once
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "protocol.hpp"
+
+// Incremental sync (--incremental)
+// The receiver describes its tree as (path hash, size, mtime) entries
+// sorted by hash and streams them to the sender in MANIFEST frames. The
+// sender sorts its own file list the same way and merges the two in one
+// pass, so neither side holds the other's paths.
+
+// ============================================================
+// Entries
+// ============================================================
+
+// FNV-1a 64 of the path relative to the transfer root
+inline uint64_t path_hash(std::string_view path) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned char c : path) {
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+inline int64_t to_mtime_ns(const struct timespec& ts) {
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+inline struct timespec from_mtime_ns(int64_t ns) {
+    struct timespec ts;
+    ts.tv_sec = ns / 1000000000LL;
+    ts.tv_nsec = ns % 1000000000LL;
+    if (ts.tv_nsec < 0) {
+        ts.tv_sec--;
+        ts.tv_nsec += 1000000000LL;
+    }
+    return ts;
+}
+
+// Set a file's mtime (atime untouched)
+inline bool set_mtime(int fd, int64_t mtime_ns) {
+    struct timespec times[2] = {{0, UTIME_OMIT}, from_mtime_ns(mtime_ns)};
+    return futimens(fd, times) == 0;
+}
+
+// Manifest of every regular file under root, sorted by path hash. A root
+// that doesn't exist yet gives an empty manifest.
+inline bool build_manifest(const std::string& root, std::vector<protocol::ManifestEntry>& out) {
+    namespace fs = std::filesystem;
+    out.clear();
+
+    std::error_code ec;
+    if (!fs::is_directory(root, ec)) return true;
+
+    auto it = fs::recursive_directory_iterator(root, ec);
+    if (ec) return false;
+    for (; it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        if (ec) return false;
+        struct stat st;
+        if (stat(it->path().c_str(), &st) != 0 || !S_ISREG(st.st_mode)) continue;
+        std::string rel = fs::relative(it->path(), root).string();
+        out.push_back({path_hash(rel), static_cast<uint64_t>(st.st_size), to_mtime_ns(st.st_mtim)});
+    }
+
+    std::sort(out.begin(), out.end(),
+              [](const protocol::ManifestEntry& a, const protocol::ManifestEntry& b) {
+                  return a.hash < b.hash;
+              });
+    return true;
+}
+
+// ============================================================
+// Streaming Merge
+// ============================================================
+// Walks the local entries (sorted by hash) alongside the peer's manifest
+// as its frames arrive. A local file is unchanged when some peer entry has
+// the same hash, size and mtime; entries sharing a hash are all checked.
+// Two paths would need a 64-bit hash collision and the same size and mtime
+// for a changed file to be skipped.
+
+class ManifestMerge {
+public:
+    explicit ManifestMerge(const std::vector<protocol::ManifestEntry>& local)
+        : local_(local), unchanged_(local.size(), 0), present_(local.size(), 0) {}
+
+    // Feed the next run of peer entries; false if they are out of order
+    bool feed(const protocol::ManifestEntry* peer, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            const auto& p = peer[i];
+            if (p.hash < last_hash_) return false;
+            last_hash_ = p.hash;
+
+            while (pos_ < local_.size() && local_[pos_].hash < p.hash) pos_++;
+            for (size_t j = pos_; j < local_.size() && local_[j].hash == p.hash; j++) {
+                present_[j] = 1;
+                if (!unchanged_[j] && local_[j].size == p.size &&
+                    local_[j].mtime_ns == p.mtime_ns) {
+                    unchanged_[j] = 1;
+                    matched_++;
+                }
+            }
+        }
+        return true;
+    }
+
+    // unchanged()[i] is 1 if local entry i can be skipped
+    const std::vector<uint8_t>& unchanged() const { return unchanged_; }
+    // present()[i] is 1 if the peer has some copy of local entry i's path
+    const std::vector<uint8_t>& present() const { return present_; }
+    size_t matched() const { return matched_; }
+
+private:
+    const std::vector<protocol::ManifestEntry>& local_;
+    std::vector<uint8_t> unchanged_;
+    std::vector<uint8_t> present_;
+    size_t pos_ = 0;
+    uint64_t last_hash_ = 0;
+    size_t matched_ = 0;
+};
+
+// Send entries as MANIFEST frames followed by MANIFEST_END.
+// send(const uint8_t*, size_t) returns false on a failed send.
+template <typename SendFn>
+inline bool send_manifest(const std::vector<protocol::ManifestEntry>& entries, SendFn&& send) {
+    for (size_t i = 0; i < entries.size(); i += protocol::MAX_MANIFEST_ENTRIES) {
+        auto msg = protocol::make_manifest(entries.data() + i, entries.size() - i);
+        if (!send(msg.data(), msg.size())) return false;
+    }
+    auto end = protocol::make_manifest_end();
+    return send(end.data(), end.size());
+}
@@ -0,0 +1,433 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <fmt/core.h>
+#include "common.hpp"
+
+// Operation metrics (--metrics, --metrics-stream, --trace)
+// Each worker (local copy) or stream (network) owns a WorkerMetrics: a
+// latency histogram per op kind, timed from SQE preparation to its CQE,
+// and gauges for ring occupancy and files in flight. Each has exactly one
+// writer, so recording is a relaxed load and store with no atomic
+// read-modify-write; the streamer and the final report merge what the
+// workers have recorded so far. With --trace every timed op is also
+// kept as a Chrome trace event ("X": start, duration, worker).
+
+// ============================================================
+// Latency Histogram
+// ============================================================
+
+// Log-linear buckets, HDR style: values below SUB are exact, every power
+// of two above is split into SUB buckets, so a bucket is within 1/SUB
+// (12.5%) of its values. Nanoseconds, 0 to 2^64.
+class LatencyHistogram {
+public:
+    static constexpr unsigned SUB_BITS = 3;
+    static constexpr unsigned SUB = 1u << SUB_BITS;
+    static constexpr size_t BUCKETS = (64 - SUB_BITS + 1) * SUB;
+
+    static size_t bucket(uint64_t v) {
+        if (v < SUB) return v;
+        unsigned e = 63 - __builtin_clzll(v);
+        return (e - SUB_BITS + 1) * SUB + ((v >> (e - SUB_BITS)) - SUB);
+    }
+
+    // Largest value that lands in bucket i
+    static uint64_t bucket_high(size_t i) {
+        if (i < SUB) return i;
+        unsigned shift = static_cast<unsigned>(i / SUB) - 1;
+        uint64_t m = i % SUB + SUB;
+        return ((m + 1) << shift) - 1;
+    }
+
+    // Single writer
+    void record(uint64_t v) {
+        add(counts_[bucket(v)], 1);
+        add(sum_, v);
+        if (v > max_.load(std::memory_order_relaxed)) max_.store(v, std::memory_order_relaxed);
+    }
+
+    // Into a histogram only the caller writes
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < BUCKETS; i++) {
+            uint64_t c = other.counts_[i].load(std::memory_order_relaxed);
+            if (c) add(counts_[i], c);
+        }
+        add(sum_, other.sum());
+        if (other.max() > max()) max_.store(other.max(), std::memory_order_relaxed);
+    }
+
+    uint64_t count() const {
+        uint64_t n = 0;
+        for (const auto& c : counts_) n += c.load(std::memory_order_relaxed);
+        return n;
+    }
+    uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+    // Upper bound of the bucket holding the q-quantile, capped at the max
+    uint64_t percentile(double q) const {
+        uint64_t n = count();
+        if (n == 0) return 0;
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * n + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; i++) {
+            seen += counts_[i].load(std::memory_order_relaxed);
+            if (seen >= rank) return std::min(bucket_high(i), max());
+        }
+        return max();
+    }
+
+private:
+    static void add(std::atomic<uint64_t>& a, uint64_t n) {
+        a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    std::array<std::atomic<uint64_t>, BUCKETS> counts_{};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+// ============================================================
+// Gauges
+// ============================================================
+
+// Last value set, with the mean and max over all samples (single writer)
+class Gauge {
+public:
+    void set(uint64_t v) {
+        value_.store(v, std::memory_order_relaxed);
+        sum_.store(sum_.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+        samples_.store(samples_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (v > max_.load(std::memory_order_relaxed)) max_.store(v, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+    uint64_t samples() const { return samples_.load(std::memory_order_relaxed); }
+    double mean() const {
+        uint64_t n = samples();
+        return n ? double(sum_.load(std::memory_order_relaxed)) / n : 0.0;
+    }
+
+private:
+    std::atomic<uint64_t> value_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> samples_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+// ============================================================
+// Per-Worker Metrics
+// ============================================================
+
+struct TraceEvent {
+    uint64_t start_ns;
+    uint64_t end_ns;
+    uint8_t op;
+};
+
+class WorkerMetrics {
+public:
+    // Trace events kept per worker (24 bytes each); later ones are counted only
+    static constexpr size_t MAX_TRACE_EVENTS = 1 << 20;
+
+    WorkerMetrics(std::string name, size_t ops, bool trace)
+        : name_(std::move(name)), ops_(ops),
+          hist_(std::make_unique<LatencyHistogram[]>(ops)), trace_(trace) {}
+
+    // Op of kind op ran from start to end (now_ns() clock)
+    void record(size_t op, uint64_t start, uint64_t end) {
+        if (op >= ops_ || start == 0) return;
+        hist_[op].record(end > start ? end - start : 0);
+        if (!trace_) return;
+        if (events_.size() < MAX_TRACE_EVENTS) {
+            events_.push_back({start, end, static_cast<uint8_t>(op)});
+        } else {
+            dropped_++;
+        }
+    }
+
+    const std::string& name() const { return name_; }
+    size_t ops() const { return ops_; }
+    const LatencyHistogram& op(size_t i) const { return hist_[i]; }
+
+    // Trace events; read only once the worker is done
+    const std::vector<TraceEvent>& events() const { return events_; }
+    uint64_t dropped() const { return dropped_; }
+
+    Gauge ring_in_flight;     // SQEs submitted whose CQE is not reaped yet
+    Gauge files_in_flight;    // Files (or segments) being worked on
+
+private:
+    std::string name_;
+    size_t ops_;
+    std::unique_ptr<LatencyHistogram[]> hist_;
+    bool trace_;
+    std::vector<TraceEvent> events_;
+    uint64_t dropped_ = 0;
+};
+
+// ============================================================
+// Registry and Reports
+// ============================================================
+
+struct MetricsSetup {
+    std::string json_path;        // --metrics: JSON report at exit ("-" = stdout)
+    std::string stream_target;    // --metrics-stream: file, or unix:<socket path>
+    unsigned interval_ms = 1000;  // --metrics-interval
+    std::string trace_path;       // --trace: Chrome trace events
+
+    bool enabled() const {
+        return !json_path.empty() || !stream_target.empty() || !trace_path.empty();
+    }
+};
+
+// All workers of one run, sharing one op-kind table (OpType, SendOp, RecvOp)
+class MetricsRegistry {
+public:
+    MetricsRegistry(std::string mode, std::vector<const char*> op_names, bool trace)
+        : mode_(std::move(mode)), op_names_(std::move(op_names)), trace_(trace),
+          start_ns_(now_ns()) {}
+
+    // Addresses stay valid for the registry's lifetime
+    WorkerMetrics& add(std::string name) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return workers_.emplace_back(std::move(name), op_names_.size(), trace_);
+    }
+
+    // Histograms of every op kind over all workers, in microseconds, then
+    // each worker's gauges and ops. counters is a list of "key": value
+    // pairs (no braces) put under "counters".
+    std::string json(const std::string& counters = "") const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::string out = fmt::format("{{\"mode\":\"{}\",\"elapsed_s\":{:.3f}", mode_,
+                                      (now_ns() - start_ns_) / 1e9);
+        if (!counters.empty()) out += fmt::format(",\"counters\":{{{}}}", counters);
+
+        std::vector<LatencyHistogram> total(op_names_.size());
+        for (const auto& w : workers_) {
+            for (size_t i = 0; i < op_names_.size(); i++) total[i].merge(w.op(i));
+        }
+        out += ",\"ops\":" + ops_json([&](size_t i) -> const LatencyHistogram& { return total[i]; });
+
+        out += ",\"workers\":[";
+        for (size_t n = 0; n < workers_.size(); n++) {
+            const auto& w = workers_[n];
+            out += fmt::format("{}{{\"name\":\"{}\"", n ? "," : "", w.name());
+            append_gauge(out, "ring_in_flight", w.ring_in_flight);
+            append_gauge(out, "files_in_flight", w.files_in_flight);
+            out += ",\"ops\":" + ops_json([&](size_t i) -> const LatencyHistogram& { return w.op(i); });
+            out += "}";
+        }
+        out += "]}";
+        return out;
+    }
+
+    // Chrome trace format (chrome://tracing, Perfetto): one complete event
+    // per op, a thread per worker, microseconds from the registry's start
+    bool write_trace(const std::string& path) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        FILE* f = fopen(path.c_str(), "w");
+        if (!f) return false;
+        fmt::print(f, "{{\"traceEvents\":[\n");
+        uint64_t dropped = 0;
+        bool first = true;
+        for (size_t tid = 0; tid < workers_.size(); tid++) {
+            const auto& w = workers_[tid];
+            fmt::print(f, "{}{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},"
+                          "\"args\":{{\"name\":\"{}\"}}}}",
+                       first ? "" : ",\n", tid, w.name());
+            first = false;
+            for (const auto& e : w.events()) {
+                fmt::print(f, ",\n{{\"name\":\"{}\",\"cat\":\"{}\",\"ph\":\"X\",\"pid\":1,\"tid\":{},"
+                              "\"ts\":{:.3f},\"dur\":{:.3f}}}",
+                           op_names_[e.op], mode_, tid, (e.start_ns - start_ns_) / 1e3,
+                           (e.end_ns - e.start_ns) / 1e3);
+            }
+            dropped += w.dropped();
+        }
+        fmt::print(f, "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{{\"dropped_events\":{}}}}}\n",
+                   dropped);
+        return fclose(f) == 0;
+    }
+
+private:
+    template<typename Get>
+    std::string ops_json(Get&& get) const {
+        std::string out = "{";
+        bool first = true;
+        for (size_t i = 0; i < op_names_.size(); i++) {
+            const LatencyHistogram& h = get(i);
+            uint64_t n = h.count();
+            if (n == 0) continue;
+            out += fmt::format("{}\"{}\":{{\"count\":{},\"mean_us\":{:.3f},\"p50_us\":{:.3f},"
+                               "\"p90_us\":{:.3f},\"p99_us\":{:.3f},\"p999_us\":{:.3f},"
+                               "\"max_us\":{:.3f}}}",
+                               first ? "" : ",", op_names_[i], n, h.sum() / 1e3 / n,
+                               h.percentile(0.5) / 1e3, h.percentile(0.9) / 1e3,
+                               h.percentile(0.99) / 1e3, h.percentile(0.999) / 1e3,
+                               h.max() / 1e3);
+            first = false;
+        }
+        return out + "}";
+    }
+
+    static void append_gauge(std::string& out, const char* name, const Gauge& g) {
+        if (g.samples() == 0) return;
+        out += fmt::format(",\"{}\":{{\"current\":{},\"mean\":{:.2f},\"max\":{}}}",
+                           name, g.value(), g.mean(), g.max());
+    }
+
+    std::string mode_;
+    std::vector<const char*> op_names_;
+    bool trace_;
+    uint64_t start_ns_;
+    mutable std::mutex mutex_;
+    std::deque<WorkerMetrics> workers_;
+};
+
+// ============================================================
+// Streaming
+// ============================================================
+
+// Writes the registry's JSON as one line every interval (NDJSON) to a
+// file, or to a Unix stream socket someone listens on ("unix:<path>"),
+// plus a last line when stopped. A failed write ends the stream.
+class MetricsStreamer {
+public:
+    using Counters = std::function<std::string()>;
+
+    MetricsStreamer(const MetricsRegistry& registry, const MetricsSetup& setup,
+                    Counters counters = {})
+        : registry_(registry), interval_(std::max(setup.interval_ms, 10u)),
+          counters_(std::move(counters)) {
+        const std::string& target = setup.stream_target;
+        if (target.rfind("unix:", 0) == 0) {
+            std::string path = target.substr(5);
+            struct sockaddr_un addr = {};
+            addr.sun_family = AF_UNIX;
+            if (path.size() >= sizeof(addr.sun_path)) {
+                throw std::runtime_error("Metrics socket path too long: " + path);
+            }
+            memcpy(addr.sun_path, path.c_str(), path.size());
+            fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (fd_ < 0 || connect(fd_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+                int err = errno;
+                if (fd_ >= 0) close(fd_);
+                throw std::runtime_error("Cannot connect to metrics socket " + path + ": " +
+                                         strerror(err));
+            }
+            socket_ = true;
+        } else {
+            fd_ = open(target.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            if (fd_ < 0) {
+                throw std::runtime_error("Cannot open metrics stream " + target + ": " +
+                                         strerror(errno));
+            }
+        }
+        thread_ = std::thread([this] { run(); });
+    }
+
+    ~MetricsStreamer() {
+        stop();
+    }
+
+    MetricsStreamer(const MetricsStreamer&) = delete;
+    MetricsStreamer& operator=(const MetricsStreamer&) = delete;
+
+    // Write the last line and close
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopped_) return;
+            stopped_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+        emit();
+        close(fd_);
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!cv_.wait_for(lock, interval_, [this] { return stopped_; })) {
+            lock.unlock();
+            emit();
+            lock.lock();
+        }
+    }
+
+    void emit() {
+        if (failed_) return;
+        std::string line = registry_.json(counters_ ? counters_() : "") + "\n";
+        size_t done = 0;
+        while (done < line.size()) {
+            ssize_t n = socket_ ? send(fd_, line.data() + done, line.size() - done, MSG_NOSIGNAL)
+                                : write(fd_, line.data() + done, line.size() - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                fprintf(stderr, "Metrics stream closed: %s\n", strerror(errno));
+                failed_ = true;
+                return;
+            }
+            done += n;
+        }
+    }
+
+    const MetricsRegistry& registry_;
+    std::chrono::milliseconds interval_;
+    Counters counters_;
+    int fd_ = -1;
+    bool socket_ = false;
+    bool failed_ = false;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopped_ = false;
+    std::thread thread_;
+};
+
+// The --metrics report and --trace file at the end of a run
+inline bool write_metrics_reports(const MetricsRegistry& registry, const MetricsSetup& setup,
+                                  const std::string& counters = "") {
+    bool ok = true;
+    if (!setup.json_path.empty()) {
+        std::string report = registry.json(counters) + "\n";
+        if (setup.json_path == "-") {
+            fmt::print("{}", report);
+        } else {
+            FILE* f = fopen(setup.json_path.c_str(), "w");
+            bool written = f && fputs(report.c_str(), f) >= 0;
+            if (f && fclose(f) != 0) written = false;
+            if (!written) {
+                fprintf(stderr, "Cannot write metrics to %s: %s\n",
+                        setup.json_path.c_str(), strerror(errno));
+                ok = false;
+            }
+        }
+    }
+    if (!setup.trace_path.empty() && !registry.write_trace(setup.trace_path)) {
+        fprintf(stderr, "Cannot write trace to %s: %s\n", setup.trace_path.c_str(), strerror(errno));
+        ok = false;
+    }
+    return ok;
+}
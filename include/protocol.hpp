@@ -2,6 +2,7 @@
 #include <cstdint>
 #include <cstring>
 #include <string>
+#include <string_view>
 #include <vector>
 
 // Wire protocol for uring-sync network transfer
@@ -18,8 +19,30 @@ enum class MsgType : uint8_t {
 
     // File transfer
     FILE_HDR    = 0x10,   // File metadata (size, mode, path)
-    FILE_DATA   = 0x11,   // File content chunk
-    FILE_END    = 0x12,   // File complete
+    FILE_DATA   = 0x11,   // File content chunk (framed only in compressed sessions)
+    FILE_END    = 0x12,   // File complete (carries a CRC32C when verifying)
+    FILE_BATCH  = 0x13,   // Many small files: metadata + contents in one frame
+
+    // Incremental sync
+    MANIFEST    = 0x14,   // Receiver → Sender: run of (path hash, size, mtime)
+    MANIFEST_END = 0x15,  // Receiver → Sender: manifest complete
+
+    // Block delta (stream 0, between the manifest and the file data)
+    SIG_REQ     = 0x16,   // Sender → Receiver: signature of this path, please
+    SIGNATURE   = 0x17,   // Receiver → Sender: block checksums of its copy
+    DELTA_HDR   = 0x18,   // File rebuilt from DELTA_COPY + FILE_DATA, then FILE_END
+    DELTA_COPY  = 0x19,   // Run of blocks taken from the receiver's copy
+    DELTA_DONE  = 0x1A,   // Delta phase over; normal transfer follows
+
+    // Resume (stream 0, ahead of the manifest)
+    RESUME      = 0x1B,   // Receiver → Sender: run of (path hash, size, mtime, offset)
+    RESUME_END  = 0x1C,   // Receiver → Sender: resume list complete
+    FILE_RESUME = 0x1D,   // FILE_HDR of a file whose data starts at an offset
+
+    // Sparse files and hardlinks
+    FILE_SPARSE = 0x1E,   // FILE_HDR of a file sent as FILE_DATA frames and FILE_HOLEs
+    FILE_HOLE   = 0x1F,   // Run of zeros the receiver leaves unwritten
+    FILE_LINK   = 0x21,   // Hardlink to a file sent earlier in the session
 
     // Control
     ALL_DONE    = 0x20,   // All files transferred
@@ -32,7 +55,61 @@ constexpr size_t MSG_HEADER_SIZE = 5;
 // Protocol version
 // Version 1: Original plaintext protocol
 // Version 2: Added nonces for kTLS key derivation
-constexpr uint8_t PROTOCOL_VERSION = 2;
+// Version 3: Session ID + stream index/count in HELLO (multi-stream)
+// Version 4: FILE_BATCH; HELLO_OK carries the receiver's version
+// Version 5: Compression codec in HELLO/HELLO_OK; FILE_DATA frames
+// Version 6: Session flags in HELLO/HELLO_OK; manifest exchange and mtimes
+// Version 7: Block delta for changed files (FLAG_DELTA)
+// Version 8: Per-file CRC32C checks (FLAG_VERIFY)
+// Version 9: Resume of partial files (FLAG_RESUME)
+// Version 10: Sparse files and hardlinks (FLAG_SPARSE, FLAG_HARDLINKS)
+constexpr uint8_t PROTOCOL_VERSION = 10;
+
+// First version whose receivers accept FILE_BATCH
+constexpr uint8_t BATCH_MIN_VERSION = 4;
+
+// Chunk codecs. In HELLO/HELLO_OK, NONE means compression off; in a
+// FILE_DATA frame it means the chunk is stored raw.
+enum class Codec : uint8_t {
+    NONE = 0,
+    ZSTD = 1,
+    LZ4  = 2,
+};
+
+inline bool is_known_codec(uint8_t codec) {
+    return codec <= static_cast<uint8_t>(Codec::LZ4);
+}
+
+// Session flags (HELLO requests, HELLO_OK accepts)
+// INCREMENTAL: the receiver sends a MANIFEST of its tree on stream 0 right
+// after HELLO_OK, and FILE_HDR / FILE_BATCH entries carry the source mtime
+// DELTA (with INCREMENTAL): after the manifest the sender may ask for block
+// signatures of files the receiver has and send those files as deltas
+// VERIFY: each FILE_HDR file's data (and each delta) is followed by a
+// FILE_END carrying the CRC32C of the file's bytes; FILE_BATCH entries
+// carry theirs in front of the data
+// RESUME (with INCREMENTAL): the receiver keeps a checkpoint journal and,
+// before the manifest, sends a RESUME list of the partial files it has;
+// the sender sends the rest of each as a FILE_RESUME. With VERIFY, the
+// CRC covers the bytes sent in this session only.
+// SPARSE: a file with holes may come as FILE_SPARSE; its data is a run of
+// FILE_DATA frames (codec NONE in raw sessions) and FILE_HOLEs, and the
+// last byte is always data
+// HARDLINKS: stream 0 may send FILE_LINK for a file that is a hardlink of
+// one the session sends; the receiver links it once all streams are done
+constexpr uint8_t FLAG_INCREMENTAL = 0x01;
+constexpr uint8_t FLAG_DELTA = 0x02;
+constexpr uint8_t FLAG_VERIFY = 0x04;
+constexpr uint8_t FLAG_RESUME = 0x08;
+constexpr uint8_t FLAG_SPARSE = 0x10;
+constexpr uint8_t FLAG_HARDLINKS = 0x20;
+constexpr uint8_t KNOWN_FLAGS = FLAG_INCREMENTAL | FLAG_DELTA | FLAG_VERIFY | FLAG_RESUME |
+                                FLAG_SPARSE | FLAG_HARDLINKS;
+
+// HELLO_FAIL reasons
+constexpr uint8_t FAIL_BAD_SECRET = 1;
+constexpr uint8_t FAIL_BAD_SESSION = 2;   // Unknown session or duplicate stream
+constexpr uint8_t FAIL_UNSUPPORTED = 3;   // Receiver can't serve this request
 
 // Nonce size for kTLS key derivation
 constexpr size_t NONCE_SIZE = 16;
@@ -41,6 +118,74 @@ constexpr size_t NONCE_SIZE = 16;
 constexpr size_t MAX_SECRET_LEN = 64;
 constexpr size_t MAX_PATH_LEN = 4096;
 constexpr size_t MAX_ERROR_MSG_LEN = 256;
+constexpr uint16_t MAX_STREAMS = 64;
+
+// FILE_BATCH limits. A frame (header included) fits one 128KB pool buffer.
+constexpr size_t MAX_BATCH_FRAME = 128 * 1024;
+constexpr uint64_t MAX_BATCH_FILE_SIZE = 16 * 1024;  // Larger files use FILE_HDR
+constexpr uint16_t MAX_BATCH_FILES = 64;
+constexpr size_t BATCH_ENTRY_HDR_SIZE = 8 + 4 + 2;   // size + mode + path_len
+constexpr size_t MTIME_SIZE = 8;                     // Nanoseconds since the epoch
+constexpr size_t CRC_SIZE = 4;                       // CRC32C of a file (verify)
+constexpr size_t FILE_END_CRC_SIZE = MSG_HEADER_SIZE + CRC_SIZE;
+
+// FILE_DATA frames (compressed sessions): a file's data after FILE_HDR is a
+// run of frames, each holding at most MAX_FRAME_RAW bytes of the file
+constexpr size_t DATA_FRAME_HDR_SIZE = MSG_HEADER_SIZE + 1 + 4;  // + codec + raw_len
+constexpr uint32_t MAX_FRAME_RAW = 128 * 1024;
+
+// FILE_HOLE: a 40-bit length, so the message is as long as a frame header
+constexpr size_t HOLE_LEN_SIZE = 5;
+constexpr uint64_t MAX_HOLE = (uint64_t{1} << 40) - 1;
+
+// MANIFEST frames: entries sorted by path hash across the whole manifest
+constexpr size_t MANIFEST_ENTRY_SIZE = 8 + 8 + 8;    // hash + size + mtime
+constexpr size_t MAX_MANIFEST_ENTRIES = 4096;        // Per frame (96KB)
+
+struct ManifestEntry {
+    uint64_t hash;
+    uint64_t size;
+    int64_t mtime_ns;
+};
+
+// RESUME frames: a partial file the receiver holds the first offset bytes
+// of, as a copy of a source with this size and mtime
+constexpr size_t RESUME_ENTRY_SIZE = 8 + 8 + 8 + 8;  // hash + size + mtime + offset
+constexpr size_t MAX_RESUME_ENTRIES = 4096;          // Per frame (128KB)
+constexpr size_t RESUME_OFFSET_SIZE = 8;             // Trails a FILE_RESUME
+
+struct ResumeEntry {
+    uint64_t hash;
+    uint64_t size;
+    int64_t mtime_ns;
+    uint64_t offset;
+};
+
+// Block signatures: weak rolling checksum + truncated strong hash per block
+constexpr size_t DELTA_STRONG_SIZE = 16;
+constexpr size_t BLOCK_SIG_SIZE = 4 + DELTA_STRONG_SIZE;
+constexpr size_t SIGNATURE_HDR_SIZE = 8 + 4 + 4;     // file_size + block_size + count
+constexpr uint32_t MAX_SIG_BLOCKS = 1u << 20;        // Block size grows past this
+
+struct BlockSig {
+    uint32_t weak;
+    uint8_t strong[DELTA_STRONG_SIZE];
+};
+
+struct Signature {
+    uint64_t file_size = 0;
+    uint32_t block_size = 0;
+    std::vector<BlockSig> blocks;   // Empty: no usable copy, send the whole file
+};
+
+// Multi-stream session: every stream of one transfer carries the same id
+constexpr size_t SESSION_INFO_SIZE = 8 + 2 + 2;  // id + index + count
+
+struct SessionInfo {
+    uint64_t id = 0;
+    uint16_t index = 0;   // This stream, 0..count-1
+    uint16_t count = 1;   // Streams in the session
+};
 
 // ============================================================
 // Message Encoding
@@ -99,9 +244,14 @@ inline bool parse_header(const uint8_t* buf, MsgType& type, uint32_t& payload_le
 
 // HELLO message (includes nonce for kTLS key derivation)
 // Format: version (1) + secret_len (1) + secret (N) + nonce (16)
-inline std::vector<uint8_t> make_hello(const std::string& secret, const uint8_t nonce[NONCE_SIZE]) {
+//         + [v3] session_id (8) + stream_index (2) + stream_count (2)
+//         + [v5] requested codec (1) + [v6] requested flags (1)
+// Older receivers ignore the trailing fields.
+inline std::vector<uint8_t> make_hello(const std::string& secret, const uint8_t nonce[NONCE_SIZE],
+                                       const SessionInfo& session = {},
+                                       Codec codec = Codec::NONE, uint8_t flags = 0) {
     size_t secret_len = std::min(secret.size(), MAX_SECRET_LEN);
-    size_t payload_len = 2 + secret_len + NONCE_SIZE;  // version + secret_len + secret + nonce
+    size_t payload_len = 2 + secret_len + NONCE_SIZE + SESSION_INFO_SIZE + 2;
 
     std::vector<uint8_t> msg(MSG_HEADER_SIZE + payload_len);
     write_header(msg.data(), MsgType::HELLO, payload_len);
@@ -111,15 +261,30 @@ inline std::vector<uint8_t> make_hello(const std::string& secret, const uint8_t
     memcpy(msg.data() + 7, secret.data(), secret_len);
     memcpy(msg.data() + 7 + secret_len, nonce, NONCE_SIZE);
 
+    uint8_t* p = msg.data() + 7 + secret_len + NONCE_SIZE;
+    write_u64(p, session.id);
+    write_u16(p + 8, session.index);
+    write_u16(p + 10, session.count);
+    p[SESSION_INFO_SIZE] = static_cast<uint8_t>(codec);
+    p[SESSION_INFO_SIZE + 1] = flags;
+
     return msg;
 }
 
 // HELLO_OK message (includes nonce for kTLS key derivation)
-// Format: nonce (16)
-inline std::vector<uint8_t> make_hello_ok(const uint8_t nonce[NONCE_SIZE]) {
-    std::vector<uint8_t> msg(MSG_HEADER_SIZE + NONCE_SIZE);
-    write_header(msg.data(), MsgType::HELLO_OK, NONCE_SIZE);
+// Format: nonce (16) + [v4] version (1) + [v5] accepted codec (1)
+//         + [v6] accepted flags (1)
+// Older senders read the whole payload and ignore the trailing bytes. The
+// sender compresses only if the accepted codec is the one it asked for.
+inline std::vector<uint8_t> make_hello_ok(const uint8_t nonce[NONCE_SIZE],
+                                          uint8_t version = PROTOCOL_VERSION,
+                                          Codec codec = Codec::NONE, uint8_t flags = 0) {
+    std::vector<uint8_t> msg(MSG_HEADER_SIZE + NONCE_SIZE + 3);
+    write_header(msg.data(), MsgType::HELLO_OK, NONCE_SIZE + 3);
     memcpy(msg.data() + MSG_HEADER_SIZE, nonce, NONCE_SIZE);
+    msg[MSG_HEADER_SIZE + NONCE_SIZE] = version;
+    msg[MSG_HEADER_SIZE + NONCE_SIZE + 1] = static_cast<uint8_t>(codec);
+    msg[MSG_HEADER_SIZE + NONCE_SIZE + 2] = flags;
     return msg;
 }
 
@@ -132,9 +297,12 @@ inline std::vector<uint8_t> make_hello_fail(uint8_t reason) {
 }
 
 // FILE_HDR message
-inline std::vector<uint8_t> make_file_hdr(uint64_t size, uint32_t mode, const std::string& path) {
+// Format: size (8) + mode (4) + path_len (2) + path + [incremental] mtime (8)
+inline std::vector<uint8_t> make_file_hdr(uint64_t size, uint32_t mode, const std::string& path,
+                                          bool with_mtime = false, int64_t mtime_ns = 0) {
     size_t path_len = std::min(path.size(), MAX_PATH_LEN);
     size_t payload_len = 8 + 4 + 2 + path_len;  // size + mode + path_len + path
+    if (with_mtime) payload_len += MTIME_SIZE;
 
     std::vector<uint8_t> msg(MSG_HEADER_SIZE + payload_len);
     write_header(msg.data(), MsgType::FILE_HDR, payload_len);
@@ -143,6 +311,7 @@ inline std::vector<uint8_t> make_file_hdr(uint64_t size, uint32_t mode, const st
     write_u32(msg.data() + 13, mode);
     write_u16(msg.data() + 17, static_cast<uint16_t>(path_len));
     memcpy(msg.data() + 19, path.data(), path_len);
+    if (with_mtime) write_u64(msg.data() + 19 + path_len, static_cast<uint64_t>(mtime_ns));
 
     return msg;
 }
@@ -154,6 +323,15 @@ inline std::vector<uint8_t> make_file_data_header(uint32_t data_len) {
     return msg;
 }
 
+// FILE_DATA frame header, written in place in front of the chunk bytes
+// Format: codec (1) + raw_len (4) + data (data_len)
+inline void write_data_frame_header(uint8_t* buf, Codec codec, uint32_t raw_len,
+                                    uint32_t data_len) {
+    write_header(buf, MsgType::FILE_DATA, 1 + 4 + data_len);
+    buf[MSG_HEADER_SIZE] = static_cast<uint8_t>(codec);
+    write_u32(buf + MSG_HEADER_SIZE + 1, raw_len);
+}
+
 // FILE_END message
 inline std::vector<uint8_t> make_file_end() {
     std::vector<uint8_t> msg(MSG_HEADER_SIZE);
@@ -161,6 +339,13 @@ inline std::vector<uint8_t> make_file_end() {
     return msg;
 }
 
+// FILE_END with the file's CRC32C (verify), FILE_END_CRC_SIZE bytes in place
+// Format: crc (4)
+inline void write_file_end(uint8_t* buf, uint32_t crc) {
+    write_header(buf, MsgType::FILE_END, CRC_SIZE);
+    write_u32(buf + MSG_HEADER_SIZE, crc);
+}
+
 // ALL_DONE message
 inline std::vector<uint8_t> make_all_done() {
     std::vector<uint8_t> msg(MSG_HEADER_SIZE);
@@ -168,6 +353,160 @@ inline std::vector<uint8_t> make_all_done() {
     return msg;
 }
 
+// MANIFEST message: count (2) + count x [hash (8) + size (8) + mtime (8)]
+inline std::vector<uint8_t> make_manifest(const ManifestEntry* entries, size_t count) {
+    count = std::min(count, MAX_MANIFEST_ENTRIES);
+    size_t payload_len = 2 + count * MANIFEST_ENTRY_SIZE;
+
+    std::vector<uint8_t> msg(MSG_HEADER_SIZE + payload_len);
+    write_header(msg.data(), MsgType::MANIFEST, payload_len);
+    write_u16(msg.data() + 5, static_cast<uint16_t>(count));
+
+    uint8_t* p = msg.data() + 7;
+    for (size_t i = 0; i < count; i++, p += MANIFEST_ENTRY_SIZE) {
+        write_u64(p, entries[i].hash);
+        write_u64(p + 8, entries[i].size);
+        write_u64(p + 16, static_cast<uint64_t>(entries[i].mtime_ns));
+    }
+    return msg;
+}
+
+// MANIFEST_END message
+inline std::vector<uint8_t> make_manifest_end() {
+    std::vector<uint8_t> msg(MSG_HEADER_SIZE);
+    write_header(msg.data(), MsgType::MANIFEST_END, 0);
+    return msg;
+}
+
+// RESUME message: count (2) + count x [hash (8) + size (8) + mtime (8) + offset (8)]
+inline std::vector<uint8_t> make_resume(const ResumeEntry* entries, size_t count) {
+    count = std::min(count, MAX_RESUME_ENTRIES);
+    size_t payload_len = 2 + count * RESUME_ENTRY_SIZE;
+
+    std::vector<uint8_t> msg(MSG_HEADER_SIZE + payload_len);
+    write_header(msg.data(), MsgType::RESUME, payload_len);
+    write_u16(msg.data() + 5, static_cast<uint16_t>(count));
+
+    uint8_t* p = msg.data() + 7;
+    for (size_t i = 0; i < count; i++, p += RESUME_ENTRY_SIZE) {
+        write_u64(p, entries[i].hash);
+        write_u64(p + 8, entries[i].size);
+        write_u64(p + 16, static_cast<uint64_t>(entries[i].mtime_ns));
+        write_u64(p + 24, entries[i].offset);
+    }
+    return msg;
+}
+
+// RESUME_END message
+inline std::vector<uint8_t> make_resume_end() {
+    std::vector<uint8_t> msg(MSG_HEADER_SIZE);
+    write_header(msg.data(), MsgType::RESUME_END, 0);
+    return msg;
+}
+
+// FILE_RESUME message: a FILE_HDR payload with mtime, then offset (8). The
+// file's bytes from offset on follow as after a FILE_HDR.
+inline std::vector<uint8_t> make_file_resume(uint64_t size, uint32_t mode, const std::string& path,
+                                             int64_t mtime_ns, uint64_t offset) {
+    auto msg = make_file_hdr(size, mode, path, true, mtime_ns);
+    size_t payload_len = msg.size() - MSG_HEADER_SIZE + RESUME_OFFSET_SIZE;
+    msg.resize(MSG_HEADER_SIZE + payload_len);
+    write_header(msg.data(), MsgType::FILE_RESUME, payload_len);
+    write_u64(msg.data() + msg.size() - RESUME_OFFSET_SIZE, offset);
+    return msg;
+}
+
+// FILE_SPARSE message: a FILE_HDR payload. The file's bytes follow as
+// FILE_DATA frames and FILE_HOLEs.
+inline std::vector<uint8_t> make_file_sparse(uint64_t size, uint32_t mode, const std::string& path,
+                                             bool with_mtime = false, int64_t mtime_ns = 0) {
+    auto msg = make_file_hdr(size, mode, path, with_mtime, mtime_ns);
+    msg[0] = static_cast<uint8_t>(MsgType::FILE_SPARSE);
+    return msg;
+}
+
+// FILE_HOLE message, written in place: length (5), at most MAX_HOLE
+inline void write_file_hole(uint8_t* buf, uint64_t len) {
+    write_header(buf, MsgType::FILE_HOLE, HOLE_LEN_SIZE);
+    write_u32(buf + MSG_HEADER_SIZE, static_cast<uint32_t>(len));
+    buf[MSG_HEADER_SIZE + 4] = static_cast<uint8_t>(len >> 32);
+}
+
+// FILE_LINK message: path_len (2) + path + target_len (2) + target. path
+// becomes a hardlink of target, both below the destination root.
+inline std::vector<uint8_t> make_file_link(const std::string& path, const std::string& target) {
+    size_t path_len = std::min(path.size(), MAX_PATH_LEN);
+    size_t target_len = std::min(target.size(), MAX_PATH_LEN);
+    size_t payload_len = 2 + path_len + 2 + target_len;
+
+    std::vector<uint8_t> msg(MSG_HEADER_SIZE + payload_len);
+    write_header(msg.data(), MsgType::FILE_LINK, payload_len);
+    uint8_t* p = msg.data() + MSG_HEADER_SIZE;
+    write_u16(p, static_cast<uint16_t>(path_len));
+    memcpy(p + 2, path.data(), path_len);
+    p += 2 + path_len;
+    write_u16(p, static_cast<uint16_t>(target_len));
+    memcpy(p + 2, target.data(), target_len);
+    return msg;
+}
+
+// SIG_REQ message: path_len (2) + path
+inline std::vector<uint8_t> make_sig_req(const std::string& path) {
+    size_t path_len = std::min(path.size(), MAX_PATH_LEN);
+    std::vector<uint8_t> msg(MSG_HEADER_SIZE + 2 + path_len);
+    write_header(msg.data(), MsgType::SIG_REQ, 2 + path_len);
+    write_u16(msg.data() + 5, static_cast<uint16_t>(path_len));
+    memcpy(msg.data() + 7, path.data(), path_len);
+    return msg;
+}
+
+// SIGNATURE message: file_size (8) + block_size (4) + count (4)
+//                    + count x [weak (4) + strong (16)]
+inline std::vector<uint8_t> make_signature(const Signature& sig) {
+    size_t count = std::min<size_t>(sig.blocks.size(), MAX_SIG_BLOCKS);
+    size_t payload_len = SIGNATURE_HDR_SIZE + count * BLOCK_SIG_SIZE;
+
+    std::vector<uint8_t> msg(MSG_HEADER_SIZE + payload_len);
+    write_header(msg.data(), MsgType::SIGNATURE, payload_len);
+    write_u64(msg.data() + 5, sig.file_size);
+    write_u32(msg.data() + 13, sig.block_size);
+    write_u32(msg.data() + 17, static_cast<uint32_t>(count));
+
+    uint8_t* p = msg.data() + MSG_HEADER_SIZE + SIGNATURE_HDR_SIZE;
+    for (size_t i = 0; i < count; i++, p += BLOCK_SIG_SIZE) {
+        write_u32(p, sig.blocks[i].weak);
+        memcpy(p + 4, sig.blocks[i].strong, DELTA_STRONG_SIZE);
+    }
+    return msg;
+}
+
+// DELTA_HDR message: a FILE_HDR payload with mtime, then block_size (4)
+inline std::vector<uint8_t> make_delta_hdr(uint64_t size, uint32_t mode, const std::string& path,
+                                           int64_t mtime_ns, uint32_t block_size) {
+    auto msg = make_file_hdr(size, mode, path, true, mtime_ns);
+    size_t payload_len = msg.size() - MSG_HEADER_SIZE + 4;
+    msg.resize(MSG_HEADER_SIZE + payload_len);
+    write_header(msg.data(), MsgType::DELTA_HDR, payload_len);
+    write_u32(msg.data() + msg.size() - 4, block_size);
+    return msg;
+}
+
+// DELTA_COPY message: first block (4) + block count (4)
+constexpr size_t DELTA_COPY_SIZE = MSG_HEADER_SIZE + 8;
+
+inline void write_delta_copy(uint8_t* buf, uint32_t first, uint32_t count) {
+    write_header(buf, MsgType::DELTA_COPY, 8);
+    write_u32(buf + 5, first);
+    write_u32(buf + 9, count);
+}
+
+// DELTA_DONE message
+inline std::vector<uint8_t> make_delta_done() {
+    std::vector<uint8_t> msg(MSG_HEADER_SIZE);
+    write_header(msg.data(), MsgType::DELTA_DONE, 0);
+    return msg;
+}
+
 // ERROR message
 inline std::vector<uint8_t> make_error(uint8_t code, const std::string& message) {
     size_t msg_len = std::min(message.size(), MAX_ERROR_MSG_LEN);
@@ -183,6 +522,72 @@ inline std::vector<uint8_t> make_error(uint8_t code, const std::string& message)
     return msg;
 }
 
+// FILE_BATCH message, built in place in a caller-owned buffer (no
+// per-message allocation). Each entry is a FILE_HDR payload followed by
+// the file's bytes; the caller reads the file straight into add()'s slot.
+// Format: count (2) + count x [size (8) + mode (4) + path_len (2) + path
+//         + [incremental] mtime (8) + [verify] crc (4) + data]
+class BatchBuilder {
+public:
+    void reset(uint8_t* buf, size_t capacity, bool with_mtime = false, bool with_crc = false) {
+        buf_ = buf;
+        capacity_ = std::min(capacity, MAX_BATCH_FRAME);
+        with_mtime_ = with_mtime;
+        with_crc_ = with_crc;
+        entry_hdr_ = BATCH_ENTRY_HDR_SIZE + (with_mtime ? MTIME_SIZE : 0) +
+                     (with_crc ? CRC_SIZE : 0);
+        len_ = MSG_HEADER_SIZE + 2;
+        count_ = 0;
+    }
+
+    bool empty() const { return count_ == 0; }
+    uint16_t count() const { return count_; }
+    size_t size() const { return len_; }
+
+    // Whether a file can join this batch (or any batch, once empty)
+    bool fits(size_t path_len, uint64_t size) const {
+        if (size > MAX_BATCH_FILE_SIZE || count_ >= MAX_BATCH_FILES) return false;
+        return len_ + entry_hdr_ + std::min(path_len, MAX_PATH_LEN) + size <= capacity_;
+    }
+
+    // Append an entry; returns where its `size` bytes of data go. mtime_ns
+    // is written only if the builder was reset with_mtime. With with_crc
+    // the CRC_SIZE bytes in front of the data hold the entry's CRC32C; it
+    // starts as 0 (right for an empty file) and the caller fills it in.
+    uint8_t* add(uint64_t size, uint32_t mode, const std::string& path, int64_t mtime_ns = 0) {
+        size_t path_len = std::min(path.size(), MAX_PATH_LEN);
+        uint8_t* p = buf_ + len_;
+        write_u64(p, size);
+        write_u32(p + 8, mode);
+        write_u16(p + 12, static_cast<uint16_t>(path_len));
+        memcpy(p + BATCH_ENTRY_HDR_SIZE, path.data(), path_len);
+        if (with_mtime_) {
+            write_u64(p + BATCH_ENTRY_HDR_SIZE + path_len, static_cast<uint64_t>(mtime_ns));
+        }
+        if (with_crc_) write_u32(p + entry_hdr_ + path_len - CRC_SIZE, 0);
+
+        len_ += entry_hdr_ + path_len + size;
+        count_++;
+        return p + entry_hdr_ + path_len;
+    }
+
+    // Write the message header and count; returns the frame length
+    size_t finish() {
+        write_header(buf_, MsgType::FILE_BATCH, static_cast<uint32_t>(len_ - MSG_HEADER_SIZE));
+        write_u16(buf_ + MSG_HEADER_SIZE, count_);
+        return len_;
+    }
+
+private:
+    uint8_t* buf_ = nullptr;
+    size_t capacity_ = 0;
+    size_t entry_hdr_ = BATCH_ENTRY_HDR_SIZE;
+    bool with_mtime_ = false;
+    bool with_crc_ = false;
+    size_t len_ = 0;
+    uint16_t count_ = 0;
+};
+
 // ============================================================
 // Message Parsers
 // ============================================================
@@ -191,6 +596,9 @@ struct HelloMsg {
     uint8_t version;
     std::string secret;
     uint8_t nonce[NONCE_SIZE];
+    SessionInfo session;  // Defaults (single stream) for pre-v3 senders
+    Codec codec;          // Requested compression; NONE for pre-v5 senders
+    uint8_t flags;        // Requested session flags; 0 for pre-v6 senders
 };
 
 inline bool parse_hello(const uint8_t* payload, size_t len, HelloMsg& out) {
@@ -200,16 +608,53 @@ inline bool parse_hello(const uint8_t* payload, size_t len, HelloMsg& out) {
     if (len < 2 + secret_len + NONCE_SIZE) return false;
     out.secret.assign(reinterpret_cast<const char*>(payload + 2), secret_len);
     memcpy(out.nonce, payload + 2 + secret_len, NONCE_SIZE);
+
+    out.session = {};
+    size_t pos = 2 + secret_len + NONCE_SIZE;
+    if (out.version >= 3 && len >= pos + SESSION_INFO_SIZE) {
+        out.session.id = read_u64(payload + pos);
+        out.session.index = read_u16(payload + pos + 8);
+        out.session.count = read_u16(payload + pos + 10);
+        if (out.session.count == 0 || out.session.count > MAX_STREAMS ||
+            out.session.index >= out.session.count) {
+            return false;
+        }
+    }
+
+    out.codec = Codec::NONE;
+    pos += SESSION_INFO_SIZE;
+    if (out.version >= 5 && len > pos) {
+        if (!is_known_codec(payload[pos])) return false;
+        out.codec = static_cast<Codec>(payload[pos]);
+    }
+
+    out.flags = 0;
+    if (out.version >= 6 && len > pos + 1) {
+        out.flags = payload[pos + 1];
+    }
     return true;
 }
 
 struct HelloOkMsg {
     uint8_t nonce[NONCE_SIZE];
+    uint8_t version;      // Receiver's version; 3 for pre-v4 receivers
+    Codec codec;          // Accepted compression; NONE for pre-v5 receivers
+    uint8_t flags;        // Accepted session flags; 0 for pre-v6 receivers
 };
 
 inline bool parse_hello_ok(const uint8_t* payload, size_t len, HelloOkMsg& out) {
     if (len < NONCE_SIZE) return false;
     memcpy(out.nonce, payload, NONCE_SIZE);
+    out.version = len > NONCE_SIZE ? payload[NONCE_SIZE] : 3;
+    out.codec = Codec::NONE;
+    if (out.version >= 5 && len > NONCE_SIZE + 1) {
+        if (!is_known_codec(payload[NONCE_SIZE + 1])) return false;
+        out.codec = static_cast<Codec>(payload[NONCE_SIZE + 1]);
+    }
+    out.flags = 0;
+    if (out.version >= 6 && len > NONCE_SIZE + 2) {
+        out.flags = payload[NONCE_SIZE + 2];
+    }
     return true;
 }
 
@@ -217,6 +662,8 @@ struct FileHdrMsg {
     uint64_t size;
     uint32_t mode;
     std::string path;
+    bool has_mtime = false;   // Incremental sessions carry the source mtime
+    int64_t mtime_ns = 0;
 };
 
 inline bool parse_file_hdr(const uint8_t* payload, size_t len, FileHdrMsg& out) {
@@ -226,18 +673,179 @@ inline bool parse_file_hdr(const uint8_t* payload, size_t len, FileHdrMsg& out)
     uint16_t path_len = read_u16(payload + 12);
     if (len < 14 + path_len) return false;
     out.path.assign(reinterpret_cast<const char*>(payload + 14), path_len);
+    out.has_mtime = len >= 14 + path_len + MTIME_SIZE;
+    out.mtime_ns = out.has_mtime ? static_cast<int64_t>(read_u64(payload + 14 + path_len)) : 0;
+    return true;
+}
+
+inline bool parse_sig_req(const uint8_t* payload, size_t len, std::string& path) {
+    if (len < 2) return false;
+    uint16_t path_len = read_u16(payload);
+    if (len != 2u + path_len) return false;
+    path.assign(reinterpret_cast<const char*>(payload + 2), path_len);
+    return true;
+}
+
+inline bool parse_signature(const uint8_t* payload, size_t len, Signature& out) {
+    if (len < SIGNATURE_HDR_SIZE) return false;
+    out.file_size = read_u64(payload);
+    out.block_size = read_u32(payload + 8);
+    uint32_t count = read_u32(payload + 12);
+    if (count > MAX_SIG_BLOCKS || len != SIGNATURE_HDR_SIZE + count * BLOCK_SIG_SIZE) return false;
+    if (count > 0 && (out.block_size == 0 ||
+                      (out.file_size + out.block_size - 1) / out.block_size != count)) {
+        return false;
+    }
+
+    out.blocks.resize(count);
+    const uint8_t* p = payload + SIGNATURE_HDR_SIZE;
+    for (uint32_t i = 0; i < count; i++, p += BLOCK_SIG_SIZE) {
+        out.blocks[i].weak = read_u32(p);
+        memcpy(out.blocks[i].strong, p + 4, DELTA_STRONG_SIZE);
+    }
     return true;
 }
 
+// DELTA_HDR: the FILE_HDR fields (mtime required) plus the block size
+inline bool parse_delta_hdr(const uint8_t* payload, size_t len, FileHdrMsg& out,
+                            uint32_t& block_size) {
+    if (len < 4 || !parse_file_hdr(payload, len - 4, out) || !out.has_mtime) return false;
+    if (len != 14 + out.path.size() + MTIME_SIZE + 4) return false;
+    block_size = read_u32(payload + len - 4);
+    return block_size > 0;
+}
+
+// Append a MANIFEST payload's entries to out. Checks the count against the
+// length; ordering is the merger's job.
+inline bool parse_manifest(const uint8_t* payload, size_t len, std::vector<ManifestEntry>& out) {
+    if (len < 2) return false;
+    uint16_t count = read_u16(payload);
+    if (count > MAX_MANIFEST_ENTRIES || len != 2 + count * MANIFEST_ENTRY_SIZE) return false;
+
+    const uint8_t* p = payload + 2;
+    for (uint16_t i = 0; i < count; i++, p += MANIFEST_ENTRY_SIZE) {
+        out.push_back({read_u64(p), read_u64(p + 8), static_cast<int64_t>(read_u64(p + 16))});
+    }
+    return true;
+}
+
+// Append a RESUME payload's entries to out
+inline bool parse_resume(const uint8_t* payload, size_t len, std::vector<ResumeEntry>& out) {
+    if (len < 2) return false;
+    uint16_t count = read_u16(payload);
+    if (count > MAX_RESUME_ENTRIES || len != 2 + count * RESUME_ENTRY_SIZE) return false;
+
+    const uint8_t* p = payload + 2;
+    for (uint16_t i = 0; i < count; i++, p += RESUME_ENTRY_SIZE) {
+        out.push_back({read_u64(p), read_u64(p + 8), static_cast<int64_t>(read_u64(p + 16)),
+                       read_u64(p + 24)});
+    }
+    return true;
+}
+
+// FILE_RESUME: the FILE_HDR fields (mtime required) plus an offset inside
+// the file (not at its end: a whole copy needs no resume)
+inline bool parse_file_resume(const uint8_t* payload, size_t len, FileHdrMsg& out,
+                              uint64_t& offset) {
+    if (len < RESUME_OFFSET_SIZE ||
+        !parse_file_hdr(payload, len - RESUME_OFFSET_SIZE, out) || !out.has_mtime) {
+        return false;
+    }
+    if (len != 14 + out.path.size() + MTIME_SIZE + RESUME_OFFSET_SIZE) return false;
+    offset = read_u64(payload + len - RESUME_OFFSET_SIZE);
+    return offset > 0 && offset < out.size;
+}
+
+// FILE_HOLE: a run of zeros inside what is left of the file (remaining),
+// never reaching its end
+inline bool parse_file_hole(const uint8_t* payload, size_t len, uint64_t remaining,
+                            uint64_t& hole) {
+    if (len != HOLE_LEN_SIZE) return false;
+    hole = read_u32(payload) | (static_cast<uint64_t>(payload[4]) << 32);
+    return hole > 0 && hole < remaining;
+}
+
+// FILE_LINK: two non-empty paths
+inline bool parse_file_link(const uint8_t* payload, size_t len, std::string& path,
+                            std::string& target) {
+    if (len < 2) return false;
+    uint16_t path_len = read_u16(payload);
+    if (path_len == 0 || len < 2u + path_len + 2) return false;
+    uint16_t target_len = read_u16(payload + 2 + path_len);
+    if (target_len == 0 || len != 2u + path_len + 2 + target_len) return false;
+    path.assign(reinterpret_cast<const char*>(payload + 2), path_len);
+    target.assign(reinterpret_cast<const char*>(payload + 4 + path_len), target_len);
+    return true;
+}
+
+struct DataFrame {
+    Codec codec;
+    uint32_t raw_len;     // Bytes of the file this frame carries
+    uint32_t data_len;    // Bytes following the frame header
+};
+
+// Parse the frame fields after the 5-byte message header. Checks the
+// frame against what is left of the file (remaining) and the raw limit.
+inline bool parse_data_frame(const uint8_t* buf, uint32_t payload_len, uint64_t remaining,
+                             DataFrame& out) {
+    if (payload_len < 5 || !is_known_codec(buf[0])) return false;
+    out.codec = static_cast<Codec>(buf[0]);
+    out.raw_len = read_u32(buf + 1);
+    out.data_len = payload_len - 5;
+    if (out.raw_len == 0 || out.raw_len > MAX_FRAME_RAW || out.raw_len > remaining) return false;
+    if (out.codec == Codec::NONE && out.data_len != out.raw_len) return false;
+    return out.data_len > 0;
+}
+
+// One FILE_BATCH entry; path and data point into the payload
+struct BatchEntry {
+    uint64_t size;
+    uint32_t mode;
+    std::string_view path;
+    int64_t mtime_ns;     // 0 unless parsed with_mtime
+    uint32_t crc;         // 0 unless parsed with_crc
+    const uint8_t* data;
+};
+
+// Split a FILE_BATCH payload into entries (out is reused by the caller).
+// The whole frame is checked before anything is written.
+inline bool parse_file_batch(const uint8_t* payload, size_t len, std::vector<BatchEntry>& out,
+                             bool with_mtime = false, bool with_crc = false) {
+    size_t extra = (with_mtime ? MTIME_SIZE : 0) + (with_crc ? CRC_SIZE : 0);
+    out.clear();
+    if (len < 2) return false;
+    uint16_t count = read_u16(payload);
+    if (count == 0 || count > MAX_BATCH_FILES) return false;
+
+    size_t pos = 2;
+    for (uint16_t i = 0; i < count; i++) {
+        if (len - pos < BATCH_ENTRY_HDR_SIZE) return false;
+        BatchEntry e;
+        e.size = read_u64(payload + pos);
+        e.mode = read_u32(payload + pos + 8);
+        uint16_t path_len = read_u16(payload + pos + 12);
+        pos += BATCH_ENTRY_HDR_SIZE;
+
+        if (e.size > MAX_BATCH_FILE_SIZE || len - pos < path_len + extra + e.size) return false;
+        e.path = std::string_view(reinterpret_cast<const char*>(payload + pos), path_len);
+        e.mtime_ns = with_mtime ? static_cast<int64_t>(read_u64(payload + pos + path_len)) : 0;
+        e.crc = with_crc ? read_u32(payload + pos + path_len + extra - CRC_SIZE) : 0;
+        e.data = payload + pos + path_len + extra;
+        pos += path_len + extra + e.size;
+        out.push_back(e);
+    }
+    return pos == len;
+}
+
 // ============================================================
 // Path Validation (Security)
 // ============================================================
 
-inline bool is_safe_path(const std::string& path) {
+inline bool is_safe_path(std::string_view path) {
     if (path.empty()) return false;
     if (path[0] == '/') return false;  // No absolute paths
-    if (path.find("..") != std::string::npos) return false;  // No traversal
-    if (path.find('\0') != std::string::npos) return false;  // No null bytes
+    if (path.find("..") != std::string_view::npos) return false;  // No traversal
+    if (path.find('\0') != std::string_view::npos) return false;  // No null bytes
     return true;
 }
 
@@ -1,14 +1,126 @@
 #pragma once
 #include <liburing.h>
+#include <algorithm>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <fcntl.h>
+#include <unistd.h>
 #include "common.hpp"
 
+// ============================================================
+// Ring Setup Profiles
+// ============================================================
+// How a ring is set up trades CPU for syscalls and interrupts:
+//   DEFAULT  every submit is an io_uring_enter
+//   SQPOLL   a kernel thread polls the SQ, so submits cost no syscall while
+//            it is awake; it sleeps after sqpoll_idle_ms without work
+//   COOP     COOP_TASKRUN: completion work waits for our next syscall
+//            instead of interrupting the thread
+//   DEFER    SINGLE_ISSUER | DEFER_TASKRUN: completion work runs only when
+//            we wait for it; only the thread that made the ring may use it
+// A profile the kernel refuses falls back: DEFER to COOP, the others to
+// DEFAULT.
+
+enum class RingProfile : uint8_t { DEFAULT, SQPOLL, COOP, DEFER };
+
+struct RingSetup {
+    RingProfile profile = RingProfile::DEFAULT;
+    int sqpoll_cpu = -1;            // SQPOLL thread of ring i runs on CPU sqpoll_cpu + i (-1 = any)
+    unsigned sqpoll_idle_ms = 50;   // SQPOLL thread sleeps after this long without work
+};
+
+inline const char* ring_profile_name(RingProfile profile) {
+    switch (profile) {
+        case RingProfile::SQPOLL: return "sqpoll";
+        case RingProfile::COOP:   return "coop";
+        case RingProfile::DEFER:  return "defer";
+        default:                  return "default";
+    }
+}
+
+inline bool parse_ring_profile(const std::string& name, RingProfile& out) {
+    for (RingProfile p : {RingProfile::DEFAULT, RingProfile::SQPOLL,
+                          RingProfile::COOP, RingProfile::DEFER}) {
+        if (name == ring_profile_name(p)) {
+            out = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+// TASKRUN_FLAG makes peeking for CQEs enter the kernel when work is pending
+inline unsigned ring_setup_flags(RingProfile profile) {
+    switch (profile) {
+        case RingProfile::SQPOLL:
+            return IORING_SETUP_SQPOLL;
+        case RingProfile::COOP:
+            return IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG;
+        case RingProfile::DEFER:
+            return IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN |
+                   IORING_SETUP_TASKRUN_FLAG;
+        default:
+            return 0;
+    }
+}
+
+// Set up ring with setup.profile or the first fallback the kernel takes;
+// used gets the profile in effect. index is the ring's number among its
+// siblings (worker, stream). Returns 0 or -errno if a plain ring fails too.
+inline int ring_init(unsigned entries, struct io_uring* ring, const RingSetup& setup,
+                     unsigned index = 0, RingProfile* used = nullptr) {
+    RingProfile profile = setup.profile;
+    while (true) {
+        struct io_uring_params params = {};
+        params.flags = ring_setup_flags(profile);
+        if (profile == RingProfile::SQPOLL) {
+            params.sq_thread_idle = setup.sqpoll_idle_ms;
+            if (setup.sqpoll_cpu >= 0) {
+                long cpus = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+                params.flags |= IORING_SETUP_SQ_AFF;
+                params.sq_thread_cpu = static_cast<unsigned>((setup.sqpoll_cpu + index) % cpus);
+            }
+        }
+
+        int ret = io_uring_queue_init_params(entries, ring, &params);
+        // Before 5.11 an SQPOLL ring only takes fixed files
+        if (ret == 0 && profile == RingProfile::SQPOLL &&
+            !(params.features & IORING_FEAT_SQPOLL_NONFIXED)) {
+            io_uring_queue_exit(ring);
+            ret = -EINVAL;
+        }
+        if (ret == 0 || profile == RingProfile::DEFAULT) {
+            if (ret == 0 && used) *used = profile;
+            return ret;
+        }
+        profile = profile == RingProfile::DEFER ? RingProfile::COOP : RingProfile::DEFAULT;
+    }
+}
+
+// The profile rings made with setup get on this kernel (startup probe)
+inline RingProfile probe_ring_profile(const RingSetup& setup) {
+    struct io_uring ring;
+    RingProfile used = RingProfile::DEFAULT;
+    if (ring_init(4, &ring, setup, 0, &used) == 0) io_uring_queue_exit(&ring);
+    return used;
+}
+
+// Make room for n SQEs. Flushing an SQPOLL ring only hands the entries to
+// its kernel thread, so wait until the thread has taken enough of them.
+inline void ring_reserve(struct io_uring* ring, unsigned n) {
+    if (io_uring_sq_space_left(ring) >= n) return;
+    io_uring_submit(ring);
+    while ((ring->flags & IORING_SETUP_SQPOLL) && io_uring_sq_space_left(ring) < n) {
+        if (io_uring_sqring_wait(ring) < 0) break;
+    }
+}
+
 class RingManager {
 public:
-    RingManager(unsigned int depth) : depth_(depth) {
-        if (io_uring_queue_init(depth, &ring, 0) < 0) {
+    RingManager(unsigned int depth, const RingSetup& setup = {}, unsigned index = 0)
+        : depth_(depth) {
+        if (ring_init(depth, &ring, setup, index, &profile_) < 0) {
             throw std::runtime_error("Failed to initialize io_uring");
         }
     }
@@ -30,7 +142,7 @@ public:
                         FileContext* ctx, bool link = false) {
         struct io_uring_sqe* sqe = get_sqe();
         io_uring_prep_openat(sqe, dirfd, path, flags, mode);
-        io_uring_sqe_set_data(sqe, ctx);
+        set_data(sqe, ctx, 0);
         if (link) sqe->flags |= IOSQE_IO_LINK;
     }
 
@@ -39,7 +151,7 @@ public:
                        struct statx* statxbuf, FileContext* ctx, bool link = false) {
         struct io_uring_sqe* sqe = get_sqe();
         io_uring_prep_statx(sqe, dirfd, path, flags, mask, statxbuf);
-        io_uring_sqe_set_data(sqe, ctx);
+        set_data(sqe, ctx, 0);
         if (link) sqe->flags |= IOSQE_IO_LINK;
     }
 
@@ -47,50 +159,124 @@ public:
     void prepare_close(int fd, FileContext* ctx, bool link = false) {
         struct io_uring_sqe* sqe = get_sqe();
         io_uring_prep_close(sqe, fd);
-        io_uring_sqe_set_data(sqe, ctx);
+        set_data(sqe, ctx, 0);
         if (link) sqe->flags |= IOSQE_IO_LINK;
     }
 
-    // Read from file (using fd)
+    // Read from file (using fd); tag comes back with the completion
     void prepare_read(int fd, char* buffer, unsigned len, uint64_t offset,
-                      FileContext* ctx, bool link = false) {
+                      FileContext* ctx, bool link = false, unsigned tag = 0) {
         struct io_uring_sqe* sqe = get_sqe();
         io_uring_prep_read(sqe, fd, buffer, len, offset);
-        io_uring_sqe_set_data(sqe, ctx);
+        set_data(sqe, ctx, tag);
         if (link) sqe->flags |= IOSQE_IO_LINK;
     }
 
-    // Write to file (using fd)
+    // Write to file (using fd); tag comes back with the completion
     void prepare_write(int fd, char* buffer, unsigned len, uint64_t offset,
-                       FileContext* ctx, bool link = false) {
+                       FileContext* ctx, bool link = false, unsigned tag = 0) {
         struct io_uring_sqe* sqe = get_sqe();
         io_uring_prep_write(sqe, fd, buffer, len, offset);
-        io_uring_sqe_set_data(sqe, ctx);
+        set_data(sqe, ctx, tag);
         if (link) sqe->flags |= IOSQE_IO_LINK;
     }
 
     // Splice - kernel-to-kernel zero copy (requires pipe)
-    // For file copy: src_fd → pipe_write, then pipe_read → dst_fd
+    // For file copy: src_fd → pipe_write, then pipe_read → dst_fd; tag as for reads
     void prepare_splice(int fd_in, int64_t off_in, int fd_out, int64_t off_out,
                         unsigned int len, unsigned int flags, FileContext* ctx,
-                        bool link = false) {
+                        bool link = false, unsigned tag = 0) {
         struct io_uring_sqe* sqe = get_sqe();
         io_uring_prep_splice(sqe, fd_in, off_in, fd_out, off_out, len, flags);
-        io_uring_sqe_set_data(sqe, ctx);
+        set_data(sqe, ctx, tag);
+        if (link) sqe->flags |= IOSQE_IO_LINK;
+    }
+
+
+    // ============================================================
+    // Fixed-File (direct descriptor) Operations
+    // ============================================================
+    // Slots are chosen by the caller rather than IORING_FILE_INDEX_ALLOC so
+    // that linked SQEs can refer to a slot before the open has completed.
+
+    // Register a sparse fixed-file table with `count` empty slots
+    bool register_file_slots(unsigned count) {
+        if (file_slots_ > 0) return false;
+        if (io_uring_register_files_sparse(&ring, count) < 0) return false;
+        file_slots_ = count;
+        return true;
+    }
+
+    unsigned file_slots() const { return file_slots_; }
+
+    // Open directly into fixed-file slot (fd never returned to userspace)
+    void prepare_openat_direct(int dirfd, const char* path, int flags, mode_t mode,
+                               unsigned slot, FileContext* ctx, bool link = false) {
+        struct io_uring_sqe* sqe = get_sqe();
+        io_uring_prep_openat_direct(sqe, dirfd, path, flags, mode, slot);
+        set_data(sqe, ctx, 0);
+        if (link) sqe->flags |= IOSQE_IO_LINK;
+    }
+
+    // Read from fixed-file slot
+    void prepare_read_direct(unsigned slot, char* buffer, unsigned len, uint64_t offset,
+                             FileContext* ctx, bool link = false) {
+        struct io_uring_sqe* sqe = get_sqe();
+        io_uring_prep_read(sqe, slot, buffer, len, offset);
+        set_data(sqe, ctx, 0);
+        sqe->flags |= IOSQE_FIXED_FILE;
         if (link) sqe->flags |= IOSQE_IO_LINK;
     }
 
+    // Write to fixed-file slot
+    void prepare_write_direct(unsigned slot, char* buffer, unsigned len, uint64_t offset,
+                              FileContext* ctx, bool link = false) {
+        struct io_uring_sqe* sqe = get_sqe();
+        io_uring_prep_write(sqe, slot, buffer, len, offset);
+        set_data(sqe, ctx, 0);
+        sqe->flags |= IOSQE_FIXED_FILE;
+        if (link) sqe->flags |= IOSQE_IO_LINK;
+    }
+
+    // Close fixed-file slot
+    void prepare_close_direct(unsigned slot, FileContext* ctx, bool link = false) {
+        struct io_uring_sqe* sqe = get_sqe();
+        io_uring_prep_close_direct(sqe, slot);
+        set_data(sqe, ctx, 0);
+        if (link) sqe->flags |= IOSQE_IO_LINK;
+    }
+
+    // Page cache advice (readahead hints). Completes with a null context,
+    // which the worker skips: a failed hint changes nothing
+    void prepare_fadvise(int fd, uint64_t offset, uint32_t len, int advice) {
+        struct io_uring_sqe* sqe = get_sqe();
+        io_uring_prep_fadvise(sqe, fd, offset, len, advice);
+        io_uring_sqe_set_data(sqe, nullptr);
+    }
+
+    // No-op completion - used to drive steps that run outside io_uring
+    // (e.g. copy_file_range, which has no io_uring opcode) through the state machine
+    void prepare_nop(FileContext* ctx) {
+        struct io_uring_sqe* sqe = get_sqe();
+        io_uring_prep_nop(sqe);
+        set_data(sqe, ctx, 0);
+    }
 
     // Create directory asynchronously
     void prepare_mkdirat(int dirfd, const char* path, mode_t mode, FileContext* ctx) {
         struct io_uring_sqe* sqe = get_sqe();
         io_uring_prep_mkdirat(sqe, dirfd, path, mode);
-        io_uring_sqe_set_data(sqe, ctx);
+        set_data(sqe, ctx, 0);
     }
 
     // ============================================================
     // Submission and Completion
     // ============================================================
+    // FileContext is cache-line aligned, so the low bits of user_data carry
+    // a small tag: it tells apart the ops of a context that has several in
+    // flight (the read/write pipeline). Callbacks take (ctx, res) or
+    // (ctx, res, tag).
+    static constexpr unsigned TAG_MASK = alignof(FileContext) - 1;
 
     int submit() {
         return io_uring_submit(&ring);
@@ -101,9 +287,10 @@ public:
         int ret = io_uring_wait_cqe(&ring, &cqe);
         if (ret < 0) return nullptr;
 
-        FileContext* ctx = static_cast<FileContext*>(io_uring_cqe_get_data(cqe));
+        FileContext* ctx = context_of(cqe);
         res_out = cqe->res;
         io_uring_cqe_seen(&ring, cqe);
+        in_flight_--;
         return ctx;
     }
 
@@ -113,11 +300,7 @@ public:
         int processed = 0;
 
         while (io_uring_peek_cqe(&ring, &cqe) == 0) {
-            FileContext* ctx = static_cast<FileContext*>(io_uring_cqe_get_data(cqe));
-            int res = cqe->res;
-            io_uring_cqe_seen(&ring, cqe);
-
-            callback(ctx, res);
+            complete(cqe, callback);
             processed++;
         }
         return processed;
@@ -129,11 +312,7 @@ public:
         int ret = io_uring_wait_cqe(&ring, &cqe);
         if (ret < 0) return -1;
 
-        FileContext* ctx = static_cast<FileContext*>(io_uring_cqe_get_data(cqe));
-        int res = cqe->res;
-        io_uring_cqe_seen(&ring, cqe);
-        callback(ctx, res);
-
+        complete(cqe, callback);
         return 1 + process_completions(std::forward<Callback>(callback));
     }
 
@@ -141,8 +320,28 @@ public:
         return io_uring_sq_space_left(&ring) > 0;
     }
 
+    // Free SQ slots - a link chain must fit in one submission or it is cut short
+    unsigned sq_space_left() const {
+        return io_uring_sq_space_left(&ring);
+    }
+
+    // Make room for a chain of n SQEs (submits, and on SQPOLL waits)
+    void reserve(unsigned n) {
+        ring_reserve(&ring, n);
+    }
+
     unsigned int depth() const { return depth_; }
 
+    // Profile in effect after any fallback
+    RingProfile profile() const { return profile_; }
+
+    // Stamp each file op's preparation time into its context
+    // (cold->op_start, by tag) for op latency metrics
+    void set_op_clock(bool on) { op_clock_ = on; }
+
+    // SQEs handed out whose CQE has not been reaped
+    unsigned in_flight() const { return in_flight_; }
+
     // ============================================================
     // Network Operations
     // ============================================================
@@ -184,16 +383,45 @@ public:
 private:
     struct io_uring ring;
     unsigned int depth_;
+    unsigned int file_slots_ = 0;
+    RingProfile profile_ = RingProfile::DEFAULT;
+    bool op_clock_ = false;
+    unsigned in_flight_ = 0;
+
+    void set_data(struct io_uring_sqe* sqe, FileContext* ctx, unsigned tag) {
+        io_uring_sqe_set_data64(sqe, reinterpret_cast<uintptr_t>(ctx) | tag);
+        if (op_clock_ && ctx) ctx->cold->op_start[tag % OP_CLOCK_SLOTS] = now_ns();
+    }
+
+    static FileContext* context_of(const struct io_uring_cqe* cqe) {
+        return reinterpret_cast<FileContext*>(io_uring_cqe_get_data64(cqe) & ~uint64_t{TAG_MASK});
+    }
+
+    // Hand one CQE to the callback and mark it seen
+    template<typename Callback>
+    void complete(struct io_uring_cqe* cqe, Callback& callback) {
+        FileContext* ctx = context_of(cqe);
+        int res = cqe->res;
+        unsigned tag = static_cast<unsigned>(io_uring_cqe_get_data64(cqe) & TAG_MASK);
+        io_uring_cqe_seen(&ring, cqe);
+        in_flight_--;
+        if constexpr (std::is_invocable_v<Callback&, FileContext*, int, unsigned>) {
+            callback(ctx, res, tag);
+        } else {
+            callback(ctx, res);
+        }
+    }
 
     struct io_uring_sqe* get_sqe() {
         struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
         if (!sqe) {
-            io_uring_submit(&ring);
+            ring_reserve(&ring, 1);
             sqe = io_uring_get_sqe(&ring);
             if (!sqe) {
                 throw std::runtime_error("Submission Queue is full!");
             }
         }
+        in_flight_++;
         return sqe;
     }
 };
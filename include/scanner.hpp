@@ -0,0 +1,463 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "common.hpp"
+#include "extent.hpp"
+#include "journal.hpp"
+#include "scheduler.hpp"
+
+// ============================================================
+// Streaming Directory Scanner
+// ============================================================
+// Walks the source tree with N threads and feeds FileWorkItems into the
+// work queue in batches while workers are already copying.
+//
+// - getdents64 + d_type: no stat() per entry (inode comes from d_ino)
+// - Destination directories are created once, when their source dir is
+//   first discovered, so no per-file create_directories()
+// - Each batch is inode-sorted before it is pushed, preserving most of
+//   the disk locality of a global sort without holding the whole tree
+// - File sizes are stat'ed for the first `sample_files` entries only,
+//   enough for SizeStats::pick_chunk_size(), unless `stat_files` asks
+//   for size/mode on every item
+// - `skip_unchanged` (incremental) compares every file with its copy and
+//   drops it when size and mtime match; items then carry the mtime
+// - `split_size` turns each file at least that large into SPLIT_SEGMENT
+//   range items, so workers copy its parts concurrently; segments the
+//   `journal` (--resume) records as copied are left out
+// - `extent_order` looks up each file's first physical extent (FIEMAP) as
+//   it is found, and batches are sorted by it instead; once the source
+//   filesystem turns out not to support FIEMAP, inode order is kept
+// - `hardlinks` stats every file; of the names sharing a (dev, ino), the
+//   first found is queued and the others become links to its copy,
+//   collected for take_links() instead of being copied again
+
+// Kernel dirent layout for getdents64
+struct linux_dirent64 {
+    uint64_t       d_ino;
+    int64_t        d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char           d_name[];
+};
+
+// A hardlink to recreate: dst_path becomes a link of target, the copy of
+// the first name of the file that was found
+struct HardLink {
+    std::string dst_path;
+    std::string target;
+};
+
+// Append item to batch; a file of at least split_size (0 = never) with a
+// known size is appended as SPLIT_SEGMENT ranges in file order instead.
+// With a journal (--resume), segments its copy of this source already
+// holds are left out; the last one always goes, to stamp the mtime.
+// Returns the bytes left out.
+inline uint64_t append_split(std::vector<FileWorkItem>& batch, FileWorkItem&& item,
+                             uint64_t split_size, const CheckpointJournal* journal = nullptr) {
+    if (split_size == 0 || item.size == FileWorkItem::UNKNOWN_SIZE ||
+        item.size < split_size || item.size <= SPLIT_SEGMENT) {
+        batch.push_back(std::move(item));
+        return 0;
+    }
+
+    auto split = std::make_shared<SplitFile>();
+    split->size = item.size;
+    split->mtime = item.mtime;
+    uint64_t count = (item.size + SPLIT_SEGMENT - 1) / SPLIT_SEGMENT;
+
+    CheckpointJournal::Progress done;
+    split->resumed = journal && item.mtime.tv_nsec != UTIME_OMIT &&
+                     journal->find(journal->key(item.dst_path), done) &&
+                     done.size == item.size && done.mtime_ns == to_mtime_ns(item.mtime);
+    uint64_t skipped = 0;
+    size_t first = batch.size();
+
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t offset = i * SPLIT_SEGMENT;
+        uint64_t len = std::min(SPLIT_SEGMENT, item.size - offset);
+        if (split->resumed && i + 1 < count && done.covers(offset, len)) {
+            skipped += len;
+            continue;
+        }
+        FileWorkItem seg;
+        seg.src_path = item.src_path;
+        seg.dst_path = item.dst_path;
+        seg.inode = item.inode;
+        seg.extent = item.extent;
+        seg.size = item.size;
+        seg.mode = item.mode;
+        seg.mtime = item.mtime;
+        seg.split = split;
+        seg.range_offset = offset;
+        seg.range_len = len;
+        batch.push_back(std::move(seg));
+    }
+    split->segments_left = static_cast<uint32_t>(batch.size() - first);
+    return skipped;
+}
+
+struct ScanOptions {
+    int threads = 4;              // Concurrent directory walkers
+    size_t batch_size = 256;      // Files per push_bulk()
+    size_t sample_files = 200;    // Files stat'ed for chunk-size sampling
+    bool stat_files = false;      // stat every file so items carry size/mode
+    bool skip_unchanged = false;  // Skip files whose dst has the same size + mtime
+    uint64_t split_size = 0;      // Files this large become range segments (needs stat_files)
+    bool extent_order = false;    // Sort batches by first physical extent (FIEMAP)
+    const CheckpointJournal* journal = nullptr;  // Split files resume from it (--resume)
+    bool hardlinks = false;       // Recreate hardlinks instead of copying each name
+    bool verbose = false;
+};
+
+// Queue is anything with push_bulk(std::vector<FileWorkItem>&) and set_done()
+template<typename Queue = WorkScheduler<FileWorkItem>>
+class DirScanner {
+public:
+    using Options = ScanOptions;
+
+    DirScanner(const std::string& src_base, const std::string& dst_base,
+               Queue& queue, Stats& stats, const Options& opts)
+        : src_base_(src_base), dst_base_(dst_base), queue_(queue),
+          stats_(stats), opts_(opts) {
+        if (opts_.threads <= 0) opts_.threads = 1;
+        if (opts_.batch_size == 0) opts_.batch_size = 1;
+    }
+
+    ~DirScanner() {
+        join();
+    }
+
+    // Non-copyable
+    DirScanner(const DirScanner&) = delete;
+    DirScanner& operator=(const DirScanner&) = delete;
+
+    // Start walking. dst_base must already exist.
+    void start() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            dirs_.push_back({src_base_, dst_base_});
+            outstanding_ = 1;
+        }
+        threads_.reserve(opts_.threads);
+        for (int i = 0; i < opts_.threads; i++) {
+            threads_.emplace_back([this] { scan_loop(); });
+        }
+    }
+
+    // Block until enough file sizes are sampled (or the scan is finished)
+    void wait_for_samples() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] {
+            return finished_ || sampled_ >= opts_.sample_files;
+        });
+    }
+
+    // Wait for all scanner threads (the queue is marked done when the walk ends)
+    void join() {
+        for (auto& t : threads_) {
+            if (t.joinable()) t.join();
+        }
+        threads_.clear();
+    }
+
+    // Snapshot of sampled sizes (safe while scanning)
+    SizeStats size_stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return size_stats_;
+    }
+
+    bool finished() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return finished_;
+    }
+
+    uint64_t files_found() const { return files_found_.load(); }
+    uint64_t dirs_scanned() const { return dirs_scanned_.load(); }
+    uint64_t errors() const { return errors_.load(); }
+    uint64_t extents_mapped() const { return extents_mapped_.load(); }
+    bool fiemap_supported() const { return fiemap_ok_.load(); }
+
+    size_t links_found() const {
+        std::lock_guard<std::mutex> lock(links_mutex_);
+        return links_.size();
+    }
+
+    // The links, once the walk is finished
+    std::vector<HardLink> take_links() {
+        std::lock_guard<std::mutex> lock(links_mutex_);
+        return std::move(links_);
+    }
+
+private:
+    struct DirTask {
+        std::string src;
+        std::string dst;
+        bool dst_created = false;   // Created by this scan, so nothing to compare
+    };
+
+    void scan_loop() {
+        std::vector<char> dent_buf(64 * 1024);
+        std::vector<FileWorkItem> batch;
+        batch.reserve(opts_.batch_size);
+
+        while (true) {
+            DirTask task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return !dirs_.empty() || finished_; });
+                if (dirs_.empty()) break;
+                // LIFO: depth-first keeps the pending set small
+                task = std::move(dirs_.back());
+                dirs_.pop_back();
+            }
+
+            scan_dir(task, dent_buf, batch);
+            flush(batch);
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--outstanding_ == 0) {
+                finished_ = true;
+                queue_.set_done();
+                cv_.notify_all();
+            }
+        }
+    }
+
+    void scan_dir(const DirTask& task, std::vector<char>& dent_buf,
+                  std::vector<FileWorkItem>& batch) {
+        int dfd = open(task.src.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dfd < 0) {
+            if (opts_.verbose) {
+                fprintf(stderr, "Cannot open directory %s: %s\n",
+                        task.src.c_str(), strerror(errno));
+            }
+            errors_++;
+            return;
+        }
+        dirs_scanned_++;
+
+        int dst_dfd = -1;
+        if (opts_.skip_unchanged && !task.dst_created) {
+            dst_dfd = open(task.dst.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        }
+
+        while (true) {
+            long n = syscall(SYS_getdents64, dfd, dent_buf.data(), dent_buf.size());
+            if (n <= 0) {
+                if (n < 0) errors_++;
+                break;
+            }
+
+            for (long pos = 0; pos < n;) {
+                auto* d = reinterpret_cast<linux_dirent64*>(dent_buf.data() + pos);
+                pos += d->d_reclen;
+
+                const char* name = d->d_name;
+                if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                    continue;
+                }
+
+                unsigned char type = d->d_type;
+                struct stat st;
+                bool have_stat = false;
+
+                // Symlinks are followed for files (matches previous is_regular_file()
+                // behaviour), never for directories
+                if (type == DT_UNKNOWN || type == DT_LNK) {
+                    int flags = (type == DT_LNK) ? 0 : AT_SYMLINK_NOFOLLOW;
+                    if (fstatat(dfd, name, &st, flags) != 0) continue;
+                    have_stat = true;
+                    if (S_ISREG(st.st_mode)) type = DT_REG;
+                    else if (S_ISDIR(st.st_mode) && d->d_type != DT_LNK) type = DT_DIR;
+                    else continue;
+                }
+
+                if (type == DT_DIR) {
+                    DirTask child{task.src + "/" + name, task.dst + "/" + name};
+                    if (mkdir(child.dst.c_str(), 0777) == 0) {
+                        stats_.dirs_created++;
+                        child.dst_created = true;
+                    } else if (errno != EEXIST) {
+                        if (opts_.verbose) {
+                            fprintf(stderr, "Cannot create directory %s: %s\n",
+                                    child.dst.c_str(), strerror(errno));
+                        }
+                        errors_++;
+                        continue;
+                    }
+                    push_dir(std::move(child));
+                } else if (type == DT_REG) {
+                    bool need_stat = opts_.stat_files || opts_.skip_unchanged || opts_.hardlinks;
+                    if (need_stat && !have_stat) {
+                        have_stat = fstatat(dfd, name, &st, 0) == 0;
+                    }
+                    // Before the unchanged check: a copy may match without being a link
+                    if (opts_.hardlinks && have_stat && st.st_nlink > 1 &&
+                        link_seen(st, task.dst + "/" + name)) {
+                        continue;
+                    }
+                    if (dst_dfd >= 0 && have_stat && unchanged(dst_dfd, name, st)) {
+                        stats_.files_skipped++;
+                        continue;
+                    }
+                    if (next_sample_.load(std::memory_order_relaxed) < opts_.sample_files) {
+                        sample(dfd, name, have_stat ? &st : nullptr);
+                    }
+                    batch.push_back({task.src + "/" + name, task.dst + "/" + name,
+                                     static_cast<ino_t>(d->d_ino)});
+                    if (opts_.stat_files && have_stat) {
+                        batch.back().size = st.st_size;
+                        batch.back().mode = st.st_mode;
+                    }
+                    if (opts_.skip_unchanged && have_stat) {
+                        batch.back().mtime = st.st_mtim;
+                    }
+                    if (opts_.extent_order && fiemap_ok_.load(std::memory_order_relaxed)) {
+                        batch.back().extent = lookup_extent(dfd, name);
+                    }
+                    if (batch.size() >= opts_.batch_size) {
+                        flush(batch);
+                    }
+                }
+            }
+        }
+
+        if (dst_dfd >= 0) close(dst_dfd);
+        close(dfd);
+    }
+
+    // The copy is a regular file with the source's size and mtime
+    static bool unchanged(int dst_dfd, const char* name, const struct stat& src) {
+        struct stat dst;
+        if (fstatat(dst_dfd, name, &dst, AT_SYMLINK_NOFOLLOW) != 0) return false;
+        return S_ISREG(dst.st_mode) && dst.st_size == src.st_size &&
+               dst.st_mtim.tv_sec == src.st_mtim.tv_sec &&
+               dst.st_mtim.tv_nsec == src.st_mtim.tv_nsec;
+    }
+
+    // A file with more than one name: true (and its link recorded) unless
+    // this is the first name found
+    bool link_seen(const struct stat& st, std::string dst) {
+        std::lock_guard<std::mutex> lock(links_mutex_);
+        auto [it, fresh] = inodes_.try_emplace({st.st_dev, st.st_ino}, dst);
+        if (fresh) return false;
+        links_.push_back({std::move(dst), it->second});
+        return true;
+    }
+
+    // First physical byte of the file's data, 0 if it has none or FIEMAP
+    // is unsupported (which stops further lookups)
+    uint64_t lookup_extent(int dfd, const char* name) {
+        int fd = openat(dfd, name, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return 0;
+        uint64_t physical = 0;
+        ExtentLookup found = first_extent(fd, physical);
+        close(fd);
+        if (found == ExtentLookup::UNSUPPORTED) {
+            fiemap_ok_ = false;
+        } else if (found == ExtentLookup::MAPPED) {
+            extents_mapped_++;
+            return physical;
+        }
+        return 0;
+    }
+
+    void sample(int dfd, const char* name, const struct stat* known) {
+        if (next_sample_.fetch_add(1) >= opts_.sample_files) return;
+
+        struct stat st;
+        bool ok = true;
+        if (known) {
+            st = *known;
+        } else {
+            ok = fstatat(dfd, name, &st, 0) == 0;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (ok) size_stats_.observe(st.st_size);
+        if (++sampled_ >= opts_.sample_files) {
+            cv_.notify_all();
+        }
+    }
+
+    void push_dir(DirTask&& task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            dirs_.push_back(std::move(task));
+            outstanding_++;
+        }
+        cv_.notify_one();
+    }
+
+    void flush(std::vector<FileWorkItem>& batch) {
+        if (batch.empty()) return;
+
+        std::sort(batch.begin(), batch.end(), [](const FileWorkItem& a, const FileWorkItem& b) {
+            return disk_order(a.extent, a.inode) < disk_order(b.extent, b.inode);
+        });
+
+        // Count before pushing so progress never sees completed > total
+        files_found_ += batch.size();
+        stats_.files_total += batch.size();
+        if (opts_.split_size > 0 &&
+            std::any_of(batch.begin(), batch.end(), [this](const FileWorkItem& item) {
+                return item.size != FileWorkItem::UNKNOWN_SIZE && item.size >= opts_.split_size;
+            })) {
+            // Segments follow their file, keeping the disk order
+            std::vector<FileWorkItem> items;
+            items.reserve(batch.size());
+            for (auto& item : batch) {
+                uint64_t skipped = append_split(items, std::move(item), opts_.split_size,
+                                                opts_.journal);
+                if (skipped > 0) {
+                    stats_.files_resumed++;
+                    stats_.bytes_resumed += skipped;
+                }
+            }
+            batch.swap(items);
+        }
+        queue_.push_bulk(batch);
+        batch.clear();
+    }
+
+    std::string src_base_;
+    std::string dst_base_;
+    Queue& queue_;
+    Stats& stats_;
+    Options opts_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<DirTask> dirs_;       // Pending directories (LIFO)
+    size_t outstanding_ = 0;          // Queued + in-progress directories
+    bool finished_ = false;
+    SizeStats size_stats_;
+    size_t sampled_ = 0;              // Sample attempts (incl. failed stats)
+
+    std::atomic<size_t> next_sample_{0};
+    std::atomic<uint64_t> files_found_{0};
+    std::atomic<uint64_t> dirs_scanned_{0};
+    std::atomic<uint64_t> errors_{0};
+    std::atomic<uint64_t> extents_mapped_{0};
+    std::atomic<bool> fiemap_ok_{true};
+
+    mutable std::mutex links_mutex_;
+    std::map<std::pair<dev_t, ino_t>, std::string> inodes_;  // Multi-link file → first dst
+    std::vector<HardLink> links_;
+    std::vector<std::thread> threads_;
+};
@@ -0,0 +1,342 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+#include "utils.hpp"
+
+// ============================================================
+// Chase-Lev Work-Stealing Deque
+// ============================================================
+// Lock-free deque (Chase & Lev 2005, C11 memory orders from Lê et al. 2013).
+// One owner thread pushes/pops at the bottom; any thread may steal from the
+// top. Holds raw pointers; ownership passes with the pointer.
+template<typename T>
+class ChaseLevDeque {
+public:
+    explicit ChaseLevDeque(size_t capacity = 256) {
+        size_t cap = 1;
+        while (cap < capacity) cap <<= 1;
+        auto arr = std::make_unique<Array>(cap);
+        array_.store(arr.get(), std::memory_order_relaxed);
+        arrays_.push_back(std::move(arr));
+    }
+
+    // Non-copyable
+    ChaseLevDeque(const ChaseLevDeque&) = delete;
+    ChaseLevDeque& operator=(const ChaseLevDeque&) = delete;
+
+    // Owner only
+    void push(T* item) {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_acquire);
+        Array* a = array_.load(std::memory_order_relaxed);
+        if (b - t > static_cast<int64_t>(a->mask)) {
+            a = grow(a, t, b);
+        }
+        a->put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // Owner only - returns nullptr if empty
+    T* pop() {
+        int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        Array* a = array_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        T* item = a->get(b);
+        if (t == b) {
+            // Last item - race against thieves
+            if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                              std::memory_order_relaxed)) {
+                item = nullptr;
+            }
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    // Any thread - returns nullptr if empty or if it lost a race
+    T* steal() {
+        int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom_.load(std::memory_order_acquire);
+        if (t >= b) return nullptr;
+
+        Array* a = array_.load(std::memory_order_acquire);
+        T* item = a->get(t);
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return item;
+    }
+
+    // Approximate (racy) size
+    size_t size() const {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_relaxed);
+        return b > t ? static_cast<size_t>(b - t) : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+
+private:
+    struct Array {
+        size_t mask;
+        std::unique_ptr<std::atomic<T*>[]> slots;
+
+        explicit Array(size_t cap) : mask(cap - 1), slots(new std::atomic<T*>[cap]) {}
+
+        T* get(int64_t i) const {
+            return slots[i & mask].load(std::memory_order_relaxed);
+        }
+        void put(int64_t i, T* item) {
+            slots[i & mask].store(item, std::memory_order_relaxed);
+        }
+    };
+
+    Array* grow(Array* old, int64_t t, int64_t b) {
+        auto bigger = std::make_unique<Array>((old->mask + 1) * 2);
+        for (int64_t i = t; i < b; i++) {
+            bigger->put(i, old->get(i));
+        }
+        Array* a = bigger.get();
+        // Thieves may still read the old array - it is retired, not freed
+        arrays_.push_back(std::move(bigger));
+        array_.store(a, std::memory_order_release);
+        return a;
+    }
+
+    alignas(64) std::atomic<int64_t> top_{0};
+    alignas(64) std::atomic<int64_t> bottom_{0};
+    std::atomic<Array*> array_{nullptr};
+    std::vector<std::unique_ptr<Array>> arrays_;  // Owner-only; current + retired
+};
+
+// ============================================================
+// Work-Stealing Scheduler
+// ============================================================
+// Feeds the copy workers:
+// - Producers (scanner) hand over whole batches - one lock per batch, not
+//   per file. Each batch is an inode-sorted contiguous range.
+// - A worker moves one batch into its own deque and pops it lock-free in
+//   ascending inode order, keeping disk access sequential per worker.
+// - An idle worker steals half of a busy worker's remaining range (the
+//   high-inode tail, so both halves stay contiguous).
+//
+// The producer side (push / push_bulk / set_done) is what DirScanner
+// feeds. With set_limits() push_bulk also applies backpressure: the scan
+// waits for the workers instead of running ahead and queueing the whole
+// tree.
+template<typename T>
+class WorkScheduler {
+public:
+    explicit WorkScheduler(size_t num_workers) {
+        if (num_workers == 0) num_workers = 1;
+        deques_.reserve(num_workers);
+        for (size_t i = 0; i < num_workers; i++) {
+            deques_.push_back(std::make_unique<ChaseLevDeque<T>>());
+        }
+    }
+
+    ~WorkScheduler() {
+        for (auto& d : deques_) {
+            while (T* item = d->pop()) delete item;
+        }
+        for (auto& batch : batches_) {
+            for (T* item : batch) delete item;
+        }
+    }
+
+    // Non-copyable
+    WorkScheduler(const WorkScheduler&) = delete;
+    WorkScheduler& operator=(const WorkScheduler&) = delete;
+
+    // ---- Producer side (any thread) ----
+
+    void push(T item) {
+        std::vector<T*> batch;
+        batch.push_back(new T(std::move(item)));
+        add_batch(std::move(batch));
+    }
+
+    // Items should already be in the order they are best processed in.
+    // Blocks while the queue is over its limits (see set_limits()).
+    void push_bulk(std::vector<T>& items) {
+        if (items.empty()) return;
+        wait_for_room();
+        std::vector<T*> batch;
+        batch.reserve(items.size());
+        for (auto& item : items) {
+            batch.push_back(new T(std::move(item)));
+        }
+        add_batch(std::move(batch));
+    }
+
+    void set_done() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_ = true;
+        }
+        cv_.notify_all();
+    }
+
+    // push_bulk() waits while max_queued items are queued, or while the
+    // process has more than max_rss bytes resident (0 = no limit). It never
+    // waits on an empty queue, so set this once workers are draining it.
+    void set_limits(size_t max_queued, uint64_t max_rss) {
+        max_queued_.store(max_queued, std::memory_order_relaxed);
+        max_rss_.store(max_rss, std::memory_order_relaxed);
+    }
+
+    // Items queued and not yet popped (approximate while workers run)
+    size_t queued() const { return queued_.load(std::memory_order_relaxed); }
+    // push_bulk() calls that had to wait
+    uint64_t throttled() const { return throttled_.load(std::memory_order_relaxed); }
+
+    // True once set_done() was called and every item has been handed out
+    bool is_done() const {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!done_ || !batches_.empty()) return false;
+        }
+        for (const auto& d : deques_) {
+            if (!d->empty()) return false;
+        }
+        return true;
+    }
+
+    // ---- Worker side (worker `w` only) ----
+
+    // Own deque, then a fresh batch, then steal. Non-blocking.
+    bool try_pop(size_t w, T& out) {
+        ChaseLevDeque<T>& own = *deques_[w];
+
+        T* item = own.pop();
+        if (!item && take_batch(own)) item = own.pop();
+        if (!item && steal_into(w)) item = own.pop();
+        if (!item) return false;
+
+        out = std::move(*item);
+        delete item;
+        queued_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Blocks until an item is available; false once all work is handed out
+    bool wait_pop(size_t w, T& out) {
+        while (true) {
+            if (try_pop(w, out)) return true;
+            if (is_done()) return false;
+
+            // Work can also appear in another worker's deque (a batch it just
+            // took), which doesn't signal - so wait with a short timeout
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait_for(lock, std::chrono::milliseconds(1),
+                         [this] { return !batches_.empty() || done_; });
+        }
+    }
+
+    // Return an item the worker couldn't start; it is popped again next
+    void push_local(size_t w, T item) {
+        queued_.fetch_add(1, std::memory_order_relaxed);
+        deques_[w]->push(new T(std::move(item)));
+    }
+
+    size_t num_workers() const { return deques_.size(); }
+    uint64_t steals() const { return steals_.load(std::memory_order_relaxed); }
+
+private:
+    // Poll like wait_pop(): pops are lock-free and don't signal
+    void wait_for_room() {
+        size_t max_queued = max_queued_.load(std::memory_order_relaxed);
+        uint64_t max_rss = max_rss_.load(std::memory_order_relaxed);
+        if (max_queued == 0 && max_rss == 0) return;
+
+        bool waited = false;
+        while (size_t queued = queued_.load(std::memory_order_relaxed)) {
+            bool over = (max_queued > 0 && queued >= max_queued) ||
+                        (max_rss > 0 && resident_bytes() > max_rss);
+            if (!over) break;
+            waited = true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (waited) throttled_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void add_batch(std::vector<T*>&& batch) {
+        queued_.fetch_add(batch.size(), std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            batches_.push_back(std::move(batch));
+        }
+        cv_.notify_one();
+    }
+
+    // Move the oldest batch into `own`. Pushed in reverse so that pop()
+    // (bottom, LIFO) yields the batch in its original ascending order.
+    bool take_batch(ChaseLevDeque<T>& own) {
+        std::vector<T*> batch;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (batches_.empty()) return false;
+            batch = std::move(batches_.front());
+            batches_.pop_front();
+        }
+        for (auto it = batch.rbegin(); it != batch.rend(); ++it) {
+            own.push(*it);
+        }
+        return true;
+    }
+
+    // Steal half of the first non-empty victim's deque into our own
+    bool steal_into(size_t w) {
+        size_t n = deques_.size();
+        for (size_t i = 1; i < n; i++) {
+            ChaseLevDeque<T>& victim = *deques_[(w + i) % n];
+            size_t want = (victim.size() + 1) / 2;
+            size_t got = 0;
+            // Steals come off the top (highest inode first); pushing them in
+            // that order leaves the lowest at our bottom
+            while (got < want) {
+                T* item = victim.steal();
+                if (!item) break;
+                deques_[w]->push(item);
+                got++;
+            }
+            if (got > 0) {
+                steals_.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<std::unique_ptr<ChaseLevDeque<T>>> deques_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::vector<T*>> batches_;   // Injection queue (one entry per batch)
+    bool done_ = false;
+    std::atomic<uint64_t> steals_{0};
+
+    // Backpressure (set_limits())
+    std::atomic<size_t> queued_{0};
+    std::atomic<size_t> max_queued_{0};
+    std::atomic<uint64_t> max_rss_{0};
+    std::atomic<uint64_t> throttled_{0};
+};
@@ -1,6 +1,8 @@
 #pragma once
 #include <string>
 #include <cstdint>
+#include <cstdio>
+#include <unistd.h>
 #include <fmt/core.h>
 
 // Format bytes with auto-adaptive units (B, KB, MB, GB, TB)
@@ -33,3 +35,14 @@ inline std::string format_throughput(double bytes_per_sec) {
 
     return fmt::format("{:.2f} {}", rate, units[unit_idx]);
 }
+
+// Resident set size of this process in bytes, 0 if it can't be read
+inline uint64_t resident_bytes() {
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    unsigned long long size = 0, resident = 0;
+    int n = fscanf(f, "%llu %llu", &size, &resident);
+    fclose(f);
+    if (n != 2) return 0;
+    return resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+}
@@ -1,6 +1,9 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/sysmacros.h>
+#include <linux/fs.h>
 #include <dirent.h>
 #include <getopt.h>
 #include <cstdlib>
@@ -11,29 +14,70 @@
 #include <string>
 #include <algorithm>
 #include <filesystem>
+#include <memory>
 #include <thread>
+#include <mutex>
+#include <unordered_set>
 #include <fmt/core.h>
+#include "protocol.hpp"
+#include "affinity.hpp"
+#include "autotune.hpp"
+#include "metrics.hpp"
+#include "checksum.hpp"
+#include "journal.hpp"
 #include "ring.hpp"
+#include "scanner.hpp"
+#include "scheduler.hpp"
 #include "utils.hpp"
 
 // Network mode functions (defined in net.cpp)
 int run_sender(const std::string& src_path, const std::string& host,
                uint16_t port, const std::string& secret, bool use_splice,
-               bool use_tls);
+               bool use_tls, bool file_batch);
 int run_receiver(const std::string& dst_path, uint16_t port,
                  const std::string& secret, bool use_tls);
 
 // io_uring async network functions (defined in net_uring.cpp)
 int run_sender_uring(const std::string& src_path, const std::string& host,
-                     uint16_t port, const std::string& secret);
+                     uint16_t port, const std::string& secret, int streams,
+                     bool zero_copy, bool use_tls, bool file_batch,
+                     protocol::Codec compress, bool incremental, bool delta, bool verify,
+                     bool resume, bool extent_order, bool hardlinks, const RingSetup& ring,
+                     bool affinity, const MetricsSetup& metrics);
 int run_receiver_uring(const std::string& dst_path, uint16_t port,
-                       const std::string& secret);
+                       const std::string& secret, bool zero_copy, bool use_tls,
+                       unsigned write_workers, uint64_t direct_size, const RingSetup& ring,
+                       bool affinity, const MetricsSetup& metrics);
+int run_receiver_daemon(const std::string& dst_path, uint16_t port, const std::string& secret,
+                        const std::string& config_path, bool zero_copy, bool use_tls,
+                        unsigned write_workers, uint64_t direct_size, unsigned warm,
+                        const RingSetup& ring, bool affinity);
 
 namespace fs = std::filesystem;
 
 // ============================================================
 // Configuration
 // ============================================================
+
+// Destinations whose copy failed, with --hardlinks: make_links leaves the
+// other names of those files alone rather than link them to a partial or
+// stale copy. Failures are few, so this stays small.
+class FailedCopies {
+public:
+    void add(const std::string& dst_path) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        paths_.insert(dst_path);
+    }
+
+    bool contains(const std::string& dst_path) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return paths_.count(dst_path) > 0;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::unordered_set<std::string> paths_;
+};
 struct Config {
     int num_workers = 1;              // 1 = optimal for local copy (io_uring provides async parallelism)
     int queue_depth = 64;
@@ -43,6 +87,30 @@ struct Config {
     bool sync_mode = false;           // Use synchronous I/O instead of io_uring (better for network storage)
     bool quiet = false;               // Disable progress output
     bool chunk_size_set = false;      // True if user explicitly set chunk size via -c
+    int scan_threads = 4;             // Directory walker threads (scan overlaps with copy)
+    bool use_reflink = false;         // Try FICLONE, then copy_file_range, before splice/read-write
+    bool use_chain = true;            // Submit files <= chunk_size as one linked SQE chain
+    bool incremental = false;         // Skip files whose copy has the same size + mtime
+    bool verify = false;              // Re-read chunks of each copy and compare CRCs
+    uint32_t verify_sample = 4;       // Chunks checked per splice/offload copy (0 = all)
+    uint64_t split_size = 32 * 1024 * 1024;  // Files this large are copied as parallel segments (0 = off)
+    bool resume = false;              // Keep the segments the journal records (implies incremental)
+    CheckpointJournal* journal = nullptr;  // Progress of split files, with --resume
+    bool hardlinks = false;           // Link the other names of a multi-link file, not copy them
+    FailedCopies* failed_copies = nullptr;  // Copies make_links must not link to, with --hardlinks
+    int pipeline = 2;                 // Chunk buffers per file on the read/write path (1 = no overlap)
+    bool pipeline_set = false;        // True if --pipeline was given
+    uint64_t direct_size = 0;         // Files this large bypass the page cache, O_DIRECT (0 = off)
+    RingSetup ring;                   // io_uring setup profile of the worker rings (--ring)
+    bool affinity = false;            // Pin workers near the source (else destination) device
+    Placement placement;              // Their CPUs, with --affinity
+    bool autotune = false;            // Pick the engine by filesystem, tune depth and chunk online
+    bool jobs_set = false;            // True if -j was given
+    const TuneKnobs* tune = nullptr;  // Live depth and chunk (io_uring engine under --autotune)
+    bool extent_order = false;        // Order files by first physical extent (FIEMAP), not inode
+    uint64_t max_memory = 0;          // RSS cap the scan waits under, in bytes (0 = none)
+    MetricsSetup metrics;             // --metrics, --metrics-stream, --trace
+    std::vector<WorkerMetrics*> worker_metrics;  // Per worker, empty unless metrics are on
     std::string src_path;
     std::string dst_path;
 };
@@ -62,6 +130,33 @@ void print_usage(const char* prog) {
     fmt::print("  --quiet              Disable progress output\n");
     fmt::print("  --no-splice          Use read/write instead of splice\n");
     fmt::print("  --sync               Use synchronous I/O (for network storage)\n");
+    fmt::print("  --scan-threads <n>   Directory scanner threads (default: 4)\n");
+    fmt::print("  --reflink            Server-side copy: reflink, then copy_file_range (same fs)\n");
+    fmt::print("  --no-chain           Disable linked-SQE chains for small files\n");
+    fmt::print("  --incremental        Skip files whose copy has the same size and mtime\n");
+    fmt::print("  --verify             Check each copy by CRC32C of its chunks\n");
+    fmt::print("  --verify-sample <n>  Chunks checked per splice/offload copy (default: 4, 0 = all)\n");
+    fmt::print("  --split-size <n>     Copy files of n+ bytes as parallel 8MB segments (default: 32MB, 0 = off)\n");
+    fmt::print("  --resume             Journal split files; a rerun keeps the segments already copied\n");
+    fmt::print("                       (implies --incremental)\n");
+    fmt::print("  -H, --hardlinks      Recreate hardlinks instead of copying each name\n");
+    fmt::print("  --pipeline <n>       Chunk buffers per file, reads overlap writes (default: 2, 1-4)\n");
+    fmt::print("  --direct             Copy files of 8MB+ with O_DIRECT, bypassing the page cache\n");
+    fmt::print("                       (pipeline defaults to 4)\n");
+    fmt::print("  --direct-size <n>    Threshold of --direct in bytes (implies --direct)\n");
+    fmt::print("  --ring <profile>     Ring setup: default, sqpoll, coop or defer (falls back if unsupported)\n");
+    fmt::print("  --sqpoll-cpu <n>     Pin worker i's SQPOLL thread to CPU n + i\n");
+    fmt::print("  --sqpoll-idle <ms>   SQPOLL thread idle time before it sleeps (default: 50)\n");
+    fmt::print("  --affinity           Pin each worker (and its SQPOLL thread) to a CPU of the device's\n");
+    fmt::print("                       NUMA node and allocate its buffers there\n");
+    fmt::print("  --autotune           Pick the engine per filesystem; adapt in-flight depth (up to -q)\n");
+    fmt::print("                       and chunk size to measured throughput and latency\n");
+    fmt::print("  --extent-order       Copy in order of physical disk address (FIEMAP), not inode\n");
+    fmt::print("  --max-memory <mb>    Pause the scan while the process uses more memory (RSS)\n");
+    fmt::print("  --metrics <file>     Write op latency histograms and gauges as JSON at exit (- = stdout)\n");
+    fmt::print("  --metrics-stream <target>  Also write them every interval to a file or unix:<socket>\n");
+    fmt::print("  --metrics-interval <ms>    Streaming interval (default: 1000)\n");
+    fmt::print("  --trace <file>       Write every timed op as a Chrome trace event (io_uring engine)\n");
     fmt::print("  -h, --help           Show this help\n");
     fmt::print("\nExamples:\n");
     fmt::print("  {} src_dir/ dst_dir/           # Copy directory\n", prog);
@@ -69,79 +164,701 @@ void print_usage(const char* prog) {
 }
 
 // ============================================================
-// Directory Scanner
+// State Machine
 // ============================================================
-struct ScanResult {
-    std::vector<FileWorkItem> files;
-    SizeStats size_stats;
-};
 
-ScanResult scan_files(
-    const std::string& src_base,
-    const std::string& dst_base
-) {
-    ScanResult result;
+// Largest copy_file_range step per helper call, so a file's progress shows
+// in the stats as it goes rather than all at the end
+constexpr size_t COPY_RANGE_STEP = 8 * 1024 * 1024;
+
+// Files with this much left to read get readahead hints once the source
+// is open; the first READAHEAD_WINDOW is fetched while the destination opens
+constexpr uint64_t READAHEAD_MIN = 1024 * 1024;
+constexpr uint32_t READAHEAD_WINDOW = 2 * 1024 * 1024;
+
+// Hint that [offset, file_size) is read once, in order (the kernel doubles
+// its readahead window, as for the sync worker), and start on its head
+static void hint_readahead(const FileContext* ctx, RingManager& ring) {
+    uint64_t left = ctx->file_size - ctx->offset;
+    if (left < READAHEAD_MIN) return;
+    ring.prepare_fadvise(ctx->src_fd, ctx->offset, 0, POSIX_FADV_SEQUENTIAL);
+    ring.prepare_fadvise(ctx->src_fd, ctx->offset, std::min<uint64_t>(left, READAHEAD_WINDOW),
+                         POSIX_FADV_WILLNEED);
+}
 
-    struct stat st;
-    if (stat(src_base.c_str(), &st) != 0) {
-        fmt::print(stderr, "Error: Cannot access '{}'\n", src_base);
-        return result;
+// --direct: a file of direct_size or more on the read/write path is read
+// and written with O_DIRECT (see common.hpp); readahead would only fill
+// the cache it bypasses, so the pipeline's buffers (MAX_PIPELINE unless
+// --pipeline says otherwise) and split segments keep the device busy
+// instead. Sparse files stay buffered: their data runs need not be
+// block-aligned.
+static bool wants_direct(uint64_t size, uint64_t blocks, const Config& cfg) {
+    return cfg.direct_size != 0 && size >= cfg.direct_size && !maybe_sparse(size, blocks);
+}
+
+// Both ends to O_DIRECT, or neither
+static bool set_direct_pair(int src_fd, int dst_fd) {
+    if (!set_direct(src_fd, true)) return false;
+    if (set_direct(dst_fd, true)) return true;
+    set_direct(src_fd, false);
+    return false;
+}
+
+// ============================================================
+// Read/Write Pipeline
+// ============================================================
+// A file on the read/write path gets cfg.pipeline chunk buffers (one pool
+// slot). The next read is issued as soon as a read completes and a buffer
+// is free, so chunk N+1 is read while chunk N is still being written. One
+// read at a time keeps the read position exact (offset + read_ahead);
+// writes of different chunks may overlap. Completion tags carry the buffer
+// index, plus TAG_WRITE for writes; io_busy has a bit per buffer in use.
+
+constexpr unsigned TAG_WRITE = 4;
+constexpr uint8_t PIPELINE_ERROR = 0x40;   // An op failed: let the rest drain
+constexpr uint8_t READ_IN_FLIGHT = 0x80;
+
+inline char* chunk_buffer(const FileContext* ctx, unsigned i, const Config& cfg) {
+    return ctx->buffer + static_cast<size_t>(i) * cfg.chunk_size;
+}
+
+// Bytes per read or splice. cfg.chunk_size is the buffer stride; under
+// --autotune the controller moves the chunk below it.
+inline uint32_t io_chunk(const Config& cfg) {
+    return cfg.tune ? cfg.tune->chunk.load(std::memory_order_relaxed) : cfg.chunk_size;
+}
+
+// Read the next chunk into a free buffer, unless a read is out or all is read
+static void pipeline_read(FileContext* ctx, RingManager& ring, const Config& cfg) {
+    uint64_t pos = ctx->offset + ctx->read_ahead;
+    if ((ctx->io_busy & READ_IN_FLIGHT) || pos >= ctx->file_size) return;
+    for (unsigned i = 0; i < static_cast<unsigned>(cfg.pipeline); i++) {
+        if (ctx->io_busy & (1u << i)) continue;
+        uint32_t chunk = io_chunk(cfg);
+        uint32_t len;
+        if (ctx->cold->direct) {
+            // Whole blocks: the tail is read rounded up, and comes back short
+            chunk = std::max<uint32_t>(chunk & ~(DIRECT_ALIGN - 1), DIRECT_ALIGN);
+            uint64_t want = std::min<uint64_t>(chunk, ctx->file_size - pos);
+            len = static_cast<uint32_t>(direct_round(want));
+        } else {
+            len = std::min<uint64_t>(chunk, ctx->file_size - pos);
+        }
+        ctx->io_busy |= READ_IN_FLIGHT | (1u << i);
+        ctx->current_op = OpType::READ;
+        ring.prepare_read(ctx->src_fd, chunk_buffer(ctx, i, cfg), len, pos, ctx, false, i);
+        return;
     }
+}
 
-    if (S_ISREG(st.st_mode)) {
-        result.files.push_back({src_base, dst_base});
-        result.size_stats.observe(st.st_size);
-        return result;
+// Start moving data with splice (if enabled and a pipe is free) or read/write,
+// continuing from ctx->offset
+static void start_data_copy(FileContext* ctx, RingManager& ring, const Config& cfg,
+                            PipePool* pipe_pool) {
+    if (ctx->use_splice && pipe_pool && ctx->pipe_index < 0) {
+        // Use splice for zero-copy (requires pipe)
+        auto pipe = pipe_pool->acquire();
+        if (pipe.index >= 0) {
+            ctx->pipe_read_fd = pipe.read_fd;
+            ctx->pipe_write_fd = pipe.write_fd;
+            ctx->pipe_index = pipe.index;
+        } else {
+            // No pipe available, fall back to read/write
+            ctx->use_splice = false;
+        }
+    }
+    // A sparse file's next data run keeps the pipe it already holds
+    if (ctx->use_splice && ctx->pipe_index >= 0) {
+        ctx->state = FileState::SPLICE_IN;
+        ctx->current_op = OpType::SPLICE_IN;
+        uint32_t to_splice = std::min<uint64_t>(io_chunk(cfg), ctx->file_size - ctx->offset);
+        ring.prepare_splice(ctx->src_fd, ctx->offset,
+                           ctx->pipe_write_fd, -1,
+                           to_splice, SPLICE_F_MOVE, ctx);
+        return;
     }
 
-    if (!S_ISDIR(st.st_mode)) {
-        fmt::print(stderr, "Error: '{}' is not a file or directory\n", src_base);
-        return result;
+    ctx->state = FileState::READING;
+    ctx->read_ahead = 0;
+    ctx->io_busy = 0;
+    pipeline_read(ctx, ring, cfg);
+}
+
+// All data written: close both fds. A segment of a split file leaves the
+// shared fds open and is finished by end_segment.
+static void end_data(FileContext* ctx, RingManager& ring) {
+    if (ctx->cold->split) {
+        ctx->state = FileState::DONE;
+        return;
     }
+    ctx->state = FileState::CLOSING_SRC;
+    ctx->current_op = OpType::CLOSE_SRC;
+    ring.prepare_close(ctx->src_fd, ctx);
+}
 
-    try {
-        fs::create_directories(dst_base);
+// Run call on the helper thread; its result completes ctx's read of the
+// slot's eventfd like any other op
+static void run_on_helper(FileContext* ctx, RingManager& ring, HelperThread& helper,
+                          HelperThread::Call call) {
+    size_t slot = static_cast<size_t>(ctx->buffer_index);
+    helper.run(slot, std::move(call));
+    ring.prepare_read(helper.fd(slot), reinterpret_cast<char*>(&ctx->cold->helper_word),
+                      sizeof(ctx->cold->helper_word), 0, ctx);
+}
 
-        for (const auto& entry : fs::recursive_directory_iterator(src_base)) {
-            if (entry.is_regular_file()) {
-                std::string rel_path = fs::relative(entry.path(), src_base).string();
-                std::string src_file = entry.path().string();
-                std::string dst_file = (fs::path(dst_base) / rel_path).string();
+// Next copy_file_range step of [offset, file_size), on the helper thread
+static void copy_range_step(FileContext* ctx, RingManager& ring, HelperThread& helper,
+                            const Config& cfg) {
+    ctx->state = FileState::COPYING;
+    ctx->current_op = OpType::COPY_FILE_RANGE;
+    int src_fd = ctx->src_fd, dst_fd = ctx->dst_fd;
+    loff_t off = static_cast<loff_t>(ctx->offset);
+    size_t len = std::min<uint64_t>(ctx->file_size - ctx->offset,
+                                    std::max<size_t>(cfg.chunk_size, COPY_RANGE_STEP));
+    run_on_helper(ctx, ring, helper, [src_fd, dst_fd, off, len]() -> int64_t {
+        loff_t off_in = off, off_out = off;
+        ssize_t copied = copy_file_range(src_fd, &off_in, dst_fd, &off_out, len, 0);
+        return copied < 0 ? -errno : copied;
+    });
+}
 
-                fs::create_directories(fs::path(dst_file).parent_path());
+// copy_file_range may write a sparse file's holes out as zeros
+static bool start_copy_range(FileContext* ctx, RingManager& ring, HelperThread& helper,
+                             const Config& cfg) {
+    if (ctx->cold->offload->copy_range == CopyOffloadCache::Support::NO ||
+        maybe_sparse(ctx->file_size, ctx->cold->stx.stx_blocks)) {
+        return false;
+    }
+    copy_range_step(ctx, ring, helper, cfg);
+    return true;
+}
 
-                // Get inode for sorting and file size for adaptive chunk sizing
-                struct stat file_stat;
-                ino_t inode = 0;
-                if (stat(src_file.c_str(), &file_stat) == 0) {
-                    inode = file_stat.st_ino;
-                    result.size_stats.observe(file_stat.st_size);
-                }
-                result.files.push_back({src_file, dst_file, inode});
+// Server-side copy: reflink the whole file if the device pair supports it,
+// otherwise copy_file_range steps. Returns false if neither applies.
+static bool start_offload(FileContext* ctx, RingManager& ring, CopyOffloadCache& cache,
+                          HelperThread& helper, const Config& cfg) {
+    struct stat dst_st;
+    if (fstat(ctx->dst_fd, &dst_st) != 0) return false;
+
+    dev_t src_dev = makedev(ctx->cold->stx.stx_dev_major, ctx->cold->stx.stx_dev_minor);
+    CopyOffloadCache::Entry* pair = cache.lookup(src_dev, dst_st.st_dev);
+    ctx->cold->offload = pair;
+
+    if (pair->clone != CopyOffloadCache::Support::NO) {
+        ctx->state = FileState::CLONING;
+        ctx->current_op = OpType::CLONE;
+        int src_fd = ctx->src_fd, dst_fd = ctx->dst_fd;
+        run_on_helper(ctx, ring, helper, [src_fd, dst_fd]() -> int64_t {
+            return ioctl(dst_fd, FICLONE, src_fd) == 0 ? 0 : -errno;
+        });
+        return true;
+    }
+    return start_copy_range(ctx, ring, helper, cfg);
+}
+
+// ============================================================
+// Verification (--verify)
+// ============================================================
+// Chunks read back from the copy and compared by CRC32C, on the worker's
+// helper thread. Every chunk that went through the read/write buffer was
+// hashed there on the way, and all of those are checked. Splice,
+// copy_file_range and reflink never show the bytes to userspace, so the
+// source has to be read again as well: of those, verify_sample chunks per
+// file, spread over it (0 = all). The re-read normally hits the page cache:
+// it catches a wrong copy, not media that loses data later.
+
+// Read completion (or a small chain): hash the chunk at pos
+static void record_chunk_crc(FileContext* ctx, const char* data, uint64_t pos, uint32_t len,
+                             const Config& cfg) {
+    if (pos % cfg.chunk_size != 0) return;
+    ctx->cold->verify_crcs.push_back({pos, len, crc32c(0, data, len)});
+}
+
+static bool pread_crc(int fd, std::vector<char>& buf, uint64_t off, uint32_t len, uint32_t& crc) {
+    if (pread(fd, buf.data(), len, off) != (ssize_t)len) return false;
+    crc = crc32c(0, buf.data(), len);
+    return true;
+}
+
+// known: chunk CRCs taken on the copy path, by offset; buf holds one chunk
+static bool verify_copy(const std::string& src_path, const std::string& dst_path, uint64_t size,
+                        const std::vector<ChunkCrc>& known, const Config& cfg,
+                        std::vector<char>& buf) {
+    int dst_fd = open(dst_path.c_str(), O_RDONLY);
+    struct stat st;
+    if (dst_fd < 0 || fstat(dst_fd, &st) != 0 || (uint64_t)st.st_size != size) {
+        fmt::print(stderr, "Verify failed: {} is missing or has the wrong size\n", dst_path);
+        if (dst_fd >= 0) close(dst_fd);
+        return false;
+    }
+
+    int src_fd = -1;
+    bool ok = true;
+    uint64_t chunk = cfg.chunk_size;
+    uint64_t chunks = (size + chunk - 1) / chunk;
+    auto next = known.begin();
+    for (uint64_t k = 0; ok && k < chunks; k++) {
+        uint64_t off = k * chunk;
+        uint32_t len = static_cast<uint32_t>(std::min(chunk, size - off));
+        while (next != known.end() && next->offset < off) ++next;
+        bool hashed = next != known.end() && next->offset == off && next->len == len;
+        if (!hashed && !sample_chunk(k, chunks, cfg.verify_sample)) continue;
+
+        uint32_t expected = 0;
+        if (hashed) {
+            expected = next->crc;
+        } else {
+            if (src_fd < 0) src_fd = open(src_path.c_str(), O_RDONLY);
+            if (src_fd < 0 || !pread_crc(src_fd, buf, off, len, expected)) {
+                fmt::print(stderr, "Verify failed: cannot re-read {}\n", src_path);
+                ok = false;
+                break;
             }
         }
-    } catch (const fs::filesystem_error& e) {
-        fmt::print(stderr, "Filesystem error: {}\n", e.what());
+
+        uint32_t actual = 0;
+        if (!pread_crc(dst_fd, buf, off, len, actual) || actual != expected) {
+            fmt::print(stderr, "Verify failed: {} differs from {} in bytes {}-{}\n",
+                       dst_path, src_path, off, off + len);
+            ok = false;
+        }
     }
 
-    return result;
+    if (src_fd >= 0) close(src_fd);
+    close(dst_fd);
+    return ok;
+}
+
+// Remember a failed copy for make_links (--hardlinks)
+static void note_failed(const std::string& dst_path, const Config& cfg) {
+    if (cfg.failed_copies) cfg.failed_copies->add(dst_path);
+}
+
+static void count_verify(bool ok, Stats& stats) {
+    if (ok) {
+        stats.files_verified++;
+    } else {
+        stats.files_mismatched++;
+    }
 }
 
 // ============================================================
-// State Machine
+// Split Files (--split-size)
 // ============================================================
-void advance_state(FileContext* ctx, int result, RingManager& ring,
-                   Stats& stats, const Config& cfg, PipePool* pipe_pool = nullptr) {
-    if (result < 0 && ctx->state != FileState::DONE) {
-        // ECANCELED is expected for linked ops when earlier op fails
-        if (-result != ECANCELED && cfg.verbose) {
-            fmt::print(stderr, "Error on {}: {} (state={})\n",
-                      ctx->src_path, strerror(-result), static_cast<int>(ctx->state));
+// One file is otherwise one read or write in flight at a time. The scanner
+// turns a file of at least split_size into SPLIT_SEGMENT range items that
+// share a SplitFile, so a worker keeps up to queue_depth of them in flight
+// and idle workers (-j) steal the rest. Server-side copies (--reflink) and
+// --sync are not split; --verify re-reads both sides of a split file, since
+// its chunks were hashed by different contexts.
+
+// The first segment to start opens both ends and pre-sizes the copy.
+// False if that failed (reported once).
+static bool open_split(SplitFile& split, const FileWorkItem& item, Stats& stats,
+                       const Config& cfg) {
+    std::lock_guard<std::mutex> lock(split.open_mutex);
+    if (split.opened) return split.dst_fd >= 0;
+    split.opened = true;
+
+    const char* error = nullptr;
+    struct stat st;
+    split.src_fd = open(item.src_path.c_str(), O_RDONLY);
+    if (split.src_fd < 0 || fstat(split.src_fd, &st) != 0) {
+        error = strerror(errno);
+    } else if ((uint64_t)st.st_size != split.size) {
+        error = "size changed since scan";
+    } else {
+        // A resumed copy keeps the segments the journal vouches for
+        int flags = O_WRONLY | O_CREAT | (split.resumed ? 0 : O_TRUNC);
+        split.dst_fd = open(item.dst_path.c_str(), flags, st.st_mode & 0777);
+        // Extents in one go, so segments landing out of order don't fragment
+        // the copy; a sparse copy is only sized, keeping the holes
+        split.sparse = maybe_sparse(st.st_size, st.st_blocks);
+        if (split.dst_fd < 0) {
+            error = strerror(errno);
+        } else if (split.sparse ? ftruncate(split.dst_fd, st.st_size) != 0
+                                : (fallocate(split.dst_fd, 0, 0, st.st_size) != 0 &&
+                                   errno != EOPNOTSUPP)) {
+            error = strerror(errno);
+        } else if (wants_direct(st.st_size, st.st_blocks, cfg) &&
+                   set_direct_pair(split.src_fd, split.dst_fd)) {
+            split.direct = true;
+            stats.files_direct++;
         }
-        ctx->state = FileState::FAILED;
+    }
+    if (!error) return true;
+
+    if (cfg.verbose) fmt::print(stderr, "Error on {}: {}\n", item.src_path, error);
+    if (split.src_fd >= 0) close(split.src_fd);
+    if (split.dst_fd >= 0) close(split.dst_fd);
+    split.src_fd = split.dst_fd = -1;
+    return false;
+}
+
+// A segment of the copy at dst_path is over. True if it was the last and
+// every segment succeeded: the file is complete.
+static bool end_segment(std::shared_ptr<SplitFile> split, bool failed, const std::string& dst_path,
+                        Stats& stats, const Config& cfg) {
+    if (failed && !split->failed.exchange(true)) {
+        stats.files_failed++;
+        note_failed(dst_path, cfg);
+    }
+    if (split->segments_left.fetch_sub(1) != 1 || split->failed) return false;
+
+    // The last segment's padded O_DIRECT tail ran past the end
+    if (split->direct && ftruncate(split->dst_fd, split->size) != 0) {
         stats.files_failed++;
-        if (ctx->src_fd >= 0) close(ctx->src_fd);
-        if (ctx->dst_fd >= 0) close(ctx->dst_fd);
+        note_failed(dst_path, cfg);
+        return false;
+    }
+
+    if (split->mtime.tv_nsec != UTIME_OMIT) {
+        struct timespec times[2] = {{0, UTIME_OMIT}, split->mtime};
+        futimens(split->dst_fd, times);
+    }
+    stats.files_completed++;
+    return true;
+}
+
+// Small-file chain: open src → read → statx → open dst → write → close src
+// → close dst
+constexpr int SMALL_CHAIN_OPS = 7;
+
+// Give the copy the source's mtime so the next incremental run sees it as
+// unchanged. io_uring has no utimensat op; this is one syscall per file.
+// A failure only means the file is copied again next time.
+// dst_fd < 0 sets it by path.
+static void stamp_mtime(const FileContext* ctx, int dst_fd) {
+    if (ctx->cold->mtime.tv_nsec == UTIME_OMIT) return;
+    struct timespec times[2] = {{0, UTIME_OMIT}, ctx->cold->mtime};
+    if (dst_fd >= 0) {
+        futimens(dst_fd, times);
+    } else {
+        utimensat(AT_FDCWD, ctx->cold->dst_path.c_str(), times, 0);
+    }
+}
+
+// Fixed-file slots for a context, derived from its (unique) buffer index
+inline unsigned src_slot(const FileContext* ctx) { return 2 * ctx->buffer_index; }
+inline unsigned dst_slot(const FileContext* ctx) { return 2 * ctx->buffer_index + 1; }
+
+// Submit a whole small file (file_size <= one chunk, from the scan or a
+// probe) as a single IOSQE_IO_LINK chain on fixed-file slots: one submit,
+// no round-trips. The statx by path after the read catches a file that
+// changed size since file_size was taken: the read would have cut it.
+static void start_small_chain(FileContext* ctx, RingManager& ring, mode_t mode) {
+    // The chain must not be split across submissions
+    ring.reserve(SMALL_CHAIN_OPS);
+
+    uint32_t len = static_cast<uint32_t>(ctx->file_size);
+    ctx->state = FileState::SMALL_CHAIN;
+    ctx->chain_left = SMALL_CHAIN_OPS;
+    ctx->cold->chain_error = 0;
+
+    ring.prepare_openat_direct(AT_FDCWD, ctx->cold->src_path.c_str(), O_RDONLY, 0,
+                               src_slot(ctx), ctx, true);
+    ring.prepare_read_direct(src_slot(ctx), ctx->buffer, len, 0, ctx, true);
+    ring.prepare_statx(AT_FDCWD, ctx->cold->src_path.c_str(), 0, STATX_SIZE,
+                       &ctx->cold->stx, ctx, true);
+    ring.prepare_openat_direct(AT_FDCWD, ctx->cold->dst_path.c_str(),
+                               O_WRONLY | O_CREAT | O_TRUNC, mode & 0777,
+                               dst_slot(ctx), ctx, true);
+    ring.prepare_write_direct(dst_slot(ctx), ctx->buffer, len, 0, ctx, true);
+    ring.prepare_close_direct(src_slot(ctx), ctx, true);
+    ring.prepare_close_direct(dst_slot(ctx), ctx);
+}
+
+// The regular path: open, statx, then the data by splice, read/write or
+// offload
+static void start_regular(FileContext* ctx, RingManager& ring) {
+    ctx->offset = 0;
+    ctx->state = FileState::OPENING_SRC;
+    ctx->current_op = OpType::OPEN_SRC;
+    ring.prepare_openat(AT_FDCWD, ctx->cold->src_path.c_str(), O_RDONLY, 0, ctx);
+}
+
+// A file the scan did not stat: statx by path, then a chain if it is
+// small, else the regular path
+static void probe_small(FileContext* ctx, RingManager& ring) {
+    ctx->state = FileState::PROBING;
+    ctx->current_op = OpType::STATX;
+    ring.prepare_statx(AT_FDCWD, ctx->cold->src_path.c_str(), 0, STATX_SIZE | STATX_MODE,
+                       &ctx->cold->stx, ctx);
+}
+
+static void advance_probe(FileContext* ctx, int result, RingManager& ring, Stats& stats,
+                          const Config& cfg) {
+    const struct statx& stx = ctx->cold->stx;
+    // A failed statx goes the regular way too, which reports the error
+    if (result == 0 && S_ISREG(stx.stx_mode) && stx.stx_size > 0 &&
+        stx.stx_size <= (uint64_t)cfg.chunk_size) {
+        ctx->file_size = stx.stx_size;
+        stats.bytes_total += ctx->file_size;
+        start_small_chain(ctx, ring, stx.stx_mode);
+    } else {
+        start_regular(ctx, ring);
+    }
+}
+
+// Completions for SMALL_CHAIN / SMALL_CLEANUP. A failed or short op, or a
+// statx showing the file changed size, fails the chain; the file is then
+// retried on the regular path, which also reports any real error.
+static void advance_small_chain(FileContext* ctx, int result, RingManager& ring,
+                                Stats& stats, const Config& cfg) {
+    if (ctx->state == FileState::SMALL_CLEANUP) {
+        if (--ctx->chain_left > 0) return;
+        start_regular(ctx, ring);
+        return;
+    }
+
+    // Linked CQEs arrive in submission order
+    int step = SMALL_CHAIN_OPS - ctx->chain_left--;
+    bool is_data = (step == 1 || step == 4);  // read or write
+    if (ctx->cold->chain_error == 0) {
+        if (result < 0) {
+            ctx->cold->chain_error = -result;
+        } else if (is_data && (uint64_t)result != ctx->file_size) {
+            ctx->cold->chain_error = EIO;
+        } else if (step == 2 && ctx->cold->stx.stx_size != ctx->file_size) {
+            ctx->cold->chain_error = EAGAIN;    // Grew or shrank: the read was cut
+        }
+    }
+    if (ctx->chain_left > 0) return;
+
+    if (ctx->cold->chain_error == 0) {
+        stamp_mtime(ctx, -1);  // Fixed slot is already closed
+        if (cfg.verify) {
+            record_chunk_crc(ctx, ctx->buffer, 0, static_cast<uint32_t>(ctx->file_size), cfg);
+        }
+        ctx->offset = ctx->file_size;
+        stats.bytes_copied += ctx->file_size;
+        ctx->state = FileState::DONE;
+        stats.files_completed++;
+        return;
+    }
+
+    // Release both slots (cancelled closes left them populated), then retry
+    stats.bytes_total -= ctx->file_size;
+    ctx->state = FileState::SMALL_CLEANUP;
+    ctx->chain_left = 2;
+    ring.prepare_close_direct(src_slot(ctx), ctx);
+    ring.prepare_close_direct(dst_slot(ctx), ctx);
+}
+
+static void report_error(const FileContext* ctx, int result, const Config& cfg) {
+    // ECANCELED is expected for linked ops when earlier op fails
+    if (-result != ECANCELED && cfg.verbose) {
+        fmt::print(stderr, "Error on {}: {} (state={})\n",
+                  ctx->cold->src_path, strerror(-result), static_cast<int>(ctx->state));
+    }
+}
+
+// No ops of the file are in flight any more
+static void fail_file(FileContext* ctx, Stats& stats) {
+    ctx->state = FileState::FAILED;
+    if (ctx->cold->split) return;  // Shared fds; end_segment counts the file once
+    stats.files_failed++;
+    if (ctx->src_fd >= 0) close(ctx->src_fd);
+    if (ctx->dst_fd >= 0) close(ctx->dst_fd);
+}
+
+// ============================================================
+// Sparse Files
+// ============================================================
+// A source with fewer blocks than its size is mapped with SEEK_DATA /
+// SEEK_HOLE, and each data run is copied as [offset, file_size) in turn
+// on the same path (splice or read/write). The destination's holes are
+// never written: the copy is truncated to the full size at the end, or
+// was sized with ftruncate (not fallocate) when a split file was opened.
+
+// Map the data runs of [offset, file_size), the holes left out of the
+// byte counts. False if there is no hole (or the filesystem can't tell):
+// the range is copied linearly.
+static bool map_sparse(FileContext* ctx, Stats& stats) {
+    FileContextCold* cold = ctx->cold;
+    if (!data_runs(ctx->src_fd, ctx->offset, ctx->file_size, cold->extents)) return false;
+    uint64_t data = 0;
+    for (const auto& run : cold->extents) data += run.second;
+    uint64_t holes = ctx->file_size - ctx->offset - data;
+    if (holes == 0) return false;
+
+    cold->extent_index = 0;
+    cold->sparse_end = ctx->file_size;
+    stats.bytes_total -= holes;
+    stats.bytes_sparse += holes;
+    return true;
+}
+
+// [offset, file_size) is copied. A mapped file moves on to its next data
+// run (the first, right after map_sparse); past the last, the copy takes
+// its trailing hole.
+static void end_range(FileContext* ctx, RingManager& ring, Stats& stats, const Config& cfg,
+                      PipePool* pipe_pool) {
+    FileContextCold* cold = ctx->cold;
+    if (cold->sparse_end == 0) {
+        // A padded O_DIRECT tail is cut off (a split file's by end_segment)
+        if (cold->direct_pad != 0 && !cold->split && ftruncate(ctx->dst_fd, ctx->file_size) != 0) {
+            report_error(ctx, -errno, cfg);
+            fail_file(ctx, stats);
+            return;
+        }
+        end_data(ctx, ring);
+        return;
+    }
+    if (cold->extent_index < cold->extents.size()) {
+        auto [offset, len] = cold->extents[cold->extent_index++];
+        ctx->offset = offset;
+        ctx->file_size = offset + len;
+        start_data_copy(ctx, ring, cfg, pipe_pool);
+        return;
+    }
+
+    ctx->offset = ctx->file_size = cold->sparse_end;
+    if (!cold->split && ftruncate(ctx->dst_fd, ctx->file_size) != 0) {
+        report_error(ctx, -errno, cfg);
+        fail_file(ctx, stats);
+        return;
+    }
+    end_data(ctx, ring);
+}
+
+// READING / WRITING completions. A failed op stops new ones; the file
+// fails once the others have drained, as they still use its buffers.
+static void advance_pipeline(FileContext* ctx, int result, unsigned tag, RingManager& ring,
+                             Stats& stats, const Config& cfg, PipePool* pipe_pool) {
+    unsigned buf = tag & ~TAG_WRITE;
+    ctx->io_busy &= ~(1u << buf);
+    if (result < 0) {
+        report_error(ctx, result, cfg);
+        ctx->io_busy |= PIPELINE_ERROR;
+        if (!(tag & TAG_WRITE)) ctx->io_busy &= ~READ_IN_FLIGHT;
+    } else if (tag & TAG_WRITE) {
+        ChunkWrite& w = ctx->cold->writes[buf];
+        w.done += result;
+        if (w.done < w.len && result > 0) {
+            // Short write: the rest of the chunk goes out from where it stopped
+            ctx->io_busy |= 1u << buf;
+            ring.prepare_write(ctx->dst_fd, chunk_buffer(ctx, buf, cfg) + w.done, w.len - w.done,
+                               w.pos + w.done, ctx, false, TAG_WRITE | buf);
+            return;
+        }
+        if (w.done < w.len) {
+            report_error(ctx, -EIO, cfg);       // Wrote nothing: no progress to wait for
+            ctx->io_busy |= PIPELINE_ERROR;
+        } else {
+            uint32_t data = w.len;
+            if (static_cast<int>(buf) == ctx->cold->pad_buf) {
+                data -= ctx->cold->direct_pad;
+                ctx->cold->pad_buf = -1;
+            }
+            ctx->offset += data;
+            ctx->read_ahead -= data;
+            stats.bytes_copied += data;
+        }
+    } else {
+        ctx->io_busy &= ~READ_IN_FLIGHT;
+        uint64_t pos = ctx->offset + ctx->read_ahead;
+        if (result == 0) {
+            ctx->file_size = pos;  // Source shrank: the copy ends here
+        } else if (!(ctx->io_busy & PIPELINE_ERROR)) {
+            char* data = chunk_buffer(ctx, buf, cfg);
+            uint32_t len = std::min<uint64_t>(result, ctx->file_size - pos);
+            ctx->read_ahead += len;
+            if (cfg.verify && !ctx->cold->split && ctx->cold->sparse_end == 0) {
+                record_chunk_crc(ctx, data, pos, len, cfg);
+            }
+            if (ctx->cold->direct && !direct_aligned(len)) {
+                // The last block: written whole, cut back once all is in
+                uint32_t padded = pad_direct(data, len);
+                ctx->cold->direct_pad = padded - len;
+                ctx->cold->pad_buf = static_cast<int>(buf);
+                len = padded;
+            }
+            ctx->io_busy |= 1u << buf;
+            ctx->current_op = OpType::WRITE;
+            ctx->cold->writes[buf] = {pos, len, 0};
+            ring.prepare_write(ctx->dst_fd, data, len, pos, ctx, false, TAG_WRITE | buf);
+        }
+    }
+
+    if (ctx->io_busy & PIPELINE_ERROR) {
+        if (ctx->io_busy == PIPELINE_ERROR) fail_file(ctx, stats);
+        return;
+    }
+    pipeline_read(ctx, ring, cfg);
+    if (ctx->offset + ctx->read_ahead >= ctx->file_size) {
+        ctx->state = FileState::WRITING;
+        if (ctx->io_busy == 0) end_range(ctx, ring, stats, cfg, pipe_pool);
+    }
+}
+
+// Both ends open, no offload: a sparse file's data runs, or the whole file
+// by splice or read/write (O_DIRECT if it is large enough)
+static void start_data_path(FileContext* ctx, RingManager& ring, Stats& stats,
+                            const Config& cfg, PipePool* pipe_pool) {
+    if (maybe_sparse(ctx->file_size, ctx->cold->stx.stx_blocks) && map_sparse(ctx, stats)) {
+        end_range(ctx, ring, stats, cfg, pipe_pool);
+        return;
+    }
+    if (wants_direct(ctx->file_size, ctx->cold->stx.stx_blocks, cfg) &&
+        set_direct_pair(ctx->src_fd, ctx->dst_fd)) {
+        ctx->cold->direct = true;
+        ctx->use_splice = false;
+        stats.files_direct++;
+    }
+    start_data_copy(ctx, ring, cfg, pipe_pool);
+}
+
+// Time the op a completion belongs to, before advance_state moves the
+// context on. The links of a small-file chain run one after another, so
+// each is timed from the completion of the link before it.
+static void record_op(FileContext* ctx, unsigned tag, WorkerMetrics& metrics) {
+    static constexpr OpType CHAIN_OPS[SMALL_CHAIN_OPS] = {
+        OpType::OPEN_SRC, OpType::READ, OpType::STATX, OpType::OPEN_DST,
+        OpType::WRITE, OpType::CLOSE_SRC, OpType::CLOSE_DST};
+    OpType op;
+    switch (ctx->state) {
+        case FileState::SMALL_CHAIN:
+            op = CHAIN_OPS[SMALL_CHAIN_OPS - ctx->chain_left];
+            break;
+        case FileState::SMALL_CLEANUP:
+            op = ctx->chain_left == 2 ? OpType::CLOSE_SRC : OpType::CLOSE_DST;
+            break;
+        case FileState::READING:
+        case FileState::WRITING:
+            op = (tag & TAG_WRITE) ? OpType::WRITE : OpType::READ;
+            break;
+        case FileState::VERIFYING:
+            return;  // Not a copy op
+        default:
+            op = ctx->current_op;
+            break;
+    }
+    uint64_t now = now_ns();
+    uint64_t& start = ctx->cold->op_start[tag % OP_CLOCK_SLOTS];
+    metrics.record(static_cast<size_t>(op), start, now);
+    start = now;
+}
+
+void advance_state(FileContext* ctx, int result, unsigned tag, RingManager& ring,
+                   Stats& stats, const Config& cfg, PipePool* pipe_pool = nullptr,
+                   CopyOffloadCache* offload_cache = nullptr, HelperThread* helper = nullptr) {
+    if (ctx->state == FileState::PROBING) {
+        advance_probe(ctx, result, ring, stats, cfg);
+        return;
+    }
+    if (ctx->state == FileState::SMALL_CHAIN || ctx->state == FileState::SMALL_CLEANUP) {
+        advance_small_chain(ctx, result, ring, stats, cfg);
+        return;
+    }
+    if (ctx->state == FileState::READING || ctx->state == FileState::WRITING) {
+        advance_pipeline(ctx, result, tag, ring, stats, cfg, pipe_pool);
+        return;
+    }
+
+    if (result < 0 && ctx->state != FileState::DONE) {
+        report_error(ctx, result, cfg);
+        fail_file(ctx, stats);
         return;
     }
 
@@ -151,21 +868,31 @@ void advance_state(FileContext* ctx, int result, RingManager& ring,
             ctx->state = FileState::STATING;
             ctx->current_op = OpType::STATX;
             ring.prepare_statx(ctx->src_fd, "", AT_EMPTY_PATH,
-                              STATX_SIZE | STATX_MODE, &ctx->stx, ctx);
+                              STATX_SIZE | STATX_MODE | STATX_MTIME | STATX_BLOCKS,
+                              &ctx->cold->stx, ctx);
             break;
 
         case FileState::STATING: {
-            ctx->file_size = ctx->stx.stx_size;
-            ctx->mode = ctx->stx.stx_mode;
+            ctx->file_size = ctx->cold->stx.stx_size;
+            ctx->cold->mode = ctx->cold->stx.stx_mode;
+            if (cfg.incremental) {
+                ctx->cold->mtime = {static_cast<time_t>(ctx->cold->stx.stx_mtime.tv_sec),
+                                    static_cast<long>(ctx->cold->stx.stx_mtime.tv_nsec)};
+            }
             stats.bytes_total += ctx->file_size;
+            // A reflink reads nothing, nor does the cache under O_DIRECT
+            if (!cfg.use_reflink &&
+                !wants_direct(ctx->file_size, ctx->cold->stx.stx_blocks, cfg)) {
+                hint_readahead(ctx, ring);
+            }
 
             // Decide whether to use splice (zero-copy via pipe)
             ctx->use_splice = cfg.use_splice;
 
             ctx->state = FileState::OPENING_DST;
             ctx->current_op = OpType::OPEN_DST;
-            ring.prepare_openat(AT_FDCWD, ctx->dst_path.c_str(),
-                               O_WRONLY | O_CREAT | O_TRUNC, ctx->mode & 0777, ctx);
+            ring.prepare_openat(AT_FDCWD, ctx->cold->dst_path.c_str(),
+                               O_WRONLY | O_CREAT | O_TRUNC, ctx->cold->mode & 0777, ctx);
             break;
         }
 
@@ -177,63 +904,68 @@ void advance_state(FileContext* ctx, int result, RingManager& ring,
                 ctx->state = FileState::CLOSING_SRC;
                 ctx->current_op = OpType::CLOSE_SRC;
                 ring.prepare_close(ctx->src_fd, ctx);
-            } else if (ctx->use_splice && pipe_pool) {
-                // Use splice for zero-copy (requires pipe)
-                auto pipe = pipe_pool->acquire();
-                if (pipe.index >= 0) {
-                    ctx->pipe_read_fd = pipe.read_fd;
-                    ctx->pipe_write_fd = pipe.write_fd;
-                    ctx->pipe_index = pipe.index;
-
-                    ctx->state = FileState::SPLICE_IN;
-                    ctx->current_op = OpType::SPLICE_IN;
-                    uint32_t to_splice = std::min((uint64_t)cfg.chunk_size,
-                                                  ctx->file_size - ctx->offset);
-                    ring.prepare_splice(ctx->src_fd, ctx->offset,
-                                       ctx->pipe_write_fd, -1,
-                                       to_splice, SPLICE_F_MOVE, ctx);
-                } else {
-                    // No pipe available, fall back to read/write
-                    ctx->use_splice = false;
-                    ctx->state = FileState::READING;
-                    ctx->current_op = OpType::READ;
-                    uint32_t to_read = std::min((uint64_t)cfg.chunk_size,
-                                               ctx->file_size - ctx->offset);
-                    ring.prepare_read(ctx->src_fd, ctx->buffer, to_read, ctx->offset, ctx);
-                }
+            } else if (offload_cache && start_offload(ctx, ring, *offload_cache, *helper, cfg)) {
+                // FICLONE or a copy_file_range step on the helper thread
             } else {
-                // Use read/write
-                ctx->state = FileState::READING;
-                ctx->current_op = OpType::READ;
-                uint32_t to_read = std::min((uint64_t)cfg.chunk_size,
-                                           ctx->file_size - ctx->offset);
-                ring.prepare_read(ctx->src_fd, ctx->buffer, to_read, ctx->offset, ctx);
+                start_data_path(ctx, ring, stats, cfg, pipe_pool);
             }
             break;
 
-        case FileState::READING:
-            ctx->last_read_size = result;
-            ctx->state = FileState::WRITING;
-            ctx->current_op = OpType::WRITE;
-            ring.prepare_write(ctx->dst_fd, ctx->buffer, result, ctx->offset, ctx);
+        case FileState::CLONING: {
+            // The eventfd read completed: the ioctl's own result is in helper_word
+            int64_t res = HelperThread::result(ctx->cold->helper_word);
+            CopyOffloadCache::Entry* pair = ctx->cold->offload;
+            if (res == 0) {
+                pair->clone = CopyOffloadCache::Support::YES;
+                ctx->offset = ctx->file_size;
+                stats.bytes_copied += ctx->file_size;
+                ctx->state = FileState::CLOSING_SRC;
+                ctx->current_op = OpType::CLOSE_SRC;
+                ring.prepare_close(ctx->src_fd, ctx);
+                break;
+            }
+            if (CopyOffloadCache::is_unsupported(static_cast<int>(-res)) &&
+                pair->clone != CopyOffloadCache::Support::YES) {
+                pair->clone = CopyOffloadCache::Support::NO;
+            }
+            if (!start_copy_range(ctx, ring, *helper, cfg)) {
+                start_data_path(ctx, ring, stats, cfg, pipe_pool);
+            }
             break;
+        }
 
-        case FileState::WRITING:
-            ctx->offset += ctx->last_read_size;
-            stats.bytes_copied += ctx->last_read_size;
+        case FileState::COPYING: {
+            // One copy_file_range step done on the helper thread
+            CopyOffloadCache::Entry* pair = ctx->cold->offload;
+            int64_t copied = HelperThread::result(ctx->cold->helper_word);
+
+            if (copied < 0) {
+                int err = static_cast<int>(-copied);
+                if (CopyOffloadCache::is_unsupported(err) &&
+                    pair->copy_range != CopyOffloadCache::Support::YES) {
+                    // Device pair can't do it - remember, and finish this file the normal way
+                    pair->copy_range = CopyOffloadCache::Support::NO;
+                    start_data_copy(ctx, ring, cfg, pipe_pool);
+                } else {
+                    advance_state(ctx, -err, 0, ring, stats, cfg, pipe_pool, offload_cache, helper);
+                }
+                break;
+            }
 
-            if (ctx->offset >= ctx->file_size) {
+            pair->copy_range = CopyOffloadCache::Support::YES;
+            ctx->offset += copied;
+            stats.bytes_copied += copied;
+
+            if (copied == 0 || ctx->offset >= ctx->file_size) {
+                // copied == 0: source shrank underneath us, nothing more to copy
                 ctx->state = FileState::CLOSING_SRC;
                 ctx->current_op = OpType::CLOSE_SRC;
                 ring.prepare_close(ctx->src_fd, ctx);
             } else {
-                ctx->state = FileState::READING;
-                ctx->current_op = OpType::READ;
-                uint32_t to_read = std::min((uint64_t)cfg.chunk_size,
-                                           ctx->file_size - ctx->offset);
-                ring.prepare_read(ctx->src_fd, ctx->buffer, to_read, ctx->offset, ctx);
+                copy_range_step(ctx, ring, *helper, cfg);
             }
             break;
+        }
 
         case FileState::SPLICE_IN:
             // Splice from src_fd to pipe completed
@@ -252,16 +984,14 @@ void advance_state(FileContext* ctx, int result, RingManager& ring,
             stats.bytes_copied += result;
 
             if (ctx->offset >= ctx->file_size) {
-                // Done with file
-                ctx->state = FileState::CLOSING_SRC;
-                ctx->current_op = OpType::CLOSE_SRC;
-                ring.prepare_close(ctx->src_fd, ctx);
+                // Done with file (or segment, or data run)
+                end_range(ctx, ring, stats, cfg, pipe_pool);
             } else {
                 // More data to splice - go back to SPLICE_IN
                 ctx->state = FileState::SPLICE_IN;
                 ctx->current_op = OpType::SPLICE_IN;
-                uint32_t to_splice = std::min((uint64_t)cfg.chunk_size,
-                                              ctx->file_size - ctx->offset);
+                uint32_t to_splice = std::min<uint64_t>(io_chunk(cfg),
+                                                        ctx->file_size - ctx->offset);
                 // Splice from src_fd to pipe (pipe offset is always -1)
                 ring.prepare_splice(ctx->src_fd, ctx->offset,
                                    ctx->pipe_write_fd, -1,
@@ -271,6 +1001,7 @@ void advance_state(FileContext* ctx, int result, RingManager& ring,
 
         case FileState::CLOSING_SRC:
             ctx->src_fd = -1;
+            stamp_mtime(ctx, ctx->dst_fd);  // All writes have completed
             ctx->state = FileState::CLOSING_DST;
             ctx->current_op = OpType::CLOSE_DST;
             ring.prepare_close(ctx->dst_fd, ctx);
@@ -290,11 +1021,14 @@ void advance_state(FileContext* ctx, int result, RingManager& ring,
 // ============================================================
 // Synchronous Worker Thread (no io_uring, better for network storage)
 // ============================================================
-void sync_worker_thread(int worker_id, WorkQueue<FileWorkItem>& work_queue,
+void sync_worker_thread(int worker_id, WorkScheduler<FileWorkItem>& work_queue,
                         Stats& stats, const Config& cfg) {
+    if (!cfg.placement.worker_cpu.empty()) pin_thread({cfg.placement.worker_cpu[worker_id]});
     FileWorkItem item;
+    std::vector<char> verify_buf(cfg.verify ? cfg.chunk_size : 0);
+    std::vector<std::pair<uint64_t, uint64_t>> runs;
 
-    while (work_queue.wait_pop(item)) {
+    while (work_queue.wait_pop(worker_id, item)) {
         // Open source file
         int src_fd = open(item.src_path.c_str(), O_RDONLY);
         if (src_fd < 0) {
@@ -303,6 +1037,7 @@ void sync_worker_thread(int worker_id, WorkQueue<FileWorkItem>& work_queue,
                           item.src_path, strerror(errno));
             }
             stats.files_failed++;
+            note_failed(item.dst_path, cfg);
             continue;
         }
 
@@ -318,6 +1053,7 @@ void sync_worker_thread(int worker_id, WorkQueue<FileWorkItem>& work_queue,
             }
             close(src_fd);
             stats.files_failed++;
+            note_failed(item.dst_path, cfg);
             continue;
         }
         uint64_t file_size = st.st_size;
@@ -332,25 +1068,52 @@ void sync_worker_thread(int worker_id, WorkQueue<FileWorkItem>& work_queue,
             }
             close(src_fd);
             stats.files_failed++;
+            note_failed(item.dst_path, cfg);
             continue;
         }
 
+        // A sparse source: only its data runs, then the size for the trailing hole
+        bool sparse = maybe_sparse(file_size, st.st_blocks) &&
+                      data_runs(src_fd, 0, file_size, runs);
+        if (sparse) {
+            uint64_t holes = file_size;
+            for (const auto& run : runs) holes -= run.second;
+            stats.bytes_total -= holes;
+            stats.bytes_sparse += holes;
+        } else {
+            runs.assign(1, {0, file_size});
+        }
+
         // Copy data using copy_file_range (zero-copy)
-        loff_t off_in = 0, off_out = 0;
         bool success = true;
 
-        while (off_in < (loff_t)file_size) {
-            ssize_t copied = copy_file_range(src_fd, &off_in, dst_fd, &off_out,
-                                            file_size - off_in, 0);
-            if (copied <= 0) {
-                if (copied < 0 && cfg.verbose) {
-                    fmt::print(stderr, "copy_file_range failed on {}: {}\n",
-                              item.src_path, strerror(errno));
+        for (size_t r = 0; success && r < runs.size(); r++) {
+            loff_t off_in = runs[r].first, off_out = runs[r].first;
+            loff_t end = runs[r].first + runs[r].second;
+            while (off_in < end) {
+                ssize_t copied = copy_file_range(src_fd, &off_in, dst_fd, &off_out,
+                                                end - off_in, 0);
+                if (copied <= 0) {
+                    if (copied < 0 && cfg.verbose) {
+                        fmt::print(stderr, "copy_file_range failed on {}: {}\n",
+                                  item.src_path, strerror(errno));
+                    }
+                    success = false;
+                    break;
                 }
-                success = false;
-                break;
+                stats.bytes_copied += copied;
             }
-            stats.bytes_copied += copied;
+        }
+        if (success && sparse && ftruncate(dst_fd, file_size) != 0) {
+            if (cfg.verbose) {
+                fmt::print(stderr, "Failed to size {}: {}\n", item.dst_path, strerror(errno));
+            }
+            success = false;
+        }
+
+        if (success && cfg.incremental) {
+            struct timespec times[2] = {{0, UTIME_OMIT}, st.st_mtim};
+            futimens(dst_fd, times);
         }
 
         // Close files
@@ -359,8 +1122,14 @@ void sync_worker_thread(int worker_id, WorkQueue<FileWorkItem>& work_queue,
 
         if (success) {
             stats.files_completed++;
+            // copy_file_range never showed us the bytes: both sides are re-read
+            if (cfg.verify) {
+                count_verify(verify_copy(item.src_path, item.dst_path, file_size, {}, cfg,
+                                         verify_buf), stats);
+            }
         } else {
             stats.files_failed++;
+            note_failed(item.dst_path, cfg);
         }
     }
 
@@ -372,42 +1141,176 @@ void sync_worker_thread(int worker_id, WorkQueue<FileWorkItem>& work_queue,
 // ============================================================
 // io_uring Worker Thread
 // ============================================================
-void worker_thread(int worker_id, WorkQueue<FileWorkItem>& work_queue,
+
+// --affinity gives the worker's SQPOLL thread the CPU planned beside it.
+// The ring is set up before the worker pins itself: the kernel only binds
+// a poller to a CPU its creator may run on. Returns the ring's index.
+static unsigned worker_ring_setup(int worker_id, const Config& cfg, RingSetup& setup) {
+    if (cfg.placement.sqpoll_cpu.empty()) return worker_id;
+    setup.sqpoll_cpu = cfg.placement.sqpoll_cpu[worker_id];
+    return 0;   // sqpoll_cpu is this worker's own CPU, not a base
+}
+
+void worker_thread(int worker_id, WorkScheduler<FileWorkItem>& work_queue,
                    Stats& stats, const Config& cfg) {
-    // Each worker has its own io_uring, buffer pool, and pipe pool
-    RingManager ring(cfg.queue_depth);
-    BufferPool buffer_pool(cfg.queue_depth, cfg.chunk_size);
+    // Each worker has its own io_uring, buffer pool, and pipe pool.
+    // Small-file chains need SMALL_CHAIN_OPS SQEs per in-flight file, the
+    // read/write pipeline a read plus a write per buffer.
+    int ops_per_file = std::max(cfg.use_chain ? SMALL_CHAIN_OPS : 1, cfg.pipeline + 1);
+    unsigned ring_depth = std::min(cfg.queue_depth * ops_per_file, 4096);
+    RingSetup setup = cfg.ring;
+    unsigned ring_index = worker_ring_setup(worker_id, cfg, setup);
+    RingManager ring(ring_depth, setup, ring_index);
+    BufferPool buffer_pool(cfg.queue_depth, static_cast<size_t>(cfg.pipeline) * cfg.chunk_size);
+    if (!cfg.placement.worker_cpu.empty()) {
+        pin_thread({cfg.placement.worker_cpu[worker_id]});
+        buffer_pool.touch();     // First touch: its pages come from this node
+    }
     PipePool pipe_pool(cfg.queue_depth, cfg.chunk_size);
+    // FICLONE, copy_file_range and the --verify re-reads block: they run on
+    // a helper thread, one slot per buffer
+    std::unique_ptr<HelperThread> helper;
+    if (cfg.use_reflink || cfg.verify) {
+        helper = std::make_unique<HelperThread>(cfg.queue_depth);
+        if (!helper->ok()) {
+            fmt::print(stderr, "Worker {}: no helper thread: --reflink off, --verify inline\n",
+                       worker_id);
+            helper.reset();
+        }
+    }
+    CopyOffloadCache offload_cache;
+    CopyOffloadCache* offload = cfg.use_reflink && helper ? &offload_cache : nullptr;
+
+    // Two fixed-file slots (src, dst) per buffer; needs 5.15+ for direct open
+    bool chain = cfg.use_chain && ring.register_file_slots(2 * cfg.queue_depth);
+    if (cfg.use_chain && !chain && cfg.verbose) {
+        fmt::print(stderr, "Worker {}: fixed-file slots unavailable, small-file chains disabled\n",
+                   worker_id);
+    }
 
-    std::vector<FileContext*> in_flight;
-    in_flight.reserve(cfg.queue_depth);
+    // One context per buffer; the slab count doubles as the in-flight count
+    FileContextSlab contexts(cfg.queue_depth);
+    WorkerMetrics* metrics = cfg.worker_metrics.empty() ? nullptr : cfg.worker_metrics[worker_id];
+    ring.set_op_clock(metrics != nullptr);
+    std::vector<char> verify_buf(cfg.verify ? cfg.chunk_size : 0);
 
     auto start_file = [&](const FileWorkItem& item) -> bool {
-        auto [buffer, buf_idx] = buffer_pool.acquire();
-        if (!buffer) return false;
+        if (item.split && !open_split(*item.split, item, stats, cfg)) {
+            end_segment(item.split, true, item.dst_path, stats, cfg);
+            return true;  // Nothing to start
+        }
 
-        FileContext* ctx = new FileContext();
-        ctx->src_path = item.src_path;
-        ctx->dst_path = item.dst_path;
+        FileContext* ctx = contexts.acquire();
+        if (!ctx) return false;
+        auto [buffer, buf_idx] = buffer_pool.acquire();
+        if (!buffer) {
+            contexts.release(ctx);
+            return false;
+        }
+        if (cfg.tune) stats.files_in_flight++;
+
+        ctx->cold->src_path.assign(item.src_path);
+        ctx->cold->dst_path.assign(item.dst_path);
+        ctx->cold->mtime = item.mtime;
+        ctx->cold->verify_crcs.clear();
+        ctx->cold->split = item.split;
+        ctx->cold->split_offset = item.range_offset;
         ctx->buffer = buffer;
         ctx->buffer_index = buf_idx;
-        ctx->state = FileState::OPENING_SRC;
-        ctx->current_op = OpType::OPEN_SRC;
 
-        ring.prepare_openat(AT_FDCWD, ctx->src_path.c_str(), O_RDONLY, 0, ctx);
-        in_flight.push_back(ctx);
+        if (item.split) {
+            // Fds are open: straight to the data, as [offset, file_size)
+            ctx->src_fd = item.split->src_fd;
+            ctx->dst_fd = item.split->dst_fd;
+            ctx->offset = item.range_offset;
+            ctx->file_size = item.range_offset + item.range_len;
+            ctx->cold->direct = item.split->direct;
+            ctx->use_splice = cfg.use_splice && !item.split->direct;
+            stats.bytes_total += item.range_len;
+            if (item.split->sparse && map_sparse(ctx, stats)) {
+                end_range(ctx, ring, stats, cfg, &pipe_pool);
+                // Only a hole: nothing was queued to complete on
+                if (ctx->state == FileState::DONE) ring.prepare_nop(ctx);
+            } else {
+                if (!item.split->direct) hint_readahead(ctx, ring);
+                start_data_copy(ctx, ring, cfg, &pipe_pool);
+            }
+        } else if (chain && item.size == FileWorkItem::UNKNOWN_SIZE) {
+            probe_small(ctx, ring);
+        } else if (chain && item.size > 0 && item.size <= (uint64_t)cfg.chunk_size) {
+            ctx->file_size = item.size;
+            stats.bytes_total += item.size;
+            start_small_chain(ctx, ring, item.mode);
+        } else {
+            start_regular(ctx, ring);
+        }
+        return true;
+    };
+
+    // Verify the copy, on the helper thread if there is one
+    const std::vector<ChunkCrc> no_crcs;
+    auto verify_file = [&](FileContext* ctx, uint64_t size, const std::vector<ChunkCrc>& known) {
+        if (!helper) {
+            count_verify(verify_copy(ctx->cold->src_path, ctx->cold->dst_path, size, known, cfg,
+                                     verify_buf), stats);
+            return false;
+        }
+        // Jobs run one at a time, so the helper has verify_buf to itself
+        ctx->state = FileState::VERIFYING;
+        run_on_helper(ctx, ring, *helper, [ctx, size, &known, &cfg, &verify_buf]() -> int64_t {
+            return verify_copy(ctx->cold->src_path, ctx->cold->dst_path, size, known, cfg,
+                               verify_buf) ? 1 : 0;
+        });
         return true;
     };
 
+    // A file or segment is done or failed; true if it now waits for --verify
+    auto finish_file = [&](FileContext* ctx) -> bool {
+        if (ctx->cold->split) {
+            // Segments carry no chunk CRCs: both sides are re-read
+            uint64_t size = ctx->cold->split->size;
+            std::string key;
+            if (cfg.journal) {
+                key = cfg.journal->key(ctx->cold->dst_path);
+                if (ctx->state == FileState::DONE) {
+                    cfg.journal->range(key, size, to_mtime_ns(ctx->cold->split->mtime),
+                                       ctx->cold->split_offset,
+                                       ctx->file_size - ctx->cold->split_offset);
+                }
+            }
+            bool complete = end_segment(std::move(ctx->cold->split),
+                                        ctx->state == FileState::FAILED,
+                                        ctx->cold->dst_path, stats, cfg);
+            if (complete && cfg.journal) cfg.journal->finish(key);
+            return complete && cfg.verify && verify_file(ctx, size, no_crcs);
+        }
+        if (ctx->state == FileState::FAILED) {
+            note_failed(ctx->cold->dst_path, cfg);
+            return false;
+        }
+        if (!cfg.verify) return false;
+        // Pipeline reads complete out of order; verify_copy walks them by offset
+        auto& crcs = ctx->cold->verify_crcs;
+        std::sort(crcs.begin(), crcs.end(),
+                  [](const ChunkCrc& a, const ChunkCrc& b) { return a.offset < b.offset; });
+        return verify_file(ctx, ctx->file_size, crcs);
+    };
+
     bool queue_exhausted = false;
 
-    while (!queue_exhausted || !in_flight.empty()) {
+    while (!queue_exhausted || !contexts.empty()) {
+        // Under --autotune the controller sets how much of the pipeline is used
+        size_t limit = contexts.capacity();
+        if (cfg.tune) {
+            limit = std::min<size_t>(limit, cfg.tune->depth.load(std::memory_order_relaxed));
+        }
+
         // Try to fill pipeline with more work
-        while (!queue_exhausted && in_flight.size() < (size_t)cfg.queue_depth) {
+        while (!queue_exhausted && contexts.in_use() < limit) {
             FileWorkItem item;
-            if (work_queue.try_pop(item)) {
+            if (work_queue.try_pop(worker_id, item)) {
                 if (!start_file(item)) {
-                    work_queue.push(std::move(item));
+                    work_queue.push_local(worker_id, std::move(item));
                     break;
                 }
             } else {
@@ -418,13 +1321,13 @@ void worker_thread(int worker_id, WorkQueue<FileWorkItem>& work_queue,
             }
         }
 
-        if (in_flight.empty()) {
+        if (contexts.empty()) {
             if (!queue_exhausted) {
                 FileWorkItem item;
-                if (work_queue.wait_pop(item)) {
+                if (work_queue.wait_pop(worker_id, item)) {
                     if (!start_file(item)) {
                         // Failed to start - push back and retry
-                        work_queue.push(std::move(item));
+                        work_queue.push_local(worker_id, std::move(item));
                         continue;
                     }
                 } else {
@@ -437,23 +1340,32 @@ void worker_thread(int worker_id, WorkQueue<FileWorkItem>& work_queue,
         }
 
         ring.submit();
+        if (metrics) {
+            metrics->ring_in_flight.set(ring.in_flight());
+            metrics->files_in_flight.set(contexts.in_use());
+        }
 
         // Process completions
-        ring.wait_and_process([&](FileContext* ctx, int result) {
-            advance_state(ctx, result, ring, stats, cfg, &pipe_pool);
-
-            if (ctx->state == FileState::DONE || ctx->state == FileState::FAILED) {
-                buffer_pool.release(ctx->buffer_index);
-                pipe_pool.release(ctx->pipe_index);  // Safe even if -1 (no pipe was used)
-
-                auto it = std::find(in_flight.begin(), in_flight.end(), ctx);
-                if (it != in_flight.end()) {
-                    in_flight.erase(it);
-                }
-
-                delete ctx;
+        int completed = ring.wait_and_process([&](FileContext* ctx, int result, unsigned tag) {
+            if (!ctx) return;  // Readahead hint
+            if (metrics) record_op(ctx, tag, *metrics);
+            if (ctx->state == FileState::VERIFYING) {
+                // A failed eventfd read leaves no verdict: count it against the copy
+                count_verify(result >= 0 && HelperThread::result(ctx->cold->helper_word) == 1,
+                             stats);
+                ctx->state = FileState::DONE;
+            } else {
+                advance_state(ctx, result, tag, ring, stats, cfg, &pipe_pool, offload,
+                              helper.get());
+                if (ctx->state != FileState::DONE && ctx->state != FileState::FAILED) return;
+                if (finish_file(ctx)) return;   // Verify in flight
             }
+            buffer_pool.release(ctx->buffer_index);
+            pipe_pool.release(ctx->pipe_index);  // Safe even if -1 (no pipe was used)
+            contexts.release(ctx);
+            if (cfg.tune) stats.files_in_flight--;
         });
+        if (cfg.tune && completed > 0) stats.ops_completed += completed;
 
         ring.submit();
     }
@@ -463,6 +1375,162 @@ void worker_thread(int worker_id, WorkQueue<FileWorkItem>& work_queue,
     }
 }
 
+// ============================================================
+// Hardlinks (--hardlinks)
+// ============================================================
+// The scanner queues one name of each multi-link file and hands back the
+// others. Once every copy is written they are linked to it; a name that
+// already is a link of the copy (an earlier run) is left alone, anything
+// else there is replaced. When the first name's copy failed, whatever is
+// at its path may be partial or an old copy: its other names are not
+// linked and count as failed too.
+static void make_links(const std::vector<HardLink>& links, Stats& stats, const Config& cfg) {
+    for (const auto& link : links) {
+        struct stat target_st, dst_st;
+        if (cfg.failed_copies && cfg.failed_copies->contains(link.target)) {
+            if (cfg.verbose) {
+                fmt::print(stderr, "Cannot link {}: copy of {} failed\n", link.dst_path,
+                           link.target);
+            }
+            stats.files_failed++;
+            continue;
+        }
+        if (stat(link.target.c_str(), &target_st) != 0) {
+            fmt::print(stderr, "Cannot link {}: {}: {}\n", link.dst_path, link.target,
+                       strerror(errno));
+            stats.files_failed++;
+            continue;
+        }
+        if (lstat(link.dst_path.c_str(), &dst_st) == 0) {
+            if (dst_st.st_dev == target_st.st_dev && dst_st.st_ino == target_st.st_ino) {
+                stats.files_skipped++;
+                continue;
+            }
+            unlink(link.dst_path.c_str());
+        }
+        if (linkat(AT_FDCWD, link.target.c_str(), AT_FDCWD, link.dst_path.c_str(), 0) != 0) {
+            fmt::print(stderr, "Cannot link {}: {}\n", link.dst_path, strerror(errno));
+            stats.files_failed++;
+            continue;
+        }
+        stats.files_linked++;
+    }
+}
+
+// ============================================================
+// Autotune (--autotune)
+// ============================================================
+
+constexpr int AUTOTUNE_SYNC_WORKERS = 8;                 // Blocking workers on network filesystems
+constexpr size_t AUTOTUNE_MAX_CHUNK = 1024 * 1024;       // Largest chunk pick_chunk_size() picks
+constexpr size_t AUTOTUNE_ARENA = 64 * 1024 * 1024;      // Buffer memory per worker for chunk trials
+
+// Engine from the filesystem types, unless --sync was given
+static void choose_engine(Config& cfg) {
+    if (cfg.sync_mode) return;
+    FsClass src = probe_fs_class(cfg.src_path);
+    FsClass dst = probe_fs_class(cfg.dst_path);
+    if (src == FsClass::NETWORK || dst == FsClass::NETWORK) {
+        cfg.sync_mode = true;
+        if (!cfg.jobs_set) cfg.num_workers = AUTOTUNE_SYNC_WORKERS;
+    } else if (src == FsClass::FUSE || dst == FsClass::FUSE) {
+        cfg.use_splice = false;  // FUSE daemons see splice as plain reads and writes anyway
+    }
+    fmt::print("Autotune: source on {} fs, destination on {} fs: {} engine\n",
+               fs_class_name(src), fs_class_name(dst),
+               cfg.sync_mode ? "sync" : cfg.use_splice ? "io_uring splice" : "io_uring read/write");
+}
+
+// Buffer stride that leaves chunk trials room to grow: up to 4x the
+// picked chunk, within AUTOTUNE_ARENA per worker
+static size_t autotune_max_chunk(const Config& cfg) {
+    size_t chunk = cfg.chunk_size;
+    size_t limit = std::min(4 * chunk, AUTOTUNE_MAX_CHUNK);
+    size_t per_chunk = static_cast<size_t>(cfg.queue_depth) * cfg.pipeline;
+    while (2 * chunk <= limit && 2 * chunk * per_chunk <= AUTOTUNE_ARENA) chunk *= 2;
+    return chunk;
+}
+
+// ============================================================
+// Ring Setup (--ring)
+// ============================================================
+
+static bool is_ring_option(const char* arg) {
+    return strcmp(arg, "--ring") == 0 || strcmp(arg, "--sqpoll-cpu") == 0 ||
+           strcmp(arg, "--sqpoll-idle") == 0;
+}
+
+// Apply --<name> <value>; false (after printing why) if the value is bad
+static bool set_ring_option(const char* name, const char* value, RingSetup& setup) {
+    if (strcmp(name, "ring") == 0) {
+        if (!parse_ring_profile(value, setup.profile)) {
+            fmt::print(stderr, "Error: --ring must be default, sqpoll, coop or defer\n");
+            return false;
+        }
+    } else if (strcmp(name, "sqpoll-cpu") == 0) {
+        setup.sqpoll_cpu = std::atoi(value);
+        if (setup.sqpoll_cpu < 0) {
+            fmt::print(stderr, "Error: sqpoll-cpu must not be negative\n");
+            return false;
+        }
+    } else {
+        int ms = std::atoi(value);
+        if (ms <= 0) {
+            fmt::print(stderr, "Error: sqpoll-idle must be positive\n");
+            return false;
+        }
+        setup.sqpoll_idle_ms = static_cast<unsigned>(ms);
+    }
+    return true;
+}
+
+// Probe the requested profile once, so every ring starts from one the
+// kernel takes and the fallback is reported a single time
+static void resolve_ring_profile(RingSetup& setup) {
+    if (setup.profile == RingProfile::DEFAULT) return;
+    RingProfile used = probe_ring_profile(setup);
+    if (used != setup.profile) {
+        fmt::print(stderr, "Warning: --ring {} is not supported here, using {}\n",
+                   ring_profile_name(setup.profile), ring_profile_name(used));
+        setup.profile = used;
+    }
+}
+
+// ============================================================
+// Metrics (--metrics, --metrics-stream, --trace)
+// ============================================================
+
+// In OpType order
+constexpr const char* OP_TYPE_NAMES[] = {
+    "open_src", "open_dst", "statx", "read", "write", "copy_file_range", "clone",
+    "splice_in", "splice_out", "close_src", "close_dst", "mkdir", "network_send",
+    "network_recv"};
+static_assert(std::size(OP_TYPE_NAMES) == static_cast<size_t>(OpType::NETWORK_RECV) + 1);
+
+static bool is_metrics_option(const char* arg) {
+    return strcmp(arg, "--metrics") == 0 || strcmp(arg, "--metrics-stream") == 0 ||
+           strcmp(arg, "--metrics-interval") == 0 || strcmp(arg, "--trace") == 0;
+}
+
+// Apply --<name> <value>; false (after printing why) if the value is bad
+static bool set_metrics_option(const char* name, const char* value, MetricsSetup& setup) {
+    if (strcmp(name, "metrics") == 0) {
+        setup.json_path = value;
+    } else if (strcmp(name, "metrics-stream") == 0) {
+        setup.stream_target = value;
+    } else if (strcmp(name, "metrics-interval") == 0) {
+        int ms = std::atoi(value);
+        if (ms <= 0) {
+            fmt::print(stderr, "Error: metrics-interval must be positive\n");
+            return false;
+        }
+        setup.interval_ms = static_cast<unsigned>(ms);
+    } else {
+        setup.trace_path = value;
+    }
+    return true;
+}
+
 // ============================================================
 // Network Mode Helpers
 // ============================================================
@@ -478,11 +1546,45 @@ static void print_net_usage(const char* prog) {
     fmt::print("Network usage:\n");
     fmt::print("  {} send <source> <host:port> [options]\n", prog);
     fmt::print("  {} recv <dest> --listen <port> [options]\n", prog);
+    fmt::print("  {} recv [<dest>] --listen <port> --uring --daemon [--config <file>] [options]\n", prog);
     fmt::print("\nOptions:\n");
     fmt::print("  --secret <s>  Pre-shared secret for authentication\n");
     fmt::print("  --tls         Enable kTLS encryption (requires --secret)\n");
     fmt::print("  --uring       Use io_uring async batching (faster)\n");
     fmt::print("  --splice      Use zero-copy splice (slower for small files)\n");
+    fmt::print("  --streams <n> Parallel TCP connections (send, requires --uring)\n");
+    fmt::print("  --zero-copy   SEND_ZC on send, provided buffer ring on recv (requires --uring)\n");
+    fmt::print("  --no-batch    Send every file with its own FILE_HDR (no FILE_BATCH packing)\n");
+    fmt::print("  --compress [zstd|lz4]  Compress file data (send, requires --uring; default zstd)\n");
+    fmt::print("  --incremental Skip files the receiver has with the same size and mtime\n");
+    fmt::print("                (send, requires --uring)\n");
+    fmt::print("  --delta       Send large changed files as block deltas (send, implies\n");
+    fmt::print("                --incremental, requires --uring)\n");
+    fmt::print("  --verify      Send a CRC32C with every file; the receiver checks it and\n");
+    fmt::print("                removes copies that don't match (send, requires --uring)\n");
+    fmt::print("  --resume      Finish the large files an interrupted transfer left partial\n");
+    fmt::print("                (send, implies --incremental, requires --uring)\n");
+    fmt::print("  --extent-order  Send files in physical disk order (FIEMAP) (send, requires --uring)\n");
+    fmt::print("  --hardlinks   Send each further name of a hardlinked file as a link, not its\n");
+    fmt::print("                data (send, requires --uring)\n");
+    fmt::print("  --write-workers <n>  Disk writes of each stream on n worker rings, so slow\n");
+    fmt::print("                storage doesn't stall the socket (recv, requires --uring)\n");
+    fmt::print("  --direct      Write files of 8MB+ with O_DIRECT, bypassing the page cache\n");
+    fmt::print("                (recv, requires --uring)\n");
+    fmt::print("  --direct-size <n>  Threshold of --direct in bytes (implies --direct)\n");
+    fmt::print("  --daemon      Keep serving sessions, several at once, until SIGINT/SIGTERM\n");
+    fmt::print("                (recv, requires --uring)\n");
+    fmt::print("  --config <file>  Daemon routes, one \"<secret> <dest>\" per line: a session\n");
+    fmt::print("                lands under the dest of its secret (recv --daemon)\n");
+    fmt::print("  --warm <n>    Streams the daemon keeps set up ahead of connections (default: 4)\n");
+    fmt::print("  --ring <profile>  Ring setup: default, sqpoll, coop or defer (requires --uring)\n");
+    fmt::print("  --sqpoll-cpu <n>  Pin stream i's SQPOLL thread to CPU n + i\n");
+    fmt::print("  --sqpoll-idle <ms>  SQPOLL thread idle time before it sleeps (default: 50)\n");
+    fmt::print("  --affinity    Run each stream on the NIC's NUMA node, on the CPU its packets\n");
+    fmt::print("                arrive on (requires --uring)\n");
+    fmt::print("  --metrics <file>, --metrics-stream <target>, --metrics-interval <ms>, --trace <file>\n");
+    fmt::print("                Per-op latency metrics and traces of each stream, as for local\n");
+    fmt::print("                copy (requires --uring)\n");
     fmt::print("\nEncryption modes:\n");
     fmt::print("  Plaintext:    {} send /data host:9999 --secret key\n", prog);
     fmt::print("  Native kTLS:  {} send /data host:9999 --secret key --tls\n", prog);
@@ -494,6 +1596,13 @@ static void print_net_usage(const char* prog) {
     fmt::print("\n  # With native kTLS encryption\n");
     fmt::print("  {} recv /backup --listen 9999 --secret abc123 --tls\n", prog);
     fmt::print("  {} send /data 192.168.1.100:9999 --secret abc123 --tls\n", prog);
+    fmt::print("\n  # Four parallel encrypted streams (receiver accepts them automatically)\n");
+    fmt::print("  {} recv /backup --listen 9999 --secret abc123 --uring --tls\n", prog);
+    fmt::print("  {} send /data 192.168.1.100:9999 --secret abc123 --uring --tls --streams 4\n", prog);
+    fmt::print("\n  # Compressed over a slow link (receivers decompress automatically)\n");
+    fmt::print("  {} send /data 192.168.1.100:9999 --secret abc123 --uring --compress zstd\n", prog);
+    fmt::print("\n  # Long-running receiver for many senders, one dest per secret\n");
+    fmt::print("  {} recv --listen 9999 --uring --daemon --config /etc/uring-sync/routes\n", prog);
     fmt::print("\n  # Using SSH tunnel (encryption via SSH)\n");
     fmt::print("  ssh -L 9999:localhost:9999 user@remote-host  # Terminal 1\n");
     fmt::print("  {} recv /backup --listen 9999 --secret abc123  # On remote\n", prog);
@@ -503,6 +1612,12 @@ static void print_net_usage(const char* prog) {
 // ============================================================
 // Main
 // ============================================================
+
+// Scanned files waiting for a worker before the scan pauses. A work item
+// carries two full paths, so this caps the queue at a few hundred MB on
+// trees of any size; --max-memory adds a cap on the whole process.
+constexpr size_t MAX_QUEUED_ITEMS = 1 << 20;
+
 int main(int argc, char* argv[]) {
     // Check for network mode first (before getopt)
     if (argc >= 2) {
@@ -514,15 +1629,69 @@ int main(int argc, char* argv[]) {
             bool use_splice = false;
             bool use_uring = false;
             bool use_tls = false;
+            bool zero_copy = false;
+            bool file_batch = true;
+            protocol::Codec compress = protocol::Codec::NONE;
+            bool incremental = false;
+            bool delta = false;
+            bool verify = false;
+            bool resume = false;
+            bool extent_order = false;
+            bool hardlinks = false;
+            bool affinity = false;
+            RingSetup ring;
+            MetricsSetup metrics;
+            int streams = 1;
             for (int i = 2; i < argc; i++) {
                 if (strcmp(argv[i], "--secret") == 0 && i + 1 < argc) {
                     secret = argv[++i];
+                } else if (strcmp(argv[i], "--streams") == 0 && i + 1 < argc) {
+                    streams = std::atoi(argv[++i]);
+                    if (streams < 1 || streams > protocol::MAX_STREAMS) {
+                        fmt::print(stderr, "Error: --streams must be 1-{}\n", protocol::MAX_STREAMS);
+                        return 1;
+                    }
                 } else if (strcmp(argv[i], "--splice") == 0) {
                     use_splice = true;
                 } else if (strcmp(argv[i], "--uring") == 0) {
                     use_uring = true;
                 } else if (strcmp(argv[i], "--tls") == 0) {
                     use_tls = true;
+                } else if (strcmp(argv[i], "--zero-copy") == 0) {
+                    zero_copy = true;
+                } else if (strcmp(argv[i], "--no-batch") == 0) {
+                    file_batch = false;
+                } else if (strcmp(argv[i], "--compress") == 0) {
+                    // The codec name is optional
+                    compress = protocol::Codec::ZSTD;
+                    if (i + 1 < argc && strcmp(argv[i + 1], "zstd") == 0) {
+                        i++;
+                    } else if (i + 1 < argc && strcmp(argv[i + 1], "lz4") == 0) {
+                        compress = protocol::Codec::LZ4;
+                        i++;
+                    }
+                } else if (strcmp(argv[i], "--incremental") == 0) {
+                    incremental = true;
+                } else if (strcmp(argv[i], "--delta") == 0) {
+                    incremental = true;
+                    delta = true;
+                } else if (strcmp(argv[i], "--verify") == 0) {
+                    verify = true;
+                } else if (strcmp(argv[i], "--resume") == 0) {
+                    incremental = true;
+                    resume = true;
+                } else if (strcmp(argv[i], "--extent-order") == 0) {
+                    extent_order = true;
+                } else if (strcmp(argv[i], "--hardlinks") == 0) {
+                    hardlinks = true;
+                } else if (strcmp(argv[i], "--affinity") == 0) {
+                    affinity = true;
+                } else if (is_ring_option(argv[i]) && i + 1 < argc) {
+                    if (!set_ring_option(argv[i] + 2, argv[i + 1], ring)) return 1;
+                    i++;
+                } else if (is_metrics_option(argv[i]) && i + 1 < argc) {
+                    if (!set_metrics_option(argv[i] + 2, argv[i + 1], metrics)) return 1;
+                    i++;
                 } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
                     print_net_usage(argv[0]);
                     return 0;
@@ -551,13 +1720,61 @@ int main(int argc, char* argv[]) {
             }
 
             if (use_uring) {
-                if (use_tls) {
-                    fmt::print(stderr, "Error: --tls + --uring not yet supported. Use --tls without --uring.\n");
-                    return 1;
-                }
-                return run_sender_uring(src, host, port, secret);
+                resolve_ring_profile(ring);
+                return run_sender_uring(src, host, port, secret, streams, zero_copy, use_tls,
+                                        file_batch, compress, incremental, delta, verify,
+                                        resume, extent_order, hardlinks, ring, affinity,
+                                        metrics);
+            }
+            if (streams > 1) {
+                fmt::print(stderr, "Error: --streams requires --uring\n");
+                return 1;
+            }
+            if (zero_copy) {
+                fmt::print(stderr, "Error: --zero-copy requires --uring\n");
+                return 1;
+            }
+            if (compress != protocol::Codec::NONE) {
+                fmt::print(stderr, "Error: --compress requires --uring\n");
+                return 1;
+            }
+            if (delta) {
+                fmt::print(stderr, "Error: --delta requires --uring\n");
+                return 1;
+            }
+            if (resume) {
+                fmt::print(stderr, "Error: --resume requires --uring\n");
+                return 1;
+            }
+            if (incremental) {
+                fmt::print(stderr, "Error: --incremental requires --uring\n");
+                return 1;
+            }
+            if (verify) {
+                fmt::print(stderr, "Error: --verify requires --uring\n");
+                return 1;
+            }
+            if (extent_order) {
+                fmt::print(stderr, "Error: --extent-order requires --uring\n");
+                return 1;
+            }
+            if (hardlinks) {
+                fmt::print(stderr, "Error: --hardlinks requires --uring\n");
+                return 1;
+            }
+            if (affinity) {
+                fmt::print(stderr, "Error: --affinity requires --uring\n");
+                return 1;
+            }
+            if (ring.profile != RingProfile::DEFAULT) {
+                fmt::print(stderr, "Error: --ring requires --uring\n");
+                return 1;
             }
-            return run_sender(src, host, port, secret, use_splice, use_tls);
+            if (metrics.enabled()) {
+                fmt::print(stderr, "Error: --metrics, --metrics-stream and --trace require --uring\n");
+                return 1;
+            }
+            return run_sender(src, host, port, secret, use_splice, use_tls, file_batch);
         }
 
         if (mode == "recv") {
@@ -567,6 +1784,15 @@ int main(int argc, char* argv[]) {
             std::string secret;
             bool use_uring = false;
             bool use_tls = false;
+            bool zero_copy = false;
+            int write_workers = 0;
+            uint64_t direct_size = 0;
+            bool affinity = false;
+            bool daemon = false;
+            std::string config_path;
+            int warm = 4;
+            RingSetup ring;
+            MetricsSetup metrics;
 
             for (int i = 2; i < argc; i++) {
                 if (strcmp(argv[i], "--listen") == 0 && i + 1 < argc) {
@@ -579,6 +1805,41 @@ int main(int argc, char* argv[]) {
                     use_uring = true;
                 } else if (strcmp(argv[i], "--tls") == 0) {
                     use_tls = true;
+                } else if (strcmp(argv[i], "--zero-copy") == 0) {
+                    zero_copy = true;
+                } else if (strcmp(argv[i], "--write-workers") == 0 && i + 1 < argc) {
+                    write_workers = std::atoi(argv[++i]);
+                    if (write_workers < 1 || write_workers > 64) {
+                        fmt::print(stderr, "Error: --write-workers must be between 1 and 64\n");
+                        return 1;
+                    }
+                } else if (strcmp(argv[i], "--direct") == 0) {
+                    if (direct_size == 0) direct_size = DIRECT_MIN_SIZE;
+                } else if (strcmp(argv[i], "--direct-size") == 0 && i + 1 < argc) {
+                    long long n = std::atoll(argv[++i]);
+                    if (n <= 0) {
+                        fmt::print(stderr, "Error: --direct-size must be positive\n");
+                        return 1;
+                    }
+                    direct_size = static_cast<uint64_t>(n);
+                } else if (strcmp(argv[i], "--affinity") == 0) {
+                    affinity = true;
+                } else if (strcmp(argv[i], "--daemon") == 0) {
+                    daemon = true;
+                } else if (strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+                    config_path = argv[++i];
+                } else if (strcmp(argv[i], "--warm") == 0 && i + 1 < argc) {
+                    warm = std::atoi(argv[++i]);
+                    if (warm < 0 || warm > 128) {
+                        fmt::print(stderr, "Error: --warm must be between 0 and 128\n");
+                        return 1;
+                    }
+                } else if (is_ring_option(argv[i]) && i + 1 < argc) {
+                    if (!set_ring_option(argv[i] + 2, argv[i + 1], ring)) return 1;
+                    i++;
+                } else if (is_metrics_option(argv[i]) && i + 1 < argc) {
+                    if (!set_metrics_option(argv[i] + 2, argv[i + 1], metrics)) return 1;
+                    i++;
                 } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
                     print_net_usage(argv[0]);
                     return 0;
@@ -587,23 +1848,65 @@ int main(int argc, char* argv[]) {
                 }
             }
 
-            if (dest.empty() || port == 0) {
+            // A daemon may take every destination from its config
+            if ((dest.empty() && config_path.empty()) || (dest.empty() && !daemon) || port == 0) {
                 print_net_usage(argv[0]);
                 return 1;
             }
+            if (!config_path.empty() && !daemon) {
+                fmt::print(stderr, "Error: --config requires --daemon\n");
+                return 1;
+            }
 
             // Validate --tls requires --secret
-            if (use_tls && secret.empty()) {
+            if (use_tls && secret.empty() && config_path.empty()) {
                 fmt::print(stderr, "Error: --tls requires --secret\n");
                 return 1;
             }
 
-            if (use_uring) {
-                if (use_tls) {
-                    fmt::print(stderr, "Error: --tls + --uring not yet supported. Use --tls without --uring.\n");
+            if (daemon) {
+                if (!use_uring) {
+                    fmt::print(stderr, "Error: --daemon requires --uring\n");
+                    return 1;
+                }
+                // Reports are written at exit; a daemon's would grow with every stream
+                if (metrics.enabled()) {
+                    fmt::print(stderr, "Error: --metrics, --metrics-stream and --trace can't be used with --daemon\n");
                     return 1;
                 }
-                return run_receiver_uring(dest, port, secret);
+                resolve_ring_profile(ring);
+                return run_receiver_daemon(dest, port, secret, config_path, zero_copy, use_tls,
+                                           write_workers, direct_size, warm, ring, affinity);
+            }
+
+            if (use_uring) {
+                resolve_ring_profile(ring);
+                return run_receiver_uring(dest, port, secret, zero_copy, use_tls, write_workers,
+                                          direct_size, ring, affinity, metrics);
+            }
+            if (zero_copy) {
+                fmt::print(stderr, "Error: --zero-copy requires --uring\n");
+                return 1;
+            }
+            if (write_workers > 0) {
+                fmt::print(stderr, "Error: --write-workers requires --uring\n");
+                return 1;
+            }
+            if (direct_size > 0) {
+                fmt::print(stderr, "Error: --direct requires --uring\n");
+                return 1;
+            }
+            if (affinity) {
+                fmt::print(stderr, "Error: --affinity requires --uring\n");
+                return 1;
+            }
+            if (ring.profile != RingProfile::DEFAULT) {
+                fmt::print(stderr, "Error: --ring requires --uring\n");
+                return 1;
+            }
+            if (metrics.enabled()) {
+                fmt::print(stderr, "Error: --metrics, --metrics-stream and --trace require --uring\n");
+                return 1;
             }
             return run_receiver(dest, port, secret, use_tls);
         }
@@ -620,15 +1923,39 @@ int main(int argc, char* argv[]) {
         {"quiet",      no_argument,       nullptr, 'Q'},
         {"no-splice",  no_argument,       nullptr, 'N'},
         {"sync",       no_argument,       nullptr, 'S'},
+        {"scan-threads", required_argument, nullptr, 'T'},
+        {"reflink",    no_argument,       nullptr, 'R'},
+        {"no-chain",   no_argument,       nullptr, 'L'},
+        {"incremental", no_argument,      nullptr, 'I'},
+        {"verify",     no_argument,       nullptr, 'V'},
+        {"verify-sample", required_argument, nullptr, 'W'},
+        {"split-size", required_argument, nullptr, 'P'},
+        {"pipeline",   required_argument, nullptr, 'B'},
+        {"direct",     no_argument,       nullptr, 'X'},
+        {"direct-size", required_argument, nullptr, 'F'},
+        {"ring",       required_argument, nullptr, 'G'},
+        {"sqpoll-cpu", required_argument, nullptr, 'C'},
+        {"sqpoll-idle", required_argument, nullptr, 'D'},
+        {"autotune",   no_argument,       nullptr, 'A'},
+        {"extent-order", no_argument,     nullptr, 'E'},
+        {"max-memory", required_argument, nullptr, 'Z'},
+        {"metrics",    required_argument, nullptr, 'M'},
+        {"metrics-stream", required_argument, nullptr, 'O'},
+        {"metrics-interval", required_argument, nullptr, 'Y'},
+        {"trace",      required_argument, nullptr, 'K'},
+        {"resume",     no_argument,       nullptr, 'U'},
+        {"hardlinks",  no_argument,       nullptr, 'H'},
+        {"affinity",   no_argument,       nullptr, 'n'},
         {"help",       no_argument,       nullptr, 'h'},
         {nullptr,      0,                 nullptr,  0 }
     };
 
     int opt;
-    while ((opt = getopt_long(argc, argv, "j:c:q:vQNSh", long_options, nullptr)) != -1) {
+    while ((opt = getopt_long(argc, argv, "j:c:q:vQNST:RLIVW:P:B:XF:G:C:D:AEZ:M:O:Y:K:UHnh", long_options, nullptr)) != -1) {
         switch (opt) {
             case 'j':
                 cfg.num_workers = std::atoi(optarg);
+                cfg.jobs_set = true;
                 if (cfg.num_workers <= 0) {
                     fmt::print(stderr, "Error: jobs must be positive\n");
                     return 1;
@@ -661,6 +1988,110 @@ int main(int argc, char* argv[]) {
             case 'S':
                 cfg.sync_mode = true;
                 break;
+            case 'R':
+                cfg.use_reflink = true;
+                break;
+            case 'L':
+                cfg.use_chain = false;
+                break;
+            case 'I':
+                cfg.incremental = true;
+                break;
+            case 'U':
+                cfg.resume = true;
+                cfg.incremental = true;
+                break;
+            case 'H':
+                cfg.hardlinks = true;
+                break;
+            case 'n':
+                cfg.affinity = true;
+                break;
+            case 'V':
+                cfg.verify = true;
+                break;
+            case 'W': {
+                cfg.verify = true;
+                int n = std::atoi(optarg);
+                if (n < 0) {
+                    fmt::print(stderr, "Error: verify-sample must not be negative\n");
+                    return 1;
+                }
+                cfg.verify_sample = static_cast<uint32_t>(n);
+                break;
+            }
+            case 'P': {
+                long long n = std::atoll(optarg);
+                if (n < 0) {
+                    fmt::print(stderr, "Error: split-size must not be negative\n");
+                    return 1;
+                }
+                cfg.split_size = static_cast<uint64_t>(n);
+                break;
+            }
+            case 'B':
+                cfg.pipeline = std::atoi(optarg);
+                if (cfg.pipeline < 1 || cfg.pipeline > MAX_PIPELINE) {
+                    fmt::print(stderr, "Error: pipeline must be 1-{}\n", MAX_PIPELINE);
+                    return 1;
+                }
+                cfg.pipeline_set = true;
+                break;
+            case 'X':
+                if (cfg.direct_size == 0) cfg.direct_size = DIRECT_MIN_SIZE;
+                break;
+            case 'F': {
+                long long n = std::atoll(optarg);
+                if (n <= 0) {
+                    fmt::print(stderr, "Error: direct-size must be positive\n");
+                    return 1;
+                }
+                cfg.direct_size = static_cast<uint64_t>(n);
+                break;
+            }
+            case 'A':
+                cfg.autotune = true;
+                break;
+            case 'E':
+                cfg.extent_order = true;
+                break;
+            case 'Z': {
+                long long mb = std::atoll(optarg);
+                if (mb <= 0) {
+                    fmt::print(stderr, "Error: max-memory must be positive\n");
+                    return 1;
+                }
+                cfg.max_memory = static_cast<uint64_t>(mb) * 1024 * 1024;
+                break;
+            }
+            case 'M':
+                set_metrics_option("metrics", optarg, cfg.metrics);
+                break;
+            case 'O':
+                set_metrics_option("metrics-stream", optarg, cfg.metrics);
+                break;
+            case 'Y':
+                if (!set_metrics_option("metrics-interval", optarg, cfg.metrics)) return 1;
+                break;
+            case 'K':
+                set_metrics_option("trace", optarg, cfg.metrics);
+                break;
+            case 'G':
+                if (!set_ring_option("ring", optarg, cfg.ring)) return 1;
+                break;
+            case 'C':
+                if (!set_ring_option("sqpoll-cpu", optarg, cfg.ring)) return 1;
+                break;
+            case 'D':
+                if (!set_ring_option("sqpoll-idle", optarg, cfg.ring)) return 1;
+                break;
+            case 'T':
+                cfg.scan_threads = std::atoi(optarg);
+                if (cfg.scan_threads <= 0) {
+                    fmt::print(stderr, "Error: scan-threads must be positive\n");
+                    return 1;
+                }
+                break;
             case 'h':
                 print_usage(argv[0]);
                 return 0;
@@ -684,53 +2115,223 @@ int main(int argc, char* argv[]) {
         cfg.num_workers = 1;
     }
 
+    if (cfg.autotune) choose_engine(cfg);
+
     // ========================================================
-    // Phase 1: Scan files
+    // Phase 1: Start scanning (streams into the work queue)
     // ========================================================
-    fmt::print("Scanning files...\n");
-    auto scan_result = scan_files(cfg.src_path, cfg.dst_path);
-    auto& files = scan_result.files;
+    Stats stats;
+    // Per-worker deques; scanner batches are handed out whole and idle
+    // workers steal from busy ones
+    WorkScheduler<FileWorkItem> work_queue(cfg.num_workers);
+    SizeStats size_stats;
+    std::unique_ptr<DirScanner<WorkScheduler<FileWorkItem>>> scanner;
+
+    // Op metrics: a set per worker, merged by the reports
+    std::unique_ptr<MetricsRegistry> registry;
+    std::unique_ptr<MetricsStreamer> streamer;
+    auto metric_counters = [&stats] {
+        return fmt::format("\"files_total\":{},\"files_completed\":{},\"files_failed\":{},"
+                           "\"bytes_total\":{},\"bytes_copied\":{}",
+                           stats.files_total.load(), stats.files_completed.load(),
+                           stats.files_failed.load(), stats.bytes_total.load(),
+                           stats.bytes_copied.load());
+    };
+    if (cfg.metrics.enabled()) {
+        registry = std::make_unique<MetricsRegistry>(
+            "copy", std::vector<const char*>(std::begin(OP_TYPE_NAMES), std::end(OP_TYPE_NAMES)),
+            !cfg.metrics.trace_path.empty());
+        for (int i = 0; i < cfg.num_workers; i++) {
+            cfg.worker_metrics.push_back(&registry->add(fmt::format("worker {}", i)));
+        }
+        if (!cfg.metrics.stream_target.empty()) {
+            try {
+                streamer = std::make_unique<MetricsStreamer>(*registry, cfg.metrics, metric_counters);
+            } catch (const std::exception& e) {
+                fmt::print(stderr, "Error: {}\n", e.what());
+                return 1;
+            }
+        }
+    }
 
-    // Sort files by inode for sequential disk access (improves network storage performance)
-    // Inode order approximates physical disk allocation order on most filesystems
-    std::sort(files.begin(), files.end(), [](const FileWorkItem& a, const FileWorkItem& b) {
-        return a.inode < b.inode;
-    });
+    struct stat src_st;
+    if (stat(cfg.src_path.c_str(), &src_st) != 0) {
+        fmt::print(stderr, "Error: Cannot access '{}'\n", cfg.src_path);
+        return 1;
+    }
 
-    if (files.empty()) {
-        fmt::print(stderr, "No files to copy\n");
+    // Only the io_uring workers copy segments
+    uint64_t split_size = (cfg.sync_mode || cfg.use_reflink) ? 0 : cfg.split_size;
+
+    // --hardlinks links names to their first copy only if it succeeded
+    FailedCopies failed_copies;
+    if (cfg.hardlinks) cfg.failed_copies = &failed_copies;
+
+    // --resume journals split files by segment; the journal sits next to
+    // the destination, so in directory mode it opens once that exists
+    CheckpointJournal journal;
+    auto open_journal = [&cfg, &journal, split_size]() -> bool {
+        if (!cfg.resume) return true;
+        if (split_size == 0) {
+            fmt::print(stderr, "Warning: --resume needs split files; not used with --sync, "
+                               "--reflink or --split-size 0\n");
+            return true;
+        }
+        std::string error;
+        if (!journal.open(cfg.dst_path, error)) {
+            fmt::print(stderr, "Error: resume journal: {}\n", error);
+            return false;
+        }
+        cfg.journal = &journal;
+        return true;
+    };
+
+    fmt::print("Scanning files...\n");
+    if (S_ISREG(src_st.st_mode)) {
+        struct stat dst_st;
+        if (cfg.incremental && stat(cfg.dst_path.c_str(), &dst_st) == 0 &&
+            S_ISREG(dst_st.st_mode) && dst_st.st_size == src_st.st_size &&
+            dst_st.st_mtim.tv_sec == src_st.st_mtim.tv_sec &&
+            dst_st.st_mtim.tv_nsec == src_st.st_mtim.tv_nsec) {
+            fmt::print("Up to date: '{}' is unchanged\n", cfg.dst_path);
+            return 0;
+        }
+        if (!open_journal()) return 1;
+        size_stats.observe(src_st.st_size);
+        stats.files_total = 1;
+        std::vector<FileWorkItem> items;
+        uint64_t resumed = append_split(items, {cfg.src_path, cfg.dst_path, src_st.st_ino,
+                                                (uint64_t)src_st.st_size, src_st.st_mode,
+                                                cfg.incremental ? src_st.st_mtim
+                                                                : timespec{0, UTIME_OMIT}},
+                                        split_size, cfg.journal);
+        if (resumed > 0) {
+            stats.files_resumed = 1;
+            stats.bytes_resumed = resumed;
+        }
+        work_queue.push_bulk(items);
+        work_queue.set_done();
+    } else if (S_ISDIR(src_st.st_mode)) {
+        std::error_code ec;
+        fs::create_directories(cfg.dst_path, ec);
+        if (ec) {
+            fmt::print(stderr, "Filesystem error: {}\n", ec.message());
+            return 1;
+        }
+        if (!open_journal()) return 1;
+
+        ScanOptions scan_opts;
+        scan_opts.threads = cfg.scan_threads;
+        scan_opts.verbose = cfg.verbose;
+        // Only splitting needs sizes at scan time (stat runs in scanner
+        // threads); without them small-file chains statx on the ring
+        scan_opts.stat_files = split_size > 0 && !cfg.sync_mode;
+        scan_opts.split_size = split_size;
+        scan_opts.skip_unchanged = cfg.incremental;
+        scan_opts.extent_order = cfg.extent_order;
+        scan_opts.journal = cfg.journal;
+        scan_opts.hardlinks = cfg.hardlinks;
+        scanner = std::make_unique<DirScanner<WorkScheduler<FileWorkItem>>>(
+            cfg.src_path, cfg.dst_path, work_queue, stats, scan_opts);
+        scanner->start();
+
+        // Only the first files are needed to pick a chunk size; the rest of
+        // the walk continues while workers copy
+        scanner->wait_for_samples();
+        size_stats = scanner->size_stats();
+
+        if (scanner->finished() && stats.files_total == 0 && scanner->links_found() == 0) {
+            if (stats.files_skipped > 0) {
+                fmt::print("Up to date: {} files unchanged\n", stats.files_skipped.load());
+                return scanner->errors() > 0 ? 1 : 0;
+            }
+            fmt::print(stderr, "No files to copy\n");
+            return 1;
+        }
+    } else {
+        fmt::print(stderr, "Error: '{}' is not a file or directory\n", cfg.src_path);
         return 1;
     }
 
     // ========================================================
-    // Phase 1.5: Auto-tune chunk size based on file size distribution
+    // Phase 2: Auto-tune chunk size based on file size distribution
     // ========================================================
-    if (!cfg.chunk_size_set && !scan_result.size_stats.samples.empty()) {
-        cfg.chunk_size = scan_result.size_stats.pick_chunk_size();
+    if (!cfg.chunk_size_set && !size_stats.samples.empty()) {
+        cfg.chunk_size = size_stats.pick_chunk_size();
         if (cfg.verbose) {
             fmt::print("Auto-tuned chunk size based on file distribution:\n");
-            scan_result.size_stats.print_summary();
+            size_stats.print_summary();
             fmt::print("  Selected chunk_size: {} bytes\n", cfg.chunk_size);
         }
     }
 
+    // O_DIRECT moves whole chunks, so they must be block-aligned. Without
+    // the page cache's readahead every file keeps all its pipeline buffers.
+    if (cfg.direct_size != 0) {
+        if (cfg.sync_mode || !direct_aligned(cfg.chunk_size)) {
+            fmt::print(stderr, "Warning: --direct needs the io_uring engine and a chunk size "
+                               "that is a multiple of {}; not used\n", DIRECT_ALIGN);
+            cfg.direct_size = 0;
+        } else if (!cfg.pipeline_set) {
+            cfg.pipeline = MAX_PIPELINE;
+        }
+    }
+
+    // The controller starts from the picked chunk. Chunk trials need a
+    // larger buffer stride, and --verify's CRCs are indexed by chunk size,
+    // so -c or --verify pin it.
+    TuneKnobs knobs;
+    std::unique_ptr<AutoTuner> tuner;
+    if (cfg.autotune && !cfg.sync_mode) {
+        uint32_t chunk = cfg.chunk_size;
+        uint32_t max_chunk = 0;
+        if (!cfg.chunk_size_set && !cfg.verify) {
+            max_chunk = autotune_max_chunk(cfg);
+            cfg.chunk_size = max_chunk;
+        }
+        tuner = std::make_unique<AutoTuner>(cfg.num_workers, cfg.queue_depth, chunk, max_chunk);
+        knobs.depth = tuner->depth();
+        knobs.chunk = tuner->chunk();
+        cfg.tune = &knobs;
+    }
+
     if (cfg.sync_mode) {
-        fmt::print("Found {} files, using {} workers (SYNC mode)\n",
-                   files.size(), cfg.num_workers);
+        fmt::print("Copying with {} workers (SYNC mode)\n", cfg.num_workers);
     } else {
-        fmt::print("Found {} files, using {} workers (queue_depth={}, chunk_size={})\n",
-                   files.size(), cfg.num_workers, cfg.queue_depth, cfg.chunk_size);
+        resolve_ring_profile(cfg.ring);
+        fmt::print("Copying with {} workers (queue_depth={}, chunk_size={})\n",
+                   cfg.num_workers, cfg.queue_depth, io_chunk(cfg));
+        if (cfg.ring.profile != RingProfile::DEFAULT) {
+            fmt::print("Ring profile: {}\n", ring_profile_name(cfg.ring.profile));
+        }
+        if (tuner) {
+            fmt::print("Autotune: depth {} of {} per worker, chunk {} of up to {}\n",
+                       tuner->depth(), cfg.queue_depth, format_bytes(tuner->chunk()),
+                       format_bytes(cfg.chunk_size));
+        }
     }
 
-    // ========================================================
-    // Phase 2: Initialize
-    // ========================================================
-    Stats stats;
-    stats.files_total = files.size();
-
-    WorkQueue<FileWorkItem> work_queue;
-    work_queue.push_bulk(files);
-    work_queue.set_done();
+    // Workers go to the node of the source's device, where reads complete;
+    // a source that can't be placed (tmpfs, NFS) defers to the destination
+    if (cfg.affinity) {
+        const char* side = "source";
+        int node = path_node(cfg.src_path);
+        if (node < 0) {
+            side = "destination";
+            node = path_node(cfg.dst_path);
+        }
+        bool sqpoll = !cfg.sync_mode && cfg.ring.profile == RingProfile::SQPOLL &&
+                      cfg.ring.sqpoll_cpu < 0;
+        cfg.placement = plan_placement(node, placement_cpus(node), cfg.num_workers, sqpoll);
+        std::string cpus = format_cpu_list(cfg.placement.cpus);
+        if (node >= 0) {
+            fmt::print("Affinity: node {} ({} device), workers pinned over CPUs {}{}\n", node,
+                       side, cpus, sqpoll ? ", SQPOLL threads beside them" : "");
+        } else {
+            fmt::print("Affinity: device node unknown, workers pinned over CPUs {}{}\n", cpus,
+                       sqpoll ? ", SQPOLL threads beside them" : "");
+        }
+    }
 
     // ========================================================
     // Phase 3: Start workers
@@ -749,16 +2350,22 @@ int main(int argc, char* argv[]) {
                                 std::ref(stats), std::ref(cfg));
         }
     }
+    // Workers drain the queue from here on, so the scan may wait for them
+    work_queue.set_limits(MAX_QUEUED_ITEMS, cfg.max_memory);
 
     // ========================================================
-    // Phase 4: Progress monitoring (main thread)
+    // Phase 4: Progress monitoring and autotune (main thread)
     // ========================================================
-    if (cfg.quiet) {
+    if (cfg.quiet && !tuner) {
         // Just wait for completion without progress output
         for (auto& t : workers) {
             t.join();
         }
     } else {
+        // Each tick is a controller window
+        auto tick_start = start_time;
+        uint64_t tick_bytes = 0, tick_ops = 0;
+        uint32_t tick_in_flight = 0;
         while (true) {
             std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
@@ -772,6 +2379,30 @@ int main(int argc, char* argv[]) {
                 break;
             }
 
+            if (tuner) {
+                auto now = std::chrono::steady_clock::now();
+                uint64_t ops = stats.ops_completed.load();
+                uint32_t in_flight = stats.files_in_flight.load();
+                TuneWindow window;
+                window.bytes = bytes - tick_bytes;
+                window.ops = ops - tick_ops;
+                window.in_flight = (tick_in_flight + in_flight) / 2.0;
+                window.seconds = std::chrono::duration<double>(now - tick_start).count();
+                tuner->update(window);
+                if (cfg.verbose && (tuner->depth() != knobs.depth || tuner->chunk() != knobs.chunk)) {
+                    fmt::print("\nAutotune: depth {}, chunk {} ({:.0f} MB/s, latency floor {:.0f} us)\n",
+                               tuner->depth(), format_bytes(tuner->chunk()),
+                               window.bytes / window.seconds / 1e6, tuner->latency_floor() * 1e6);
+                }
+                knobs.depth.store(tuner->depth(), std::memory_order_relaxed);
+                knobs.chunk.store(tuner->chunk(), std::memory_order_relaxed);
+                tick_start = now;
+                tick_bytes = bytes;
+                tick_ops = ops;
+                tick_in_flight = in_flight;
+            }
+            if (cfg.quiet) continue;
+
             double pct = bytes_total > 0 ? (100.0 * bytes / bytes_total) : 0;
             fmt::print("\rProgress: {}/{} files, {}/{} bytes ({:.1f}%)     ",
                       completed, total, bytes, bytes_total, pct);
@@ -782,11 +2413,16 @@ int main(int argc, char* argv[]) {
     // ========================================================
     // Phase 5: Wait for workers (skip if already joined in quiet mode)
     // ========================================================
-    if (!cfg.quiet) {
+    if (!cfg.quiet || tuner) {
         for (auto& t : workers) {
             t.join();
         }
     }
+    if (scanner) {
+        scanner->join();
+        make_links(scanner->take_links(), stats, cfg);
+    }
+    if (streamer) streamer->stop();
 
     auto end_time = std::chrono::steady_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
@@ -800,15 +2436,67 @@ int main(int argc, char* argv[]) {
     double bytes_per_sec = seconds > 0 ? bytes_copied / seconds : 0;
     double files_per_sec = seconds > 0 ? files_completed / seconds : 0;
 
+    if (stats.files_total == 0 && stats.files_skipped == 0 && stats.files_linked == 0) {
+        fmt::print(stderr, "No files to copy\n");
+        return 1;
+    }
+
     fmt::print("Completed: {} files, {} in {:.2f}s\n",
                files_completed, format_bytes(bytes_copied), seconds);
+    if (cfg.incremental) {
+        fmt::print("Skipped: {} unchanged files\n", stats.files_skipped.load());
+    }
+    if (stats.files_resumed > 0) {
+        fmt::print("Resumed: {} files, {} already copied\n", stats.files_resumed.load(),
+                   format_bytes(stats.bytes_resumed.load()));
+    }
+    if (stats.files_linked > 0) {
+        fmt::print("Hardlinks: {} recreated\n", stats.files_linked.load());
+    }
+    if (stats.files_direct > 0) {
+        fmt::print("Direct I/O: {} files bypassed the page cache\n", stats.files_direct.load());
+    }
+    if (stats.bytes_sparse > 0) {
+        fmt::print("Sparse: {} of holes left unwritten\n", format_bytes(stats.bytes_sparse.load()));
+    }
     fmt::print("Throughput: {}, {:.0f} files/s\n",
                format_throughput(bytes_per_sec), files_per_sec);
+    if (cfg.verbose) {
+        fmt::print("Work steals: {}\n", work_queue.steals());
+        fmt::print("Scan waits on a full queue: {}\n", work_queue.throttled());
+    }
+    if (scanner && cfg.extent_order) {
+        if (scanner->fiemap_supported()) {
+            fmt::print("Extent order: {} of {} files placed by physical address\n",
+                       scanner->extents_mapped(), scanner->files_found());
+        } else {
+            fmt::print("Extent order: source filesystem has no FIEMAP, used inode order\n");
+        }
+    }
+    if (tuner) {
+        fmt::print("Autotune: settled at depth {} per worker, chunk {}\n",
+                   tuner->depth(), format_bytes(tuner->chunk()));
+    }
+
+    if (cfg.verify) {
+        fmt::print("Verified: {} files\n", stats.files_verified.load());
+    }
+    bool reports_ok = !registry || write_metrics_reports(*registry, cfg.metrics, metric_counters());
 
     if (stats.files_failed > 0) {
         fmt::print("Failed: {} files\n", stats.files_failed.load());
         return 1;
     }
 
-    return 0;
+    if (stats.files_mismatched > 0) {
+        fmt::print("Verify failed: {} files\n", stats.files_mismatched.load());
+        return 1;
+    }
+
+    if (scanner && scanner->errors() > 0) {
+        fmt::print("Scan errors: {} entries skipped\n", scanner->errors());
+        return 1;
+    }
+
+    return reports_ok ? 0 : 1;
 }
@@ -12,12 +12,16 @@
 
 #include <cstring>
 #include <filesystem>
+#include <memory>
 #include <vector>
 #include <string>
 
 #include <fmt/core.h>
 #include "protocol.hpp"
+#include "checksum.hpp"
+#include "compress.hpp"
 #include "ktls.hpp"
+#include "manifest.hpp"
 
 // Global flag to enable/disable splice (for benchmarking)
 // Default: false - benchmarks show read/send is 2.5x faster than splice for small files
@@ -108,24 +112,41 @@ static bool splice_to_socket(int pipe_read_fd, int sockfd, size_t len) {
     return true;
 }
 
-static bool send_file(int sockfd, const std::string& base_path,
-                      const std::string& rel_path, char* buffer, size_t buf_size,
-                      int pipe_read_fd, int pipe_write_fd) {
-    std::string full_path = base_path + "/" + rel_path;
+// Send the batch built so far (if any) and start a new one in the same buffer
+static bool flush_batch(int sockfd, protocol::BatchBuilder& batch, std::vector<uint8_t>& buf) {
+    if (batch.empty()) return true;
+    size_t len = batch.finish();
+    batch.reset(buf.data(), buf.size());
+    return send_all(sockfd, buf.data(), len);
+}
 
-    // Open and stat file
-    int fd = open(full_path.c_str(), O_RDONLY);
-    if (fd < 0) {
-        fmt::print(stderr, "Failed to open {}: {}\n", full_path, strerror(errno));
+// Read a small file straight into its FILE_BATCH entry (takes ownership of fd)
+static bool batch_file(int sockfd, int fd, const struct stat& st, const std::string& rel_path,
+                       protocol::BatchBuilder& batch, std::vector<uint8_t>& buf) {
+    if (!batch.fits(rel_path.size(), st.st_size) && !flush_batch(sockfd, batch, buf)) {
+        close(fd);
         return false;
     }
 
-    struct stat st;
-    if (fstat(fd, &st) < 0) {
-        close(fd);
-        return false;
+    uint8_t* data = batch.add(st.st_size, st.st_mode & 0777, rel_path);
+    size_t got = 0;
+    while (got < (size_t)st.st_size) {
+        ssize_t n = read(fd, data + got, st.st_size - got);
+        if (n <= 0) {
+            // The entry already promised st_size bytes
+            close(fd);
+            return false;
+        }
+        got += n;
     }
+    close(fd);
+    return true;
+}
 
+// Send FILE_HDR + raw data (takes ownership of fd)
+static bool send_file(int sockfd, int fd, const struct stat& st,
+                      const std::string& rel_path, char* buffer, size_t buf_size,
+                      int pipe_read_fd, int pipe_write_fd) {
     // Send FILE_HDR
     auto hdr = protocol::make_file_hdr(st.st_size, st.st_mode & 0777, rel_path);
     if (!send_msg(sockfd, hdr)) {
@@ -205,7 +226,7 @@ static void collect_files(const std::string& base_path, const std::string& rel_p
 
 int run_sender(const std::string& src_path, const std::string& host,
                uint16_t port, const std::string& secret, bool use_splice,
-               bool use_tls) {
+               bool use_tls, bool file_batch) {
     g_use_splice = use_splice;
 
     fmt::print("Connecting to {}:{}...\n", host, port);
@@ -268,9 +289,12 @@ int run_sender(const std::string& src_path, const std::string& host,
             return 1;
         }
         memcpy(nonce_receiver, hello_ok.nonce, protocol::NONCE_SIZE);
+        // Older receivers only understand per-file FILE_HDR framing
+        if (hello_ok.version < protocol::BATCH_MIN_VERSION) file_batch = false;
     } else {
         // Old protocol without nonce (shouldn't happen with v2)
         memset(nonce_receiver, 0, protocol::NONCE_SIZE);
+        file_batch = false;
     }
 
     // Enable kTLS if requested
@@ -334,10 +358,34 @@ int run_sender(const std::string& src_path, const std::string& host,
         }
     }
 
+    // Small files are packed into FILE_BATCH frames built in this buffer
+    std::vector<uint8_t> batch_buf(file_batch ? protocol::MAX_BATCH_FRAME : 0);
+    protocol::BatchBuilder batch;
+    batch.reset(batch_buf.data(), batch_buf.size());
+
     size_t sent = 0;
     for (const auto& rel_path : files) {
-        if (!send_file(sockfd, base_path, rel_path, buffer, BUF_SIZE,
-                      pipefd[0], pipefd[1])) {
+        std::string full_path = base_path + "/" + rel_path;
+        bool ok = false;
+
+        int fd = open(full_path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0) {
+            fmt::print(stderr, "Failed to open {}: {}\n", full_path, strerror(errno));
+        } else if (fstat(fd, &st) < 0) {
+            close(fd);
+        } else if (file_batch && (uint64_t)st.st_size <= protocol::MAX_BATCH_FILE_SIZE) {
+            ok = batch_file(sockfd, fd, st, rel_path, batch, batch_buf);
+        } else {
+            // Keep wire order: everything batched so far goes first
+            if (flush_batch(sockfd, batch, batch_buf)) {
+                ok = send_file(sockfd, fd, st, rel_path, buffer, BUF_SIZE, pipefd[0], pipefd[1]);
+            } else {
+                close(fd);
+            }
+        }
+
+        if (!ok) {
             fmt::print(stderr, "Failed to send {}\n", rel_path);
             delete[] buffer;
             if (pipefd[0] >= 0) { close(pipefd[0]); close(pipefd[1]); }
@@ -355,6 +403,12 @@ int run_sender(const std::string& src_path, const std::string& host,
     delete[] buffer;
     if (pipefd[0] >= 0) { close(pipefd[0]); close(pipefd[1]); }
 
+    if (!flush_batch(sockfd, batch, batch_buf)) {
+        fmt::print(stderr, "Failed to send file batch\n");
+        close(sockfd);
+        return 1;
+    }
+
     // Send ALL_DONE
     if (!send_msg(sockfd, protocol::make_all_done())) {
         fmt::print(stderr, "Failed to send ALL_DONE\n");
@@ -417,6 +471,110 @@ static int create_listen_socket(uint16_t port) {
     return sockfd;
 }
 
+// Write every file of a FILE_BATCH payload (parsed as a whole first)
+static bool receive_batch(const std::string& dst_root, const uint8_t* payload, size_t len,
+                          std::vector<protocol::BatchEntry>& entries, bool with_mtime,
+                          bool with_crc, size_t& files_received) {
+    if (!protocol::parse_file_batch(payload, len, entries, with_mtime, with_crc)) {
+        fmt::print(stderr, "Invalid FILE_BATCH\n");
+        return false;
+    }
+
+    for (const auto& entry : entries) {
+        if (!protocol::is_safe_path(entry.path)) {
+            fmt::print(stderr, "Unsafe path rejected: {}\n", entry.path);
+            return false;
+        }
+
+        std::string file_path = dst_root + "/" + std::string(entry.path);
+        if (with_crc && crc32c(0, entry.data, entry.size) != entry.crc) {
+            fmt::print(stderr, "Checksum mismatch on {}\n", file_path);
+            return false;
+        }
+        fs::create_directories(fs::path(file_path).parent_path());
+
+        int fd = open(file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, entry.mode);
+        if (fd < 0) {
+            fmt::print(stderr, "Failed to create {}: {}\n", file_path, strerror(errno));
+            return false;
+        }
+        bool ok = entry.size == 0 || write(fd, entry.data, entry.size) == (ssize_t)entry.size;
+        if (ok && with_mtime) set_mtime(fd, entry.mtime_ns);
+        close(fd);
+        if (!ok) {
+            fmt::print(stderr, "Write failed\n");
+            return false;
+        }
+
+        files_received++;
+        if (files_received % 1000 == 0) {
+            fmt::print("\rReceived {} files", files_received);
+            fflush(stdout);
+        }
+    }
+    return true;
+}
+
+// Receive one FILE_DATA frame of a compressed session and write its raw
+// bytes to fd. zbuf holds the largest compressed payload, out MAX_FRAME_RAW.
+// The raw bytes are folded into crc when verifying (non-null).
+static bool receive_frame(int sockfd, int fd, uint64_t& remaining, ChunkCodec& codec,
+                          std::vector<uint8_t>& zbuf, char* out, uint32_t* crc) {
+    uint8_t hdr[protocol::DATA_FRAME_HDR_SIZE];
+    if (!recv_all(sockfd, hdr, sizeof(hdr))) return false;
+
+    protocol::MsgType type;
+    uint32_t payload_len;
+    protocol::DataFrame frame;
+    protocol::parse_header(hdr, type, payload_len);
+    if (type != protocol::MsgType::FILE_DATA ||
+        !protocol::parse_data_frame(hdr + protocol::MSG_HEADER_SIZE, payload_len, remaining, frame) ||
+        frame.data_len > zbuf.size()) {
+        fmt::print(stderr, "Bad data frame\n");
+        return false;
+    }
+
+    const char* data = out;
+    if (frame.codec == protocol::Codec::NONE) {
+        if (!recv_all(sockfd, out, frame.raw_len)) return false;
+    } else {
+        if (!recv_all(sockfd, zbuf.data(), frame.data_len)) return false;
+        if (!codec.decompress(frame.codec, zbuf.data(), frame.data_len,
+                              reinterpret_cast<uint8_t*>(out), frame.raw_len)) {
+            fmt::print(stderr, "Corrupt compressed data\n");
+            return false;
+        }
+    }
+
+    if (write(fd, data, frame.raw_len) != (ssize_t)frame.raw_len) {
+        fmt::print(stderr, "Write failed\n");
+        return false;
+    }
+    if (crc) *crc = crc32c(*crc, data, frame.raw_len);
+    remaining -= frame.raw_len;
+    return true;
+}
+
+// FILE_END after a file's data (verify): the sender's CRC must match ours
+static bool receive_file_end(int sockfd, const std::string& file_path, uint32_t crc) {
+    uint8_t msg[protocol::FILE_END_CRC_SIZE];
+    protocol::MsgType type;
+    uint32_t payload_len;
+    if (!recv_all(sockfd, msg, sizeof(msg))) return false;
+    protocol::parse_header(msg, type, payload_len);
+    if (type != protocol::MsgType::FILE_END || payload_len != protocol::CRC_SIZE) {
+        fmt::print(stderr, "Expected FILE_END after {}\n", file_path);
+        return false;
+    }
+    uint32_t expected = protocol::read_u32(msg + protocol::MSG_HEADER_SIZE);
+    if (expected != crc) {
+        fmt::print(stderr, "Checksum mismatch on {}: sent {:08x}, received {:08x}\n",
+                   file_path, expected, crc);
+        return false;
+    }
+    return true;
+}
+
 static bool receive_file(int sockfd, const std::string& dst_root,
                          char* buffer, size_t buf_size) {
     // Already received FILE_HDR header, now get payload
@@ -501,7 +659,16 @@ int run_receiver(const std::string& dst_path, uint16_t port,
     // Verify secret
     if (!secret.empty() && hello.secret != secret) {
         fmt::print(stderr, "Wrong secret\n");
-        send_msg(client_fd, protocol::make_hello_fail(1));
+        send_msg(client_fd, protocol::make_hello_fail(protocol::FAIL_BAD_SECRET));
+        close(client_fd);
+        close(listen_fd);
+        return 1;
+    }
+
+    // Only the io_uring receiver joins multi-stream sessions
+    if (hello.session.count > 1) {
+        fmt::print(stderr, "Multi-stream transfer requires recv --uring\n");
+        send_msg(client_fd, protocol::make_hello_fail(protocol::FAIL_UNSUPPORTED));
         close(client_fd);
         close(listen_fd);
         return 1;
@@ -516,8 +683,15 @@ int run_receiver(const std::string& dst_path, uint16_t port,
         return 1;
     }
 
-    // Send HELLO_OK with our nonce
-    if (!send_msg(client_fd, protocol::make_hello_ok(nonce_receiver))) {
+    // Send HELLO_OK with our nonce, accepting the requested codec and flags.
+    // Deltas, resumes, holes and links are only served by the io_uring receiver.
+    uint8_t flags = hello.flags & protocol::KNOWN_FLAGS &
+                    ~(protocol::FLAG_DELTA | protocol::FLAG_RESUME |
+                      protocol::FLAG_SPARSE | protocol::FLAG_HARDLINKS);
+    bool incremental = (flags & protocol::FLAG_INCREMENTAL) != 0;
+    bool verify = (flags & protocol::FLAG_VERIFY) != 0;
+    if (!send_msg(client_fd, protocol::make_hello_ok(nonce_receiver, protocol::PROTOCOL_VERSION,
+                                                     hello.codec, flags))) {
         close(client_fd);
         close(listen_fd);
         return 1;
@@ -547,12 +721,44 @@ int run_receiver(const std::string& dst_path, uint16_t port,
         fmt::print("kTLS enabled (AES-128-GCM)\n");
     }
 
+    // Incremental: describe what we already have before any file data
+    if (incremental) {
+        std::vector<protocol::ManifestEntry> entries;
+        if (!build_manifest(dst_path, entries)) {
+            fmt::print(stderr, "Failed to scan {} for the manifest\n", dst_path);
+            close(client_fd);
+            close(listen_fd);
+            return 1;
+        }
+        fmt::print("Sending manifest: {} files\n", entries.size());
+        if (!send_manifest(entries, [client_fd](const uint8_t* data, size_t len) {
+                return send_all(client_fd, data, len);
+            })) {
+            close(client_fd);
+            close(listen_fd);
+            return 1;
+        }
+    }
+
     fmt::print("Authenticated. Receiving files...\n");
 
     // Allocate buffer
     constexpr size_t BUF_SIZE = 128 * 1024;
+    static_assert(BUF_SIZE >= protocol::MAX_FRAME_RAW);
     char* buffer = new char[BUF_SIZE];
 
+    // Compressed sessions: codec state and the compressed payload buffer
+    std::unique_ptr<ChunkCodec> codec;
+    std::vector<uint8_t> zbuf;
+    if (hello.codec != protocol::Codec::NONE) {
+        codec = std::make_unique<ChunkCodec>();
+        zbuf.resize(compress_bound(hello.codec, protocol::MAX_FRAME_RAW));
+    }
+
+    // FILE_BATCH payload buffer and entry list, reused across batches
+    std::vector<uint8_t> batch_buf(protocol::MAX_BATCH_FRAME);
+    std::vector<protocol::BatchEntry> batch_entries;
+
     size_t files_received = 0;
     bool error = false;
 
@@ -568,8 +774,18 @@ int run_receiver(const std::string& dst_path, uint16_t port,
             break;
         }
 
+        if (type == protocol::MsgType::FILE_BATCH) {
+            if (payload_len > batch_buf.size() ||
+                !recv_all(client_fd, batch_buf.data(), payload_len) ||
+                !receive_batch(dst_path, batch_buf.data(), payload_len, batch_entries,
+                               incremental, verify, files_received)) {
+                error = true;
+            }
+            continue;
+        }
+
         if (type != protocol::MsgType::FILE_HDR) {
-            fmt::print(stderr, "Expected FILE_HDR or ALL_DONE, got {}\n", static_cast<int>(type));
+            fmt::print(stderr, "Expected FILE_HDR, FILE_BATCH or ALL_DONE, got {}\n", static_cast<int>(type));
             error = true;
             break;
         }
@@ -606,9 +822,18 @@ int run_receiver(const std::string& dst_path, uint16_t port,
             break;
         }
 
-        // Receive exactly hdr.size bytes of file data (no per-chunk headers)
+        // Receive exactly hdr.size bytes of file data: raw, or framed when compressed
         uint64_t remaining = hdr.size;
-        while (remaining > 0) {
+        uint32_t crc = 0;
+        while (codec && remaining > 0) {
+            if (!receive_frame(client_fd, fd, remaining, *codec, zbuf, buffer,
+                               verify ? &crc : nullptr)) {
+                close(fd);
+                error = true;
+                break;
+            }
+        }
+        while (!error && remaining > 0) {
             size_t to_recv = std::min(remaining, (uint64_t)BUF_SIZE);
             if (!recv_all(client_fd, buffer, to_recv)) {
                 fmt::print(stderr, "Failed to receive file data\n");
@@ -624,10 +849,19 @@ int run_receiver(const std::string& dst_path, uint16_t port,
                 error = true;
                 break;
             }
+            if (verify) crc = crc32c(crc, buffer, to_recv);
             remaining -= to_recv;
         }
 
+        // A copy that doesn't match is not kept
+        if (!error && verify && !receive_file_end(client_fd, file_path, crc)) {
+            close(fd);
+            unlink(file_path.c_str());
+            error = true;
+        }
+
         if (!error) {
+            if (hdr.has_mtime) set_mtime(fd, hdr.mtime_ns);
             close(fd);
             files_received++;
 
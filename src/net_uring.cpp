@@ -4,21 +4,53 @@
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/signalfd.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <dirent.h>
 #include <liburing.h>
 
+#include <poll.h>
+
+#include <array>
 #include <cstring>
 #include <filesystem>
 #include <vector>
+#include <deque>
 #include <string>
 #include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <fmt/core.h>
 #include "protocol.hpp"
+#include "affinity.hpp"
+#include "checksum.hpp"
 #include "common.hpp"
+#include "compress.hpp"
+#include "ktls.hpp"
+#include "manifest.hpp"
+#include "delta.hpp"
+#include "ring.hpp"
+#include "extent.hpp"
+#include "metrics.hpp"
+#include "daemon.hpp"
+#include "disk_ops.hpp"
+#include "file_list.hpp"
+#include "journal.hpp"
+#include "utils.hpp"
 
 namespace fs = std::filesystem;
 
@@ -29,41 +61,192 @@ struct NetConfig {
     size_t queue_depth = 64;       // Files in-flight
     size_t chunk_size = 128 * 1024;  // 128KB chunks
     bool verbose = false;
+    bool progress = true;          // Per-stream progress lines (off for multi-stream)
+    bool zero_copy = false;        // SEND_ZC on send, provided buffer ring on recv
+    bool file_batch = false;       // Peer accepts FILE_BATCH (protocol v4)
+    protocol::Codec compress = protocol::Codec::NONE;  // Negotiated codec (v5): data is framed
+    bool incremental = false;      // Incremental session (v6): headers carry mtimes
+    bool verify = false;           // Verified session (v8): files end with a CRC32C
+    bool sparse = false;           // Sparse session (v10): holes go as FILE_HOLE
+    bool hardlinks = false;        // Hardlinked names go as FILE_LINK (v10)
+    RingSetup ring;                // Ring profile (see ring.hpp), already probed
+    unsigned ring_index = 0;       // Stream number, spreads pinned SQPOLL threads
+    unsigned write_workers = 0;    // Receiver disk workers per stream (0 = the stream's ring writes)
+    uint64_t direct_size = 0;      // Receiver writes files this large with O_DIRECT (0 = off)
+    bool reusable = false;         // Receiver buffers for any codec, reset() between connections
+    bool affinity = false;         // Pools are first touched by the (pinned) constructing thread
+    CheckpointJournal* journal = nullptr;  // Resumed session (v9): receiver checkpoints here
+    WorkerMetrics* metrics = nullptr;  // This stream's op timing (--metrics, --trace)
 };
 
 // ============================================================
-// Sender State Machine
+// Completion Tags
+// ============================================================
+// Several ops per file are in flight at once (chunk reads/writes, a send
+// chain), so user_data names the op and an index - file slot, chunk or
+// stream sequence number - instead of a context pointer.
+
+static constexpr uint64_t TAG_INDEX_MASK = (1ULL << 56) - 1;
+
+template<typename Op>
+inline uint64_t make_tag(Op op, uint64_t index) {
+    return (static_cast<uint64_t>(op) << 56) | (index & TAG_INDEX_MASK);
+}
+
+template<typename Op>
+inline Op tag_op(uint64_t tag) {
+    return static_cast<Op>(tag >> 56);
+}
+
+inline uint64_t tag_index(uint64_t tag) {
+    return tag & TAG_INDEX_MASK;
+}
+
+// ============================================================
+// Op Timing (--metrics, --trace)
 // ============================================================
+// Tags are unique among the ops in flight, so the preparation time is kept
+// by tag. A multishot CQE (F_MORE) is timed from the one before it; the
+// SEND_ZC notification ends the op without being timed again.
+
+class OpClock {
+public:
+    void start(uint64_t tag) { started_[tag] = now_ns(); }
+
+    template<typename Op>
+    void finish(uint64_t tag, uint32_t flags, WorkerMetrics& metrics) {
+        auto it = started_.find(tag);
+        if (it == started_.end()) return;
+        uint64_t now = now_ns();
+        if (!(flags & IORING_CQE_F_NOTIF)) {
+            metrics.record(static_cast<size_t>(tag_op<Op>(tag)), it->second, now);
+        }
+        if (flags & IORING_CQE_F_MORE) {
+            it->second = now;
+        } else {
+            started_.erase(it);
+        }
+    }
+
+private:
+    std::unordered_map<uint64_t, uint64_t> started_;
+};
+
+static bool uring_supports_op(int opcode) {
+    struct io_uring_probe* probe = io_uring_get_probe();
+    if (!probe) return false;
+    bool ok = io_uring_opcode_supported(probe, opcode);
+    io_uring_free_probe(probe);
+    return ok;
+}
+
+// Get an SQE, flushing the SQ once if it is full
+static struct io_uring_sqe* get_net_sqe(struct io_uring* ring) {
+    struct io_uring_sqe* sqe = io_uring_get_sqe(ring);
+    if (!sqe) {
+        ring_reserve(ring, 1);
+        sqe = io_uring_get_sqe(ring);
+    }
+    return sqe;
+}
 
-enum class SendState {
+// ============================================================
+// Sender State Machine
+// ============================================================
+// Files are opened and stat'ed ahead, then read chunk by chunk in stream
+// order into pool buffers. Every header and chunk becomes a SendSegment in
+// a FIFO that mirrors the bytes on the wire. When nothing is being sent,
+// the ready prefix of the FIFO goes out as one IOSQE_IO_LINK chain of
+// sends, so reads keep filling buffers while the socket drains.
+//
+// With file_batch, consecutive small files are packed into one FILE_BATCH
+// segment instead: entry headers are written in place in a pool buffer and
+// each file is read straight into its entry.
+//
+// With compression, each chunk is read behind room for a FILE_DATA frame
+// header and handed to the shared CompressPool; the segment becomes ready
+// when its job comes back over the sink's eventfd. A chunk that doesn't
+// shrink enough is framed raw, and the rest of its file skips compression.
+//
+// With sparse, a file with holes goes as FILE_SPARSE: its data runs are
+// framed (raw unless compressing) and each hole is one FILE_HOLE segment
+// that never touches a buffer. The last byte is always sent as data.
+
+enum class SendState : uint8_t {
     PENDING,        // Waiting to start
     OPENING,        // openat submitted
     STATING,        // statx submitted
     READY,          // File opened & stated, waiting for turn to send
-    READING,        // read submitted
-    CLOSING,        // close submitted
+    STREAMING,      // Header queued, chunk reads being issued
+    CLOSING,        // Last chunk read, close submitted
     DONE,           // Complete
     FAILED          // Error
 };
 
-// Forward declare
-enum class SendOp : uint8_t;
-
 struct SendContext {
     std::string src_path;
     std::string rel_path;
     SendState state = SendState::PENDING;
-    SendOp current_op;  // Current operation type for user_data lookup
 
     int fd = -1;
-    struct statx stx;
+    struct statx stx{};
     uint64_t file_size = 0;
-    uint64_t offset = 0;
+    uint64_t offset = 0;            // Next byte to read
+    int64_t mtime_ns = 0;           // From the scan; matched against the manifest
+    uint64_t resume = 0;            // Bytes the receiver already has (--resume)
+
+    // Sparse: data runs (offset, length), the one being read, and the
+    // holes between them go as FILE_HOLEs
+    bool sparse = false;
+    std::vector<std::pair<uint64_t, uint64_t>> runs;
+    size_t run_index = 0;
+
+    std::vector<uint8_t> hdr{};     // FILE_HDR bytes, live until sent
+    uint8_t* batch_data = nullptr;  // Entry data inside a FILE_BATCH segment
+    uint64_t batch_seq = 0;
+    bool compress_off = false;      // Data didn't compress; frame the rest raw
+    bool closed = false;            // close completed
+    bool sent = false;              // Last segment is on the wire
+
+    // Verify: CRC of the chunks folded so far, and the FILE_END carrying it
+    uint32_t crc = 0;
+    std::array<uint8_t, protocol::FILE_END_CRC_SIZE> end{};
+};
 
-    char* buffer = nullptr;
-    size_t buf_size = 0;
-    size_t buffer_idx = 0;  // Which buffer this context is using
-    ssize_t last_read = 0;
+inline int64_t stx_mtime_ns(const struct statx& stx) {
+    return static_cast<int64_t>(stx.stx_mtime.tv_sec) * 1000000000LL + stx.stx_mtime.tv_nsec;
+}
+
+// One piece of the outgoing byte stream, in wire order
+struct SendSegment {
+    uint64_t seq = 0;
+    SendContext* file = nullptr;    // nullptr for ALL_DONE and FILE_BATCH
+    uint8_t* data = nullptr;
+    uint32_t len = 0;
+    uint32_t filled = 0;            // Bytes read so far
+    uint32_t sent = 0;              // Bytes sent so far
+    uint64_t file_offset = 0;
+    int buffer_idx = -1;            // Pool buffer (data chunks only)
+    int zbuf_idx = -1;              // Compressed copy being sent instead
+    bool ready = false;             // Fully read, may be sent
+    bool last = false;              // Last segment of its file
+
+    // FILE_HOLE: the message lives here (the deque never moves segments)
+    uint64_t hole = 0;
+    std::array<uint8_t, protocol::DATA_FRAME_HDR_SIZE> hole_msg{};
+
+    // Verify: a chunk's CRC over its raw bytes (before compression), folded
+    // into the file's in wire order; FILE_END is ready once all are
+    uint32_t crc = 0;
+    uint32_t crc_len = 0;           // Raw bytes covered (data chunks only)
+    bool crc_done = false;
+    bool file_end = false;
+
+    // FILE_BATCH: files [batch_first, batch_end) in stream order, minus failed ones
+    bool batch = false;
+    uint16_t reads_pending = 0;
+    size_t batch_first = 0;
+    size_t batch_end = 0;
 };
 
 // Operation types for user_data identification
@@ -71,22 +254,22 @@ enum class SendOp : uint8_t {
     OPEN,
     STATX,
     READ,
+    BATCH_READ,     // Index is the file
     SEND,
-    CLOSE
+    SEND_ZC,        // Index is the pool buffer (notifications carry no seq)
+    CLOSE,
+    WAKE            // Compression sink's eventfd
 };
 
-// Store op in context and use raw pointer as user_data (avoids alignment issues)
-inline uint64_t make_user_data(SendContext* ctx, SendOp op) {
-    ctx->current_op = op;
-    return reinterpret_cast<uint64_t>(ctx);
-}
+static const std::vector<const char*> SEND_OP_NAMES = {
+    "open", "statx", "read", "batch_read", "send", "send_zc", "close", "wake"};
 
-inline SendContext* get_context(uint64_t user_data) {
-    return reinterpret_cast<SendContext*>(user_data);
-}
+// Sends linked into one chain; later segments wait for the next chain
+static constexpr size_t MAX_LINKED_SENDS = 16;
 
-inline SendOp get_op(SendContext* ctx) {
-    return ctx->current_op;
+// Keep a compressed chunk only if it saves at least 1/8
+static bool worth_compressing(size_t raw_len, size_t out_len) {
+    return out_len > 0 && out_len <= raw_len - raw_len / 8;
 }
 
 // ============================================================
@@ -95,33 +278,91 @@ inline SendOp get_op(SendContext* ctx) {
 
 class AsyncSender {
 public:
-    AsyncSender(int sockfd, const std::string& base_path, const NetConfig& cfg)
-        : sockfd_(sockfd), base_path_(base_path), cfg_(cfg) {
+    // Sends files [first, end) of the list, which must outlive the sender.
+    // compressor is required when cfg.compress is set; compress_threads is
+    // this stream's share of its workers (for the level controller)
+    AsyncSender(int sockfd, const FileList& list, size_t first, size_t end, const NetConfig& cfg,
+                CompressPool* compressor = nullptr, double compress_threads = 1.0)
+        : sockfd_(sockfd), cfg_(cfg), list_(list), first_(first), count_(end - first),
+          window_(std::clamp<size_t>(count_, 1, window_size(cfg.queue_depth))),
+          framed_(cfg.compress != protocol::Codec::NONE),
+          read_size_(framed_ ? std::min<size_t>(cfg.chunk_size, protocol::MAX_FRAME_RAW)
+                             : cfg.chunk_size),
+          buffer_pool_(cfg.queue_depth, read_size_ + frame_room()),
+          all_done_(protocol::make_all_done()),
+          compressor_(compressor),
+          zbuf_pool_(framed_ ? cfg.queue_depth : 0,
+                     frame_room() + (framed_ ? compress_bound(cfg.compress, read_size_) : 0)),
+          level_(cfg.compress, compress_threads) {
+
+        if (framed_) {
+            if (!compressor_) throw std::runtime_error("Compression needs a CompressPool");
+            sink_ = std::make_unique<CompressSink>();
+        }
 
         // Initialize io_uring
-        struct io_uring_params params = {};
-        if (io_uring_queue_init_params(cfg.queue_depth * 4, &ring_, &params) < 0) {
+        if (ring_init(cfg.queue_depth * 4, &ring_, cfg.ring, cfg.ring_index) < 0) {
             throw std::runtime_error("Failed to init io_uring");
         }
-
-        // Allocate buffers and initialize free list
-        buffers_.resize(cfg.queue_depth);
-        for (size_t i = 0; i < cfg.queue_depth; i++) {
-            buffers_[i].resize(cfg.chunk_size);
-            free_buffers_.push_back(i);
+        if (cfg.affinity) {
+            buffer_pool_.touch();
+            zbuf_pool_.touch();
         }
+
+        zc_notifs_.assign(buffer_pool_.count(), 0);
+        zc_retired_.assign(buffer_pool_.count(), 0);
     }
 
     ~AsyncSender() {
         io_uring_queue_exit(&ring_);
+        for (auto& ctx : window_) {
+            if (ctx.fd >= 0) close(ctx.fd);
+        }
+
+        // Workers still hold pointers into our buffers and the sink
+        while (jobs_pending_ > 0) {
+            sink_->drain(done_jobs_);
+            jobs_pending_ -= done_jobs_.size();
+            uint64_t count;
+            if (jobs_pending_ > 0 && read(sink_->fd(), &count, sizeof(count)) < 0) break;
+        }
     }
 
-    bool scan_files() {
+    // Collect regular files under base_path (or base_path itself), inode-sorted,
+    // or by first physical extent with extent_order (see extent.hpp).
+    // size is filled from stat() for sharding; statx refreshes it later.
+    // With hardlinks, later names of a file become links (FileList::add_link).
+    static bool scan_files(const std::string& base_path, FileList& files,
+                           bool extent_order = false, bool hardlinks = false) {
+        InodeMap inodes;
+        InodeMap* seen = hardlinks ? &inodes : nullptr;
         try {
-            for (const auto& entry : fs::recursive_directory_iterator(base_path_)) {
-                if (entry.is_regular_file()) {
-                    std::string rel = fs::relative(entry.path(), base_path_).string();
-                    files_.push_back({entry.path().string(), rel, SendState::PENDING});
+            if (fs::is_regular_file(base_path)) {
+                fs::path path(base_path);
+                files.reset(path.has_parent_path() ? path.parent_path().string() : ".");
+                add_scanned(files, 0, path.filename().string(), base_path, extent_order, seen);
+            } else {
+                files.reset(base_path);
+                // Depth first: only directories waiting on the stack hold full paths
+                std::vector<std::pair<uint32_t, std::string>> dirs = {{0, base_path}};
+                while (!dirs.empty()) {
+                    auto [dir, path] = std::move(dirs.back());
+                    dirs.pop_back();
+                    for (const auto& entry : fs::directory_iterator(path)) {
+                        std::string name = entry.path().filename().string();
+                        if (!entry.is_symlink() && entry.is_directory()) {
+                            uint32_t sub = files.add_dir(dir, name);
+                            if (sub == FileList::TOO_DEEP) {
+                                fmt::print(stderr, "Scan error: {}: more than {} directory levels\n",
+                                           entry.path().string(), FileList::MAX_DEPTH);
+                                return false;
+                            }
+                            dirs.push_back({sub, entry.path().string()});
+                        } else if (entry.is_regular_file()) {
+                            add_scanned(files, dir, name, entry.path().string(), extent_order,
+                                        seen);
+                        }
+                    }
                 }
             }
         } catch (const fs::filesystem_error& e) {
@@ -129,819 +370,3992 @@ public:
             return false;
         }
 
-        // Sort by inode for sequential access
-        std::vector<std::pair<ino_t, size_t>> inode_order;
-        for (size_t i = 0; i < files_.size(); i++) {
-            struct stat st;
-            ino_t inode = 0;
-            if (stat(files_[i].src_path.c_str(), &st) == 0) {
-                inode = st.st_ino;
-            }
-            inode_order.push_back({inode, i});
-        }
-        std::sort(inode_order.begin(), inode_order.end());
-
-        std::vector<SendContext> sorted;
-        sorted.reserve(files_.size());
-        for (auto& [inode, idx] : inode_order) {
-            sorted.push_back(std::move(files_[idx]));
-        }
-        files_ = std::move(sorted);
-
+        // Sort by disk position for sequential access
+        files.sort_disk_order();
         return true;
     }
 
-    bool run() {
-        size_t next_to_open = 0;    // Next file to start opening
-        size_t next_to_send = 0;    // Next file to send over network (must be sequential)
-        size_t in_flight = 0;       // Files with pending io_uring ops
-        size_t completed = 0;
-        bool sending_active = false; // True if a file is currently being sent
-
-        fmt::print("Sending {} files...\n", files_.size());
-
-        while (completed < files_.size()) {
-            // Start opening new files (batch opens/stats for prefetch)
-            while (!free_buffers_.empty() && next_to_open < files_.size()) {
-                size_t buf_idx = free_buffers_.back();
-                free_buffers_.pop_back();
-
-                auto& ctx = files_[next_to_open];
-                ctx.buffer = buffers_[buf_idx].data();
-                ctx.buf_size = buffers_[buf_idx].size();
-                ctx.buffer_idx = buf_idx;
-
-                // Submit openat
-                struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
-                if (!sqe) break;
-
-                io_uring_prep_openat(sqe, AT_FDCWD, ctx.src_path.c_str(), O_RDONLY, 0);
-                io_uring_sqe_set_data64(sqe, make_user_data(&ctx, SendOp::OPEN));
-                ctx.state = SendState::OPENING;
+    size_t files_sent() const { return files_sent_; }
+    size_t file_count() const { return count_; }
 
-                next_to_open++;
-                in_flight++;
-            }
+    // File data before and after compression (data frames only)
+    uint64_t raw_bytes() const { return raw_bytes_; }
+    uint64_t wire_bytes() const { return wire_bytes_; }
 
-            // If no file is currently sending AND next file is ready, start it
-            if (!sending_active &&
-                next_to_send < files_.size() &&
-                files_[next_to_send].state == SendState::READY) {
+    // Bytes of sparse files sent as FILE_HOLEs
+    uint64_t hole_bytes() const { return hole_bytes_; }
 
-                if (!start_sending_file(&files_[next_to_send])) {
-                    files_[next_to_send].state = SendState::FAILED;
-                    free_buffers_.push_back(files_[next_to_send].buffer_idx);
-                    completed++;
-                    in_flight--;
-                    next_to_send++;
-                } else {
-                    sending_active = true;
-                    // Don't increment next_to_send until file is done
-                }
+    bool run() {
+        while (true) {
+            if (!error_) {
+                open_files();
+                queue_reads();
+                submit_sends();
             }
 
-            // Submit any pending ops
-            io_uring_submit(&ring_);
+            // Nothing in flight: finished, or draining after an error
+            if (in_flight_ == 0) break;
+            if (cfg_.metrics) cfg_.metrics->ring_in_flight.set(in_flight_);
 
-            // If nothing to wait for, we're stuck
-            if (in_flight == 0) break;
-
-            // Wait for completions
-            struct io_uring_cqe* cqe;
-            int ret = io_uring_wait_cqe(&ring_, &cqe);
-            if (ret < 0) {
-                fmt::print(stderr, "wait_cqe error: {}\n", strerror(-ret));
+            int ret = io_uring_submit_and_wait(&ring_, 1);
+            if (ret < 0 && ret != -EINTR) {
+                fmt::print(stderr, "submit_and_wait error: {}\n", strerror(-ret));
                 return false;
             }
 
-            // Process all available completions
+            struct io_uring_cqe* cqe;
             unsigned head;
             unsigned count = 0;
             io_uring_for_each_cqe(&ring_, head, cqe) {
                 count++;
-                uint64_t user_data = io_uring_cqe_get_data64(cqe);
-                SendContext* ctx = get_context(user_data);
-                SendOp op = get_op(ctx);
-                int res = cqe->res;
-
-                bool ok = true;
-                if (op == SendOp::READ) {
-                    // Handle read completion - send data and maybe more reads
-                    ok = continue_sending_file(ctx, res);
-                } else {
-                    // Handle open/stat/close completions
-                    ok = advance_open_state(ctx, res);
-                }
-
-                if (!ok) {
-                    ctx->state = SendState::FAILED;
-                }
-
-                if (ctx->state == SendState::DONE || ctx->state == SendState::FAILED) {
-                    completed++;
-                    in_flight--;
-
-                    // Return buffer to free list
-                    free_buffers_.push_back(ctx->buffer_idx);
-
-                    // If this was the file being sent, allow next file to start
-                    if (ctx == &files_[next_to_send]) {
-                        sending_active = false;
-                        next_to_send++;
-                    }
-
-                    if (completed % 1000 == 0) {
-                        fmt::print("Sent {}/{} files\r", completed, files_.size());
-                    }
-                }
+                in_flight_--;
+                uint64_t tag = io_uring_cqe_get_data64(cqe);
+                if (cfg_.metrics) clock_.finish<SendOp>(tag, cqe->flags, *cfg_.metrics);
+                handle_completion(tag_op<SendOp>(tag), tag_index(tag), cqe->res, cqe->flags);
             }
             io_uring_cq_advance(&ring_, count);
         }
 
-        // Send ALL_DONE
-        auto done_msg = protocol::make_all_done();
-        send(sockfd_, done_msg.data(), done_msg.size(), 0);
-
-        fmt::print("Transfer complete: {} files\n", completed);
+        if (error_) return false;
+        if (!all_done_queued_ || !queue_.empty()) {
+            fmt::print(stderr, "Sender stalled with {} segments unsent\n", queue_.size());
+            return false;
+        }
         return true;
     }
 
 private:
-    // Process completion - advance state machine for open/stat/close
-    bool advance_open_state(SendContext* ctx, int result) {
-        if (result < 0) {
-            if (cfg_.verbose) {
-                fmt::print(stderr, "Error on {}: {}\n", ctx->src_path, strerror(-result));
+    // (device, inode) of multiply-linked files → their first entry
+    using InodeMap = std::map<std::pair<dev_t, ino_t>, size_t>;
+
+    static void add_scanned(FileList& files, uint32_t dir, const std::string& name,
+                            const std::string& path, bool& extent_order, InodeMap* inodes) {
+        FileList::Entry& e = files.add_file(dir, name);
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0) {
+            e.inode = st.st_ino;
+            e.size = st.st_size;
+            e.mtime_ns = to_mtime_ns(st.st_mtim);
+            if (inodes && st.st_nlink > 1) {
+                auto [it, fresh] = inodes->try_emplace({st.st_dev, st.st_ino}, files.size() - 1);
+                if (!fresh) {
+                    files.add_link(e, files[it->second]);
+                    files.entries().pop_back();
+                    return;
+                }
+            }
+        }
+        if (extent_order) {
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd >= 0) {
+                // Inode order for the rest once FIEMAP is unsupported
+                if (first_extent(fd, e.extent) == ExtentLookup::UNSUPPORTED) extent_order = false;
+                close(fd);
             }
-            if (ctx->fd >= 0) close(ctx->fd);
-            return false;
         }
+    }
 
-        switch (ctx->state) {
-            case SendState::OPENING: {
-                ctx->fd = result;
+    // user_data of an op, timed when metrics are on
+    void set_tag(struct io_uring_sqe* sqe, uint64_t tag) {
+        io_uring_sqe_set_data64(sqe, tag);
+        if (cfg_.metrics) clock_.start(tag);
+    }
 
-                // Submit statx
-                struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
-                if (!sqe) return false;
+    // ---- Submission ----
 
-                io_uring_prep_statx(sqe, ctx->fd, "", AT_EMPTY_PATH,
-                                   STATX_SIZE | STATX_MODE, &ctx->stx);
-                io_uring_sqe_set_data64(sqe, make_user_data(ctx, SendOp::STATX));
-                ctx->state = SendState::STATING;
+    // Keep up to queue_depth files opening/stat'ing ahead of the read cursor,
+    // each in the window slot of a file that has finished
+    void open_files() {
+        while (next_to_open_ < count_ &&
+               next_to_open_ - next_to_read_ < cfg_.queue_depth) {
+            if (next_to_open_ - retired_ >= window_.size()) {
+                // Everything open sits in the unsent batch: let it go out
+                if (batch_open_ && next_to_read_ == next_to_open_) seal_batch();
                 break;
             }
+            struct io_uring_sqe* sqe = get_net_sqe(&ring_);
+            if (!sqe) break;
+
+            // Paths are built only now, from the compact list
+            SendContext& ctx = file(next_to_open_);
+            const FileList::Entry& entry = list_[first_ + next_to_open_];
+            ctx = SendContext{};
+            ctx.src_path = list_.src_path(entry);
+            ctx.rel_path = list_.rel_path(entry);
+            ctx.file_size = entry.size;
+            ctx.mtime_ns = entry.mtime_ns;
+            ctx.resume = list_.resume_offset(entry);
+
+            io_uring_prep_openat(sqe, AT_FDCWD, ctx.src_path.c_str(), O_RDONLY, 0);
+            set_tag(sqe, make_tag(SendOp::OPEN, slot(ctx)));
+            ctx.state = SendState::OPENING;
+
+            next_to_open_++;
+            in_flight_++;
+        }
+    }
 
-            case SendState::STATING:
-                // File is ready - store size and wait for turn
-                ctx->file_size = ctx->stx.stx_size;
-                ctx->state = SendState::READY;
-                break;
+    // Walk files in stream order: queue the header, then one read per free
+    // buffer. The cursor waits at a file that is still opening.
+    void queue_reads() {
+        while (next_to_read_ < count_) {
+            // The slot still holds an earlier file until this one opens
+            if (next_to_read_ == next_to_open_) break;
+            SendContext& ctx = file(next_to_read_);
+
+            if (ctx.state == SendState::FAILED) {
+                // Never got a header on the wire - just skip it
+                next_to_read_++;
+                continue;
+            }
 
-            case SendState::CLOSING:
-                ctx->fd = -1;
-                ctx->state = SendState::DONE;
-                break;
+            if (ctx.state == SendState::READY && cfg_.file_batch &&
+                ctx.file_size <= protocol::MAX_BATCH_FILE_SIZE) {
+                if (!add_to_batch(ctx)) break;
+                continue;
+            }
 
-            default:
-                return false;
-        }
+            // Anything else goes after the open batch on the wire
+            if (ctx.state == SendState::READY && batch_open_) seal_batch();
+
+            if (ctx.state == SendState::READY) {
+                if (ctx.resume > 0) {
+                    // Only the rest goes; reads start at the offset
+                    ctx.hdr = protocol::make_file_resume(ctx.file_size, ctx.stx.stx_mode & 0777,
+                                                         ctx.rel_path, stx_mtime_ns(ctx.stx),
+                                                         ctx.resume);
+                    ctx.offset = ctx.resume;
+                } else if (cfg_.sparse && map_holes(ctx)) {
+                    ctx.sparse = true;
+                    ctx.hdr = protocol::make_file_sparse(ctx.file_size, ctx.stx.stx_mode & 0777,
+                                                         ctx.rel_path, cfg_.incremental,
+                                                         stx_mtime_ns(ctx.stx));
+                } else {
+                    ctx.hdr = protocol::make_file_hdr(ctx.file_size, ctx.stx.stx_mode & 0777,
+                                                      ctx.rel_path, cfg_.incremental,
+                                                      stx_mtime_ns(ctx.stx));
+                }
+                SendSegment& seg = push_segment(&ctx, ctx.hdr.data(), ctx.hdr.size());
+                seg.ready = true;
+                ctx.state = SendState::STREAMING;
+
+                if (ctx.file_size == 0) {
+                    end_file(ctx, seg);
+                    next_to_read_++;
+                    if (!submit_close(ctx)) return;
+                    continue;
+                }
+            }
 
-        return true;
-    }
+            if (ctx.state != SendState::STREAMING) break;
 
-    // Start sending a file that's ready (sends FILE_HDR and submits first read)
-    bool start_sending_file(SendContext* ctx) {
-        if (ctx->state != SendState::READY) {
-            fmt::print(stderr, "BUG: start_sending_file called with state != READY (state={})\n", (int)ctx->state);
-            return false;
+            // Up to the next data run is a hole
+            if (ctx.sparse && ctx.offset < ctx.runs[ctx.run_index].first) {
+                queue_hole(ctx);
+                continue;
+            }
+            if (buffer_pool_.available_count() == 0) break;
+
+            struct io_uring_sqe* sqe = get_net_sqe(&ring_);
+            if (!sqe) break;
+
+            auto [buffer, buf_idx] = buffer_pool_.acquire();
+            size_t len = std::min<uint64_t>(ctx.file_size - ctx.offset, read_size_);
+            if (ctx.sparse) {
+                // A frame at most, and never past the run
+                const auto& run = ctx.runs[ctx.run_index];
+                len = std::min<uint64_t>({len, run.first + run.second - ctx.offset,
+                                          protocol::MAX_FRAME_RAW});
+            }
+            SendSegment& seg = push_segment(&ctx, reinterpret_cast<uint8_t*>(buffer) + frame_room(),
+                                            len);
+            seg.buffer_idx = buf_idx;
+            seg.file_offset = ctx.offset;
+            if (cfg_.verify) seg.crc_len = seg.len;
+
+            io_uring_prep_read(sqe, ctx.fd, seg.data, seg.len, seg.file_offset);
+            set_tag(sqe, make_tag(SendOp::READ, seg.seq));
+            in_flight_++;
+
+            ctx.offset += len;
+            if (ctx.sparse && ctx.run_index + 1 < ctx.runs.size() &&
+                ctx.offset >= ctx.runs[ctx.run_index].first + ctx.runs[ctx.run_index].second) {
+                ctx.run_index++;
+            }
+            if (ctx.offset >= ctx.file_size) {
+                end_file(ctx, seg);
+                next_to_read_++;
+            }
         }
 
-        // Send FILE_HDR synchronously
-        auto hdr = protocol::make_file_hdr(ctx->file_size,
-                                           ctx->stx.stx_mode & 0777,
-                                           ctx->rel_path);
-        if (send(sockfd_, hdr.data(), hdr.size(), MSG_MORE) < 0) {
-            return false;
+        if (next_to_read_ == count_ && !all_done_queued_) {
+            if (batch_open_) seal_batch();
+            push_segment(nullptr, all_done_.data(), all_done_.size()).ready = true;
+            all_done_queued_ = true;
         }
+    }
 
-        if (ctx->file_size == 0) {
-            // Empty file - go to close
-            struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
-            if (!sqe) return false;
-            io_uring_prep_close(sqe, ctx->fd);
-            io_uring_sqe_set_data64(sqe, make_user_data(ctx, SendOp::CLOSE));
-            ctx->state = SendState::CLOSING;
-        } else {
-            // Submit read
-            struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
-            if (!sqe) return false;
+    // Send the ready prefix of the stream as one linked chain. Only one
+    // chain is in flight, so sends never reorder on the socket.
+    void submit_sends() {
+        if (cfg_.verify) fold_checksums();
+        if (sends_in_flight_ > 0) return;
+
+        size_t n = 0;
+        size_t limit = std::min<size_t>(MAX_LINKED_SENDS, io_uring_sq_space_left(&ring_));
+        while (n < queue_.size() && n < limit && queue_[n].ready) n++;
+        if (n == 0) return;
 
-            size_t to_read = std::min(ctx->file_size - ctx->offset, ctx->buf_size);
-            io_uring_prep_read(sqe, ctx->fd, ctx->buffer, to_read, ctx->offset);
-            io_uring_sqe_set_data64(sqe, make_user_data(ctx, SendOp::READ));
-            ctx->state = SendState::READING;
+        if (framed_) {
+            chain_start_ = std::chrono::steady_clock::now();
+            chain_bytes_ = 0;
         }
 
-        return true;
-    }
+        for (size_t i = 0; i < n; i++) {
+            SendSegment& seg = queue_[i];
+            struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
 
-    // Process read completion and continue sending
-    bool continue_sending_file(SendContext* ctx, int result) {
-        if (result < 0) {
-            if (cfg_.verbose) {
-                fmt::print(stderr, "Read error on {}: {}\n", ctx->src_path, strerror(-result));
+            // MSG_MORE until a file's last byte; WAITALL retries short sends
+            int flags = MSG_WAITALL;
+            if (seg.file && !seg.last) flags |= MSG_MORE;
+
+            // Zero-copy only pays off for data chunks; headers are copied
+            if (cfg_.zero_copy && seg.buffer_idx >= 0) {
+                io_uring_prep_send_zc(sqe, sockfd_, seg.data + seg.sent, seg.len - seg.sent,
+                                      flags, 0);
+                set_tag(sqe, make_tag(SendOp::SEND_ZC, seg.buffer_idx));
+            } else {
+                io_uring_prep_send(sqe, sockfd_, seg.data + seg.sent, seg.len - seg.sent, flags);
+                set_tag(sqe, make_tag(SendOp::SEND, seg.seq));
             }
-            return false;
+            if (i + 1 < n) sqe->flags |= IOSQE_IO_LINK;
         }
+        sends_in_flight_ = n;
+        in_flight_ += n;
+    }
 
-        // Send data synchronously
-        int flags = (ctx->offset + result < ctx->file_size) ? MSG_MORE : 0;
-        if (send(sockfd_, ctx->buffer, result, flags) < 0) {
-            return false;
+    // Put a READY small file into the open batch (starting one if needed)
+    // and read it straight into its entry. False if no buffer is free.
+    bool add_to_batch(SendContext& ctx) {
+        if (batch_open_ && !batch_.fits(ctx.rel_path.size(), ctx.file_size)) seal_batch();
+
+        if (!batch_open_) {
+            if (buffer_pool_.available_count() == 0) return false;
+            auto [buffer, buf_idx] = buffer_pool_.acquire();
+            uint8_t* data = reinterpret_cast<uint8_t*>(buffer);
+            batch_.reset(data, buffer_pool_.buffer_size(), cfg_.incremental, cfg_.verify);
+            SendSegment& seg = push_segment(nullptr, data, 0);
+            seg.buffer_idx = buf_idx;
+            seg.batch = true;
+            seg.batch_first = next_to_read_;
+            batch_seq_ = seg.seq;
+            batch_open_ = true;
         }
 
-        ctx->offset += result;
-
-        if (ctx->offset >= ctx->file_size) {
-            // Done with file data - close
-            struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+        struct io_uring_sqe* sqe = nullptr;
+        if (ctx.file_size > 0) {
+            sqe = get_net_sqe(&ring_);
             if (!sqe) return false;
-            io_uring_prep_close(sqe, ctx->fd);
-            io_uring_sqe_set_data64(sqe, make_user_data(ctx, SendOp::CLOSE));
-            ctx->state = SendState::CLOSING;
-        } else {
-            // Read more
-            struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
-            if (!sqe) return false;
-
-            size_t to_read = std::min(ctx->file_size - ctx->offset, ctx->buf_size);
-            io_uring_prep_read(sqe, ctx->fd, ctx->buffer, to_read, ctx->offset);
-            io_uring_sqe_set_data64(sqe, make_user_data(ctx, SendOp::READ));
         }
 
-        return true;
-    }
+        SendSegment& seg = segment(batch_seq_);
+        ctx.batch_data = batch_.add(ctx.file_size, ctx.stx.stx_mode & 0777, ctx.rel_path,
+                                    stx_mtime_ns(ctx.stx));
+        ctx.batch_seq = batch_seq_;
+        ctx.state = SendState::STREAMING;
+        seg.batch_end = ++next_to_read_;
 
-    int sockfd_;
-    std::string base_path_;
-    NetConfig cfg_;
-    struct io_uring ring_;
-    std::vector<SendContext> files_;
-    std::vector<std::vector<char>> buffers_;
-    std::vector<size_t> free_buffers_;  // Free buffer indices
-};
+        if (ctx.file_size == 0) return submit_close(ctx);
 
-// ============================================================
-// Receiver State Machine
-// ============================================================
+        io_uring_prep_read(sqe, ctx.fd, ctx.batch_data, ctx.file_size, 0);
+        set_tag(sqe, make_tag(SendOp::BATCH_READ, slot(ctx)));
+        seg.reads_pending++;
+        in_flight_++;
+        return true;
+    }
 
-enum class RecvState {
-    RECV_HDR,       // Receiving message header (5 bytes)
-    RECV_META,      // Receiving file metadata
-    OPENING,        // openat submitted
-    RECV_DATA,      // Receiving file data
-    WRITING,        // write submitted
-    CLOSING,        // close submitted
-    DONE,           // Complete
-    FAILED          // Error
-};
+    // Frame the open batch; it goes out once its reads have landed
+    void seal_batch() {
+        SendSegment& seg = segment(batch_seq_);
+        seg.len = static_cast<uint32_t>(batch_.finish());
+        seg.ready = (seg.reads_pending == 0);
+        batch_open_ = false;
+    }
 
-// Forward declare
-enum class RecvOp : uint8_t;
+    // ---- Sparse files ----
 
-struct RecvContext {
-    RecvState state = RecvState::RECV_HDR;
-    RecvOp current_op;  // Current operation type for user_data lookup
+    // Map the data runs of a file that may have holes, with its last byte
+    // always in one: the receiver's file takes its size from that write.
+    // False if there is nothing to skip.
+    bool map_holes(SendContext& ctx) {
+        if (!maybe_sparse(ctx.file_size, ctx.stx.stx_blocks) ||
+            !data_runs(ctx.fd, 0, ctx.file_size, ctx.runs)) {
+            return false;
+        }
+        uint64_t end = ctx.runs.empty() ? 0 : ctx.runs.back().first + ctx.runs.back().second;
+        if (!ctx.runs.empty() && end == ctx.file_size - 1) {
+            ctx.runs.back().second++;
+        } else if (end < ctx.file_size) {
+            ctx.runs.push_back({ctx.file_size - 1, 1});
+        }
+        uint64_t data = 0;
+        for (const auto& run : ctx.runs) data += run.second;
+        ctx.run_index = 0;
+        return data < ctx.file_size;
+    }
 
-    std::string path;
-    int fd = -1;
-    uint64_t file_size = 0;
-    uint32_t mode = 0;
-    uint64_t received = 0;
+    // The gap up to the next data run goes as one FILE_HOLE (or a few, if
+    // it is longer than MAX_HOLE)
+    void queue_hole(SendContext& ctx) {
+        uint64_t len = std::min(ctx.runs[ctx.run_index].first - ctx.offset, protocol::MAX_HOLE);
+        SendSegment& seg = push_segment(&ctx, nullptr, protocol::DATA_FRAME_HDR_SIZE);
+        seg.data = seg.hole_msg.data();
+        protocol::write_file_hole(seg.data, len);
+        seg.hole = len;
+        seg.ready = true;
+        ctx.offset += len;
+        hole_bytes_ += len;
+    }
 
-    char* buffer = nullptr;
-    size_t buf_size = 0;
-    ssize_t last_recv = 0;
-};
+    // ---- Verification ----
 
-enum class RecvOp : uint8_t {
-    RECV,
-    OPEN,
-    WRITE,
-    CLOSE
-};
+    // Mark the file's last segment: its final chunk, or with verify a
+    // FILE_END that follows it
+    void end_file(SendContext& ctx, SendSegment& last) {
+        if (!cfg_.verify) {
+            last.last = true;
+            return;
+        }
+        SendSegment& end = push_segment(&ctx, ctx.end.data(), ctx.end.size());
+        end.file_end = true;
+        end.last = true;
+    }
 
-// Store op in context and use raw pointer as user_data (avoids alignment issues)
-inline uint64_t make_recv_user_data(RecvContext* ctx, RecvOp op) {
-    ctx->current_op = op;
-    return reinterpret_cast<uint64_t>(ctx);
-}
+    // Fold chunk CRCs into their files in wire order. Stops at the first
+    // chunk still being read, which also holds back every send after it,
+    // so nothing leaves the queue unfolded.
+    void fold_checksums() {
+        while (fold_seq_ < next_seq_) {
+            SendSegment& seg = segment(fold_seq_);
+            if (seg.crc_len > 0) {
+                if (!seg.crc_done) return;
+                seg.file->crc = crc32c_combine(seg.file->crc, seg.crc, seg.crc_len);
+            } else if (seg.hole > 0) {
+                seg.file->crc = crc32c_zeros(seg.file->crc, seg.hole);
+            } else if (seg.file_end) {
+                protocol::write_file_end(seg.data, seg.file->crc);
+                seg.ready = true;
+            }
+            fold_seq_++;
+        }
+    }
 
-inline RecvContext* get_recv_context(uint64_t user_data) {
-    return reinterpret_cast<RecvContext*>(user_data);
-}
+    // ---- Compression ----
 
-inline RecvOp get_recv_op(RecvContext* ctx) {
-    return ctx->current_op;
-}
+    // Sparse files are framed in any session
+    size_t frame_room() const {
+        return framed_ || cfg_.sparse ? protocol::DATA_FRAME_HDR_SIZE : 0;
+    }
 
-// ============================================================
-// Receiver Implementation
-// ============================================================
+    // Hand a fully read chunk to the pool; it stays unready until the job
+    // comes back. Files that didn't compress are framed raw right away.
+    void compress_chunk(SendSegment& seg) {
+        int zbuf_idx = -1;
+        char* zbuf = nullptr;
+        if (!seg.file->compress_off) std::tie(zbuf, zbuf_idx) = zbuf_pool_.acquire();
+        if (zbuf_idx < 0) {
+            frame_raw(seg);
+            return;
+        }
 
-class AsyncReceiver {
-public:
-    AsyncReceiver(int sockfd, const std::string& dst_path, const NetConfig& cfg)
-        : sockfd_(sockfd), dst_path_(dst_path), cfg_(cfg) {
+        CompressJob job;
+        job.seq = seg.seq;
+        job.codec = cfg_.compress;
+        job.level = level_.level();
+        job.src = seg.data;
+        job.len = seg.len;
+        job.dst = reinterpret_cast<uint8_t*>(zbuf) + frame_room();
+        job.cap = zbuf_pool_.buffer_size() - frame_room();
+        job.sink = sink_.get();
+        seg.zbuf_idx = zbuf_idx;
+
+        compressor_->submit(job);
+        jobs_pending_++;
+        arm_wake();
+    }
 
-        // Initialize io_uring
-        struct io_uring_params params = {};
-        if (io_uring_queue_init_params(cfg.queue_depth * 4, &ring_, &params) < 0) {
-            throw std::runtime_error("Failed to init io_uring");
+    // The read left room for the frame header in front of the chunk
+    void frame_raw(SendSegment& seg) {
+        seg.data -= frame_room();
+        protocol::write_data_frame_header(seg.data, protocol::Codec::NONE, seg.len, seg.len);
+        if (framed_) {
+            raw_bytes_ += seg.len;
+            wire_bytes_ += seg.len + frame_room();
         }
+        seg.len += frame_room();
+        seg.ready = true;
+    }
 
-        // Allocate contexts and buffers
-        contexts_.resize(cfg.queue_depth);
-        buffers_.resize(cfg.queue_depth);
-        for (size_t i = 0; i < cfg.queue_depth; i++) {
-            buffers_[i].resize(cfg.chunk_size);
-            contexts_[i].buffer = buffers_[i].data();
-            contexts_[i].buf_size = buffers_[i].size();
+    // One eventfd read stays posted while jobs are out, so the loop (and
+    // in_flight_) waits for them even when draining after an error
+    void arm_wake() {
+        if (wake_armed_) return;
+        struct io_uring_sqe* sqe = get_net_sqe(&ring_);
+        if (!sqe) {
+            fmt::print(stderr, "Submission queue full waiting for compression\n");
+            error_ = true;
+            return;
         }
-
-        // Header buffer
-        hdr_buf_.resize(protocol::MSG_HEADER_SIZE);
-        meta_buf_.resize(8 + 4 + 2 + protocol::MAX_PATH_LEN);
+        io_uring_prep_read(sqe, sink_->fd(), &wake_count_, sizeof(wake_count_), 0);
+        set_tag(sqe, make_tag(SendOp::WAKE, 0));
+        wake_armed_ = true;
+        in_flight_++;
     }
 
-    ~AsyncReceiver() {
-        io_uring_queue_exit(&ring_);
+    void on_wake() {
+        wake_armed_ = false;
+        sink_->drain(done_jobs_);
+        jobs_pending_ -= done_jobs_.size();
+        for (const CompressJob& job : done_jobs_) on_compressed(job);
+        if (jobs_pending_ > 0) arm_wake();
     }
 
-    bool run() {
-        size_t files_completed = 0;
-        size_t ctx_idx = 0;
+    void on_compressed(const CompressJob& job) {
+        if (error_) return;
+        SendSegment& seg = segment(job.seq);
+        level_.on_compressed(job.out_len > 0 ? job.out_len : job.len, job.seconds);
+
+        if (!worth_compressing(job.len, job.out_len)) {
+            zbuf_pool_.release(seg.zbuf_idx);
+            seg.zbuf_idx = -1;
+            seg.file->compress_off = true;
+            frame_raw(seg);
+            return;
+        }
 
-        // Current file being received (TCP ordering means only 1 at a time)
-        RecvContext* current = &contexts_[0];
-        current->state = RecvState::RECV_HDR;
+        // Send the compressed copy; the read buffer can take the next chunk
+        uint8_t* frame = job.dst - frame_room();
+        protocol::write_data_frame_header(frame, cfg_.compress, job.len,
+                                          static_cast<uint32_t>(job.out_len));
+        buffer_pool_.release(seg.buffer_idx);
+        seg.buffer_idx = -1;
+        seg.data = frame;
+        seg.len = static_cast<uint32_t>(frame_room() + job.out_len);
+        raw_bytes_ += job.len;
+        wire_bytes_ += seg.len;
+        seg.ready = true;
+    }
 
-        // Files in write/close stages (can have multiple)
-        std::vector<RecvContext*> writing;
+    bool submit_close(SendContext& ctx) {
+        struct io_uring_sqe* sqe = get_net_sqe(&ring_);
+        if (!sqe) {
+            fmt::print(stderr, "Submission queue full closing {}\n", ctx.src_path);
+            error_ = true;
+            return false;
+        }
+        io_uring_prep_close(sqe, ctx.fd);
+        set_tag(sqe, make_tag(SendOp::CLOSE, slot(ctx)));
+        ctx.state = SendState::CLOSING;
+        in_flight_++;
+        return true;
+    }
 
-        bool done = false;
+    SendSegment& push_segment(SendContext* file, uint8_t* data, size_t len) {
+        SendSegment seg;
+        seg.seq = next_seq_++;
+        seg.file = file;
+        seg.data = data;
+        seg.len = static_cast<uint32_t>(len);
+        queue_.push_back(seg);
+        return queue_.back();
+    }
 
-        while (!done) {
-            // Submit recv for current file if needed
-            if (current && current->state == RecvState::RECV_HDR) {
-                // Receive header synchronously (5 bytes, fast)
-                if (!recv_exact(hdr_buf_.data(), protocol::MSG_HEADER_SIZE)) {
-                    fmt::print(stderr, "Failed to receive header\n");
-                    return false;
-                }
+    // Segments leave the queue only once sent, so a sequence number maps to
+    // a fixed position relative to the front
+    SendSegment& segment(uint64_t seq) {
+        return queue_[seq - queue_.front().seq];
+    }
 
-                protocol::MsgType type;
-                uint32_t payload_len;
-                protocol::parse_header(reinterpret_cast<uint8_t*>(hdr_buf_.data()),
-                                      type, payload_len);
+    // The in-flight chain is the queue prefix; find the link using buf_idx
+    SendSegment& chain_segment(int buf_idx) {
+        size_t n = std::min(queue_.size(), MAX_LINKED_SENDS);
+        for (size_t i = 1; i < n; i++) {
+            if (queue_[i].buffer_idx == buf_idx) return queue_[i];
+        }
+        return queue_.front();
+    }
 
-                if (type == protocol::MsgType::ALL_DONE) {
-                    done = true;
-                    current = nullptr;
-                    continue;
-                }
+    // A zero-copy buffer goes back to the pool only after its notification
+    void release_buffer(int buf_idx) {
+        if (zc_notifs_[buf_idx] > 0) {
+            zc_retired_[buf_idx] = 1;
+        } else {
+            buffer_pool_.release(buf_idx);
+        }
+    }
 
-                if (type != protocol::MsgType::FILE_HDR) {
-                    fmt::print(stderr, "Unexpected message type: {}\n", (int)type);
-                    return false;
-                }
+    // ---- Completion ----
 
-                // Receive metadata
-                if (!recv_exact(meta_buf_.data(), payload_len)) {
-                    fmt::print(stderr, "Failed to receive metadata\n");
-                    return false;
+    void handle_completion(SendOp op, uint64_t index, int res, uint32_t flags) {
+        switch (op) {
+            case SendOp::OPEN:
+            case SendOp::STATX:
+                advance_open_state(window_[index], res);
+                break;
+            case SendOp::READ:
+                on_read(segment(index), res);
+                break;
+            case SendOp::BATCH_READ:
+                on_batch_read(window_[index], res);
+                break;
+            case SendOp::SEND:
+                on_send(segment(index), res);
+                break;
+            case SendOp::SEND_ZC: {
+                int buf_idx = static_cast<int>(index);
+                if (flags & IORING_CQE_F_NOTIF) {
+                    // The kernel is done with the pages - the buffer may be reused
+                    if (--zc_notifs_[buf_idx] == 0 && zc_retired_[buf_idx]) {
+                        zc_retired_[buf_idx] = 0;
+                        buffer_pool_.release(buf_idx);
+                    }
+                    break;
                 }
-
-                protocol::FileHdrMsg hdr;
-                if (!protocol::parse_file_hdr(reinterpret_cast<uint8_t*>(meta_buf_.data()),
-                                             payload_len, hdr)) {
-                    fmt::print(stderr, "Failed to parse file header\n");
-                    return false;
+                // F_MORE: a notification follows; count it before the
+                // segment can retire and try to release the buffer
+                if (flags & IORING_CQE_F_MORE) {
+                    zc_notifs_[buf_idx]++;
+                    in_flight_++;
                 }
+                on_send(chain_segment(buf_idx), res);
+                break;
+            }
+            case SendOp::CLOSE: {
+                SendContext& ctx = window_[index];
+                ctx.fd = -1;
+                ctx.closed = true;
+                finish_if_done(ctx);
+                break;
+            }
+            case SendOp::WAKE:
+                on_wake();
+                break;
+        }
+    }
 
-                if (!protocol::is_safe_path(hdr.path)) {
-                    fmt::print(stderr, "Unsafe path: {}\n", hdr.path);
-                    return false;
-                }
+    void advance_open_state(SendContext& ctx, int result) {
+        if (result < 0) {
+            if (cfg_.verbose) {
+                fmt::print(stderr, "Error on {}: {}\n", ctx.src_path, strerror(-result));
+            }
+            if (ctx.fd >= 0) {
+                close(ctx.fd);
+                ctx.fd = -1;
+            }
+            ctx.state = SendState::FAILED;
+            file_finished();
+            return;
+        }
+
+        if (ctx.state == SendState::OPENING) {
+            ctx.fd = result;
 
-                current->path = (fs::path(dst_path_) / hdr.path).string();
-                current->file_size = hdr.size;
-                current->mode = hdr.mode;
-                current->received = 0;
+            struct io_uring_sqe* sqe = get_net_sqe(&ring_);
+            if (!sqe) {
+                advance_open_state(ctx, -EBUSY);
+                return;
+            }
+            io_uring_prep_statx(sqe, ctx.fd, "", AT_EMPTY_PATH,
+                                STATX_SIZE | STATX_MODE | STATX_MTIME | STATX_BLOCKS, &ctx.stx);
+            set_tag(sqe, make_tag(SendOp::STATX, slot(ctx)));
+            ctx.state = SendState::STATING;
+            in_flight_++;
+        } else {
+            // File is ready - store size and wait for the read cursor. The
+            // receiver's part is of the file as scanned; if it changed
+            // since, it goes whole.
+            if (ctx.stx.stx_size != ctx.file_size || stx_mtime_ns(ctx.stx) != ctx.mtime_ns) {
+                ctx.resume = 0;
+            }
+            ctx.file_size = ctx.stx.stx_size;
+            ctx.state = SendState::READY;
+        }
+    }
 
-                // Create parent directories (sync, usually cached)
-                fs::create_directories(fs::path(current->path).parent_path());
+    void on_read(SendSegment& seg, int res) {
+        SendContext& ctx = *seg.file;
 
-                // Submit openat via io_uring
-                struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
-                if (!sqe) return false;
+        // The header already promised file_size bytes, so the stream can't
+        // continue past a failed or short (truncated file) read
+        if (res <= 0) {
+            fmt::print(stderr, "Read error on {}: {}\n", ctx.src_path,
+                       res < 0 ? strerror(-res) : "file shrank while sending");
+            error_ = true;
+            return;
+        }
 
-                io_uring_prep_openat(sqe, AT_FDCWD, current->path.c_str(),
-                                    O_WRONLY | O_CREAT | O_TRUNC, current->mode & 0777);
-                io_uring_sqe_set_data64(sqe, make_recv_user_data(current, RecvOp::OPEN));
-                current->state = RecvState::OPENING;
+        seg.filled += res;
+        if (seg.filled < seg.len) {
+            // Short read - fetch the rest into the same buffer
+            struct io_uring_sqe* sqe = get_net_sqe(&ring_);
+            if (!sqe) {
+                error_ = true;
+                return;
             }
+            io_uring_prep_read(sqe, ctx.fd, seg.data + seg.filled, seg.len - seg.filled,
+                               seg.file_offset + seg.filled);
+            set_tag(sqe, make_tag(SendOp::READ, seg.seq));
+            in_flight_++;
+            return;
+        }
+
+        // Framing moves seg.data and seg.len
+        bool final = seg.file_offset + seg.len >= ctx.file_size;
+        if (cfg_.verify) {
+            seg.crc = crc32c(0, seg.data, seg.len);
+            seg.crc_done = true;
+        }
+        if (framed_) {
+            compress_chunk(seg);
+        } else if (ctx.sparse) {
+            frame_raw(seg);
+        } else {
+            seg.ready = true;
+        }
+        if (final) submit_close(ctx);
+    }
 
-            // Submit any pending ops
-            io_uring_submit(&ring_);
+    void on_batch_read(SendContext& ctx, int res) {
+        // The entry header already promised file_size bytes
+        if (res <= 0) {
+            fmt::print(stderr, "Read error on {}: {}\n", ctx.src_path,
+                       res < 0 ? strerror(-res) : "file shrank while sending");
+            error_ = true;
+            return;
+        }
 
-            // Wait for completion
-            struct io_uring_cqe* cqe;
-            int ret = io_uring_wait_cqe(&ring_, &cqe);
-            if (ret < 0) {
-                fmt::print(stderr, "wait_cqe error: {}\n", strerror(-ret));
-                return false;
+        ctx.offset += res;
+        if (ctx.offset < ctx.file_size) {
+            struct io_uring_sqe* sqe = get_net_sqe(&ring_);
+            if (!sqe) {
+                error_ = true;
+                return;
             }
+            io_uring_prep_read(sqe, ctx.fd, ctx.batch_data + ctx.offset,
+                               ctx.file_size - ctx.offset, ctx.offset);
+            set_tag(sqe, make_tag(SendOp::BATCH_READ, slot(ctx)));
+            in_flight_++;
+            return;
+        }
 
-            // Process completions
-            unsigned head;
-            unsigned count = 0;
-            io_uring_for_each_cqe(&ring_, head, cqe) {
-                count++;
-                uint64_t user_data = io_uring_cqe_get_data64(cqe);
-                RecvContext* ctx = get_recv_context(user_data);
-                RecvOp op = get_recv_op(ctx);
-                int res = cqe->res;
+        if (cfg_.verify) {
+            protocol::write_u32(ctx.batch_data - protocol::CRC_SIZE,
+                                crc32c(0, ctx.batch_data, ctx.file_size));
+        }
+        SendSegment& seg = segment(ctx.batch_seq);
+        bool sealed = !batch_open_ || batch_seq_ != seg.seq;
+        if (--seg.reads_pending == 0 && sealed) seg.ready = true;
+        submit_close(ctx);
+    }
 
-                if (!advance_recv_state(ctx, op, res)) {
-                    ctx->state = RecvState::FAILED;
-                }
+    void on_send(SendSegment& seg, int res) {
+        sends_in_flight_--;
+
+        if (res > 0) {
+            seg.sent += res;
+            chain_bytes_ += res;
+        } else if (res != -ECANCELED) {
+            // -ECANCELED: an earlier link came up short; resent below
+            if (!error_) {
+                fmt::print(stderr, "Send failed: {}\n", res < 0 ? strerror(-res) : "connection closed");
+            }
+            error_ = true;
+        }
 
-                if (ctx->state == RecvState::DONE || ctx->state == RecvState::FAILED) {
-                    files_completed++;
+        if (sends_in_flight_ > 0) return;
 
-                    if (files_completed % 1000 == 0) {
-                        fmt::print("Received {} files\r", files_completed);
-                    }
+        if (framed_) {
+            level_.on_sent(chain_bytes_, std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - chain_start_).count());
+        }
 
-                    // Recycle context for next file
-                    if (ctx == current) {
-                        ctx_idx = (ctx_idx + 1) % contexts_.size();
-                        current = &contexts_[ctx_idx];
-                        current->state = RecvState::RECV_HDR;
-                        current->fd = -1;
-                    }
+        // Chain finished - drop fully sent segments; the next chain resumes
+        // at the first byte not yet on the wire. (An open batch is still
+        // empty but not ready.)
+        while (!queue_.empty() && queue_.front().ready &&
+               queue_.front().sent == queue_.front().len) {
+            SendSegment& done = queue_.front();
+            if (done.buffer_idx >= 0) release_buffer(done.buffer_idx);
+            if (done.zbuf_idx >= 0) zbuf_pool_.release(done.zbuf_idx);
+            if (done.file && done.last) {
+                done.file->sent = true;
+                finish_if_done(*done.file);
+            }
+            if (done.batch) {
+                for (size_t i = done.batch_first; i < done.batch_end; i++) {
+                    SendContext& f = file(i);
+                    if (f.state == SendState::FAILED) continue;
+                    f.sent = true;
+                    finish_if_done(f);
                 }
             }
-            io_uring_cq_advance(&ring_, count);
+            queue_.pop_front();
         }
+    }
 
-        // Wait for any remaining writes/closes
+    void finish_if_done(SendContext& ctx) {
+        if (!ctx.closed || !ctx.sent || ctx.state == SendState::DONE) return;
+        ctx.state = SendState::DONE;
+        ctx.hdr = {};
+        files_sent_++;
+        file_finished();
+    }
+
+    void file_finished() {
+        completed_++;
+        if (cfg_.progress && completed_ % 1000 == 0) {
+            fmt::print("Sent {}/{} files\r", completed_, count_);
+        }
+        // Slots free up in stream order; later files may finish first
+        while (retired_ < next_to_open_) {
+            SendState state = file(retired_).state;
+            if (state != SendState::DONE && state != SendState::FAILED) break;
+            retired_++;
+        }
+    }
+
+    // ---- Window ----
+
+    // Contexts exist only for files between the oldest unfinished one and
+    // the open cursor: a full batch, plus the read lookahead, twice over
+    static size_t window_size(size_t queue_depth) {
+        return 2 * (protocol::MAX_BATCH_FILES + queue_depth);
+    }
+
+    SendContext& file(size_t index) { return window_[index % window_.size()]; }
+    uint64_t slot(const SendContext& ctx) const { return &ctx - window_.data(); }
+
+    int sockfd_;
+    NetConfig cfg_;
+    OpClock clock_;
+    struct io_uring ring_;
+    const FileList& list_;
+    size_t first_;                      // This stream's files: list_[first_, first_ + count_)
+    size_t count_;
+    std::vector<SendContext> window_;   // File i lives in window_[i % size]
+    bool framed_;                       // Data goes out as FILE_DATA frames
+    size_t read_size_;                  // Bytes of a file per chunk
+    BufferPool buffer_pool_;            // One arena, O(1) acquire/release
+    std::vector<uint8_t> all_done_;
+
+    // Compression (framed_ only)
+    CompressPool* compressor_;          // Shared by all streams
+    BufferPool zbuf_pool_;              // Compressed frames, one per chunk in flight
+    LevelController level_;
+    std::unique_ptr<CompressSink> sink_;
+    std::vector<CompressJob> done_jobs_;
+    size_t jobs_pending_ = 0;
+    bool wake_armed_ = false;
+    uint64_t wake_count_ = 0;
+    std::chrono::steady_clock::time_point chain_start_;
+    size_t chain_bytes_ = 0;
+    uint64_t raw_bytes_ = 0;
+    uint64_t wire_bytes_ = 0;
+    uint64_t hole_bytes_ = 0;           // Sent as FILE_HOLEs
+
+    std::deque<SendSegment> queue_;     // Unsent stream, in wire order
+    uint64_t next_seq_ = 0;
+    uint64_t fold_seq_ = 0;             // Next segment to fold (verify)
+    size_t next_to_open_ = 0;           // Next file to start opening
+    size_t next_to_read_ = 0;           // Read cursor (stream order)
+    size_t retired_ = 0;                // Files before this one have finished
+    size_t in_flight_ = 0;              // SQEs awaiting completion
+    size_t sends_in_flight_ = 0;        // Links left in the current chain
+    bool all_done_queued_ = false;
+    bool error_ = false;
+
+    // Batch being filled (file_batch only)
+    protocol::BatchBuilder batch_;
+    uint64_t batch_seq_ = 0;
+    bool batch_open_ = false;
+
+    // SEND_ZC: notifications outstanding per buffer, and buffers that were
+    // fully sent but wait for them
+    std::vector<uint16_t> zc_notifs_;
+    std::vector<uint8_t> zc_retired_;
+
+    size_t completed_ = 0;
+    size_t files_sent_ = 0;
+};
+
+// ============================================================
+// Receiver State Machine
+// ============================================================
+// The socket side walks the stream: header, file metadata, then the
+// file's data. File bytes become RecvPieces that are written
+// asynchronously while more data arrives; pieces that arrive before the
+// file's openat completes are parked until the fd is known.
+//
+// Two ways to take bytes off the socket:
+// - Default: one recv in flight, sized to land a chunk exactly in a pool
+//   buffer (each piece owns its buffer).
+// - zero_copy: one multishot recv over a provided buffer ring. The kernel
+//   picks the buffer and fills it with whatever is on the wire; pieces
+//   point into it and the buffer is recycled to the ring when the last
+//   one is written. Headers straddling buffers are copied out.
+//
+// A FILE_BATCH payload lands whole in a batch buffer and fans out as one
+// submission: an open → write → close chain per entry on its own
+// fixed-file slot. The buffer is reused once every chain has completed.
+//
+// In a compressed session a file's data is a run of FILE_DATA frames. Raw
+// frames are taken like unframed data; compressed ones land in a staging
+// buffer and are inflated inline into an inflate buffer, which becomes
+// the piece that is written.
+//
+// A FILE_SPARSE file is framed in any session, and its FILE_HOLEs only
+// move the offset: the hole is never written, so it stays a hole here.
+// FILE_LINKs are kept until every stream of the session is done.
+
+enum class StreamPhase : uint8_t {
+    HDR,            // Receiving message header (5 bytes)
+    META,           // Receiving file metadata
+    DATA,           // Receiving file data
+    FRAME,          // Receiving a FILE_DATA frame header (compressed session)
+    ZDATA,          // Receiving a compressed frame's payload
+    BATCH,          // Receiving a FILE_BATCH payload
+    END,            // Receiving FILE_END and its CRC (verify)
+    DONE            // ALL_DONE seen
+};
+
+struct RecvContext {
+    std::string path;
+    int fd = -1;
+    uint64_t file_size = 0;
+    uint32_t mode = 0;
+    bool has_mtime = false;             // Stamp mtime_ns before closing (incremental)
+    int64_t mtime_ns = 0;
+    bool sparse = false;                // FILE_SPARSE: data comes as frames and FILE_HOLEs
+    bool direct = false;                // O_DIRECT: the last piece goes padded, cut back at close
+    uint64_t received = 0;              // Bytes taken off the socket
+    uint32_t writes_in_flight = 0;
+
+    // Resume journal: bytes on disk from the start of the file, pieces
+    // written past them (offset → end), and what the journal has
+    uint64_t committed = 0;
+    std::map<uint64_t, uint64_t> landed;
+    uint64_t checkpointed = 0;
+    bool opened = false;                // openat completed
+    bool failed = false;                // Remaining data is drained, not written
+    bool closing = false;
+    std::vector<int> pending;           // Pieces received before the open completed
+    std::vector<std::string> dirs;      // Parents made ahead of the open (mkdirat paths)
+
+    // Verify: CRC of the bytes received so far; the file closes only once
+    // FILE_END has been checked, and is removed if it didn't match
+    uint32_t crc = 0;
+    bool checked = false;
+    bool corrupt = false;
+};
+
+// A run of one file's bytes inside a receive buffer
+struct RecvPiece {
+    RecvContext* file = nullptr;
+    char* data = nullptr;
+    uint64_t offset = 0;
+    uint32_t len = 0;
+    uint32_t written = 0;
+    int buffer = -1;                    // Ring buffer id (zero_copy only)
+};
+
+// One FILE_BATCH entry being written; index is its fixed-file slot
+struct BatchFile {
+    std::string path;
+    uint32_t size = 0;
+    uint8_t ops_left = 0;               // Chain CQEs still to come
+    bool failed = false;
+    int64_t mtime_ns = 0;               // Stamped once written (incremental)
+    std::vector<std::string> dirs;      // Parents made ahead of the open
+};
+
+// Received bytes not yet parsed (zero_copy only)
+struct RecvSpan {
+    int buffer;
+    uint32_t offset;
+    uint32_t len;
+};
+
+enum class RecvOp : uint8_t {
+    RECV,
+    CANCEL,
+    OPEN,
+    WRITE,
+    CLOSE,
+    BATCH_OPEN,     // Index is the batch file slot
+    BATCH_WRITE,
+    BATCH_CLOSE,
+    MKDIR,          // A missing parent, ahead of an open
+    WAKE            // Doorbell between a stream and its disk workers
+};
+
+static const std::vector<const char*> RECV_OP_NAMES = {
+    "recv", "cancel", "open", "write", "close", "batch_open", "batch_write", "batch_close",
+    "mkdir", "wake"};
+
+static constexpr int RECV_BUF_GROUP = 0;
+
+// FILE_BATCH payloads being written at once; each has MAX_BATCH_FILES slots
+static constexpr size_t BATCH_BUFFERS = 2;
+
+// Files of a resumed session are checkpointed each time this many more of
+// their bytes are on disk
+static constexpr uint64_t CHECKPOINT_BYTES = 64 * 1024 * 1024;
+
+// ============================================================
+// Receiver Disk Workers
+// ============================================================
+// DiskOp, the per-worker outbox and the hand-off lists are in
+// disk_ops.hpp; here are the rings that run them.
+
+static void prep_disk_op(struct io_uring_sqe* sqe, const DiskOp& op) {
+    const int flags = O_WRONLY | O_CREAT | (op.keep ? 0 : O_TRUNC) | (op.direct ? O_DIRECT : 0);
+    switch (op.kind) {
+        case DiskOp::OPEN:
+            io_uring_prep_openat(sqe, AT_FDCWD, op.path, flags, op.mode & 0777);
+            break;
+        case DiskOp::OPEN_DIRECT:
+            io_uring_prep_openat_direct(sqe, AT_FDCWD, op.path, flags, op.mode & 0777, op.fd);
+            break;
+        case DiskOp::MKDIR:
+            io_uring_prep_mkdirat(sqe, AT_FDCWD, op.path, 0755);
+            break;
+        case DiskOp::WRITE:
+        case DiskOp::WRITE_FIXED:
+            io_uring_prep_write(sqe, op.fd, op.buf, op.len, op.offset);
+            if (op.kind == DiskOp::WRITE_FIXED) sqe->flags |= IOSQE_FIXED_FILE;
+            break;
+        case DiskOp::CLOSE:
+            io_uring_prep_close(sqe, op.fd);
+            break;
+        case DiskOp::CLOSE_DIRECT:
+            io_uring_prep_close_direct(sqe, op.fd);
+            break;
+    }
+    sqe->flags |= op.sqe_flags;
+}
+
+// Ops from ops[i] to the end of its chain
+static size_t chain_length(const std::vector<DiskOp>& ops, size_t i) {
+    size_t n = 1;
+    while (i + n < ops.size() && (ops[i + n - 1].sqe_flags & (IOSQE_IO_LINK | IOSQE_IO_HARDLINK))) n++;
+    return n;
+}
+
+// A doorbell arrives as make_tag(WAKE, 0); the CQE of ringing one, on the
+// ringing side, is make_tag(WAKE, 1 + worker)
+static constexpr uint64_t DOORBELL_INDEX = 0;
+
+static void ring_doorbell(struct io_uring* from, int to_fd, uint64_t sent_index) {
+    struct io_uring_sqe* sqe = get_net_sqe(from);
+    io_uring_prep_msg_ring(sqe, to_fd, 0, make_tag(RecvOp::WAKE, DOORBELL_INDEX), 0);
+    io_uring_sqe_set_data64(sqe, make_tag(RecvOp::WAKE, sent_index));
+}
+
+class DiskWorker {
+public:
+    // The ring is made on the worker's own thread: SINGLE_ISSUER rings
+    // (the defer profile) belong to the thread that sets them up
+    DiskWorker(const NetConfig& cfg, unsigned file_slots, int reply_fd)
+        : depth_(static_cast<unsigned>(cfg.queue_depth * 4)), setup_(cfg.ring),
+          ring_index_(cfg.ring_index), file_slots_(file_slots), reply_fd_(reply_fd) {
+        std::future<bool> ready = ready_.get_future();
+        thread_ = std::thread(&DiskWorker::run, this);
+        if (!ready.get()) {
+            thread_.join();
+            throw std::runtime_error("Failed to init disk worker io_uring");
+        }
+    }
+
+    ~DiskWorker() {
+        if (thread_.joinable()) thread_.join();
+    }
+
+    DiskWorker(const DiskWorker&) = delete;
+    DiskWorker& operator=(const DiskWorker&) = delete;
+
+    int ring_fd() const { return ring_fd_; }
+    bool direct() const { return direct_; }       // Fixed-file slots registered
+
+    // Stream side: true if the worker's doorbell must be rung
+    bool post(std::vector<DiskOp>& ops) { return inbox_.post(ops); }
+    void take_results(std::vector<DiskResult>& out) { results_.take(out); }
+
+    // Exit once idle; the caller rings the doorbell after this and
+    // then destroys the worker
+    void stop() { stop_ = true; }
+
+private:
+    void run() {
+        if (ring_init(depth_, &ring_, setup_, ring_index_) < 0) {
+            ready_.set_value(false);
+            return;
+        }
+        direct_ = io_uring_register_files_sparse(&ring_, file_slots_) == 0;
+        ring_fd_ = ring_.ring_fd;
+        ready_.set_value(true);
+
+        std::vector<DiskOp> ops;
+        std::vector<DiskResult> done;
+        size_t in_flight = 0;
         while (true) {
-            bool any_pending = false;
-            for (auto& ctx : contexts_) {
-                if (ctx.state != RecvState::DONE && ctx.state != RecvState::FAILED &&
-                    ctx.state != RecvState::RECV_HDR) {
-                    any_pending = true;
-                    break;
+            inbox_.take(ops);
+            for (size_t i = 0; i < ops.size();) {
+                size_t n = chain_length(ops, i);
+                ring_reserve(&ring_, static_cast<unsigned>(n));
+                for (size_t end = i + n; i < end; i++) {
+                    struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+                    prep_disk_op(sqe, ops[i]);
+                    io_uring_sqe_set_data64(sqe, ops[i].tag);
+                }
+                in_flight += n;
+            }
+            if (!done.empty() && results_.post(done)) {
+                ring_doorbell(&ring_, reply_fd_, 1);
+                in_flight++;
+            }
+            if (in_flight == 0 && stop_) break;
+
+            // With nothing in flight this waits for the doorbell
+            int ret = io_uring_submit_and_wait(&ring_, 1);
+            if (ret < 0 && ret != -EINTR) {
+                fmt::print(stderr, "Disk worker submit_and_wait error: {}\n", strerror(-ret));
+                break;
+            }
+
+            struct io_uring_cqe* cqe;
+            unsigned head;
+            unsigned count = 0;
+            io_uring_for_each_cqe(&ring_, head, cqe) {
+                count++;
+                uint64_t tag = io_uring_cqe_get_data64(cqe);
+                if (tag == make_tag(RecvOp::WAKE, DOORBELL_INDEX)) continue;
+                in_flight--;
+                if (tag_op<RecvOp>(tag) != RecvOp::WAKE) {
+                    done.push_back({tag, cqe->res});
+                } else if (cqe->res == -EOVERFLOW) {
+                    ring_doorbell(&ring_, reply_fd_, 1);     // The stream's CQ was full
+                    in_flight++;
+                }
+            }
+            io_uring_cq_advance(&ring_, count);
+        }
+        io_uring_queue_exit(&ring_);
+    }
+
+    unsigned depth_;
+    RingSetup setup_;
+    unsigned ring_index_;
+    unsigned file_slots_;
+    int reply_fd_;                  // The stream's ring
+    struct io_uring ring_;
+    int ring_fd_ = -1;
+    bool direct_ = false;
+    std::promise<bool> ready_;
+    std::thread thread_;
+    std::atomic<bool> stop_{false};
+    Handoff<DiskOp> inbox_;
+    Handoff<DiskResult> results_;
+};
+
+// ============================================================
+// Receiver Implementation
+// ============================================================
+
+class AsyncReceiver {
+public:
+    AsyncReceiver(int sockfd, const std::string& dst_path, const NetConfig& cfg)
+        : sockfd_(sockfd), dst_path_(dst_path), cfg_(cfg),
+          buffer_pool_(cfg.queue_depth, cfg.chunk_size),
+          contexts_(cfg.queue_depth), slots_(cfg.queue_depth),
+          // Chunk mode: piece i owns pool buffer i. Ring mode: a piece per
+          // (file, buffer) overlap, at most one per slot plus one per buffer.
+          pieces_(cfg.zero_copy ? cfg.queue_depth * 2 : cfg.queue_depth),
+          piece_free_(cfg.zero_copy ? cfg.queue_depth * 2 : 0),
+          batch_pool_(BATCH_BUFFERS, protocol::MAX_BATCH_FRAME),
+          batch_files_(BATCH_BUFFERS * protocol::MAX_BATCH_FILES),
+          batch_left_(BATCH_BUFFERS, 0),
+          framed_(cfg.compress != protocol::Codec::NONE),
+          inflate_pool_(framed_ || cfg.reusable ? cfg.queue_depth : 0, protocol::MAX_FRAME_RAW),
+          dir_cache_(dst_path) {
+
+        // Inflated pieces follow the ones above, one per inflate buffer
+        inflate_base_ = static_cast<int>(pieces_.size());
+        pieces_.resize(pieces_.size() + inflate_pool_.count());
+        if (inflate_pool_.count() > 0) {
+            codec_ = std::make_unique<ChunkCodec>();
+            zbuf_.resize(std::max(compress_bound(protocol::Codec::ZSTD, protocol::MAX_FRAME_RAW),
+                                  compress_bound(protocol::Codec::LZ4, protocol::MAX_FRAME_RAW)));
+        }
+
+        // Initialize io_uring
+        if (ring_init(cfg.queue_depth * 4, &ring_, cfg.ring, cfg.ring_index) < 0) {
+            throw std::runtime_error("Failed to init io_uring");
+        }
+
+        if (cfg_.zero_copy && !setup_buf_ring()) {
+            io_uring_queue_exit(&ring_);
+            throw std::runtime_error("Failed to register provided buffer ring");
+        }
+        if (cfg_.affinity) {
+            buffer_pool_.touch();
+            batch_pool_.touch();
+            inflate_pool_.touch();
+        }
+
+        // Batch entries open straight into fixed-file slots (5.15+);
+        // without them each entry is written synchronously
+        batch_direct_ = io_uring_register_files_sparse(&ring_, batch_files_.size()) == 0;
+        if (!batch_direct_ && cfg_.verbose) {
+            fmt::print(stderr, "Fixed-file slots unavailable, file batches written synchronously\n");
+        }
+
+        // Parents are made by mkdirat ops ahead of the open (5.15+)
+        mkdir_chain_ = uring_supports_op(IORING_OP_MKDIRAT);
+        if (cfg_.write_workers > 0) start_workers();
+
+        // Header buffer (frame headers are the longest)
+        hdr_buf_.resize(protocol::DATA_FRAME_HDR_SIZE);
+        // Metadata buffer (a FILE_LINK's two paths are the longest)
+        meta_buf_.resize(std::max<size_t>(8 + 4 + 2 + protocol::MAX_PATH_LEN + protocol::MTIME_SIZE +
+                                              protocol::RESUME_OFFSET_SIZE,
+                                          2 * (2 + protocol::MAX_PATH_LEN)));
+    }
+
+    ~AsyncReceiver() {
+        stop_workers();
+        if (buf_ring_) {
+            io_uring_free_buf_ring(&ring_, buf_ring_, buf_ring_entries_, RECV_BUF_GROUP);
+        }
+        io_uring_queue_exit(&ring_);
+        for (auto& ctx : contexts_) {
+            if (ctx.fd >= 0 && !ctx.closing) close(ctx.fd);
+        }
+    }
+
+    bool run() {
+        while (true) {
+            if (buf_ring_) {
+                parse_backlog();        // Resumes after a slot/piece stall
+                post_multishot_recv();
+            } else {
+                post_recv();
+            }
+            post_disk_ops();
+
+            // Nothing in flight: ALL_DONE handled, or draining after an error
+            if (in_flight_ == 0) break;
+            if (cfg_.metrics) cfg_.metrics->ring_in_flight.set(in_flight_);
+
+            int ret = io_uring_submit_and_wait(&ring_, 1);
+            if (ret < 0 && ret != -EINTR) {
+                fmt::print(stderr, "submit_and_wait error: {}\n", strerror(-ret));
+                return false;
+            }
+
+            struct io_uring_cqe* cqe;
+            unsigned head;
+            unsigned count = 0;
+            io_uring_for_each_cqe(&ring_, head, cqe) {
+                count++;
+                uint64_t tag = io_uring_cqe_get_data64(cqe);
+                if (tag == make_tag(RecvOp::WAKE, DOORBELL_INDEX)) {
+                    take_disk_results();
+                    continue;
+                }
+                in_flight_--;
+                if (cfg_.metrics) clock_.finish<RecvOp>(tag, cqe->flags, *cfg_.metrics);
+                handle_completion(tag_op<RecvOp>(tag), tag_index(tag), cqe->res, cqe->flags);
+            }
+            io_uring_cq_advance(&ring_, count);
+        }
+
+        files_received_ = files_ok_;
+        if (cfg_.journal && (error_ || phase_ != StreamPhase::DONE)) checkpoint_open_files();
+        if (error_) return false;
+        if (phase_ != StreamPhase::DONE) {
+            fmt::print(stderr, "Receiver stalled before ALL_DONE\n");
+            return false;
+        }
+        return true;
+    }
+
+    size_t files_received() const { return files_received_; }
+    size_t files_corrupt() const { return files_corrupt_; }
+    size_t files_failed() const { return files_failed_; }
+
+    // FILE_LINKs received: (path, target) below the destination
+    const std::vector<std::pair<std::string, std::string>>& links() const { return links_; }
+
+    // Take another connection on the same ring, buffers and disk workers
+    // (cfg.reusable). Only after run() returned true: every slot, piece
+    // and ring buffer is back and nothing is in flight.
+    void reset(int sockfd, const std::string& dst_path, const NetConfig& session) {
+        sockfd_ = sockfd;
+        dst_path_ = dst_path;
+        dir_cache_ = DirCache(dst_path);        // The tree may have changed since
+        cfg_.progress = session.progress;
+        cfg_.compress = session.compress;
+        cfg_.incremental = session.incremental;
+        cfg_.verify = session.verify;
+        cfg_.sparse = session.sparse;
+        cfg_.hardlinks = session.hardlinks;
+        cfg_.journal = session.journal;
+        cfg_.metrics = session.metrics;
+        framed_ = session.compress != protocol::Codec::NONE;
+
+        phase_ = StreamPhase::HDR;
+        rx_buf_ = nullptr;
+        rx_want_ = 0;
+        rx_got_ = 0;
+        rx_piece_ = -1;
+        rx_batch_ = -1;
+        payload_len_ = 0;
+        current_ = nullptr;
+        frame_left_ = 0;
+        cancel_sent_ = false;
+        peer_closed_ = false;
+        error_ = false;
+        files_completed_ = 0;
+        files_ok_ = 0;
+        files_received_ = 0;
+        files_corrupt_ = 0;
+        files_failed_ = 0;
+        links_.clear();
+    }
+
+private:
+    // user_data of an op, timed when metrics are on
+    void set_tag(struct io_uring_sqe* sqe, uint64_t tag) {
+        io_uring_sqe_set_data64(sqe, tag);
+        if (cfg_.metrics) clock_.start(tag);
+    }
+
+    // ---- Disk ops ----
+
+    // Disk workers; if one fails to start the stream's ring does the writes
+    void start_workers() {
+        try {
+            for (unsigned w = 0; w < cfg_.write_workers; w++) {
+                workers_.push_back(std::make_unique<DiskWorker>(
+                    cfg_, static_cast<unsigned>(batch_files_.size()), ring_.ring_fd));
+            }
+        } catch (const std::exception& e) {
+            fmt::print(stderr, "Warning: {}, writing from the stream's ring\n", e.what());
+            stop_workers();
+            return;
+        }
+        outbox_.resize(workers_.size());
+        for (const auto& worker : workers_) batch_direct_ = batch_direct_ && worker->direct();
+    }
+
+    // Workers exit once their ops are done; results are not collected
+    void stop_workers() {
+        if (workers_.empty()) return;
+        for (size_t w = 0; w < workers_.size(); w++) {
+            workers_[w]->stop();
+            ring_doorbell(&ring_, workers_[w]->ring_fd(), 1 + w);
+        }
+        io_uring_submit(&ring_);
+        workers_.clear();
+    }
+
+    // Queue chain_ on the stream's ring, or hand it to disk worker
+    // affinity % workers, which keeps all of a file's ops on one worker
+    void submit_chain(size_t affinity) {
+        if (workers_.empty()) {
+            ring_reserve(&ring_, static_cast<unsigned>(chain_.size()));
+            for (const DiskOp& op : chain_) {
+                struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+                prep_disk_op(sqe, op);
+                set_tag(sqe, op.tag);
+            }
+        } else {
+            if (cfg_.metrics) {
+                for (const DiskOp& op : chain_) clock_.start(op.tag);
+            }
+            outbox_.add(affinity, chain_);
+        }
+        in_flight_ += chain_.size();
+        chain_.clear();
+    }
+
+    // Hand queued ops over, before waiting
+    void post_disk_ops() {
+        for (size_t w = 0; w < outbox_.workers(); w++) {
+            if (!outbox_[w].empty() && workers_[w]->post(outbox_[w])) {
+                ring_doorbell(&ring_, workers_[w]->ring_fd(), 1 + w);
+                in_flight_++;
+            }
+        }
+    }
+
+    // A worker rang: complete its ops as if they ran here
+    void take_disk_results() {
+        for (auto& worker : workers_) {
+            worker->take_results(results_);
+            for (const DiskResult& r : results_) {
+                in_flight_--;
+                if (cfg_.metrics) clock_.finish<RecvOp>(r.tag, 0, *cfg_.metrics);
+                handle_completion(tag_op<RecvOp>(r.tag), tag_index(r.tag), r.res, 0);
+            }
+        }
+    }
+
+    // A MKDIR index names its directory: file slot, batch flag, chain position
+    static uint64_t mkdir_index(unsigned slot, bool batch, size_t i) {
+        return static_cast<uint64_t>(slot) << 5 | (batch ? 16 : 0) | i;
+    }
+
+    // Queue mkdirat ops for path's parents not known to exist; dirs keeps
+    // their paths until the ops complete. Without mkdirat, for deep runs
+    // and for synchronous batch writes they are made here instead.
+    void queue_parents(const std::string& path, std::vector<std::string>& dirs, unsigned slot,
+                       bool batch) {
+        dir_cache_.missing(path, dirs);
+        if (dirs.empty()) return;
+
+        if (!mkdir_chain_ || dirs.size() > MAX_DIR_CHAIN || (batch && !batch_direct_)) {
+            // Other streams may race on the same parents - that's fine
+            std::error_code ec;
+            fs::create_directories(dirs.back(), ec);
+            if (!ec) {
+                for (const auto& dir : dirs) dir_cache_.made(dir);
+            }
+            dirs.clear();
+            return;
+        }
+        for (size_t i = 0; i < dirs.size(); i++) {
+            DiskOp op{DiskOp::MKDIR};
+            op.sqe_flags = IOSQE_IO_HARDLINK;
+            op.path = dirs[i].c_str();
+            op.tag = make_tag(RecvOp::MKDIR, mkdir_index(slot, batch, i));
+            chain_.push_back(op);
+        }
+    }
+
+    void on_mkdir(uint64_t index, int res) {
+        unsigned slot = static_cast<unsigned>(index >> 5);
+        const auto& dirs = (index & 16) ? batch_files_[slot].dirs : contexts_[slot].dirs;
+        const std::string& dir = dirs[index & 15];
+        if (res == 0 || res == -EEXIST) {
+            dir_cache_.made(dir);
+        } else if (cfg_.verbose) {
+            fmt::print(stderr, "Error creating {}: {}\n", dir, strerror(-res));
+        }
+    }
+
+    // ---- Socket side (chunk mode) ----
+
+    // Keep one recv in flight. A new target (header, metadata or a chunk)
+    // waits for a free file slot or buffer, which is the backpressure.
+    void post_recv() {
+        if (recv_in_flight_ || error_ || phase_ == StreamPhase::DONE) return;
+
+        if (rx_want_ == 0) {
+            if (phase_ == StreamPhase::DATA) {
+                auto [buffer, buf_idx] = buffer_pool_.acquire();
+                if (buf_idx < 0) return;
+                RecvPiece& piece = pieces_[buf_idx];
+                piece.file = current_;
+                piece.data = buffer;
+                piece.offset = current_->received;
+                piece.len = static_cast<uint32_t>(std::min<uint64_t>(
+                    data_left(), buffer_pool_.buffer_size()));
+                piece.written = 0;
+                rx_piece_ = buf_idx;
+                rx_buf_ = buffer;
+                rx_want_ = piece.len;
+            } else if (!begin_message_target()) {
+                return;
+            }
+            rx_got_ = 0;
+        }
+
+        struct io_uring_sqe* sqe = get_net_sqe(&ring_);
+        if (!sqe) return;
+        io_uring_prep_recv(sqe, sockfd_, rx_buf_ + rx_got_, rx_want_ - rx_got_, MSG_WAITALL);
+        set_tag(sqe, make_tag(RecvOp::RECV, 0));
+        recv_in_flight_ = true;
+        in_flight_++;
+    }
+
+    void on_recv(int res) {
+        recv_in_flight_ = false;
+        if (res <= 0) {
+            fmt::print(stderr, "Receive failed: {}\n", res < 0 ? strerror(-res) : "connection closed");
+            error_ = true;
+            return;
+        }
+
+        rx_got_ += res;
+        if (rx_got_ < rx_want_) return;     // Short recv - post_recv() continues
+        rx_want_ = 0;
+
+        if (phase_ == StreamPhase::DATA) {
+            RecvPiece& piece = pieces_[rx_piece_];
+            RecvContext& ctx = *piece.file;
+            consume_data(piece.data, piece.len);
+            dispatch_piece(rx_piece_);
+            rx_piece_ = -1;
+            close_if_done(ctx);
+        } else {
+            finish_message_target();
+        }
+    }
+
+    // ---- Socket side (zero_copy: provided buffer ring) ----
+
+    bool setup_buf_ring() {
+        size_t count = buffer_pool_.count();
+        buf_ring_entries_ = 1;
+        while (buf_ring_entries_ < count) buf_ring_entries_ <<= 1;
+
+        int ret = 0;
+        buf_ring_ = io_uring_setup_buf_ring(&ring_, buf_ring_entries_, RECV_BUF_GROUP, 0, &ret);
+        if (!buf_ring_) {
+            fmt::print(stderr, "io_uring_setup_buf_ring: {}\n", strerror(-ret));
+            return false;
+        }
+
+        buf_refs_.assign(count, 0);
+        int mask = io_uring_buf_ring_mask(buf_ring_entries_);
+        for (size_t i = 0; i < count; i++) {
+            io_uring_buf_ring_add(buf_ring_, buffer_pool_.buffers()[i], buffer_pool_.buffer_size(),
+                                  static_cast<unsigned short>(i), mask, static_cast<int>(i));
+        }
+        io_uring_buf_ring_advance(buf_ring_, static_cast<int>(count));
+        ring_available_ = count;
+        return true;
+    }
+
+    // Arm the multishot recv; it ends on -ENOBUFS and is re-armed once a
+    // buffer is back in the ring
+    void post_multishot_recv() {
+        if (recv_in_flight_ || error_ || peer_closed_ || phase_ == StreamPhase::DONE) return;
+        if (ring_available_ == 0) return;
+
+        struct io_uring_sqe* sqe = get_net_sqe(&ring_);
+        if (!sqe) return;
+        io_uring_prep_recv_multishot(sqe, sockfd_, nullptr, 0, 0);
+        sqe->flags |= IOSQE_BUFFER_SELECT;
+        sqe->buf_group = RECV_BUF_GROUP;
+        set_tag(sqe, make_tag(RecvOp::RECV, 0));
+        recv_in_flight_ = true;
+        in_flight_++;
+    }
+
+    void on_multishot_recv(int res, uint32_t flags) {
+        if (flags & IORING_CQE_F_MORE) {
+            in_flight_++;               // Still armed
+        } else {
+            recv_in_flight_ = false;
+        }
+
+        if (flags & IORING_CQE_F_BUFFER) {
+            int bid = static_cast<int>(flags >> IORING_CQE_BUFFER_SHIFT);
+            ring_available_--;
+            buf_refs_[bid] = 1;         // Held by the parser until consumed
+            if (res > 0) {
+                backlog_.push_back({bid, 0, static_cast<uint32_t>(res)});
+                parse_backlog();
+                return;
+            }
+            unref_ring_buffer(bid);
+        }
+
+        if (res == -ENOBUFS) return;    // Ring drained - backpressure
+        if (phase_ == StreamPhase::DONE && (res == 0 || res == -ECANCELED)) return;
+
+        // The sender may close before a stalled parser has caught up
+        if (res == 0 && !backlog_.empty()) {
+            peer_closed_ = true;
+            return;
+        }
+        if (res < 0 || !(flags & IORING_CQE_F_MORE)) {
+            fmt::print(stderr, "Receive failed: {}\n", res < 0 ? strerror(-res) : "connection closed");
+            error_ = true;
+        }
+    }
+
+    // Consume received spans in order. Stalls (returns with the span kept)
+    // when a header needs a file slot or data needs a piece.
+    void parse_backlog() {
+        while (!backlog_.empty() && !error_ && phase_ != StreamPhase::DONE) {
+            RecvSpan& span = backlog_.front();
+            char* base = buffer_pool_.buffers()[span.buffer] + span.offset;
+
+            if (phase_ == StreamPhase::DATA) {
+                int idx = piece_free_.pop();
+                if (idx < 0) return;
+
+                RecvContext& ctx = *current_;
+                uint32_t n = static_cast<uint32_t>(std::min<uint64_t>(span.len, data_left()));
+                RecvPiece& piece = pieces_[idx];
+                piece.file = &ctx;
+                piece.data = base;
+                piece.offset = ctx.received;
+                piece.len = n;
+                piece.written = 0;
+                piece.buffer = span.buffer;
+                buf_refs_[span.buffer]++;
+
+                span.offset += n;
+                span.len -= n;
+                consume_data(base, n);
+                dispatch_piece(idx);
+                close_if_done(ctx);
+            } else {
+                if (rx_want_ == 0) {
+                    if (!begin_message_target()) return;
+                    rx_got_ = 0;
+                }
+                uint32_t n = static_cast<uint32_t>(std::min<size_t>(span.len, rx_want_ - rx_got_));
+                memcpy(rx_buf_ + rx_got_, base, n);
+                span.offset += n;
+                span.len -= n;
+                rx_got_ += n;
+                if (rx_got_ == rx_want_) {
+                    rx_want_ = 0;
+                    finish_message_target();
+                }
+            }
+
+            if (span.len == 0) {
+                int bid = span.buffer;
+                backlog_.pop_front();
+                unref_ring_buffer(bid);
+            }
+        }
+
+        if (peer_closed_ && backlog_.empty() && phase_ != StreamPhase::DONE && !error_) {
+            fmt::print(stderr, "Receive failed: connection closed\n");
+            error_ = true;
+        }
+
+        if (phase_ == StreamPhase::DONE) {
+            // Nothing may follow ALL_DONE; drop leftovers and disarm
+            while (!backlog_.empty()) {
+                int bid = backlog_.front().buffer;
+                backlog_.pop_front();
+                unref_ring_buffer(bid);
+            }
+            cancel_multishot_recv();
+        }
+    }
+
+    void unref_ring_buffer(int bid) {
+        if (--buf_refs_[bid] > 0) return;
+        io_uring_buf_ring_add(buf_ring_, buffer_pool_.buffers()[bid], buffer_pool_.buffer_size(),
+                              static_cast<unsigned short>(bid),
+                              io_uring_buf_ring_mask(buf_ring_entries_), 0);
+        io_uring_buf_ring_advance(buf_ring_, 1);
+        ring_available_++;
+    }
+
+    void cancel_multishot_recv() {
+        if (!recv_in_flight_ || cancel_sent_) return;
+        struct io_uring_sqe* sqe = get_net_sqe(&ring_);
+        if (!sqe) return;
+        io_uring_prep_cancel64(sqe, make_tag(RecvOp::RECV, 0), 0);
+        set_tag(sqe, make_tag(RecvOp::CANCEL, 0));
+        cancel_sent_ = true;
+        in_flight_++;
+    }
+
+    // ---- Message framing (both modes) ----
+
+    // Point rx_buf_ at the header or metadata staging buffer, or a batch
+    // buffer. A header is only started once a file slot is free, a batch
+    // once a batch buffer is, compressed data once an inflate buffer is.
+    bool begin_message_target() {
+        if (phase_ == StreamPhase::HDR) {
+            if (slots_.available() == 0) return false;
+            rx_buf_ = hdr_buf_.data();
+            rx_want_ = protocol::MSG_HEADER_SIZE;
+        } else if (phase_ == StreamPhase::FRAME) {
+            rx_buf_ = hdr_buf_.data();
+            rx_want_ = protocol::DATA_FRAME_HDR_SIZE;
+        } else if (phase_ == StreamPhase::ZDATA) {
+            if (inflate_pool_.available_count() == 0) return false;
+            rx_buf_ = zbuf_.data();
+            rx_want_ = frame_.data_len;
+        } else if (phase_ == StreamPhase::BATCH) {
+            auto [buffer, idx] = batch_pool_.acquire();
+            if (idx < 0) return false;
+            rx_batch_ = idx;
+            rx_buf_ = buffer;
+            rx_want_ = payload_len_;
+        } else if (phase_ == StreamPhase::END) {
+            rx_buf_ = hdr_buf_.data();
+            rx_want_ = protocol::FILE_END_CRC_SIZE;
+        } else {
+            rx_buf_ = meta_buf_.data();
+            rx_want_ = payload_len_;
+        }
+        return true;
+    }
+
+    void finish_message_target() {
+        if (phase_ == StreamPhase::HDR) {
+            on_header();
+        } else if (phase_ == StreamPhase::FRAME) {
+            on_frame();
+        } else if (phase_ == StreamPhase::ZDATA) {
+            on_zdata();
+        } else if (phase_ == StreamPhase::BATCH) {
+            on_batch();
+        } else if (phase_ == StreamPhase::END) {
+            on_file_end();
+        } else {
+            on_meta();
+        }
+    }
+
+    void on_header() {
+        protocol::MsgType type;
+        uint32_t payload_len;
+        protocol::parse_header(reinterpret_cast<uint8_t*>(hdr_buf_.data()), type, payload_len);
+
+        if (type == protocol::MsgType::ALL_DONE) {
+            phase_ = StreamPhase::DONE;
+            return;
+        }
+
+        if (type == protocol::MsgType::FILE_BATCH) {
+            if (payload_len < 2 || payload_len > batch_pool_.buffer_size()) {
+                fmt::print(stderr, "Bad file batch length: {}\n", payload_len);
+                error_ = true;
+                return;
+            }
+            payload_len_ = payload_len;
+            phase_ = StreamPhase::BATCH;
+            return;
+        }
+
+        // FILE_RESUME only in a resumed session, FILE_SPARSE and FILE_LINK
+        // only once agreed
+        resume_hdr_ = type == protocol::MsgType::FILE_RESUME && cfg_.journal;
+        sparse_hdr_ = type == protocol::MsgType::FILE_SPARSE && cfg_.sparse;
+        link_hdr_ = type == protocol::MsgType::FILE_LINK && cfg_.hardlinks;
+        if (type != protocol::MsgType::FILE_HDR && !resume_hdr_ && !sparse_hdr_ && !link_hdr_) {
+            fmt::print(stderr, "Unexpected message type: {}\n", (int)type);
+            error_ = true;
+            return;
+        }
+
+        if (payload_len == 0 || payload_len > meta_buf_.size()) {
+            fmt::print(stderr, "Bad file header length: {}\n", payload_len);
+            error_ = true;
+            return;
+        }
+        payload_len_ = payload_len;
+        phase_ = StreamPhase::META;
+    }
+
+    void on_meta() {
+        if (link_hdr_) {
+            on_link();
+            return;
+        }
+
+        protocol::FileHdrMsg hdr;
+        const uint8_t* meta = reinterpret_cast<uint8_t*>(meta_buf_.data());
+        uint64_t offset = 0;
+        if (!(resume_hdr_ ? protocol::parse_file_resume(meta, payload_len_, hdr, offset)
+                          : protocol::parse_file_hdr(meta, payload_len_, hdr))) {
+            fmt::print(stderr, "Failed to parse file header\n");
+            error_ = true;
+            return;
+        }
+
+        if (!protocol::is_safe_path(hdr.path)) {
+            fmt::print(stderr, "Unsafe path: {}\n", hdr.path);
+            error_ = true;
+            return;
+        }
+
+        // HDR only starts once a slot is free
+        int slot = slots_.pop();
+        RecvContext& ctx = contexts_[slot];
+        ctx.path = (fs::path(dst_path_) / hdr.path).string();
+        ctx.fd = -1;
+        ctx.file_size = hdr.size;
+        ctx.mode = hdr.mode;
+        ctx.has_mtime = hdr.has_mtime;
+        ctx.mtime_ns = hdr.mtime_ns;
+        ctx.sparse = sparse_hdr_;
+        // O_DIRECT takes only whole aligned pieces: chunk mode's buffers
+        // from an aligned start, all but the last one full
+        ctx.direct = cfg_.direct_size != 0 && hdr.size >= cfg_.direct_size && !buf_ring_ &&
+                     !framed_ && !sparse_hdr_ && direct_aligned(offset) &&
+                     direct_aligned(buffer_pool_.buffer_size());
+        ctx.received = offset;
+        ctx.writes_in_flight = 0;
+        ctx.committed = offset;
+        ctx.landed.clear();
+        ctx.checkpointed = offset;      // The journal has the first offset bytes
+        ctx.opened = false;
+        ctx.failed = false;
+        ctx.closing = false;
+        ctx.pending.clear();
+        ctx.crc = 0;
+        ctx.checked = !cfg_.verify;
+        ctx.corrupt = false;
+
+        queue_parents(ctx.path, ctx.dirs, slot, false);
+        queue_open(slot, offset > 0);
+
+        // Data may follow right away; the open runs meanwhile
+        current_ = &ctx;
+        if (ctx.file_size > 0) {
+            phase_ = framed() ? StreamPhase::FRAME : StreamPhase::DATA;
+        } else {
+            next_data_phase();
+        }
+    }
+
+    void queue_open(size_t slot, bool keep) {
+        RecvContext& ctx = contexts_[slot];
+        DiskOp open{DiskOp::OPEN};
+        open.path = ctx.path.c_str();
+        open.mode = ctx.mode;
+        open.tag = make_tag(RecvOp::OPEN, slot);
+        open.keep = keep;
+        open.direct = ctx.direct;
+        chain_.push_back(open);
+        submit_chain(slot);
+    }
+
+    // FILE_LINK: made once the session is done, when its target is in
+    void on_link() {
+        phase_ = StreamPhase::HDR;
+        std::string path, target;
+        if (!protocol::parse_file_link(reinterpret_cast<uint8_t*>(meta_buf_.data()), payload_len_,
+                                       path, target)) {
+            fmt::print(stderr, "Failed to parse file link\n");
+            error_ = true;
+            return;
+        }
+        if (!protocol::is_safe_path(path) || !protocol::is_safe_path(target)) {
+            fmt::print(stderr, "Unsafe link: {} -> {}\n", path, target);
+            error_ = true;
+            return;
+        }
+        links_.emplace_back(std::move(path), std::move(target));
+    }
+
+    // Compare the sender's CRC with ours (unless the file already failed
+    // here). A mismatch fails the file; it is removed once closed.
+    void on_file_end() {
+        RecvContext& ctx = *current_;
+        current_ = nullptr;
+        phase_ = StreamPhase::HDR;
+
+        const uint8_t* buf = reinterpret_cast<uint8_t*>(hdr_buf_.data());
+        protocol::MsgType type;
+        uint32_t payload_len;
+        protocol::parse_header(buf, type, payload_len);
+        if (type != protocol::MsgType::FILE_END || payload_len != protocol::CRC_SIZE) {
+            fmt::print(stderr, "Expected FILE_END after {}\n", ctx.path);
+            error_ = true;
+            return;
+        }
+
+        uint32_t expected = protocol::read_u32(buf + protocol::MSG_HEADER_SIZE);
+        if (!ctx.failed && expected != ctx.crc) {
+            fmt::print(stderr, "Checksum mismatch on {}: sent {:08x}, received {:08x}\n",
+                       ctx.path, expected, ctx.crc);
+            ctx.corrupt = true;
+            files_corrupt_++;
+            fail_file(ctx, -EBADMSG);
+        }
+        ctx.checked = true;
+        close_if_done(ctx);
+    }
+
+    // ---- Data frames (compressed session, sparse file) ----
+
+    // The current file's data comes as frames
+    bool framed() const { return framed_ || current_->sparse; }
+
+    // Bytes the current DATA run may still take: the rest of the file, or
+    // of the current raw frame
+    uint64_t data_left() const {
+        return framed() ? frame_left_ : current_->file_size - current_->received;
+    }
+
+    // n bytes of the current file came off the socket
+    void consume_data(const char* data, uint64_t n) {
+        if (cfg_.verify) current_->crc = crc32c(current_->crc, data, n);
+        current_->received += n;
+        if (framed()) frame_left_ -= n;
+        next_data_phase();
+    }
+
+    void next_data_phase() {
+        if (current_->received >= current_->file_size) {
+            if (cfg_.verify) {
+                phase_ = StreamPhase::END;
+                return;
+            }
+            current_ = nullptr;
+            phase_ = StreamPhase::HDR;
+        } else if (framed() && frame_left_ == 0) {
+            phase_ = StreamPhase::FRAME;
+        }
+    }
+
+    void on_frame() {
+        const uint8_t* buf = reinterpret_cast<uint8_t*>(hdr_buf_.data());
+        protocol::MsgType type;
+        uint32_t payload_len;
+        protocol::parse_header(buf, type, payload_len);
+
+        RecvContext& ctx = *current_;
+        if (type == protocol::MsgType::FILE_HOLE && ctx.sparse) {
+            on_hole(buf + protocol::MSG_HEADER_SIZE, payload_len);
+            return;
+        }
+        // Compressed frames only in a compressed session
+        if (type != protocol::MsgType::FILE_DATA ||
+            !protocol::parse_data_frame(buf + protocol::MSG_HEADER_SIZE, payload_len,
+                                        ctx.file_size - ctx.received, frame_) ||
+            (frame_.codec != protocol::Codec::NONE &&
+             (!framed_ || frame_.data_len > zbuf_.size()))) {
+            fmt::print(stderr, "Bad data frame for {}\n", ctx.path);
+            error_ = true;
+            return;
+        }
+
+        if (frame_.codec == protocol::Codec::NONE) {
+            frame_left_ = frame_.raw_len;
+            phase_ = StreamPhase::DATA;
+        } else {
+            phase_ = StreamPhase::ZDATA;
+        }
+    }
+
+    // Skip a hole: nothing is written there. It never ends the file (the
+    // sender sends the last byte as data), so the size comes from a write.
+    void on_hole(const uint8_t* payload, uint32_t len) {
+        RecvContext& ctx = *current_;
+        uint64_t hole;
+        if (!protocol::parse_file_hole(payload, len, ctx.file_size - ctx.received, hole)) {
+            fmt::print(stderr, "Bad hole for {}\n", ctx.path);
+            error_ = true;
+            return;
+        }
+        if (cfg_.verify) ctx.crc = crc32c_zeros(ctx.crc, hole);
+        if (cfg_.journal && !ctx.failed) land(ctx, ctx.received, hole);
+        ctx.received += hole;
+    }
+
+    // Inflate the staged frame into an inflate buffer and write it as a piece
+    void on_zdata() {
+        RecvContext& ctx = *current_;
+        uint64_t offset = ctx.received;
+        ctx.received += frame_.raw_len;
+
+        if (ctx.failed) {
+            next_data_phase();
+            close_if_done(ctx);
+            return;
+        }
+
+        auto [buffer, buf_idx] = inflate_pool_.acquire();
+        if (!codec_->decompress(frame_.codec, reinterpret_cast<uint8_t*>(zbuf_.data()),
+                                frame_.data_len, reinterpret_cast<uint8_t*>(buffer),
+                                frame_.raw_len)) {
+            fmt::print(stderr, "Corrupt compressed data for {}\n", ctx.path);
+            inflate_pool_.release(buf_idx);
+            error_ = true;
+            return;
+        }
+        if (cfg_.verify) ctx.crc = crc32c(ctx.crc, buffer, frame_.raw_len);
+        next_data_phase();
+
+        int idx = inflate_base_ + buf_idx;
+        RecvPiece& piece = pieces_[idx];
+        piece.file = &ctx;
+        piece.data = buffer;
+        piece.offset = offset;
+        piece.len = frame_.raw_len;
+        piece.written = 0;
+        dispatch_piece(idx);
+        close_if_done(ctx);
+    }
+
+    void on_batch() {
+        int b = rx_batch_;
+        rx_batch_ = -1;
+        phase_ = StreamPhase::HDR;
+
+        const uint8_t* payload = reinterpret_cast<uint8_t*>(batch_pool_.buffers()[b]);
+        bool ok = protocol::parse_file_batch(payload, payload_len_, batch_entries_,
+                                             cfg_.incremental, cfg_.verify);
+        if (!ok) fmt::print(stderr, "Failed to parse file batch\n");
+        for (size_t i = 0; ok && i < batch_entries_.size(); i++) {
+            if (!protocol::is_safe_path(batch_entries_[i].path)) {
+                fmt::print(stderr, "Unsafe path: {}\n", batch_entries_[i].path);
+                ok = false;
+            }
+        }
+        if (!ok) {
+            batch_pool_.release(b);
+            error_ = true;
+            return;
+        }
+
+        batch_left_[b] = static_cast<uint16_t>(batch_entries_.size());
+        for (size_t i = 0; i < batch_entries_.size(); i++) {
+            const protocol::BatchEntry& entry = batch_entries_[i];
+            unsigned slot = b * protocol::MAX_BATCH_FILES + i;
+            BatchFile& f = batch_files_[slot];
+            f.path = (fs::path(dst_path_) / entry.path).string();
+            f.size = static_cast<uint32_t>(entry.size);
+            f.failed = false;
+            f.mtime_ns = entry.mtime_ns;
+
+            // A corrupt entry is not written; an old copy stays as it was
+            if (cfg_.verify) {
+                uint32_t crc = crc32c(0, entry.data, entry.size);
+                if (crc != entry.crc) {
+                    fmt::print(stderr, "Checksum mismatch on {}: sent {:08x}, received {:08x}\n",
+                               f.path, entry.crc, crc);
+                    files_corrupt_++;
+                    f.failed = true;
+                    finish_batch_file(slot);
+                    continue;
+                }
+            }
+
+            queue_parents(f.path, f.dirs, slot, true);
+            if (batch_direct_) {
+                submit_batch_chain(slot, entry);
+            } else {
+                write_batch_file_sync(slot, entry);
+            }
+        }
+    }
+
+    // open → write → close on the entry's slot. A failed open cancels the
+    // rest; the close is hard-linked so a failed write still frees the slot.
+    void submit_batch_chain(unsigned slot, const protocol::BatchEntry& entry) {
+        BatchFile& f = batch_files_[slot];
+        f.ops_left = entry.size > 0 ? 3 : 2;
+
+        DiskOp op{DiskOp::OPEN_DIRECT};
+        op.sqe_flags = IOSQE_IO_LINK;
+        op.fd = static_cast<int>(slot);
+        op.path = f.path.c_str();
+        op.mode = entry.mode;
+        op.tag = make_tag(RecvOp::BATCH_OPEN, slot);
+        chain_.push_back(op);
+
+        if (entry.size > 0) {
+            op = DiskOp{DiskOp::WRITE_FIXED};
+            op.sqe_flags = IOSQE_IO_HARDLINK;
+            op.fd = static_cast<int>(slot);
+            op.buf = entry.data;
+            op.len = f.size;
+            op.tag = make_tag(RecvOp::BATCH_WRITE, slot);
+            chain_.push_back(op);
+        }
+
+        op = DiskOp{DiskOp::CLOSE_DIRECT};
+        op.fd = static_cast<int>(slot);
+        op.tag = make_tag(RecvOp::BATCH_CLOSE, slot);
+        chain_.push_back(op);
+        submit_chain(slot);
+    }
+
+    void write_batch_file_sync(unsigned slot, const protocol::BatchEntry& entry) {
+        BatchFile& f = batch_files_[slot];
+        int fd = open(f.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, entry.mode & 0777);
+        int err = fd < 0 ? -errno : 0;
+        if (fd >= 0) {
+            if (entry.size > 0 && write(fd, entry.data, f.size) != (ssize_t)f.size) err = -EIO;
+            if (err == 0 && cfg_.incremental) set_mtime(fd, f.mtime_ns);
+            close(fd);
+        }
+        if (err < 0) fail_batch_file(f, err);
+        finish_batch_file(slot);
+    }
+
+    void on_batch_op(RecvOp op, unsigned slot, int res) {
+        BatchFile& f = batch_files_[slot];
+        if (op == RecvOp::BATCH_WRITE && res >= 0 && (uint32_t)res != f.size) res = -EIO;
+        if (res < 0 && res != -ECANCELED) fail_batch_file(f, res);
+        if (--f.ops_left > 0) return;
+
+        // The slot is closed by now; no io_uring op for utimensat
+        if (!f.failed && cfg_.incremental) {
+            struct timespec times[2] = {{0, UTIME_OMIT}, from_mtime_ns(f.mtime_ns)};
+            utimensat(AT_FDCWD, f.path.c_str(), times, 0);
+        }
+        finish_batch_file(slot);
+    }
+
+    void fail_batch_file(BatchFile& f, int err) {
+        if (!f.failed) {
+            fmt::print(stderr, "Error on {}: {}\n", f.path, strerror(-err));
+            files_failed_++;
+        }
+        f.failed = true;
+    }
+
+    void finish_batch_file(unsigned slot) {
+        count_file(!batch_files_[slot].failed);
+        int b = slot / protocol::MAX_BATCH_FILES;
+        if (--batch_left_[b] == 0) batch_pool_.release(b);
+    }
+
+    // ---- File side ----
+
+    // Write now, park until the open completes, or drop for a failed file
+    void dispatch_piece(int idx) {
+        RecvContext& ctx = *pieces_[idx].file;
+        if (ctx.failed) {
+            release_piece(idx);
+        } else if (ctx.opened) {
+            submit_write(idx);
+        } else {
+            ctx.pending.push_back(idx);
+        }
+    }
+
+    void release_piece(int idx) {
+        if (idx >= inflate_base_) {
+            inflate_pool_.release(idx - inflate_base_);
+        } else if (buf_ring_) {
+            unref_ring_buffer(pieces_[idx].buffer);
+            piece_free_.push(idx);
+        } else {
+            buffer_pool_.release(idx);
+        }
+    }
+
+    void submit_write(int idx) {
+        RecvPiece& piece = pieces_[idx];
+        RecvContext& ctx = *piece.file;
+
+        DiskOp op{DiskOp::WRITE};
+        op.fd = ctx.fd;
+        op.buf = piece.data + piece.written;
+        op.len = piece.len - piece.written;
+        op.offset = piece.offset + piece.written;
+        if (ctx.direct && !direct_aligned(op.len)) {
+            // The file's last piece: written whole, cut back before the close
+            op.len = pad_direct(piece.data + piece.written, op.len);
+        }
+        op.tag = make_tag(RecvOp::WRITE, idx);
+        chain_.push_back(op);
+        submit_chain(&ctx - contexts_.data());
+        ctx.writes_in_flight++;
+    }
+
+    void handle_completion(RecvOp op, uint64_t index, int res, uint32_t flags) {
+        switch (op) {
+            case RecvOp::RECV:
+                if (buf_ring_) {
+                    on_multishot_recv(res, flags);
+                } else {
+                    on_recv(res);
+                }
+                break;
+
+            case RecvOp::CANCEL:
+                break;
+
+            case RecvOp::OPEN: {
+                RecvContext& ctx = contexts_[index];
+                if (res == -EINVAL && ctx.direct) {
+                    // No direct I/O on this filesystem: the file goes buffered
+                    ctx.direct = false;
+                    queue_open(index, ctx.committed > 0);
+                    break;
+                }
+                ctx.opened = true;
+                if (res < 0) {
+                    fail_file(ctx, res);
+                } else {
+                    ctx.fd = res;
+                    for (int idx : ctx.pending) submit_write(idx);
+                    ctx.pending.clear();
+                }
+                close_if_done(ctx);
+                break;
+            }
+
+            case RecvOp::WRITE: {
+                int idx = static_cast<int>(index);
+                RecvPiece& piece = pieces_[idx];
+                RecvContext& ctx = *piece.file;
+                ctx.writes_in_flight--;
+                if (res <= 0) {
+                    fail_file(ctx, res < 0 ? res : -EIO);
+                } else {
+                    piece.written += res;
+                    if (piece.written < piece.len && !ctx.failed) {
+                        submit_write(idx);      // Short write
+                        break;
+                    }
+                    if (cfg_.journal && !ctx.failed) land(ctx, piece.offset, piece.len);
+                }
+                release_piece(idx);
+                close_if_done(ctx);
+                break;
+            }
+
+            case RecvOp::CLOSE:
+                finish_file(contexts_[index]);
+                break;
+
+            case RecvOp::BATCH_OPEN:
+            case RecvOp::BATCH_WRITE:
+            case RecvOp::BATCH_CLOSE:
+                on_batch_op(op, static_cast<unsigned>(index), res);
+                break;
+
+            case RecvOp::MKDIR:
+                on_mkdir(index, res);
+                break;
+
+            case RecvOp::WAKE:
+                // Doorbell rung on worker index - 1; a full CQ there bounces it
+                if (res == -EOVERFLOW) {
+                    ring_doorbell(&ring_, workers_[index - 1]->ring_fd(), index);
+                    in_flight_++;
+                }
+                break;
+        }
+    }
+
+    // The file is dropped but its bytes are still consumed from the stream.
+    // A corrupt file was reported and counted by the FILE_END check.
+    void fail_file(RecvContext& ctx, int err) {
+        if (!ctx.failed && !ctx.corrupt) {
+            fmt::print(stderr, "Error on {}: {}\n", ctx.path, strerror(-err));
+            files_failed_++;
+        }
+        ctx.failed = true;
+        for (int idx : ctx.pending) release_piece(idx);
+        ctx.pending.clear();
+    }
+
+    // Close once opened, fully received and all writes have landed
+    void close_if_done(RecvContext& ctx) {
+        if (ctx.closing || !ctx.opened || ctx.writes_in_flight > 0 ||
+            ctx.received < ctx.file_size || !ctx.checked) {
+            return;
+        }
+
+        if (ctx.fd < 0) {
+            finish_file(ctx);
+            return;
+        }
+
+        // All writes have landed: a padded O_DIRECT tail is cut off, and a
+        // failed stamp only means a resend next time
+        if (ctx.direct && !ctx.failed && !direct_aligned(ctx.file_size) &&
+            ftruncate(ctx.fd, ctx.file_size) != 0) {
+            fail_file(ctx, -errno);
+        }
+        if (ctx.has_mtime && !ctx.failed) set_mtime(ctx.fd, ctx.mtime_ns);
+
+        size_t slot = &ctx - contexts_.data();
+        DiskOp op{DiskOp::CLOSE};
+        op.fd = ctx.fd;
+        op.tag = make_tag(RecvOp::CLOSE, slot);
+        chain_.push_back(op);
+        ctx.closing = true;
+        submit_chain(slot);
+    }
+
+    // ---- Resume journal ----
+
+    // A piece of ctx is on disk: advance the prefix and record it every
+    // CHECKPOINT_BYTES, so a lost stream resends at most that much
+    void land(RecvContext& ctx, uint64_t offset, uint64_t len) {
+        if (offset > ctx.committed) {
+            ctx.landed[offset] = offset + len;
+            return;
+        }
+        ctx.committed = std::max(ctx.committed, offset + len);
+        for (auto it = ctx.landed.begin(); it != ctx.landed.end() && it->first <= ctx.committed;
+             it = ctx.landed.erase(it)) {
+            ctx.committed = std::max(ctx.committed, it->second);
+        }
+        if (ctx.committed - ctx.checkpointed >= CHECKPOINT_BYTES &&
+            ctx.committed < ctx.file_size) {
+            checkpoint(ctx);
+        }
+    }
+
+    void checkpoint(RecvContext& ctx) {
+        cfg_.journal->range(cfg_.journal->key(ctx.path), ctx.file_size, ctx.mtime_ns, 0,
+                            ctx.committed);
+        ctx.checkpointed = ctx.committed;
+    }
+
+    // The stream ended early: record how far each open file got
+    void checkpoint_open_files() {
+        for (auto& ctx : contexts_) {
+            if (ctx.fd >= 0 && !ctx.closing && !ctx.failed && ctx.has_mtime &&
+                ctx.committed > ctx.checkpointed) {
+                checkpoint(ctx);
+            }
+        }
+    }
+
+    void finish_file(RecvContext& ctx) {
+        if (ctx.corrupt) unlink(ctx.path.c_str());
+        // Complete (or removed): the journal drops it
+        if (cfg_.journal && ctx.checkpointed > 0 && (!ctx.failed || ctx.corrupt)) {
+            cfg_.journal->finish(cfg_.journal->key(ctx.path));
+        }
+        ctx.fd = -1;
+        ctx.closing = false;
+        count_file(!ctx.failed);
+        slots_.push(static_cast<int>(&ctx - contexts_.data()));
+    }
+
+    void count_file(bool ok) {
+        files_completed_++;
+        if (ok) files_ok_++;
+
+        if (cfg_.progress && files_completed_ % 1000 == 0) {
+            fmt::print("Received {} files\r", files_completed_);
+        }
+    }
+
+    int sockfd_;
+    std::string dst_path_;
+    NetConfig cfg_;
+    OpClock clock_;
+    struct io_uring ring_;
+    BufferPool buffer_pool_;            // Chunk buffers, or the ring's backing memory
+    std::vector<RecvContext> contexts_; // File slots
+    FreeList slots_;
+    std::vector<RecvPiece> pieces_;
+    FreeList piece_free_;               // zero_copy only
+    std::vector<char> hdr_buf_;
+    std::vector<char> meta_buf_;
+
+    // FILE_BATCH
+    BufferPool batch_pool_;
+    std::vector<BatchFile> batch_files_;        // BATCH_BUFFERS x MAX_BATCH_FILES slots
+    std::vector<uint16_t> batch_left_;          // Entries still being written, per buffer
+    std::vector<protocol::BatchEntry> batch_entries_;
+    bool batch_direct_ = false;                 // Fixed-file chains available
+
+    // Compressed session
+    bool framed_;
+    BufferPool inflate_pool_;                   // Inflated frames being written
+    int inflate_base_ = 0;                      // Piece index of inflate buffer 0
+    std::unique_ptr<ChunkCodec> codec_;
+    std::vector<char> zbuf_;                    // Compressed payload staging
+    protocol::DataFrame frame_{};
+    uint64_t frame_left_ = 0;                   // Raw frame bytes still to take
+
+    // Disk ops
+    DirCache dir_cache_;
+    bool mkdir_chain_ = false;                  // mkdirat ops available
+    std::vector<DiskOp> chain_;                 // Ops of the chain being queued
+    std::vector<std::unique_ptr<DiskWorker>> workers_;     // write_workers
+    DiskOutbox outbox_;                 // Per worker, posted before each wait
+    std::vector<DiskResult> results_;
+
+    // Socket read cursor
+    StreamPhase phase_ = StreamPhase::HDR;
+    char* rx_buf_ = nullptr;
+    size_t rx_want_ = 0;                // 0 = no target yet
+    size_t rx_got_ = 0;
+    int rx_piece_ = -1;
+    int rx_batch_ = -1;
+    uint32_t payload_len_ = 0;
+    bool resume_hdr_ = false;           // The header being read is a FILE_RESUME
+    bool sparse_hdr_ = false;           // ... a FILE_SPARSE
+    bool link_hdr_ = false;             // ... a FILE_LINK
+    std::vector<std::pair<std::string, std::string>> links_;
+    RecvContext* current_ = nullptr;    // File whose data is on the wire
+    bool recv_in_flight_ = false;
+
+    // Provided buffer ring (zero_copy)
+    struct io_uring_buf_ring* buf_ring_ = nullptr;
+    unsigned buf_ring_entries_ = 0;
+    size_t ring_available_ = 0;         // Buffers the kernel may fill
+    std::vector<uint16_t> buf_refs_;    // Parser + pieces holding each buffer
+    std::deque<RecvSpan> backlog_;
+    bool cancel_sent_ = false;
+    bool peer_closed_ = false;          // EOF seen with backlog still unparsed
+
+    size_t in_flight_ = 0;
+    bool error_ = false;
+    size_t files_completed_ = 0;
+    size_t files_ok_ = 0;
+    size_t files_received_ = 0;
+    size_t files_corrupt_ = 0;          // Failed the FILE_END check (verify)
+    size_t files_failed_ = 0;           // Not written: open, write or close failed
+};
+
+// ============================================================
+// Connection Helpers
+// ============================================================
+
+static bool send_all(int sockfd, const void* buf, size_t len, int flags = 0) {
+    const uint8_t* p = static_cast<const uint8_t*>(buf);
+    size_t sent = 0;
+    while (sent < len) {
+        ssize_t n = send(sockfd, p + sent, len - sent, flags);
+        if (n <= 0) return false;
+        sent += n;
+    }
+    return true;
+}
+
+static bool recv_all(int sockfd, void* buf, size_t len) {
+    uint8_t* p = static_cast<uint8_t*>(buf);
+    size_t received = 0;
+    while (received < len) {
+        ssize_t n = recv(sockfd, p + received, len - received, 0);
+        if (n <= 0) return false;
+        received += n;
+    }
+    return true;
+}
+
+static int connect_to_host(const std::string& host, uint16_t port) {
+    struct addrinfo hints = {}, *res;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    std::string port_str = std::to_string(port);
+    if (getaddrinfo(host.c_str(), port_str.c_str(), &hints, &res) != 0) {
+        fmt::print(stderr, "Failed to resolve host\n");
+        return -1;
+    }
+
+    int sockfd = -1;
+    for (auto* p = res; p; p = p->ai_next) {
+        sockfd = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+        if (sockfd < 0) continue;
+        if (connect(sockfd, p->ai_addr, p->ai_addrlen) == 0) break;
+        close(sockfd);
+        sockfd = -1;
+    }
+    freeaddrinfo(res);
+    return sockfd;
+}
+
+// Sender side: HELLO → HELLO_OK, then kTLS if requested. The whole
+// HELLO_OK payload is consumed; leaving it unread makes close() send RST,
+// which can drop our ALL_DONE. peer_version is the receiver's version,
+// codec the compression it accepted (NONE unless it is the one we asked for),
+// flags the requested session flags it accepted.
+static bool client_handshake(int sockfd, const std::string& secret,
+                             const protocol::SessionInfo& session, bool use_tls,
+                             uint8_t& peer_version, protocol::Codec& codec,
+                             uint8_t& flags) {
+    // Each stream has its own nonce pair, so its own kTLS keys
+    uint8_t nonce_sender[protocol::NONCE_SIZE];
+    if (!ktls::generate_nonce(nonce_sender)) {
+        fmt::print(stderr, "Failed to generate nonce\n");
+        return false;
+    }
+    auto hello = protocol::make_hello(secret, nonce_sender, session, codec, flags);
+    if (!send_all(sockfd, hello.data(), hello.size())) return false;
+
+    uint8_t resp_hdr[protocol::MSG_HEADER_SIZE];
+    if (!recv_all(sockfd, resp_hdr, sizeof(resp_hdr))) {
+        fmt::print(stderr, "Failed to receive auth response\n");
+        return false;
+    }
+
+    protocol::MsgType type;
+    uint32_t len;
+    protocol::parse_header(resp_hdr, type, len);
+    if (len > protocol::MAX_ERROR_MSG_LEN) return false;
+
+    std::vector<uint8_t> payload(len);
+    if (len > 0 && !recv_all(sockfd, payload.data(), len)) return false;
+
+    if (type != protocol::MsgType::HELLO_OK) {
+        if (type == protocol::MsgType::HELLO_FAIL && len >= 1 &&
+            payload[0] == protocol::FAIL_UNSUPPORTED) {
+            fmt::print(stderr, "Receiver does not support this mode (multi-stream needs recv --uring)\n");
+        } else {
+            fmt::print(stderr, "Authentication failed\n");
+        }
+        return false;
+    }
+
+    protocol::HelloOkMsg hello_ok;
+    if (!protocol::parse_hello_ok(payload.data(), len, hello_ok)) {
+        fmt::print(stderr, "Failed to parse HELLO_OK\n");
+        return false;
+    }
+    peer_version = hello_ok.version;
+    if (hello_ok.codec != codec) codec = protocol::Codec::NONE;
+    flags &= hello_ok.flags;
+
+    if (use_tls) {
+        ktls::KtlsKeys keys;
+        if (!ktls::derive_keys(secret, nonce_sender, hello_ok.nonce, keys)) {
+            fmt::print(stderr, "Failed to derive kTLS keys\n");
+            return false;
+        }
+        if (!ktls::enable_sender(sockfd, keys)) {
+            fmt::print(stderr, "Failed to enable kTLS\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+// Receiver side: read and parse HELLO (not answered yet)
+static bool recv_hello(int clientfd, protocol::HelloMsg& hello) {
+    uint8_t hdr_buf[protocol::MSG_HEADER_SIZE];
+    if (!recv_all(clientfd, hdr_buf, sizeof(hdr_buf))) {
+        fmt::print(stderr, "Failed to receive HELLO\n");
+        return false;
+    }
+
+    protocol::MsgType type;
+    uint32_t payload_len;
+    protocol::parse_header(hdr_buf, type, payload_len);
+
+    if (type != protocol::MsgType::HELLO) {
+        fmt::print(stderr, "Expected HELLO, got {}\n", (int)type);
+        return false;
+    }
+    if (payload_len > 2 + protocol::MAX_SECRET_LEN + protocol::NONCE_SIZE + 256) {
+        return false;
+    }
+
+    std::vector<uint8_t> payload(payload_len);
+    if (!recv_all(clientfd, payload.data(), payload_len)) return false;
+    return protocol::parse_hello(payload.data(), payload_len, hello);
+}
+
+static void reject_hello(int clientfd, uint8_t reason) {
+    auto fail = protocol::make_hello_fail(reason);
+    send_all(clientfd, fail.data(), fail.size());
+    close(clientfd);
+}
+
+// ============================================================
+// Incremental Sync
+// ============================================================
+
+// Receiver side: describe dst_path to the sender on stream 0
+static bool send_dst_manifest(int clientfd, const std::string& dst_path) {
+    std::vector<protocol::ManifestEntry> entries;
+    if (!build_manifest(dst_path, entries)) {
+        fmt::print(stderr, "Failed to scan {} for the manifest\n", dst_path);
+        return false;
+    }
+    fmt::print("Sending manifest: {} files\n", entries.size());
+    return send_manifest(entries, [clientfd](const uint8_t* data, size_t len) {
+        return send_all(clientfd, data, len);
+    });
+}
+
+// ============================================================
+// Resume
+// ============================================================
+// With FLAG_RESUME the receiver journals how far each large file got
+// (journal.hpp). On stream 0, ahead of the manifest, it lists the partial
+// files it holds a prefix of; the sender sends the rest of each one that
+// is still the same source as a FILE_RESUME.
+
+// Receiver side: the journal's partial files, by path hash
+static bool send_resume_list(int clientfd, const CheckpointJournal& journal) {
+    std::vector<protocol::ResumeEntry> entries;
+    for (const auto& [key, progress] : journal.partial()) {
+        uint64_t prefix = progress.prefix();
+        if (key == "." || prefix == 0 || prefix >= progress.size) continue;
+        entries.push_back({path_hash(key), progress.size, progress.mtime_ns, prefix});
+    }
+    std::sort(entries.begin(), entries.end(),
+              [](const protocol::ResumeEntry& a, const protocol::ResumeEntry& b) {
+                  return a.hash < b.hash;
+              });
+    if (!entries.empty()) fmt::print("Offering {} partial files to resume\n", entries.size());
+
+    for (size_t i = 0; i < entries.size(); i += protocol::MAX_RESUME_ENTRIES) {
+        auto msg = protocol::make_resume(entries.data() + i, entries.size() - i);
+        if (!send_all(clientfd, msg.data(), msg.size())) return false;
+    }
+    auto end = protocol::make_resume_end();
+    return send_all(clientfd, end.data(), end.size());
+}
+
+// Sender side: the receiver's partial files, sorted by hash
+static bool recv_resume_list(int sockfd, std::vector<protocol::ResumeEntry>& out) {
+    std::vector<uint8_t> payload;
+    while (true) {
+        uint8_t hdr[protocol::MSG_HEADER_SIZE];
+        if (!recv_all(sockfd, hdr, sizeof(hdr))) {
+            fmt::print(stderr, "Failed to receive resume list\n");
+            return false;
+        }
+        protocol::MsgType type;
+        uint32_t len;
+        protocol::parse_header(hdr, type, len);
+        if (type == protocol::MsgType::RESUME_END && len == 0) break;
+        if (type != protocol::MsgType::RESUME ||
+            len > 2 + protocol::MAX_RESUME_ENTRIES * protocol::RESUME_ENTRY_SIZE) {
+            fmt::print(stderr, "Bad resume message: type {}, {} bytes\n", (int)type, len);
+            return false;
+        }
+        payload.resize(len);
+        if (!recv_all(sockfd, payload.data(), len) ||
+            !protocol::parse_resume(payload.data(), len, out)) {
+            fmt::print(stderr, "Bad resume frame\n");
+            return false;
+        }
+    }
+    std::sort(out.begin(), out.end(),
+              [](const protocol::ResumeEntry& a, const protocol::ResumeEntry& b) {
+                  return a.hash < b.hash;
+              });
+    return true;
+}
+
+// Offset to resume a file at: a partial entry with its hash, size and mtime
+static uint64_t resume_offset(const std::vector<protocol::ResumeEntry>& partial,
+                              const protocol::ManifestEntry& file) {
+    auto it = std::lower_bound(partial.begin(), partial.end(), file.hash,
+                               [](const protocol::ResumeEntry& e, uint64_t h) { return e.hash < h; });
+    for (; it != partial.end() && it->hash == file.hash; ++it) {
+        if (it->size == file.size && it->mtime_ns == file.mtime_ns && it->offset > 0 &&
+            it->offset < file.size) {
+            return it->offset;
+        }
+    }
+    return 0;
+}
+
+// Sender side: merge the receiver's manifest frame by frame as it arrives
+// and drop every file it already has. Only one frame of it is held.
+// Files in the resume list keep their place and are marked with their
+// offset (resumed counts them); with delta, other large files the
+// receiver has an older copy of move to delta_files.
+static bool skip_unchanged(int sockfd, FileList& files,
+                           const std::vector<protocol::ResumeEntry>& partial, size_t& skipped,
+                           size_t& resumed, std::vector<FileList::Entry>* delta_files) {
+    // Hash order for the merge; 32-bit positions keep the side table small
+    std::vector<protocol::ManifestEntry> sorted(files.size());
+    std::string rel;
+    for (size_t i = 0; i < files.size(); i++) {
+        files.rel_path(files[i], rel);
+        sorted[i] = {path_hash(rel), files[i].size, files[i].mtime_ns};
+    }
+    std::vector<uint32_t> order(files.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = static_cast<uint32_t>(i);
+    std::sort(order.begin(), order.end(),
+              [&sorted](uint32_t a, uint32_t b) { return sorted[a].hash < sorted[b].hash; });
+    {
+        std::vector<protocol::ManifestEntry> by_hash(files.size());
+        for (size_t i = 0; i < order.size(); i++) by_hash[i] = sorted[order[i]];
+        sorted.swap(by_hash);
+    }
+
+    ManifestMerge merge(sorted);
+    std::vector<uint8_t> payload;
+    std::vector<protocol::ManifestEntry> frame;
+    while (true) {
+        uint8_t hdr[protocol::MSG_HEADER_SIZE];
+        if (!recv_all(sockfd, hdr, sizeof(hdr))) {
+            fmt::print(stderr, "Failed to receive manifest\n");
+            return false;
+        }
+        protocol::MsgType type;
+        uint32_t len;
+        protocol::parse_header(hdr, type, len);
+        if (type == protocol::MsgType::MANIFEST_END && len == 0) break;
+        if (type != protocol::MsgType::MANIFEST ||
+            len > 2 + protocol::MAX_MANIFEST_ENTRIES * protocol::MANIFEST_ENTRY_SIZE) {
+            fmt::print(stderr, "Bad manifest message: type {}, {} bytes\n", (int)type, len);
+            return false;
+        }
+
+        payload.resize(len);
+        frame.clear();
+        if (!recv_all(sockfd, payload.data(), len) ||
+            !protocol::parse_manifest(payload.data(), len, frame) ||
+            !merge.feed(frame.data(), frame.size())) {
+            fmt::print(stderr, "Bad manifest frame\n");
+            return false;
+        }
+    }
+
+    std::vector<uint8_t> unchanged(files.size(), 0);
+    std::vector<uint8_t> present(files.size(), 0);
+    std::vector<uint64_t> resume_at(partial.empty() ? 0 : files.size(), 0);
+    for (size_t i = 0; i < order.size(); i++) {
+        unchanged[order[i]] = merge.unchanged()[i];
+        present[order[i]] = merge.present()[i];
+        if (!partial.empty() && !unchanged[order[i]]) {
+            resume_at[order[i]] = resume_offset(partial, sorted[i]);
+        }
+    }
+
+    // Keeps the inode order of what is left
+    auto& entries = files.entries();
+    size_t out = 0;
+    skipped = 0;
+    resumed = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (unchanged[i]) {
+            skipped++;
+        } else if (!resume_at.empty() && resume_at[i] > 0) {
+            files.set_resume(entries[i], resume_at[i]);
+            resumed++;
+            entries[out++] = entries[i];
+        } else if (delta_files && present[i] && entries[i].size >= DELTA_MIN_FILE_SIZE) {
+            delta_files->push_back(entries[i]);
+        } else {
+            entries[out++] = entries[i];
+        }
+    }
+    entries.resize(out);
+    return true;
+}
+
+// ============================================================
+// Block Delta
+// ============================================================
+// Runs on stream 0 right after the manifest, one file at a time: SIG_REQ,
+// SIGNATURE, then DELTA_HDR, DELTA_COPY / FILE_DATA in file order and
+// FILE_END (with the new file's CRC when verifying). The other streams
+// connect once it is over.
+
+// Encoder sink: frames block references and literals into a send buffer.
+// Literals use FILE_DATA frames, compressed when the session has a codec.
+class DeltaWriter {
+public:
+    static constexpr size_t FLUSH_BYTES = 1024 * 1024;
+
+    DeltaWriter(int sockfd, protocol::Codec codec) : sockfd_(sockfd), codec_(codec) {
+        if (codec_ != protocol::Codec::NONE) {
+            chunk_codec_ = std::make_unique<ChunkCodec>();
+            zbuf_.resize(compress_bound(codec_, protocol::MAX_FRAME_RAW));
+        }
+    }
+
+    void literal(const uint8_t* data, uint64_t len) {
+        literal_bytes_ += len;
+        for (uint64_t off = 0; off < len && ok_; off += protocol::MAX_FRAME_RAW) {
+            uint32_t n = static_cast<uint32_t>(std::min<uint64_t>(protocol::MAX_FRAME_RAW, len - off));
+            const uint8_t* raw = data + off;
+            size_t zlen = 0;
+            if (chunk_codec_) {
+                zlen = chunk_codec_->compress(codec_, codec_levels(codec_).initial, raw, n,
+                                              zbuf_.data(), zbuf_.size());
+            }
+            uint8_t hdr[protocol::DATA_FRAME_HDR_SIZE];
+            if (zlen > 0 && worth_compressing(n, zlen)) {
+                protocol::write_data_frame_header(hdr, codec_, n, static_cast<uint32_t>(zlen));
+                append(hdr, sizeof(hdr));
+                append(zbuf_.data(), zlen);
+            } else {
+                protocol::write_data_frame_header(hdr, protocol::Codec::NONE, n, n);
+                append(hdr, sizeof(hdr));
+                append(raw, n);
+            }
+        }
+    }
+
+    void copy(uint32_t first, uint32_t count) {
+        uint8_t msg[protocol::DELTA_COPY_SIZE];
+        protocol::write_delta_copy(msg, first, count);
+        append(msg, sizeof(msg));
+    }
+
+    void append(const void* data, size_t len) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        out_.insert(out_.end(), p, p + len);
+        if (out_.size() >= FLUSH_BYTES) flush();
+    }
+
+    bool flush() {
+        if (ok_ && !out_.empty()) {
+            wire_bytes_ += out_.size();
+            ok_ = send_all(sockfd_, out_.data(), out_.size());
+        }
+        out_.clear();
+        return ok_;
+    }
+
+    bool ok() const { return ok_; }
+    uint64_t literal_bytes() const { return literal_bytes_; }
+    uint64_t wire_bytes() const { return wire_bytes_; }
+
+private:
+    int sockfd_;
+    protocol::Codec codec_;
+    std::unique_ptr<ChunkCodec> chunk_codec_;
+    std::vector<uint8_t> zbuf_;
+    std::vector<uint8_t> out_;
+    bool ok_ = true;
+    uint64_t literal_bytes_ = 0;
+    uint64_t wire_bytes_ = 0;
+};
+
+static bool recv_signature(int sockfd, protocol::Signature& sig) {
+    uint8_t hdr[protocol::MSG_HEADER_SIZE];
+    if (!recv_all(sockfd, hdr, sizeof(hdr))) return false;
+    protocol::MsgType type;
+    uint32_t len;
+    protocol::parse_header(hdr, type, len);
+    if (type != protocol::MsgType::SIGNATURE ||
+        len > protocol::SIGNATURE_HDR_SIZE + protocol::MAX_SIG_BLOCKS * protocol::BLOCK_SIG_SIZE) {
+        return false;
+    }
+    std::vector<uint8_t> payload(len);
+    return recv_all(sockfd, payload.data(), len) &&
+           protocol::parse_signature(payload.data(), len, sig);
+}
+
+// Sender side. Files the receiver can't give a signature for (or that
+// can't be read here) go back to files for the normal transfer.
+static bool send_deltas(int sockfd, std::vector<FileList::Entry>& delta_files,
+                        FileList& files, protocol::Codec codec, bool verify, size_t& sent) {
+    DeltaWriter out(sockfd, codec);
+    sent = 0;
+    uint64_t total_bytes = 0;
+
+    for (const auto& entry : delta_files) {
+        std::string rel_path = files.rel_path(entry);
+        auto req = protocol::make_sig_req(rel_path);
+        protocol::Signature sig;
+        if (!send_all(sockfd, req.data(), req.size()) || !recv_signature(sockfd, sig)) {
+            fmt::print(stderr, "Failed to get signature for {}\n", rel_path);
+            return false;
+        }
+
+        int fd = open(files.src_path(entry).c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (sig.blocks.empty() || fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+            if (fd >= 0) close(fd);
+            files.entries().push_back(entry);
+            continue;
+        }
+        uint64_t size = st.st_size;
+        void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            close(fd);
+            files.entries().push_back(entry);
+            continue;
+        }
+        madvise(map, size, MADV_SEQUENTIAL);
+
+        auto dhdr = protocol::make_delta_hdr(size, st.st_mode & 0777, rel_path,
+                                             to_mtime_ns(st.st_mtim), sig.block_size);
+        out.append(dhdr.data(), dhdr.size());
+        encode_delta(static_cast<const uint8_t*>(map), size, sig, out);
+        // The next SIG_REQ must not overtake the rest of this file
+        if (verify) {
+            uint8_t end[protocol::FILE_END_CRC_SIZE];
+            protocol::write_file_end(end, crc32c(0, map, size));
+            out.append(end, sizeof(end));
+        } else {
+            auto end = protocol::make_file_end();
+            out.append(end.data(), end.size());
+        }
+        out.flush();
+        munmap(map, size);
+        close(fd);
+
+        if (!out.ok()) {
+            fmt::print(stderr, "Failed to send delta for {}\n", rel_path);
+            return false;
+        }
+        sent++;
+        total_bytes += size;
+    }
+    delta_files.clear();
+
+    auto done = protocol::make_delta_done();
+    out.append(done.data(), done.size());
+    if (!out.flush()) {
+        fmt::print(stderr, "Failed to finish delta phase\n");
+        return false;
+    }
+    if (sent > 0) {
+        fmt::print("Delta: {} files, {:.1f} MB of {:.1f} MB sent as literals\n", sent,
+                   out.literal_bytes() / 1e6, total_bytes / 1e6);
+    }
+    return true;
+}
+
+// Receiver side: answer SIG_REQs and apply deltas until DELTA_DONE
+static bool serve_deltas(int clientfd, const std::string& dst_path, bool verify) {
+    std::vector<uint8_t> payload;
+    std::vector<uint8_t> raw(protocol::MAX_FRAME_RAW);
+    std::unique_ptr<ChunkCodec> codec;
+    DeltaPatcher patcher;
+    protocol::FileHdrMsg file;
+    bool in_file = false;
+    size_t rebuilt = 0;
+    uint64_t reused = 0;
+
+    while (true) {
+        uint8_t hdr[protocol::MSG_HEADER_SIZE];
+        if (!recv_all(clientfd, hdr, sizeof(hdr))) {
+            fmt::print(stderr, "Connection lost during delta phase\n");
+            return false;
+        }
+        protocol::MsgType type;
+        uint32_t len;
+        protocol::parse_header(hdr, type, len);
+        // Largest: a DELTA_HDR, or a FILE_DATA frame that didn't compress
+        if (len > std::max(14 + protocol::MAX_PATH_LEN + protocol::MTIME_SIZE + 4,
+                           protocol::DATA_FRAME_HDR_SIZE - protocol::MSG_HEADER_SIZE +
+                               protocol::MAX_FRAME_RAW)) {
+            fmt::print(stderr, "Delta message too large: {} bytes\n", len);
+            return false;
+        }
+        payload.resize(len);
+        if (!recv_all(clientfd, payload.data(), len)) {
+            fmt::print(stderr, "Connection lost during delta phase\n");
+            return false;
+        }
+
+        bool ok = false;
+        switch (type) {
+        case protocol::MsgType::SIG_REQ: {
+            std::string path;
+            if (in_file || !protocol::parse_sig_req(payload.data(), len, path) ||
+                !protocol::is_safe_path(path)) {
+                break;
+            }
+            // No usable copy: an empty signature sends the whole file
+            protocol::Signature sig;
+            std::string full = (fs::path(dst_path) / path).string();
+            int fd = open(full.c_str(), O_RDONLY | O_CLOEXEC);
+            struct stat st;
+            if (fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+                compute_signature(fd, st.st_size, sig);
+            }
+            if (fd >= 0) close(fd);
+            if (sig.blocks.empty()) sig = protocol::Signature{};
+            auto msg = protocol::make_signature(sig);
+            ok = send_all(clientfd, msg.data(), msg.size());
+            break;
+        }
+        case protocol::MsgType::DELTA_HDR: {
+            uint32_t block_size;
+            if (in_file || !protocol::parse_delta_hdr(payload.data(), len, file, block_size) ||
+                !protocol::is_safe_path(file.path)) {
+                break;
+            }
+            std::string full = (fs::path(dst_path) / file.path).string();
+            ok = patcher.open(full, file.mode, block_size);
+            if (!ok) fmt::print(stderr, "Failed to open {} for delta: {}\n", full, strerror(errno));
+            in_file = ok;
+            break;
+        }
+        case protocol::MsgType::DELTA_COPY:
+            ok = in_file && len == 8 &&
+                 patcher.copy(protocol::read_u32(payload.data()), protocol::read_u32(payload.data() + 4));
+            break;
+        case protocol::MsgType::FILE_DATA: {
+            if (!in_file || len < 5 || !protocol::is_known_codec(payload[0])) break;
+            auto frame_codec = static_cast<protocol::Codec>(payload[0]);
+            uint32_t raw_len = protocol::read_u32(payload.data() + 1);
+            const uint8_t* data = payload.data() + 5;
+            size_t data_len = len - 5;
+            if (raw_len > protocol::MAX_FRAME_RAW) break;
+            if (frame_codec == protocol::Codec::NONE) {
+                ok = data_len == raw_len && patcher.write(data, data_len);
+            } else {
+                if (!codec) codec = std::make_unique<ChunkCodec>();
+                ok = codec->decompress(frame_codec, data, data_len, raw.data(), raw_len) &&
+                     patcher.write(raw.data(), raw_len);
+            }
+            break;
+        }
+        case protocol::MsgType::FILE_END: {
+            if (!in_file || len != (verify ? protocol::CRC_SIZE : 0)) break;
+            in_file = false;
+            uint32_t crc = 0;
+            if (verify && (!patcher.checksum(crc) || crc != protocol::read_u32(payload.data()))) {
+                // The old copy stays; the next run sends the file again
+                fmt::print(stderr, "Checksum mismatch on {}: sent {:08x}, rebuilt {:08x}\n",
+                           file.path, protocol::read_u32(payload.data()), crc);
+                patcher.abort();
+                return false;
+            }
+            reused += patcher.copied();
+            ok = patcher.finish(file.size, file.mtime_ns);
+            if (!ok) fmt::print(stderr, "Failed to rebuild {}\n", file.path);
+            rebuilt++;
+            break;
+        }
+        case protocol::MsgType::DELTA_DONE:
+            if (in_file || len != 0) break;
+            if (rebuilt > 0) {
+                fmt::print("Delta: rebuilt {} files, {:.1f} MB reused from the old copies\n",
+                           rebuilt, reused / 1e6);
+            }
+            return true;
+        default:
+            break;
+        }
+        if (!ok) {
+            fmt::print(stderr, "Delta phase failed (message type {})\n", (int)type);
+            return false;
+        }
+    }
+}
+
+// ============================================================
+// Receiver Handshake
+// ============================================================
+
+// Later streams of a session normally arrive within milliseconds
+static constexpr int STREAM_JOIN_TIMEOUT_MS = 30000;
+
+// Dual-stack listening socket on port, or -1
+static int open_listener(uint16_t port, int backlog) {
+    int listenfd = socket(AF_INET6, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenfd < 0) {
+        fmt::print(stderr, "Failed to create socket\n");
+        return -1;
+    }
+
+    int opt = 1;
+    setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    // Dual-stack
+    int no = 0;
+    setsockopt(listenfd, IPPROTO_IPV6, IPV6_V6ONLY, &no, sizeof(no));
+
+    struct sockaddr_in6 addr = {};
+    addr.sin6_family = AF_INET6;
+    addr.sin6_port = htons(port);
+    addr.sin6_addr = in6addr_any;
+
+    if (bind(listenfd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        fmt::print(stderr, "Failed to bind: {}\n", strerror(errno));
+        close(listenfd);
+        return -1;
+    }
+    if (listen(listenfd, backlog) < 0) {
+        close(listenfd);
+        return -1;
+    }
+    return listenfd;
+}
+
+// Peer address of an accepted socket, for the log
+static std::string peer_address(int fd) {
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    char str[INET6_ADDRSTRLEN] = "?";
+    if (getpeername(fd, (struct sockaddr*)&addr, &len) == 0) {
+        if (addr.ss_family == AF_INET6) {
+            inet_ntop(AF_INET6, &((struct sockaddr_in6*)&addr)->sin6_addr, str, sizeof(str));
+        } else {
+            inet_ntop(AF_INET, &((struct sockaddr_in*)&addr)->sin_addr, str, sizeof(str));
+        }
+    }
+    return str;
+}
+
+// Answer an authenticated HELLO: HELLO_OK with our nonce, kTLS, and on
+// stream 0 the resume list, manifest or deltas the sender asked for. A
+// resumed session gets dst_path's journal from journals. The session
+// flags agreed, or -1 if the stream is lost.
+static int answer_hello(int clientfd, const protocol::HelloMsg& hello,
+                        const std::string& dst_path, bool use_tls, JournalSet& journals,
+                        CheckpointJournal*& journal) {
+    // HELLO_OK carries our nonce for this stream's kTLS keys
+    uint8_t nonce_receiver[protocol::NONCE_SIZE];
+    if (!ktls::generate_nonce(nonce_receiver)) {
+        fmt::print(stderr, "Failed to generate nonce\n");
+        return -1;
+    }
+    // Any codec we know is accepted; the sender falls back to raw otherwise
+    uint8_t flags = hello.flags & protocol::KNOWN_FLAGS;
+    if (!(flags & protocol::FLAG_INCREMENTAL)) {
+        flags &= ~(protocol::FLAG_DELTA | protocol::FLAG_RESUME);
+    }
+    journal = nullptr;
+    if (flags & protocol::FLAG_RESUME) {
+        std::string error;
+        journal = journals.open(dst_path, error);
+        if (!journal) {
+            fmt::print(stderr, "Resume journal unavailable, declining --resume: {}\n", error);
+            flags &= ~protocol::FLAG_RESUME;
+        }
+    }
+    auto ok = protocol::make_hello_ok(nonce_receiver, protocol::PROTOCOL_VERSION,
+                                      hello.codec, flags);
+    if (!send_all(clientfd, ok.data(), ok.size())) return -1;
+
+    // The secret was checked (or isn't required); the sender keys with its own
+    if (use_tls) {
+        ktls::KtlsKeys keys;
+        if (!ktls::derive_keys(hello.secret, hello.nonce, nonce_receiver, keys) ||
+            !ktls::enable_receiver(clientfd, keys)) {
+            fmt::print(stderr, "Failed to enable kTLS\n");
+            return -1;
+        }
+    }
+
+    // The sender reads these before it connects the other streams, so
+    // they can't hold up the join
+    if (journal && hello.session.index == 0 && !send_resume_list(clientfd, *journal)) {
+        return -1;
+    }
+    if ((flags & protocol::FLAG_INCREMENTAL) && hello.session.index == 0 &&
+        !send_dst_manifest(clientfd, dst_path)) {
+        return -1;
+    }
+    if ((flags & protocol::FLAG_DELTA) && hello.session.index == 0 &&
+        !serve_deltas(clientfd, dst_path, (flags & protocol::FLAG_VERIFY) != 0)) {
+        return -1;
+    }
+    return flags;
+}
+
+// A stream's receiver config for the codec, flags and journal agreed in
+// its HELLO
+static NetConfig stream_config(const NetConfig& base, const protocol::HelloMsg& hello,
+                               uint8_t flags, CheckpointJournal* journal) {
+    NetConfig cfg = base;
+    cfg.compress = hello.codec;
+    cfg.incremental = (flags & protocol::FLAG_INCREMENTAL) != 0;
+    cfg.verify = (flags & protocol::FLAG_VERIFY) != 0;
+    cfg.sparse = (flags & protocol::FLAG_SPARSE) != 0;
+    cfg.hardlinks = (flags & protocol::FLAG_HARDLINKS) != 0;
+    cfg.journal = (flags & protocol::FLAG_RESUME) ? journal : nullptr;
+    return cfg;
+}
+
+// FILE_LINKs are coalesced into sends of about this much
+static constexpr size_t LINK_SEND_BYTES = 64 * 1024;
+
+// Sender side (--hardlinks): one FILE_LINK per name the scan folded into
+// an earlier entry
+static bool send_links(int sockfd, const FileList& files) {
+    std::vector<uint8_t> buf;
+    for (const auto& [name, target] : files.links()) {
+        auto msg = protocol::make_file_link(files.rel_path(name), files.rel_path(target));
+        buf.insert(buf.end(), msg.begin(), msg.end());
+        if (buf.size() >= LINK_SEND_BYTES) {
+            if (!send_all(sockfd, buf.data(), buf.size())) return false;
+            buf.clear();
+        }
+    }
+    return buf.empty() || send_all(sockfd, buf.data(), buf.size());
+}
+
+// Make a session's FILE_LINKs under root once all its streams are done,
+// so every target has landed. A name already linked to its target is
+// left; anything else there is replaced. Returns the links that failed.
+static size_t make_links(const std::string& root,
+                         const std::vector<std::pair<std::string, std::string>>& links) {
+    size_t failed = 0;
+    for (const auto& [path, target] : links) {
+        std::string dst = (fs::path(root) / path).string();
+        std::string src = (fs::path(root) / target).string();
+        struct stat target_st, dst_st;
+        if (stat(src.c_str(), &target_st) != 0) {
+            fmt::print(stderr, "Link target {} missing for {}\n", target, path);
+            failed++;
+            continue;
+        }
+        if (lstat(dst.c_str(), &dst_st) == 0) {
+            if (dst_st.st_dev == target_st.st_dev && dst_st.st_ino == target_st.st_ino) continue;
+            unlink(dst.c_str());
+        } else {
+            std::error_code ec;
+            fs::create_directories(fs::path(dst).parent_path(), ec);
+        }
+        if (linkat(AT_FDCWD, src.c_str(), AT_FDCWD, dst.c_str(), 0) != 0) {
+            fmt::print(stderr, "Failed to link {} to {}: {}\n", path, target, strerror(errno));
+            failed++;
+        }
+    }
+    return failed;
+}
+
+// ============================================================
+// Stream Placement (--affinity)
+// ============================================================
+// Called on a stream's thread before its sender or receiver is built:
+// the thread moves to the CPUs of the NIC's node, so the ring's SQPOLL
+// thread and disk workers start there and the pools are first touched
+// there. Returns the CPU to settle on once it is built - the one the
+// socket's packets arrive on - or -1 to stay on the whole node.
+static int place_stream(int sockfd, const std::string& name) {
+    StreamPlacement p = plan_stream(sockfd);
+    // All allowed CPUs undo a daemon thread's pin from its last connection
+    pin_thread(p.cpus.empty() ? allowed_cpus() : p.cpus);
+    bool local = p.rx_cpu >= 0 &&
+                 (p.cpus.empty() || std::binary_search(p.cpus.begin(), p.cpus.end(), p.rx_cpu));
+    if (p.node < 0) {
+        fmt::print("Affinity: {}: NIC node unknown{}\n", name,
+                   local ? fmt::format(", on RX CPU {}", p.rx_cpu) : ", not pinned");
+    } else {
+        fmt::print("Affinity: {}: node {} (CPUs {}){}\n", name, p.node, format_cpu_list(p.cpus),
+                   local ? fmt::format(", on RX CPU {}", p.rx_cpu) : "");
+    }
+    return local ? p.rx_cpu : -1;
+}
+
+// ============================================================
+// Receiver Daemon
+// ============================================================
+// recv --daemon: a multishot accept in the main thread's ring hands each
+// connection to a pool of stream threads. A stream thread keeps its
+// AsyncReceiver (ring, buffer pools, disk workers) from one connection to
+// the next, so back-to-back transfers skip that setup. A receiver that
+// lost its stream mid-transfer is rebuilt rather than trusted. Threads
+// start on demand up to DAEMON_MAX_THREADS and then stay, warm. With
+// --affinity a thread is placed per connection; its warm pools were
+// touched before any NIC was known, so only they stay where they are.
+
+// Room for a session of MAX_STREAMS streams next to others
+static constexpr size_t DAEMON_MAX_THREADS = 2 * protocol::MAX_STREAMS;
+
+// A client that hasn't sent its HELLO by then loses its thread
+static constexpr int HELLO_TIMEOUT_S = 30;
+
+enum class DaemonOp : uint8_t { ACCEPT, SIGNAL };
+
+class ReceiverDaemon {
+public:
+    ReceiverDaemon(std::vector<DaemonRoute> routes, const NetConfig& cfg, bool use_tls,
+                   unsigned warm)
+        : routes_(std::move(routes)), cfg_(cfg), use_tls_(use_tls) {
+        cfg_.reusable = true;
+        cfg_.progress = false;          // Sessions' lines would interleave
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (unsigned i = 0; i < warm && threads_.size() < DAEMON_MAX_THREADS; i++) start_thread();
+    }
+
+    ~ReceiverDaemon() { stop(); }
+
+    ReceiverDaemon(const ReceiverDaemon&) = delete;
+    ReceiverDaemon& operator=(const ReceiverDaemon&) = delete;
+
+    // Accept until sigfd reads SIGINT or SIGTERM; false if the ring fails
+    bool run(int listenfd, int sigfd) {
+        struct io_uring ring;
+        if (io_uring_queue_init(8, &ring, 0) < 0) {
+            fmt::print(stderr, "Failed to init accept io_uring\n");
+            return false;
+        }
+
+        struct signalfd_siginfo siginfo;
+        struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+        io_uring_prep_read(sqe, sigfd, &siginfo, sizeof(siginfo), 0);
+        io_uring_sqe_set_data64(sqe, make_tag(DaemonOp::SIGNAL, 0));
+
+        bool multishot = true;          // 5.19+; single accepts before that
+        bool armed = false;
+        bool backoff = false;           // Out of fds: retry on the next tick
+        bool stop = false;
+        bool ok = true;
+        while (!stop) {
+            if (!armed && !backoff) {
+                sqe = io_uring_get_sqe(&ring);
+                if (multishot) {
+                    io_uring_prep_multishot_accept(sqe, listenfd, nullptr, nullptr, SOCK_CLOEXEC);
+                } else {
+                    io_uring_prep_accept(sqe, listenfd, nullptr, nullptr, SOCK_CLOEXEC);
                 }
+                io_uring_sqe_set_data64(sqe, make_tag(DaemonOp::ACCEPT, 0));
+                armed = true;
             }
-            if (!any_pending) break;
-
-            io_uring_submit(&ring_);
 
+            // Wake at least once a second to expire sessions short of streams
+            struct __kernel_timespec tick = {1, 0};
             struct io_uring_cqe* cqe;
-            if (io_uring_wait_cqe(&ring_, &cqe) < 0) break;
+            int ret = io_uring_submit_and_wait_timeout(&ring, &cqe, 1, &tick, nullptr);
+            if (ret < 0 && ret != -ETIME && ret != -EINTR) {
+                fmt::print(stderr, "Accept ring error: {}\n", strerror(-ret));
+                ok = false;
+                break;
+            }
+            backoff = false;
 
             unsigned head;
             unsigned count = 0;
-            io_uring_for_each_cqe(&ring_, head, cqe) {
+            io_uring_for_each_cqe(&ring, head, cqe) {
                 count++;
-                uint64_t user_data = io_uring_cqe_get_data64(cqe);
-                RecvContext* ctx = get_recv_context(user_data);
-                RecvOp op = get_recv_op(ctx);
-                advance_recv_state(ctx, op, cqe->res);
-
-                if (ctx->state == RecvState::DONE || ctx->state == RecvState::FAILED) {
-                    files_completed++;
+                uint64_t tag = io_uring_cqe_get_data64(cqe);
+                if (tag_op<DaemonOp>(tag) == DaemonOp::SIGNAL) {
+                    stop = true;
+                    continue;
+                }
+                if (!(cqe->flags & IORING_CQE_F_MORE)) armed = false;
+                int res = cqe->res;
+                if (res >= 0) {
+                    enqueue(res);
+                } else if (res == -EINVAL && multishot) {
+                    multishot = false;
+                } else if (res == -EMFILE || res == -ENFILE) {
+                    fmt::print(stderr, "Accept failed: {}\n", strerror(-res));
+                    backoff = true;
+                } else if (res != -EINTR && res != -ECONNABORTED && res != -EAGAIN) {
+                    fmt::print(stderr, "Accept failed: {}\n", strerror(-res));
+                    stop = true;
+                    ok = false;
                 }
             }
-            io_uring_cq_advance(&ring_, count);
+            io_uring_cq_advance(&ring, count);
+
+            for (auto& totals : sessions_.expire(SessionTable::Clock::now(),
+                                                 std::chrono::milliseconds(STREAM_JOIN_TIMEOUT_MS))) {
+                end_session(totals);
+            }
+        }
+        // Pending accepts and the signal read are cancelled here
+        io_uring_queue_exit(&ring);
+        return ok;
+    }
+
+    // Serve the connections already accepted, then end the stream threads
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
         }
+        work_.notify_all();
+        for (auto& t : threads_) t.join();
+        threads_.clear();
+        journals_.close_all();
 
-        fmt::print("Transfer complete: {} files received\n", files_completed);
-        return true;
+        for (auto& totals : sessions_.expire(SessionTable::Clock::now(), {})) end_session(totals);
     }
 
+    size_t sessions_ok() const { return sessions_ok_; }
+    size_t sessions_failed() const { return sessions_failed_; }
+
 private:
-    bool recv_exact(char* buf, size_t len) {
-        size_t received = 0;
-        while (received < len) {
-            ssize_t n = recv(sockfd_, buf + received, len - received, 0);
-            if (n <= 0) return false;
-            received += n;
+    // With mutex_ held
+    void start_thread() {
+        unsigned index = static_cast<unsigned>(threads_.size());
+        threads_.emplace_back(&ReceiverDaemon::stream_thread, this, index);
+    }
+
+    void enqueue(int clientfd) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(clientfd);
+            if (queue_.size() > idle_ && threads_.size() < DAEMON_MAX_THREADS) start_thread();
         }
-        return true;
+        work_.notify_one();
     }
 
-    bool advance_recv_state(RecvContext* ctx, RecvOp op, int result) {
-        if (result < 0 && ctx->state != RecvState::DONE) {
-            if (cfg_.verbose) {
-                fmt::print(stderr, "Error on {}: {}\n", ctx->path, strerror(-result));
+    // The receiver is made on this thread: SINGLE_ISSUER rings (the
+    // defer profile) belong to the thread that sets them up
+    void stream_thread(unsigned index) {
+        NetConfig cfg = cfg_;
+        cfg.ring_index = index;
+        std::unique_ptr<AsyncReceiver> receiver;
+        while (true) {
+            if (!receiver) {
+                try {
+                    receiver = std::make_unique<AsyncReceiver>(-1, "", cfg);
+                } catch (const std::exception& e) {
+                    fmt::print(stderr, "Error: {}\n", e.what());
+                }
             }
-            if (ctx->fd >= 0) close(ctx->fd);
-            return false;
-        }
 
-        switch (ctx->state) {
-            case RecvState::OPENING: {
-                ctx->fd = result;
+            int clientfd;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                idle_++;
+                work_.wait(lock, [&] { return stopping_ || !queue_.empty(); });
+                idle_--;
+                if (queue_.empty()) return;
+                clientfd = queue_.front();
+                queue_.pop_front();
+            }
+            serve(clientfd, receiver);
+        }
+    }
 
-                if (ctx->file_size == 0) {
-                    // Empty file - close immediately
-                    struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
-                    if (!sqe) return false;
-                    io_uring_prep_close(sqe, ctx->fd);
-                    io_uring_sqe_set_data64(sqe, make_recv_user_data(ctx, RecvOp::CLOSE));
-                    ctx->state = RecvState::CLOSING;
-                } else {
-                    // Receive file data (sync recv, async write)
-                    size_t to_recv = std::min(ctx->file_size - ctx->received, ctx->buf_size);
-                    if (!recv_exact(ctx->buffer, to_recv)) {
-                        return false;
-                    }
-                    ctx->last_recv = to_recv;
+    // One stream, start to end; closes clientfd
+    void serve(int clientfd, std::unique_ptr<AsyncReceiver>& receiver) {
+        std::string peer = peer_address(clientfd);
 
-                    // Submit write
-                    struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
-                    if (!sqe) return false;
-                    io_uring_prep_write(sqe, ctx->fd, ctx->buffer, to_recv, ctx->received);
-                    io_uring_sqe_set_data64(sqe, make_recv_user_data(ctx, RecvOp::WRITE));
-                    ctx->state = RecvState::WRITING;
-                }
-                break;
-            }
+        // A client silent past HELLO_TIMEOUT_S gives up its thread
+        struct timeval tv = {HELLO_TIMEOUT_S, 0};
+        setsockopt(clientfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
 
-            case RecvState::WRITING: {
-                ctx->received += ctx->last_recv;
+        protocol::HelloMsg hello;
+        bool got_hello = recv_hello(clientfd, hello);
+        tv = {0, 0};
+        setsockopt(clientfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        if (!got_hello) {
+            close(clientfd);
+            return;
+        }
+        const DaemonRoute* route = find_route(routes_, hello.secret);
+        if (!route) {
+            fmt::print(stderr, "Invalid secret from {}\n", peer);
+            reject_hello(clientfd, protocol::FAIL_BAD_SECRET);
+            return;
+        }
 
-                if (ctx->received >= ctx->file_size) {
-                    // Done - close
-                    struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
-                    if (!sqe) return false;
-                    io_uring_prep_close(sqe, ctx->fd);
-                    io_uring_sqe_set_data64(sqe, make_recv_user_data(ctx, RecvOp::CLOSE));
-                    ctx->state = RecvState::CLOSING;
-                } else {
-                    // Receive more data
-                    size_t to_recv = std::min(ctx->file_size - ctx->received, ctx->buf_size);
-                    if (!recv_exact(ctx->buffer, to_recv)) {
-                        return false;
-                    }
-                    ctx->last_recv = to_recv;
+        const uint64_t id = hello.session.id;
+        switch (sessions_.join(route->root, hello.session, SessionTable::Clock::now())) {
+            case SessionTable::Join::REJECTED:
+                fmt::print(stderr, "Rejected stream from {}: not part of session {:016x}\n", peer, id);
+                reject_hello(clientfd, protocol::FAIL_BAD_SESSION);
+                return;
+            case SessionTable::Join::FIRST:
+                fmt::print("Session {:016x} from {}: {} stream(s) into {}\n", id, peer,
+                           hello.session.count, route->root);
+                break;
+            case SessionTable::Join::JOINED:
+                break;
+        }
 
-                    // Submit write
-                    struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
-                    if (!sqe) return false;
-                    io_uring_prep_write(sqe, ctx->fd, ctx->buffer, to_recv, ctx->received);
-                    io_uring_sqe_set_data64(sqe, make_recv_user_data(ctx, RecvOp::WRITE));
+        bool ok = false;
+        size_t received = 0;
+        size_t corrupt = 0;
+        size_t unwritten = 0;
+        std::vector<std::pair<std::string, std::string>> links;
+        std::error_code ec;
+        fs::create_directories(route->root, ec);
+        CheckpointJournal* journal = nullptr;
+        int flags = answer_hello(clientfd, hello, route->root, use_tls_, journals_, journal);
+        if (flags >= 0) {
+            try {
+                if (!receiver) throw std::runtime_error("No receiver for the stream");
+                if (cfg_.affinity) {
+                    int cpu = place_stream(clientfd, fmt::format("stream from {}", peer));
+                    if (cpu >= 0) pin_thread({cpu});
                 }
-                break;
+                receiver->reset(clientfd, route->root,
+                                stream_config(cfg_, hello, static_cast<uint8_t>(flags), journal));
+                ok = receiver->run();
+                received = receiver->files_received();
+                corrupt = receiver->files_corrupt();
+                unwritten = receiver->files_failed();
+                links = receiver->links();
+            } catch (const std::exception& e) {
+                fmt::print(stderr, "Error: {}\n", e.what());
             }
+            if (!ok) receiver.reset();
+        }
+        close(clientfd);
 
-            case RecvState::CLOSING:
-                ctx->fd = -1;
-                ctx->state = RecvState::DONE;
-                break;
-
-            default:
-                return false;
+        SessionTable::Totals totals;
+        if (sessions_.finish(route->root, id, received, corrupt, unwritten, !ok, totals, links)) {
+            end_session(totals);
         }
+    }
 
-        return true;
+    void end_session(const SessionTable::Totals& t) {
+        bool ok = false;
+        if (t.joined < t.count) {
+            fmt::print(stderr, "Session {:016x}: timed out waiting for {} more stream(s)\n", t.id,
+                       t.count - t.joined);
+        } else if (t.corrupt > 0) {
+            fmt::print(stderr, "Session {:016x}: checksum mismatch, {} files failed verification\n",
+                       t.id, t.corrupt);
+        } else if (t.unwritten > 0) {
+            fmt::print(stderr, "Session {:016x}: {} files could not be written\n", t.id,
+                       t.unwritten);
+        } else if (t.failed) {
+            fmt::print(stderr, "Session {:016x} failed after {} files\n", t.id, t.received);
+        } else if (size_t bad = make_links(t.root, t.links); bad > 0) {
+            fmt::print(stderr, "Session {:016x}: {} of {} hardlinks failed\n", t.id, bad,
+                       t.links.size());
+        } else {
+            fmt::print("Session {:016x} complete: {} files received into {}\n", t.id, t.received,
+                       t.root);
+            ok = true;
+        }
+        (ok ? sessions_ok_ : sessions_failed_)++;
     }
 
-    int sockfd_;
-    std::string dst_path_;
+    const std::vector<DaemonRoute> routes_;
     NetConfig cfg_;
-    struct io_uring ring_;
-    std::vector<RecvContext> contexts_;
-    std::vector<std::vector<char>> buffers_;
-    std::vector<char> hdr_buf_;
-    std::vector<char> meta_buf_;
+    bool use_tls_;
+    SessionTable sessions_;
+    JournalSet journals_;               // Per route root, for resumed sessions
+    std::atomic<size_t> sessions_ok_{0};
+    std::atomic<size_t> sessions_failed_{0};
+
+    std::mutex mutex_;
+    std::condition_variable work_;
+    std::deque<int> queue_;             // Accepted, waiting for a stream thread
+    size_t idle_ = 0;                   // Stream threads waiting for work
+    bool stopping_ = false;
+    std::vector<std::thread> threads_;
 };
 
+// Byte-balanced split of the inode-sorted list into contiguous shards:
+// shard k is files [bounds[k], bounds[k + 1]). Each file also counts a
+// fixed overhead so many tiny files spread too.
+static constexpr uint64_t SHARD_FILE_COST = 4096;
+
+static std::vector<size_t> shard_files(const FileList& files, size_t n) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < files.size(); i++) total += files[i].size + SHARD_FILE_COST;
+
+    std::vector<size_t> bounds(n + 1, files.size());
+    bounds[0] = 0;
+    uint64_t acc = 0;
+    size_t k = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        // Move to the next shard once this one has its share
+        while (k + 1 < n && acc >= total * (k + 1) / n) bounds[++k] = i;
+        acc += files[i].size + SHARD_FILE_COST;
+    }
+    return bounds;
+}
+
+// Registry for --metrics/--trace (null if none was asked for), plus the
+// --metrics-stream writer. False if the stream target can't be opened.
+static bool start_metrics(const char* mode, const std::vector<const char*>& ops,
+                          const MetricsSetup& setup, std::unique_ptr<MetricsRegistry>& registry,
+                          std::unique_ptr<MetricsStreamer>& streamer) {
+    if (!setup.enabled()) return true;
+    registry = std::make_unique<MetricsRegistry>(mode, ops, !setup.trace_path.empty());
+    if (setup.stream_target.empty()) return true;
+    try {
+        streamer = std::make_unique<MetricsStreamer>(*registry, setup);
+    } catch (const std::exception& e) {
+        fmt::print(stderr, "Error: {}\n", e.what());
+        return false;
+    }
+    return true;
+}
+
 // ============================================================
 // Public API
 // ============================================================
 
 int run_sender_uring(const std::string& src_path, const std::string& host,
-                     uint16_t port, const std::string& secret) {
-    // Connect to receiver
-    fmt::print("Connecting to {}:{}...\n", host, port);
-    fmt::print("Mode: io_uring async\n");
+                     uint16_t port, const std::string& secret, int streams,
+                     bool zero_copy, bool use_tls, bool file_batch,
+                     protocol::Codec compress, bool incremental, bool delta, bool verify,
+                     bool resume, bool extent_order, bool hardlinks, const RingSetup& ring,
+                     bool affinity, const MetricsSetup& metrics) {
+    streams = std::clamp(streams, 1, (int)protocol::MAX_STREAMS);
+
+    // SEND_ZC pins the read buffers, but compressed frames are sent from
+    // their own buffers and raw ones need a header in front anyway
+    if (zero_copy && compress != protocol::Codec::NONE) {
+        fmt::print(stderr, "Warning: --zero-copy send is not used with --compress\n");
+        zero_copy = false;
+    }
 
-    struct addrinfo hints = {}, *res;
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
+    // The kTLS ULP doesn't take zero-copy sends (the kernel encrypts into
+    // its own record buffers anyway)
+    if (zero_copy && use_tls) {
+        fmt::print(stderr, "Warning: --zero-copy send is not supported over kTLS, using copying sends\n");
+        zero_copy = false;
+    }
+    if (zero_copy && !uring_supports_op(IORING_OP_SEND_ZC)) {
+        fmt::print(stderr, "Warning: kernel lacks IORING_OP_SEND_ZC, using copying sends\n");
+        zero_copy = false;
+    }
 
-    std::string port_str = std::to_string(port);
-    if (getaddrinfo(host.c_str(), port_str.c_str(), &hints, &res) != 0) {
-        fmt::print(stderr, "Failed to resolve host\n");
-        return 1;
+    // Connect to receiver
+    fmt::print("Connecting to {}:{}...\n", host, port);
+    fmt::print("Mode: io_uring async{}{}", zero_copy ? ", zero-copy send" : "",
+               use_tls ? " + kTLS encryption" : "");
+    if (streams > 1) fmt::print(", {} streams", streams);
+    if (compress != protocol::Codec::NONE) fmt::print(", {} compression", codec_name(compress));
+    if (incremental) fmt::print(", incremental");
+    if (delta) fmt::print(", delta");
+    if (verify) fmt::print(", verify");
+    if (resume) fmt::print(", resume");
+    if (hardlinks) fmt::print(", hardlinks");
+    if (ring.profile != RingProfile::DEFAULT) fmt::print(", {} ring", ring_profile_name(ring.profile));
+    fmt::print("\n");
+
+    // Incremental: scan before connecting, so the manifest can be merged
+    // while it streams in on stream 0
+    FileList files;
+    bool scanned = false;
+    if (incremental) {
+        fmt::print("Scanning files...\n");
+        if (!AsyncSender::scan_files(src_path, files, extent_order, hardlinks)) return 1;
+        scanned = true;
     }
 
-    int sockfd = -1;
-    for (auto* p = res; p; p = p->ai_next) {
-        sockfd = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
-        if (sockfd < 0) continue;
-        if (connect(sockfd, p->ai_addr, p->ai_addrlen) == 0) break;
-        close(sockfd);
-        sockfd = -1;
+    // All streams of this transfer carry the same session id
+    std::random_device rd;
+    protocol::SessionInfo session;
+    session.id = (static_cast<uint64_t>(rd()) << 32) | rd();
+    session.count = static_cast<uint16_t>(streams);
+
+    std::vector<int> socks;
+    std::vector<protocol::Codec> codecs;
+    size_t delta_sent = 0;
+    uint8_t flags = incremental ? protocol::FLAG_INCREMENTAL : 0;
+    if (incremental && delta) flags |= protocol::FLAG_DELTA;
+    if (incremental && resume) flags |= protocol::FLAG_RESUME;
+    if (verify) flags |= protocol::FLAG_VERIFY;
+    if (hardlinks) flags |= protocol::FLAG_HARDLINKS;
+    flags |= protocol::FLAG_SPARSE;     // Holes are skipped whenever the receiver can
+    auto close_all = [&socks] {
+        for (int fd : socks) close(fd);
+    };
+
+    for (int i = 0; i < streams; i++) {
+        int sockfd = connect_to_host(host, port);
+        if (sockfd < 0) {
+            fmt::print(stderr, "Failed to connect\n");
+            close_all();
+            return 1;
+        }
+        socks.push_back(sockfd);
+
+        if (i == 0) fmt::print("Connected. Authenticating...\n");
+        session.index = static_cast<uint16_t>(i);
+        uint8_t peer_version = 0;
+        protocol::Codec codec = compress;
+        uint8_t accepted = flags;
+        if (!client_handshake(sockfd, secret, session, use_tls, peer_version, codec, accepted)) {
+            close_all();
+            return 1;
+        }
+        if (i == 0) {
+            // Later streams only ask for what stream 0 got
+            flags = accepted;
+            if (verify && !(flags & protocol::FLAG_VERIFY)) {
+                fmt::print(stderr, "Warning: receiver does not support --verify, "
+                                   "files are not checked\n");
+            }
+            if (hardlinks && !(flags & protocol::FLAG_HARDLINKS)) {
+                fmt::print(stderr, "Warning: receiver does not support --hardlinks, "
+                                   "every name is sent as a file\n");
+                files.restore_links();      // Scanned already (incremental)
+            }
+        }
+        if (i == 0 && incremental) {
+            size_t skipped = 0;
+            size_t resumed = 0;
+            bool use_delta = (flags & protocol::FLAG_DELTA) != 0;
+            std::vector<FileList::Entry> delta_files;
+            std::vector<protocol::ResumeEntry> partial;
+            if (resume && (flags & protocol::FLAG_INCREMENTAL) &&
+                !(flags & protocol::FLAG_RESUME)) {
+                fmt::print(stderr, "Warning: receiver does not support --resume, "
+                                   "partial files are sent again\n");
+            }
+            if (!(flags & protocol::FLAG_INCREMENTAL)) {
+                fmt::print(stderr, "Warning: receiver does not support incremental sync, "
+                                   "sending everything\n");
+            } else if (((flags & protocol::FLAG_RESUME) && !recv_resume_list(sockfd, partial)) ||
+                       !skip_unchanged(sockfd, files, partial, skipped, resumed,
+                                       use_delta ? &delta_files : nullptr)) {
+                close_all();
+                return 1;
+            } else {
+                fmt::print("Skipping {} unchanged files\n", skipped);
+                if (resumed > 0) {
+                    uint64_t have = 0;
+                    for (const auto& e : files.entries()) have += files.resume_offset(e);
+                    fmt::print("Resuming {} partial files ({:.1f} MB already received)\n",
+                               resumed, have / (1024.0 * 1024.0));
+                }
+            }
+            if (delta && (flags & protocol::FLAG_INCREMENTAL) && !use_delta) {
+                fmt::print(stderr, "Warning: receiver does not support delta transfer, "
+                                   "sending changed files whole\n");
+            }
+            if (use_delta && !send_deltas(sockfd, delta_files, files, codec,
+                                          (flags & protocol::FLAG_VERIFY) != 0, delta_sent)) {
+                close_all();
+                return 1;
+            }
+        }
+        // Older receivers only understand per-file FILE_HDR framing
+        if (peer_version < protocol::BATCH_MIN_VERSION) file_batch = false;
+        if (codec != compress && i == 0) {
+            fmt::print(stderr, "Warning: receiver does not support {} compression, sending raw\n",
+                       codec_name(compress));
+        }
+        codecs.push_back(codec);
     }
-    freeaddrinfo(res);
+    if (use_tls) fmt::print("kTLS enabled (AES-128-GCM)\n");
 
-    if (sockfd < 0) {
-        fmt::print(stderr, "Failed to connect\n");
+    if (!scanned) {
+        fmt::print("Authenticated. Scanning files...\n");
+        if (!AsyncSender::scan_files(src_path, files, extent_order,
+                                     (flags & protocol::FLAG_HARDLINKS) != 0)) {
+            close_all();
+            return 1;
+        }
+    }
+    // Links go ahead of the files on stream 0; the receiver makes them last
+    if (!files.links().empty() && !send_links(socks[0], files)) {
+        close_all();
         return 1;
     }
+    size_t total_files = files.size();
+    auto shards = shard_files(files, streams);
 
-    fmt::print("Connected. Authenticating...\n");
+    if (streams > 1) {
+        fmt::print("Sending {} files over {} streams...\n", total_files, streams);
+    } else {
+        fmt::print("Sending {} files...\n", total_files);
+    }
 
-    // Send HELLO (with dummy nonce - TLS not supported with --uring)
-    uint8_t dummy_nonce[protocol::NONCE_SIZE] = {};
-    auto hello = protocol::make_hello(secret, dummy_nonce);
-    if (send(sockfd, hello.data(), hello.size(), 0) < 0) {
-        close(sockfd);
+    // One compression pool for the whole transfer; each stream counts on
+    // its share of the workers when picking a level
+    std::unique_ptr<CompressPool> compressor;
+    if (std::any_of(codecs.begin(), codecs.end(),
+                    [](protocol::Codec c) { return c != protocol::Codec::NONE; })) {
+        size_t hw = std::max(1u, std::thread::hardware_concurrency());
+        compressor = std::make_unique<CompressPool>(std::clamp<size_t>(hw / 2, 1, 8));
+    }
+    double compress_threads = compressor ? double(compressor->threads()) / streams : 1.0;
+
+    // One AsyncSender (own ring + buffers) per stream
+    NetConfig cfg;
+    cfg.progress = (streams == 1);
+    cfg.zero_copy = zero_copy;
+    cfg.file_batch = file_batch;
+    cfg.incremental = (flags & protocol::FLAG_INCREMENTAL) != 0;
+    cfg.verify = (flags & protocol::FLAG_VERIFY) != 0;
+    cfg.sparse = (flags & protocol::FLAG_SPARSE) != 0;
+    cfg.ring = ring;
+    cfg.affinity = affinity;
+    std::unique_ptr<MetricsRegistry> registry;
+    std::unique_ptr<MetricsStreamer> streamer;
+    if (!start_metrics("send", SEND_OP_NAMES, metrics, registry, streamer)) {
+        close_all();
         return 1;
     }
+    std::vector<WorkerMetrics*> stream_metrics(streams, nullptr);
+    for (int i = 0; registry && i < streams; i++) {
+        stream_metrics[i] = &registry->add(fmt::format("stream {}", i));
+    }
+    std::vector<char> ok(streams, 0);
+    std::atomic<size_t> sent{0};
+    std::atomic<uint64_t> raw_bytes{0};
+    std::atomic<uint64_t> wire_bytes{0};
+    std::atomic<uint64_t> hole_bytes{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < streams; i++) {
+        threads.emplace_back([&, i] {
+            try {
+                NetConfig stream_cfg = cfg;
+                stream_cfg.compress = codecs[i];
+                stream_cfg.ring_index = i;
+                stream_cfg.metrics = stream_metrics[i];
+                int cpu = affinity ? place_stream(socks[i], fmt::format("stream {}", i)) : -1;
+                AsyncSender sender(socks[i], files, shards[i], shards[i + 1], stream_cfg,
+                                   compressor.get(), compress_threads);
+                if (cpu >= 0) pin_thread({cpu});
+                ok[i] = sender.run();
+                sent += sender.files_sent();
+                raw_bytes += sender.raw_bytes();
+                wire_bytes += sender.wire_bytes();
+                hole_bytes += sender.hole_bytes();
+            } catch (const std::exception& e) {
+                fmt::print(stderr, "Error: {}\n", e.what());
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    close_all();
+
+    bool reports_ok = true;
+    if (streamer) streamer->stop();
+    if (registry) {
+        reports_ok = write_metrics_reports(
+            *registry, metrics,
+            fmt::format("\"files_sent\":{},\"raw_bytes\":{},\"wire_bytes\":{}",
+                        sent.load() + delta_sent, raw_bytes.load(), wire_bytes.load()));
+    }
 
-    // Receive response
-    uint8_t resp_hdr[protocol::MSG_HEADER_SIZE];
-    if (recv(sockfd, resp_hdr, sizeof(resp_hdr), MSG_WAITALL) != sizeof(resp_hdr)) {
-        fmt::print(stderr, "Failed to receive auth response\n");
-        close(sockfd);
+    bool all_ok = std::all_of(ok.begin(), ok.end(), [](char v) { return v != 0; });
+    if (!all_ok) {
+        fmt::print(stderr, "Transfer failed\n");
         return 1;
     }
 
-    protocol::MsgType type;
-    uint32_t len;
-    protocol::parse_header(resp_hdr, type, len);
+    fmt::print("Transfer complete: {} files{}\n", sent.load() + delta_sent,
+               files.links().empty() ? "" : fmt::format(", {} hardlinks", files.links().size()));
+    if (hole_bytes > 0) {
+        fmt::print("Sparse: {:.1f} MB of holes not sent\n", hole_bytes / 1e6);
+    }
+    if (raw_bytes > 0) {
+        fmt::print("Compressed {:.1f} MB to {:.1f} MB on the wire ({:.2f}x)\n",
+                   raw_bytes / 1e6, wire_bytes / 1e6, double(raw_bytes) / wire_bytes);
+    }
+    return reports_ok ? 0 : 1;
+}
 
-    if (type != protocol::MsgType::HELLO_OK) {
-        fmt::print(stderr, "Authentication failed\n");
-        close(sockfd);
-        return 1;
+int run_receiver_uring(const std::string& dst_path, uint16_t port,
+                       const std::string& secret, bool zero_copy, bool use_tls,
+                       unsigned write_workers, uint64_t direct_size, const RingSetup& ring,
+                       bool affinity, const MetricsSetup& metrics) {
+    // Workers and the stream wake each other with MSG_RING (5.18+)
+    if (write_workers > 0 && !uring_supports_op(IORING_OP_MSG_RING)) {
+        fmt::print(stderr, "Warning: kernel lacks IORING_OP_MSG_RING, writing from the stream's ring\n");
+        write_workers = 0;
     }
 
-    fmt::print("Authenticated. Scanning files...\n");
+    fmt::print("Listening on port {}...{}\n", port, use_tls ? " (kTLS enabled)" : "");
+    fmt::print("Mode: io_uring async{}{}{}{}\n", zero_copy ? ", provided buffer ring" : "",
+               write_workers > 0 ? fmt::format(", {} write workers per stream", write_workers) : "",
+               direct_size > 0 ? fmt::format(", O_DIRECT from {}", format_bytes(direct_size)) : "",
+               ring.profile != RingProfile::DEFAULT
+                   ? fmt::format(", {} ring", ring_profile_name(ring.profile)) : "");
+    fmt::print("Secret: {}\n", secret.empty() ? "(none)" : secret);
 
-    // Run async sender
-    try {
-        NetConfig cfg;
-        AsyncSender sender(sockfd, src_path, cfg);
+    // Backlog fits every stream of a session connecting at once
+    int listenfd = open_listener(port, protocol::MAX_STREAMS);
+    if (listenfd < 0) return 1;
 
-        if (!sender.scan_files()) {
-            close(sockfd);
-            return 1;
-        }
+    // Create destination directory
+    fs::create_directories(dst_path);
 
-        if (!sender.run()) {
-            close(sockfd);
-            return 1;
-        }
-    } catch (const std::exception& e) {
-        fmt::print(stderr, "Error: {}\n", e.what());
-        close(sockfd);
+    NetConfig cfg;
+    cfg.zero_copy = zero_copy;
+    cfg.write_workers = write_workers;
+    cfg.direct_size = direct_size;
+    cfg.ring = ring;
+    cfg.affinity = affinity;
+    std::unique_ptr<MetricsRegistry> registry;
+    std::unique_ptr<MetricsStreamer> streamer;
+    if (!start_metrics("recv", RECV_OP_NAMES, metrics, registry, streamer)) {
+        close(listenfd);
         return 1;
     }
+    std::vector<std::thread> threads;
+    std::atomic<size_t> received{0};
+    std::atomic<size_t> corrupt{0};
+    std::atomic<size_t> unwritten{0};
+    std::atomic<bool> failed{false};
+    std::mutex links_mutex;
+    std::vector<std::pair<std::string, std::string>> links;    // Made once every stream is done
+
+    // The first authenticated HELLO defines the session; the remaining
+    // streams must present the same id
+    protocol::SessionInfo session;
+    std::vector<char> joined;
+    size_t joined_count = 0;
+    bool error = false;
+    JournalSet journals;
+
+    while (joined.empty() || joined_count < joined.size()) {
+        if (!joined.empty()) {
+            struct pollfd pfd = {listenfd, POLLIN, 0};
+            if (poll(&pfd, 1, STREAM_JOIN_TIMEOUT_MS) <= 0) {
+                fmt::print(stderr, "Timed out waiting for {} more stream(s)\n",
+                           joined.size() - joined_count);
+                error = true;
+                break;
+            }
+        }
 
-    close(sockfd);
-    return 0;
-}
-
-int run_receiver_uring(const std::string& dst_path, uint16_t port,
-                       const std::string& secret) {
-    fmt::print("Listening on port {}...\n", port);
-    fmt::print("Mode: io_uring async\n");
-    fmt::print("Secret: {}\n", secret.empty() ? "(none)" : secret);
+        // Accept connection
+        int clientfd = accept4(listenfd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (clientfd < 0) {
+            fmt::print(stderr, "Accept failed\n");
+            error = true;
+            break;
+        }
+        fmt::print("Connection from {}\n", peer_address(clientfd));
 
-    // Create socket
-    int listenfd = socket(AF_INET6, SOCK_STREAM, 0);
-    if (listenfd < 0) {
-        fmt::print(stderr, "Failed to create socket\n");
-        return 1;
-    }
+        protocol::HelloMsg hello;
+        if (!recv_hello(clientfd, hello)) {
+            close(clientfd);
+            if (joined.empty()) { error = true; break; }
+            continue;
+        }
 
-    int opt = 1;
-    setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        if (!secret.empty() && hello.secret != secret) {
+            fmt::print(stderr, "Invalid secret\n");
+            reject_hello(clientfd, protocol::FAIL_BAD_SECRET);
+            if (joined.empty()) { error = true; break; }
+            continue;
+        }
 
-    // Dual-stack
-    int no = 0;
-    setsockopt(listenfd, IPPROTO_IPV6, IPV6_V6ONLY, &no, sizeof(no));
+        if (joined.empty()) {
+            session = hello.session;
+            joined.assign(session.count, 0);
+            cfg.progress = (session.count == 1);
+        } else if (hello.session.id != session.id || hello.session.count != session.count ||
+                   joined[hello.session.index]) {
+            fmt::print(stderr, "Rejected stream: not part of the current session\n");
+            reject_hello(clientfd, protocol::FAIL_BAD_SESSION);
+            continue;
+        }
+        joined[hello.session.index] = 1;
+        joined_count++;
 
-    struct sockaddr_in6 addr = {};
-    addr.sin6_family = AF_INET6;
-    addr.sin6_port = htons(port);
-    addr.sin6_addr = in6addr_any;
+        CheckpointJournal* journal = nullptr;
+        int flags = answer_hello(clientfd, hello, dst_path, use_tls, journals, journal);
+        if (flags < 0) {
+            close(clientfd);
+            error = true;
+            break;
+        }
 
-    if (bind(listenfd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
-        fmt::print(stderr, "Failed to bind: {}\n", strerror(errno));
-        close(listenfd);
-        return 1;
-    }
+        if (joined_count == 1) {
+            fmt::print("Authenticated. Receiving files...\n");
+        }
+        if (session.count > 1) {
+            fmt::print("Stream {}/{} joined\n", joined_count, session.count);
+        }
 
-    if (listen(listenfd, 1) < 0) {
-        close(listenfd);
-        return 1;
+        // Run async receiver (own ring + buffers) per stream
+        NetConfig stream_cfg = stream_config(cfg, hello, static_cast<uint8_t>(flags), journal);
+        stream_cfg.ring_index = static_cast<unsigned>(threads.size());
+        if (registry) {
+            stream_cfg.metrics = &registry->add(fmt::format("stream {}", hello.session.index));
+        }
+        threads.emplace_back([&, clientfd, stream_cfg] {
+            try {
+                int cpu = stream_cfg.affinity
+                              ? place_stream(clientfd, fmt::format("stream {}", stream_cfg.ring_index))
+                              : -1;
+                AsyncReceiver receiver(clientfd, dst_path, stream_cfg);
+                if (cpu >= 0) pin_thread({cpu});
+                if (!receiver.run()) failed = true;
+                received += receiver.files_received();
+                corrupt += receiver.files_corrupt();
+                unwritten += receiver.files_failed();
+                std::lock_guard<std::mutex> lock(links_mutex);
+                links.insert(links.end(), receiver.links().begin(), receiver.links().end());
+            } catch (const std::exception& e) {
+                fmt::print(stderr, "Error: {}\n", e.what());
+                failed = true;
+            }
+            close(clientfd);
+        });
     }
-
-    // Accept connection
-    struct sockaddr_storage client_addr;
-    socklen_t client_len = sizeof(client_addr);
-    int clientfd = accept(listenfd, (struct sockaddr*)&client_addr, &client_len);
     close(listenfd);
 
-    if (clientfd < 0) {
-        fmt::print(stderr, "Accept failed\n");
-        return 1;
+    for (auto& t : threads) t.join();
+    // Kept if a partial file is left for the next --resume
+    journals.close_all();
+
+    bool reports_ok = true;
+    if (streamer) streamer->stop();
+    if (registry) {
+        reports_ok = write_metrics_reports(
+            *registry, metrics,
+            fmt::format("\"files_received\":{},\"files_corrupt\":{},\"files_failed\":{}",
+                        received.load(), corrupt.load(), unwritten.load()));
     }
 
-    // Get client address string
-    char client_str[INET6_ADDRSTRLEN];
-    if (client_addr.ss_family == AF_INET6) {
-        inet_ntop(AF_INET6, &((struct sockaddr_in6*)&client_addr)->sin6_addr,
-                  client_str, sizeof(client_str));
-    } else {
-        inet_ntop(AF_INET, &((struct sockaddr_in*)&client_addr)->sin_addr,
-                  client_str, sizeof(client_str));
+    if (corrupt > 0) {
+        fmt::print(stderr, "Checksum mismatch: {} files failed verification\n", corrupt.load());
     }
-    fmt::print("Connection from {}\n", client_str);
-
-    // Receive HELLO
-    uint8_t hdr_buf[protocol::MSG_HEADER_SIZE];
-    if (recv(clientfd, hdr_buf, sizeof(hdr_buf), MSG_WAITALL) != sizeof(hdr_buf)) {
-        fmt::print(stderr, "Failed to receive HELLO\n");
-        close(clientfd);
+    if (unwritten > 0) {
+        fmt::print(stderr, "Write errors: {} files could not be written\n", unwritten.load());
+    }
+    if (error || failed || corrupt > 0 || unwritten > 0) {
         return 1;
     }
-
-    protocol::MsgType type;
-    uint32_t payload_len;
-    protocol::parse_header(hdr_buf, type, payload_len);
-
-    if (type != protocol::MsgType::HELLO) {
-        fmt::print(stderr, "Expected HELLO, got {}\n", (int)type);
-        close(clientfd);
+    if (size_t bad = make_links(dst_path, links); bad > 0) {
+        fmt::print(stderr, "{} of {} hardlinks failed\n", bad, links.size());
         return 1;
     }
 
-    std::vector<uint8_t> payload(payload_len);
-    if (recv(clientfd, payload.data(), payload_len, MSG_WAITALL) != (ssize_t)payload_len) {
-        close(clientfd);
+    fmt::print("Transfer complete: {} files received{}\n", received.load(),
+               links.empty() ? "" : fmt::format(", {} hardlinks", links.size()));
+    return reports_ok ? 0 : 1;
+}
+
+int run_receiver_daemon(const std::string& dst_path, uint16_t port, const std::string& secret,
+                        const std::string& config_path, bool zero_copy, bool use_tls,
+                        unsigned write_workers, uint64_t direct_size, unsigned warm,
+                        const RingSetup& ring, bool affinity) {
+    std::vector<DaemonRoute> routes;
+    if (!dst_path.empty()) routes.push_back({secret, dst_path});
+    if (!config_path.empty()) {
+        std::string error;
+        if (!load_daemon_routes(config_path, routes, error)) {
+            fmt::print(stderr, "Error: {}: {}\n", config_path, error);
+            return 1;
+        }
+        for (size_t i = 1; i < routes.size() && !dst_path.empty(); i++) {
+            if (routes[i].secret == secret) {
+                fmt::print(stderr, "Error: {}: --secret is listed again\n", config_path);
+                return 1;
+            }
+        }
+    }
+    if (routes.empty()) {
+        fmt::print(stderr, "Error: --daemon needs <dest> or --config with at least one route\n");
         return 1;
     }
 
-    protocol::HelloMsg hello;
-    if (!protocol::parse_hello(payload.data(), payload_len, hello)) {
-        close(clientfd);
-        return 1;
+    if (write_workers > 0 && !uring_supports_op(IORING_OP_MSG_RING)) {
+        fmt::print(stderr, "Warning: kernel lacks IORING_OP_MSG_RING, writing from the stream's ring\n");
+        write_workers = 0;
     }
 
-    if (!secret.empty() && hello.secret != secret) {
-        fmt::print(stderr, "Invalid secret\n");
-        auto fail = protocol::make_hello_fail(1);
-        send(clientfd, fail.data(), fail.size(), 0);
-        close(clientfd);
+    // Backlog for several sessions connecting their streams at once
+    int listenfd = open_listener(port, static_cast<int>(DAEMON_MAX_THREADS));
+    if (listenfd < 0) return 1;
+
+    // SIGINT/SIGTERM are read from a signalfd in the accept ring; blocked
+    // before any stream thread starts, so every thread inherits the mask.
+    // A peer hanging up mid-handshake must not kill the daemon.
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+    int sigfd = signalfd(-1, &mask, SFD_CLOEXEC);
+    if (sigfd < 0) {
+        fmt::print(stderr, "signalfd: {}\n", strerror(errno));
+        close(listenfd);
         return 1;
     }
 
-    // Send HELLO_OK (with dummy nonce - kTLS not supported with uring receiver)
-    uint8_t dummy_nonce[protocol::NONCE_SIZE] = {};
-    auto ok = protocol::make_hello_ok(dummy_nonce);
-    send(clientfd, ok.data(), ok.size(), 0);
-
-    fmt::print("Authenticated. Receiving files...\n");
-
-    // Create destination directory
-    fs::create_directories(dst_path);
+    fmt::print("Daemon listening on port {}...{}\n", port, use_tls ? " (kTLS enabled)" : "");
+    fmt::print("Mode: io_uring async, {} warm stream(s){}{}{}{}\n", warm,
+               zero_copy ? ", provided buffer ring" : "",
+               write_workers > 0 ? fmt::format(", {} write workers per stream", write_workers) : "",
+               direct_size > 0 ? fmt::format(", O_DIRECT from {}", format_bytes(direct_size)) : "",
+               ring.profile != RingProfile::DEFAULT
+                   ? fmt::format(", {} ring", ring_profile_name(ring.profile)) : "");
+    for (const auto& route : routes) {
+        fmt::print("Route: {} -> {}\n", route.secret.empty() ? "(any secret)" : "(secret)", route.root);
+    }
 
-    // Run async receiver
-    try {
-        NetConfig cfg;
-        AsyncReceiver receiver(clientfd, dst_path, cfg);
+    NetConfig cfg;
+    cfg.zero_copy = zero_copy;
+    cfg.write_workers = write_workers;
+    cfg.direct_size = direct_size;
+    cfg.ring = ring;
+    cfg.affinity = affinity;
 
-        if (!receiver.run()) {
-            close(clientfd);
-            return 1;
-        }
-    } catch (const std::exception& e) {
-        fmt::print(stderr, "Error: {}\n", e.what());
-        close(clientfd);
-        return 1;
-    }
+    ReceiverDaemon daemon(std::move(routes), cfg, use_tls, warm);
+    bool ok = daemon.run(listenfd, sigfd);
+    close(listenfd);
+    close(sigfd);
+    fmt::print("Shutting down after the streams already accepted...\n");
+    daemon.stop();
 
-    close(clientfd);
-    return 0;
+    fmt::print("Daemon stopped: {} sessions complete, {} failed\n", daemon.sessions_ok(),
+               daemon.sessions_failed());
+    return ok ? 0 : 1;
 }
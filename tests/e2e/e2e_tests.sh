@@ -330,6 +330,896 @@ test_overwrite_existing() {
     cleanup
 }
 
+# Second run copies nothing; a changed file is the only one copied again
+test_incremental_local() {
+    test_name "Incremental local copy (--incremental)"
+    setup
+    mkdir -p "$SRC_DIR/sub"
+    for i in {1..20}; do
+        echo "file $i" > "$SRC_DIR/file_$i.txt"
+    done
+    dd if=/dev/urandom of="$SRC_DIR/sub/large.bin" bs=1M count=2 2>/dev/null
+
+    $BINARY --incremental "$SRC_DIR" "$DST_DIR" >/dev/null 2>&1
+    local second=$($BINARY --incremental "$SRC_DIR" "$DST_DIR" 2>&1)
+    echo "changed" >> "$SRC_DIR/file_3.txt"
+    local third=$($BINARY --incremental "$SRC_DIR" "$DST_DIR" 2>&1)
+
+    if [[ "$second" == *"Up to date: 21 files unchanged"* ]] &&
+       [[ "$third" == *"Completed: 1 files"* ]] && compare_dirs "$SRC_DIR" "$DST_DIR"; then
+        pass "Incremental local copy"
+    else
+        fail "Incremental local copy" "second: $second / third: $third"
+    fi
+    cleanup
+}
+
+# Sampled re-read after copying, through each data path: splice, read/write
+# (CRCs taken on the way) and copy_file_range (--sync)
+test_verify_local() {
+    test_name "Verified local copy (--verify)"
+    setup
+    mkdir -p "$SRC_DIR/sub"
+    for i in {1..20}; do
+        echo "file $i" > "$SRC_DIR/file_$i.txt"
+    done
+    touch "$SRC_DIR/empty.txt"
+    dd if=/dev/urandom of="$SRC_DIR/sub/large.bin" bs=1M count=3 2>/dev/null
+
+    local ok=true log
+    for flags in "--verify" "--verify --no-splice" "--verify-sample 0 --no-chain" "--verify --sync"; do
+        rm -rf "$DST_DIR"
+        log=$($BINARY $flags "$SRC_DIR" "$DST_DIR" 2>&1) || ok=false
+        if [[ "$log" != *"Verified: 22 files"* ]] || ! compare_dirs "$SRC_DIR" "$DST_DIR"; then
+            ok=false
+            break
+        fi
+    done
+
+    if $ok; then
+        pass "Verified local copy"
+    else
+        fail "Verified local copy" "flags '$flags': $log"
+    fi
+    cleanup
+}
+
+test_split_large_file() {
+    test_name "Large files copied as parallel segments (--split-size)"
+    setup
+    mkdir -p "$SRC_DIR/sub"
+    dd if=/dev/urandom of="$SRC_DIR/big.bin" bs=1M count=40 2>/dev/null
+    # Not a multiple of the segment size
+    dd if=/dev/urandom of="$SRC_DIR/sub/odd.bin" bs=1000 count=20001 2>/dev/null
+    echo "small" > "$SRC_DIR/small.txt"
+
+    local ok=true log
+    for flags in "" "-j 4 -q 2" "--no-splice -c 100000" "-j 2 --verify-sample 0" "--split-size 16777216 --incremental"; do
+        rm -rf "$DST_DIR"
+        log=$($BINARY $flags "$SRC_DIR" "$DST_DIR" 2>&1) || ok=false
+        if [[ "$log" != *"Completed: 3 files"* ]] || ! compare_dirs "$SRC_DIR" "$DST_DIR"; then
+            ok=false
+            break
+        fi
+    done
+    # A single large file is split too
+    if $ok; then
+        rm -rf "$DST_DIR"
+        $BINARY -j 2 "$SRC_DIR/big.bin" "$TEST_BASE/one.bin" >/dev/null 2>&1 || ok=false
+        cmp -s "$SRC_DIR/big.bin" "$TEST_BASE/one.bin" || ok=false
+        flags="(single file)"
+    fi
+
+    if $ok; then
+        pass "Split large-file copy"
+    else
+        fail "Split large-file copy" "flags '$flags': $log"
+    fi
+    cleanup
+}
+
+# A journal saying the first 16MB of the copy are written: --resume keeps
+# them (zeros here, so a recopy would show) and copies the rest
+test_resume_local() {
+    test_name "Interrupted copy picked up from its journal (--resume)"
+    setup
+    dd if=/dev/urandom of="$SRC_DIR/big.bin" bs=1M count=40 2>/dev/null
+    touch -d @1700000000 "$SRC_DIR/big.bin"
+    echo "small" > "$SRC_DIR/small.txt"
+    truncate -s 40M "$DST_DIR/big.bin"
+    printf 'uring-sync journal 1\nR 41943040 1700000000000000000 0 16777216 big.bin\n' \
+        > "$TEST_BASE/.dst.uring-sync-journal"
+
+    local ok=true log again
+    log=$($BINARY --resume "$SRC_DIR" "$DST_DIR" 2>&1) || ok=false
+    [[ "$log" == *"Resumed: 1 files, 16.00 MB already copied"* ]] || ok=false
+    cmp -s -n 16777216 "$DST_DIR/big.bin" /dev/zero || ok=false
+    cmp -s -i 16777216 "$SRC_DIR/big.bin" "$DST_DIR/big.bin" || ok=false
+    cmp -s "$SRC_DIR/small.txt" "$DST_DIR/small.txt" || ok=false
+    [[ ! -e "$TEST_BASE/.dst.uring-sync-journal" ]] || ok=false
+    # Complete now: the next run skips it
+    again=$($BINARY --resume "$SRC_DIR" "$DST_DIR" 2>&1) || ok=false
+    [[ "$again" == *"Up to date"* ]] || ok=false
+
+    if $ok; then
+        pass "Resumed local copy"
+    else
+        fail "Resumed local copy" "first: $log; second: $again"
+    fi
+    cleanup
+}
+
+test_pipeline_depths() {
+    test_name "Read/write pipeline depths (--pipeline)"
+    setup
+    dd if=/dev/urandom of="$SRC_DIR/medium.bin" bs=1M count=6 2>/dev/null
+    dd if=/dev/urandom of="$SRC_DIR/odd.bin" bs=777 count=3333 2>/dev/null
+    echo "small" > "$SRC_DIR/small.txt"
+
+    local ok=true log depth
+    for depth in 1 2 3 4; do
+        rm -rf "$DST_DIR"
+        log=$($BINARY --no-splice --pipeline $depth -c 65536 "$SRC_DIR" "$DST_DIR" 2>&1) || ok=false
+        if ! compare_dirs "$SRC_DIR" "$DST_DIR"; then
+            ok=false
+            break
+        fi
+    done
+    if $ok && $BINARY --pipeline 5 "$SRC_DIR" "$DST_DIR" >/dev/null 2>&1; then
+        ok=false
+        log="--pipeline 5 was accepted"
+    fi
+
+    if $ok; then
+        pass "Pipeline depths"
+    else
+        fail "Pipeline depths" "depth $depth: $log"
+    fi
+    cleanup
+}
+
+# Every profile must copy correctly, whether the kernel takes it or not
+test_ring_profiles() {
+    test_name "Ring setup profiles (--ring)"
+    setup
+    for i in {1..40}; do
+        echo "ring file $i" > "$SRC_DIR/file_$i.txt"
+    done
+    dd if=/dev/urandom of="$SRC_DIR/medium.bin" bs=1M count=3 2>/dev/null
+    dd if=/dev/urandom of="$SRC_DIR/large.bin" bs=1M count=40 2>/dev/null
+
+    local ok=true log profile
+    for profile in default sqpoll coop defer; do
+        rm -rf "$DST_DIR"
+        log=$($BINARY --ring $profile --sqpoll-cpu 0 -j 2 -q 4 "$SRC_DIR" "$DST_DIR" 2>&1) || ok=false
+        if ! $ok || ! compare_dirs "$SRC_DIR" "$DST_DIR"; then
+            ok=false
+            break
+        fi
+    done
+    if $ok && $BINARY --ring bogus "$SRC_DIR" "$DST_DIR" >/dev/null 2>&1; then
+        ok=false
+        log="--ring bogus was accepted"
+    fi
+
+    if $ok; then
+        pass "Ring profiles"
+    else
+        fail "Ring profiles" "$profile: $log"
+    fi
+    cleanup
+}
+
+# Tuned copies must match, on every engine the tuner can pick
+test_autotune() {
+    test_name "Adaptive tuning (--autotune)"
+    setup
+    mkdir -p "$SRC_DIR/sub"
+    for i in {1..60}; do
+        echo "tuned file $i" > "$SRC_DIR/sub/file_$i.txt"
+    done
+    dd if=/dev/urandom of="$SRC_DIR/medium.bin" bs=1M count=3 2>/dev/null
+    dd if=/dev/urandom of="$SRC_DIR/large.bin" bs=1M count=40 2>/dev/null
+
+    local ok=true log flags
+    for flags in "" "-j 2 --verify" "--no-splice -c 65536" "--quiet"; do
+        rm -rf "$DST_DIR"
+        log=$($BINARY --autotune $flags "$SRC_DIR" "$DST_DIR" 2>&1) || ok=false
+        if ! $ok || ! compare_dirs "$SRC_DIR" "$DST_DIR"; then
+            ok=false
+            break
+        fi
+        if [ -z "$flags" ] && ! echo "$log" | grep -q "Autotune: settled at depth"; then
+            ok=false
+            break
+        fi
+    done
+
+    if $ok; then
+        pass "Autotune"
+    else
+        fail "Autotune" "flags '$flags': $log"
+    fi
+    cleanup
+}
+
+# FIEMAP ordering changes only the order of the copy; segments of split
+# files and readahead hints on large ones must still add up
+test_extent_order() {
+    test_name "Physical extent order (--extent-order)"
+    setup
+    mkdir -p "$SRC_DIR/sub"
+    for i in {1..50}; do
+        echo "extent file $i" > "$SRC_DIR/sub/file_$i.txt"
+    done
+    touch "$SRC_DIR/empty.txt"
+    dd if=/dev/urandom of="$SRC_DIR/medium.bin" bs=1M count=3 2>/dev/null
+    dd if=/dev/urandom of="$SRC_DIR/large.bin" bs=1M count=40 2>/dev/null
+    sync
+
+    local ok=true log flags
+    for flags in "" "--no-splice -j 2" "--sync"; do
+        rm -rf "$DST_DIR"
+        log=$($BINARY --extent-order $flags "$SRC_DIR" "$DST_DIR" 2>&1) || ok=false
+        if ! $ok || ! compare_dirs "$SRC_DIR" "$DST_DIR" || [[ "$log" != *"Extent order:"* ]]; then
+            ok=false
+            break
+        fi
+    done
+
+    if $ok; then
+        pass "Extent order"
+    else
+        fail "Extent order" "flags '$flags': $log"
+    fi
+    cleanup
+}
+
+# A memory cap far below the process itself: the scan waits for the
+# workers batch by batch, but every file still arrives
+test_max_memory() {
+    test_name "Memory-capped scan (--max-memory)"
+    setup
+    for d in {1..8}; do
+        mkdir -p "$SRC_DIR/dir_$d/sub"
+        for i in {1..150}; do
+            echo "capped $d $i" > "$SRC_DIR/dir_$d/sub/file_$i.txt"
+        done
+    done
+
+    local ok=true log
+    log=$($BINARY --max-memory 1 -v "$SRC_DIR" "$DST_DIR" 2>&1) || ok=false
+    if $ok && compare_dirs "$SRC_DIR" "$DST_DIR" && [[ "$log" == *"Scan waits"* ]]; then
+        pass "Memory-capped scan"
+    else
+        fail "Memory-capped scan" "$log"
+    fi
+    cleanup
+}
+
+# Sparse images keep their holes: one with a hole in the middle and at the
+# end, one that is a hole up to its last megabyte
+test_sparse_local() {
+    test_name "Sparse files copied by data runs"
+    setup
+    dd if=/dev/urandom of="$SRC_DIR/disk.img" bs=1M count=1 2>/dev/null
+    dd if=/dev/urandom of="$SRC_DIR/disk.img" bs=1M count=1 seek=20 conv=notrunc 2>/dev/null
+    truncate -s 48M "$SRC_DIR/disk.img"
+    dd if=/dev/urandom of="$SRC_DIR/tail.img" bs=1M count=1 seek=31 2>/dev/null
+    echo "small" > "$SRC_DIR/small.txt"
+    if [[ $(du -k "$SRC_DIR/disk.img" | cut -f1) -ge 40000 ]]; then
+        skip "Sparse files" "filesystem does not keep holes"
+        cleanup
+        return
+    fi
+
+    local ok=true log flags
+    for flags in "" "--no-splice -j 2" "-j 2 --split-size 8388608" "--sync"; do
+        rm -rf "$DST_DIR"
+        log=$($BINARY $flags "$SRC_DIR" "$DST_DIR" 2>&1) || ok=false
+        if ! $ok || ! compare_dirs "$SRC_DIR" "$DST_DIR" || [[ "$log" != *"Sparse: "* ]] ||
+           [[ $(du -k "$DST_DIR/disk.img" | cut -f1) -ge 40000 ]] ||
+           [[ $(du -k "$DST_DIR/tail.img" | cut -f1) -ge 16000 ]]; then
+            ok=false
+            break
+        fi
+    done
+
+    if $ok; then
+        pass "Sparse files"
+    else
+        fail "Sparse files" "flags '$flags': $log"
+    fi
+    cleanup
+}
+
+# Three names of one file and one of its own; -H links them again
+test_hardlinks_local() {
+    test_name "Hardlinks recreated (-H)"
+    setup
+    mkdir -p "$SRC_DIR/a" "$SRC_DIR/b"
+    dd if=/dev/urandom of="$SRC_DIR/a/data.bin" bs=1M count=2 2>/dev/null
+    ln "$SRC_DIR/a/data.bin" "$SRC_DIR/b/same.bin"
+    ln "$SRC_DIR/a/data.bin" "$SRC_DIR/third.bin"
+    echo "alone" > "$SRC_DIR/alone.txt"
+
+    local ok=true log plain
+    log=$($BINARY -H "$SRC_DIR" "$DST_DIR" 2>&1) || ok=false
+    [[ "$log" == *"Hardlinks: 2 recreated"* ]] || ok=false
+    compare_dirs "$SRC_DIR" "$DST_DIR" || ok=false
+    [[ $(stat -c %h "$DST_DIR/b/same.bin") == 3 ]] || ok=false
+    [[ $(stat -c %i "$DST_DIR/a/data.bin") == $(stat -c %i "$DST_DIR/third.bin") ]] || ok=false
+    # Again: the links are already there
+    log=$($BINARY -H "$SRC_DIR" "$DST_DIR" 2>&1) || ok=false
+    [[ $(stat -c %h "$DST_DIR/b/same.bin") == 3 ]] || ok=false
+    # Without -H every name is a copy of its own
+    rm -rf "$DST_DIR"
+    plain=$($BINARY "$SRC_DIR" "$DST_DIR" 2>&1) || ok=false
+    [[ $(stat -c %h "$DST_DIR/b/same.bin") == 1 ]] || ok=false
+
+    if $ok; then
+        pass "Hardlinks"
+    else
+        fail "Hardlinks" "-H: $log; plain: $plain"
+    fi
+    cleanup
+}
+
+# Files over the --direct threshold bypass the page cache; their unaligned
+# tails are written padded and cut back to size
+test_direct_local() {
+    test_name "O_DIRECT copies (--direct)"
+    setup
+    dd if=/dev/urandom of="$SRC_DIR/big.bin" bs=1M count=9 2>/dev/null
+    head -c 123 /dev/urandom >> "$SRC_DIR/big.bin"
+    dd if=/dev/urandom of="$SRC_DIR/split.bin" bs=1M count=40 2>/dev/null
+    head -c 4097 /dev/urandom >> "$SRC_DIR/split.bin"
+    dd if=/dev/urandom of="$SRC_DIR/aligned.bin" bs=1M count=2 2>/dev/null
+    echo "small" > "$SRC_DIR/small.txt"
+    local direct=true
+    dd if=/dev/zero of="$SRC_DIR/.probe" bs=4096 count=1 oflag=direct 2>/dev/null || direct=false
+    rm -f "$SRC_DIR/.probe"
+
+    local ok=true log flags
+    for flags in "--direct" "--direct --split-size 8388608 -j 2" "--direct-size 1048576 --pipeline 1" \
+                 "--direct-size 1048576 --split-size 0 -c 12288"; do
+        rm -rf "$DST_DIR"
+        log=$($BINARY $flags "$SRC_DIR" "$DST_DIR" 2>&1) || ok=false
+        if ! $ok || ! compare_dirs "$SRC_DIR" "$DST_DIR" ||
+           { $direct && [[ "$log" != *"Direct I/O: "* ]]; }; then
+            ok=false
+            break
+        fi
+    done
+    # A chunk size O_DIRECT can't use: warned, copied through the cache
+    if $ok; then
+        rm -rf "$DST_DIR"
+        flags="--direct -c 10000"
+        log=$($BINARY $flags "$SRC_DIR" "$DST_DIR" 2>&1) || ok=false
+        [[ "$log" == *"not used"* ]] || ok=false
+        compare_dirs "$SRC_DIR" "$DST_DIR" || ok=false
+    fi
+
+    if $ok; then
+        pass "O_DIRECT copies"
+    else
+        fail "O_DIRECT copies" "flags '$flags': $log"
+    fi
+    cleanup
+}
+
+test_affinity_local() {
+    test_name "Worker placement (--affinity)"
+    setup
+    for i in {1..30}; do
+        echo "placed file $i" > "$SRC_DIR/file_$i.txt"
+    done
+    dd if=/dev/urandom of="$SRC_DIR/large.bin" bs=1M count=4 2>/dev/null
+
+    # Locality may be unknown here (tmpfs, a VM): the plan is still printed
+    local ok=true log flags
+    for flags in "--affinity -j 3" "--affinity -j 2 --ring sqpoll" "--affinity --sync -j 2"; do
+        rm -rf "$DST_DIR"
+        log=$($BINARY $flags "$SRC_DIR" "$DST_DIR" 2>&1) || ok=false
+        if ! $ok || ! compare_dirs "$SRC_DIR" "$DST_DIR" || [[ "$log" != *"Affinity: "* ]]; then
+            ok=false
+            break
+        fi
+    done
+
+    if $ok; then
+        pass "Worker placement"
+    else
+        fail "Worker placement" "flags '$flags': $log"
+    fi
+    cleanup
+}
+
+# Every report parses as JSON and names the op kinds: check_metrics <dir> <op>...
+check_metrics() {
+    local dir="$1"; shift
+    python3 - "$dir" "$@" <<'PY'
+import json, sys
+d, ops = sys.argv[1], sys.argv[2:]
+report = json.load(open(f"{d}/metrics.json"))
+trace = json.load(open(f"{d}/trace.json"))
+stream = [json.loads(line) for line in open(f"{d}/stream.ndjson")]
+assert stream and report["workers"], "empty report"
+for op in ops:
+    assert report["ops"][op]["count"] > 0, op
+    assert any(e.get("name") == op for e in trace["traceEvents"]), op
+PY
+}
+
+test_metrics() {
+    test_name "Latency metrics (--metrics, --metrics-stream, --trace)"
+    setup
+    for i in {1..40}; do
+        echo "metrics file $i" > "$SRC_DIR/file_$i.txt"
+    done
+    dd if=/dev/urandom of="$SRC_DIR/large.bin" bs=1M count=20 2>/dev/null
+
+    local out ok=true flags log
+    out=$(mktemp -d)
+    for flags in "" "--no-splice -j 2"; do
+        rm -rf "$DST_DIR" "$out"/*
+        log=$($BINARY $flags --metrics "$out/metrics.json" --trace "$out/trace.json" \
+              --metrics-stream "$out/stream.ndjson" --metrics-interval 20 \
+              "$SRC_DIR" "$DST_DIR" 2>&1) || ok=false
+        if ! $ok || ! compare_dirs "$SRC_DIR" "$DST_DIR" ||
+           ! check_metrics "$out" open_src open_dst close_src close_dst 2>/dev/null; then
+            ok=false
+            break
+        fi
+    done
+
+    if $ok && $BINARY --metrics-interval 0 "$SRC_DIR" "$DST_DIR" >/dev/null 2>&1; then
+        ok=false
+        log="--metrics-interval 0 accepted"
+    fi
+
+    if $ok; then
+        pass "Latency metrics"
+    else
+        fail "Latency metrics" "flags '$flags': $log"
+    fi
+    rm -rf "$out"
+    cleanup
+}
+
+# Round trip over localhost: run_network_transfer <name> <send flags> <recv flags>
+run_network_transfer() {
+    local name="$1" send_flags="$2" recv_flags="$3"
+    test_name "$name"
+    setup
+    mkdir -p "$SRC_DIR/sub"
+    for i in {1..30}; do
+        echo "stream file $i" > "$SRC_DIR/file_$i.txt"
+    done
+    touch "$SRC_DIR/sub/empty.txt"
+    dd if=/dev/urandom of="$SRC_DIR/sub/large.bin" bs=1M count=2 2>/dev/null
+    seq 1 200000 > "$SRC_DIR/sub/numbers.txt"
+
+    local port=$((20000 + (RANDOM + $$) % 20000))
+    $BINARY recv "$DST_DIR" --listen $port --secret e2e $recv_flags >/dev/null 2>&1 &
+    local recv_pid=$!
+    sleep 0.3
+
+    local send_ok=true
+    $BINARY send "$SRC_DIR" 127.0.0.1:$port --secret e2e $send_flags >/dev/null 2>&1 || send_ok=false
+    local recv_ok=true
+    wait $recv_pid || recv_ok=false
+
+    if $send_ok && $recv_ok && compare_dirs "$SRC_DIR" "$DST_DIR"; then
+        pass "$name"
+    else
+        fail "$name" "send_ok=$send_ok recv_ok=$recv_ok or content mismatch"
+    fi
+    cleanup
+}
+
+# A file the receiver can't write fails the receive, not just that file.
+# A plain file stands where sub/ should be, so opens under it fail with
+# ENOTDIR even for root (a read-only directory wouldn't stop root).
+test_network_write_error() {
+    local name="Network transfer (write error fails the receiver)"
+    test_name "$name"
+    setup
+    mkdir -p "$SRC_DIR/sub" "$DST_DIR"
+    for i in {1..10}; do
+        echo "stream file $i" > "$SRC_DIR/file_$i.txt"
+    done
+    echo "small" > "$SRC_DIR/sub/small.txt"
+    dd if=/dev/urandom of="$SRC_DIR/sub/large.bin" bs=1M count=2 2>/dev/null
+    echo "not a directory" > "$DST_DIR/sub"
+
+    local port=$((20000 + (RANDOM + $$) % 20000))
+    $BINARY recv "$DST_DIR" --listen $port --secret e2e --uring >"$TEST_BASE/recv.log" 2>&1 &
+    local recv_pid=$!
+    sleep 0.3
+
+    $BINARY send "$SRC_DIR" 127.0.0.1:$port --secret e2e --uring >/dev/null 2>&1
+    local recv_ok=true
+    wait $recv_pid || recv_ok=false
+    local log
+    log=$(cat "$TEST_BASE/recv.log")
+
+    if ! $recv_ok && [[ "$log" == *"could not be written"* ]] &&
+       cmp -s "$SRC_DIR/file_1.txt" "$DST_DIR/file_1.txt"; then
+        pass "$name"
+    else
+        fail "$name" "recv_ok=$recv_ok: $log"
+    fi
+    cleanup
+}
+
+test_network_streams() {
+    run_network_transfer "Network transfer (--uring --streams 3)" "--uring --streams 3" "--uring"
+}
+
+test_network_zero_copy() {
+    run_network_transfer "Network transfer (--uring --zero-copy)" "--uring --zero-copy" "--uring --zero-copy"
+}
+
+# kTLS needs the tls module; without it the handshake's setsockopt fails
+test_network_tls() {
+    if [[ ! -d /sys/module/tls ]] && ! modprobe tls 2>/dev/null; then
+        skip "Network transfer (--uring --tls)" "tls kernel module not available"
+        return
+    fi
+    run_network_transfer "Network transfer (--uring --tls, 2 streams)" "--uring --tls --streams 2" "--uring --tls"
+    separator
+    run_network_transfer "Network transfer (--uring --tls --compress)" "--uring --tls --compress" "--uring --tls"
+}
+
+test_network_mixed_engines() {
+    run_network_transfer "Network transfer (blocking send, --uring recv)" "" "--uring"
+}
+
+# Small files travel as FILE_BATCH frames unless --no-batch
+test_network_file_batch() {
+    run_network_transfer "Network transfer (--uring send, blocking recv, batched)" "--uring" ""
+    separator
+    run_network_transfer "Network transfer (--uring --no-batch)" "--uring --no-batch" "--uring"
+}
+
+# Compressed chunks (numbers.txt) and raw-framed ones (large.bin) in one stream
+test_network_compress() {
+    run_network_transfer "Network transfer (--uring --compress)" "--uring --compress" "--uring"
+    separator
+    run_network_transfer "Network transfer (--compress lz4, blocking recv)" "--uring --compress lz4" ""
+}
+
+# Send the same tree three times; the receiver's manifest leaves only the
+# changes to send: run_network_incremental <name> <send flags> <recv flags>
+run_network_incremental() {
+    local name="$1" send_flags="$2" recv_flags="$3"
+    test_name "$name"
+    setup
+    mkdir -p "$SRC_DIR/sub"
+    for i in {1..30}; do
+        echo "stream file $i" > "$SRC_DIR/file_$i.txt"
+    done
+    dd if=/dev/urandom of="$SRC_DIR/sub/large.bin" bs=1M count=2 2>/dev/null
+
+    local ok=true logs=()
+    for round in 1 2 3; do
+        if [[ $round == 3 ]]; then
+            echo "changed" >> "$SRC_DIR/file_7.txt"
+        fi
+        local port=$((20000 + (RANDOM + $$) % 20000))
+        $BINARY recv "$DST_DIR" --listen $port --secret e2e $recv_flags >/dev/null 2>&1 &
+        local recv_pid=$!
+        sleep 0.3
+        logs[$round]=$($BINARY send "$SRC_DIR" 127.0.0.1:$port --secret e2e \
+                       --incremental $send_flags 2>&1) || ok=false
+        wait $recv_pid || ok=false
+    done
+
+    if $ok && [[ "${logs[2]}" == *"Transfer complete: 0 files"* ]] &&
+       [[ "${logs[3]}" == *"Transfer complete: 1 files"* ]] && compare_dirs "$SRC_DIR" "$DST_DIR"; then
+        pass "$name"
+    else
+        fail "$name" "ok=$ok, round 2/3 sent more than the changes or content mismatch"
+    fi
+    cleanup
+}
+
+test_network_incremental() {
+    run_network_incremental "Network transfer (--incremental, 2 streams)" "--uring --streams 2" "--uring"
+    separator
+    run_network_incremental "Network transfer (--incremental, blocking recv)" "--uring" ""
+}
+
+# Changes a few bytes in the middle of a large file the receiver already
+# has and appends to another; only the dirty blocks and the appended data
+# should go out as literals:
+# run_network_delta <name> <send flags> <recv flags> <expected log line>
+run_network_delta() {
+    local name="$1" send_flags="$2" recv_flags="$3" expect="$4"
+    test_name "$name"
+    setup
+    echo "small" > "$SRC_DIR/small.txt"
+    # Created first so its delta (more than one send buffer) precedes the other
+    dd if=/dev/urandom of="$SRC_DIR/log.bin" bs=1M count=2 2>/dev/null
+    dd if=/dev/urandom of="$SRC_DIR/image.bin" bs=1M count=8 2>/dev/null
+
+    local ok=true logs=()
+    for round in 1 2; do
+        if [[ $round == 2 ]]; then
+            printf 'patched' | dd of="$SRC_DIR/image.bin" bs=1 seek=3000000 conv=notrunc 2>/dev/null
+            echo "more" >> "$SRC_DIR/small.txt"
+            dd if=/dev/urandom bs=1M count=2 2>/dev/null >> "$SRC_DIR/log.bin"
+        fi
+        local port=$((20000 + (RANDOM + $$) % 20000))
+        $BINARY recv "$DST_DIR" --listen $port --secret e2e $recv_flags >/dev/null 2>&1 &
+        local recv_pid=$!
+        sleep 0.3
+        logs[$round]=$($BINARY send "$SRC_DIR" 127.0.0.1:$port --secret e2e \
+                       --delta $send_flags 2>&1) || ok=false
+        wait $recv_pid || ok=false
+    done
+
+    if $ok && [[ "${logs[2]}" == *"$expect"* ]] && compare_dirs "$SRC_DIR" "$DST_DIR"; then
+        pass "$name"
+    else
+        fail "$name" "ok=$ok, expected '$expect' in: ${logs[2]}"
+    fi
+    cleanup
+}
+
+# Every file ends with a CRC the receiver checks: chunked, compressed,
+# batched and on the blocking receiver
+test_network_verify() {
+    run_network_transfer "Network transfer (--verify)" "--uring --verify" "--uring"
+    separator
+    run_network_transfer "Network transfer (--verify, compress, 2 streams)" \
+        "--uring --verify --compress --streams 2" "--uring --zero-copy"
+    separator
+    run_network_transfer "Network transfer (--verify, blocking recv)" "--uring --verify --compress" ""
+    separator
+    run_network_delta "Network transfer (--delta --verify)" "--uring --verify" "--uring" \
+        "Delta: 2 files, 2.1 MB of 12.6 MB sent as literals"
+}
+
+test_network_ring_profiles() {
+    run_network_transfer "Network transfer (--ring sqpoll)" "--uring --ring sqpoll --streams 2" "--uring --ring sqpoll"
+    separator
+    run_network_transfer "Network transfer (--ring defer)" "--uring --ring defer" "--uring --ring coop"
+}
+
+test_network_extent_order() {
+    run_network_transfer "Network transfer (--extent-order, 2 streams)" "--uring --extent-order --streams 2" "--uring"
+}
+
+# Disk ops on worker rings: batched and per-file opens, chunked writes
+# More files per stream than the sender keeps contexts for, across many
+# directories of the compact file list
+test_network_many_files() {
+    test_name "Network transfer (1500 files, context window reuse)"
+    setup
+    for d in {1..15}; do
+        mkdir -p "$SRC_DIR/d$d/inner"
+        for i in {1..100}; do
+            echo "window $d $i" > "$SRC_DIR/d$d/inner/f$i"
+        done
+    done
+
+    local port=$((20000 + (RANDOM + $$) % 20000))
+    $BINARY recv "$DST_DIR" --listen $port --secret e2e --uring >/dev/null 2>&1 &
+    local recv_pid=$!
+    sleep 0.3
+
+    local send_ok=true recv_ok=true
+    $BINARY send "$SRC_DIR" 127.0.0.1:$port --secret e2e --uring --streams 2 >/dev/null 2>&1 || send_ok=false
+    wait $recv_pid || recv_ok=false
+
+    if $send_ok && $recv_ok && compare_dirs "$SRC_DIR" "$DST_DIR"; then
+        pass "Network transfer (1500 files)"
+    else
+        fail "Network transfer (1500 files)" "send_ok=$send_ok recv_ok=$recv_ok or content mismatch"
+    fi
+    cleanup
+}
+
+# numbers.txt ends mid-block, large.bin on a block boundary
+test_network_direct() {
+    run_network_transfer "Network transfer (recv --direct)" "--uring --streams 2" \
+        "--uring --direct-size 1048576"
+    separator
+    run_network_transfer "Network transfer (recv --direct, --write-workers 2)" "--uring" \
+        "--uring --direct-size 1048576 --write-workers 2"
+}
+
+test_network_affinity() {
+    run_network_transfer "Network transfer (--affinity)" "--uring --streams 2 --affinity" \
+        "--uring --affinity --write-workers 2"
+}
+
+test_network_write_workers() {
+    run_network_transfer "Network transfer (--write-workers 2)" "--uring --streams 2" "--uring --write-workers 2"
+    separator
+    run_network_transfer "Network transfer (--write-workers, zero-copy, defer)" \
+        "--uring --no-batch" "--uring --write-workers 3 --zero-copy --ring defer"
+}
+
+# One daemon, two routes: concurrent sessions, then a back-to-back one on
+# the warm streams, then a clean SIGTERM
+test_network_daemon() {
+    local name="Network transfer (recv --daemon, 3 sessions)"
+    test_name "$name"
+    setup
+    mkdir -p "$SRC_DIR/sub" "$TEST_BASE/alpha" "$TEST_BASE/beta"
+    for i in {1..20}; do
+        echo "daemon file $i" > "$SRC_DIR/file_$i.txt"
+    done
+    dd if=/dev/urandom of="$SRC_DIR/sub/large.bin" bs=1M count=2 2>/dev/null
+    printf '# secret root\nalpha %s\nbeta %s\n' "$TEST_BASE/alpha" "$TEST_BASE/beta" > "$TEST_BASE/routes"
+
+    local port=$((20000 + (RANDOM + $$) % 20000))
+    $BINARY recv --listen $port --uring --daemon --warm 2 --config "$TEST_BASE/routes" \
+        >"$TEST_BASE/daemon.log" 2>&1 &
+    local recv_pid=$!
+    sleep 0.3
+
+    local send_ok=true
+    $BINARY send "$SRC_DIR" 127.0.0.1:$port --secret alpha --uring --streams 2 >/dev/null 2>&1 &
+    local alpha_pid=$!
+    $BINARY send "$SRC_DIR" 127.0.0.1:$port --secret beta --uring --compress >/dev/null 2>&1 || send_ok=false
+    wait $alpha_pid || send_ok=false
+    rm -rf "$TEST_BASE/beta"/*
+    $BINARY send "$SRC_DIR" 127.0.0.1:$port --secret beta --uring --verify >/dev/null 2>&1 || send_ok=false
+
+    # A wrong secret is turned away without hurting the daemon
+    $BINARY send "$SRC_DIR" 127.0.0.1:$port --secret gamma --uring >/dev/null 2>&1 && send_ok=false
+
+    local recv_ok=true
+    kill -TERM $recv_pid
+    wait $recv_pid || recv_ok=false
+
+    if $send_ok && $recv_ok && compare_dirs "$SRC_DIR" "$TEST_BASE/alpha" &&
+       compare_dirs "$SRC_DIR" "$TEST_BASE/beta" &&
+       grep -q "3 sessions complete, 0 failed" "$TEST_BASE/daemon.log"; then
+        pass "$name"
+    else
+        fail "$name" "send_ok=$send_ok recv_ok=$recv_ok, content mismatch or: $(tail -1 "$TEST_BASE/daemon.log")"
+    fi
+    cleanup
+}
+
+test_network_delta() {
+    run_network_delta "Network transfer (--delta)" "--uring" "--uring" \
+        "Delta: 2 files, 2.1 MB of 12.6 MB sent as literals"
+    separator
+    run_network_delta "Network transfer (--delta, 2 streams, compress)" \
+        "--uring --streams 2 --compress" "--uring" "Delta: 2 files, 2.1 MB of 12.6 MB"
+    separator
+    run_network_delta "Network transfer (--delta, blocking recv)" "--uring" "" \
+        "receiver does not support delta transfer"
+}
+
+# The receiver holds a 16MB prefix of big.bin and a journal vouching for
+# it: the sender is offered it and sends the rest
+run_network_resume() {
+    local name="$1" recv_flags="$2" expect="$3"
+    test_name "$name"
+    setup
+    dd if=/dev/urandom of="$SRC_DIR/big.bin" bs=1M count=40 2>/dev/null
+    touch -d @1700000000 "$SRC_DIR/big.bin"
+    echo "small" > "$SRC_DIR/small.txt"
+    truncate -s 16M "$DST_DIR/big.bin"
+    printf 'uring-sync journal 1\nR 41943040 1700000000000000000 0 16777216 big.bin\n' \
+        > "$TEST_BASE/.dst.uring-sync-journal"
+
+    local ok=true log
+    local port=$((20000 + (RANDOM + $$) % 20000))
+    $BINARY recv "$DST_DIR" --listen $port --secret e2e $recv_flags >/dev/null 2>&1 &
+    local recv_pid=$!
+    sleep 0.3
+    log=$($BINARY send "$SRC_DIR" 127.0.0.1:$port --secret e2e --uring --resume 2>&1) || ok=false
+    wait $recv_pid || ok=false
+
+    [[ "$log" == *"$expect"* ]] || ok=false
+    cmp -s -i 16777216 "$SRC_DIR/big.bin" "$DST_DIR/big.bin" || ok=false
+    cmp -s "$SRC_DIR/small.txt" "$DST_DIR/small.txt" || ok=false
+    if [[ -n "$recv_flags" ]]; then
+        # Resumed: the prefix was kept, and the journal went with the last partial file
+        cmp -s -n 16777216 "$DST_DIR/big.bin" /dev/zero || ok=false
+        [[ ! -e "$TEST_BASE/.dst.uring-sync-journal" ]] || ok=false
+    else
+        cmp -s "$SRC_DIR/big.bin" "$DST_DIR/big.bin" || ok=false
+    fi
+
+    if $ok; then
+        pass "$name"
+    else
+        fail "$name" "expected '$expect' in: $log"
+    fi
+    cleanup
+}
+
+test_network_resume() {
+    run_network_resume "Network transfer (--resume)" "--uring" \
+        "Resuming 1 partial files (16.0 MB already received)"
+    separator
+    run_network_resume "Network transfer (--resume, blocking recv)" "" \
+        "receiver does not support --resume"
+}
+
+# A sparse image and hardlinked names over the network:
+# run_network_sparse <name> <send flags> <recv flags> <links made (0/1)>
+# Holes stay holes only where the receiver takes FILE_HOLE (io_uring).
+run_network_sparse() {
+    local name="$1" send_flags="$2" recv_flags="$3" links="$4"
+    test_name "$name"
+    setup
+    mkdir -p "$SRC_DIR/a" "$SRC_DIR/b"
+    dd if=/dev/urandom of="$SRC_DIR/a/disk.img" bs=1M count=1 2>/dev/null
+    dd if=/dev/urandom of="$SRC_DIR/a/disk.img" bs=1M count=1 seek=20 conv=notrunc 2>/dev/null
+    truncate -s 48M "$SRC_DIR/a/disk.img"
+    dd if=/dev/urandom of="$SRC_DIR/tail.img" bs=1M count=1 seek=31 2>/dev/null
+    seq 1 100000 > "$SRC_DIR/a/numbers.txt"
+    ln "$SRC_DIR/a/numbers.txt" "$SRC_DIR/b/numbers.txt"
+    ln "$SRC_DIR/a/disk.img" "$SRC_DIR/b/disk.img"
+
+    local port=$((20000 + (RANDOM + $$) % 20000))
+    $BINARY recv "$DST_DIR" --listen $port --secret e2e $recv_flags >/dev/null 2>&1 &
+    local recv_pid=$!
+    sleep 0.3
+
+    local ok=true log
+    log=$($BINARY send "$SRC_DIR" 127.0.0.1:$port --secret e2e $send_flags 2>&1) || ok=false
+    wait $recv_pid || ok=false
+    compare_dirs "$SRC_DIR" "$DST_DIR" || ok=false
+    if [[ $links == 1 ]]; then
+        [[ "$log" == *"2 hardlinks"* ]] || ok=false
+        [[ $(stat -c %h "$DST_DIR/b/numbers.txt") == 2 ]] || ok=false
+        [[ $(stat -c %i "$DST_DIR/a/disk.img") == $(stat -c %i "$DST_DIR/b/disk.img") ]] || ok=false
+        [[ "$log" == *"Sparse: "* ]] || ok=false
+        [[ $(du -k "$DST_DIR/a/disk.img" | cut -f1) -lt 40000 ]] || ok=false
+    else
+        [[ $(stat -c %h "$DST_DIR/b/numbers.txt") == 1 ]] || ok=false
+    fi
+
+    if $ok; then
+        pass "$name"
+    else
+        fail "$name" "$log"
+    fi
+    cleanup
+}
+
+test_network_sparse_hardlinks() {
+    run_network_sparse "Network sparse files and hardlinks" "--uring --hardlinks" "--uring" 1
+    separator
+    run_network_sparse "Network sparse files and hardlinks (compress, verify, 2 streams)" \
+        "--uring --hardlinks --compress --verify --streams 2" "--uring --zero-copy" 1
+    separator
+    run_network_sparse "Network sparse files and hardlinks (incremental)" \
+        "--uring --hardlinks --incremental" "--uring" 1
+    separator
+    run_network_sparse "Network sparse files and hardlinks (blocking recv)" \
+        "--uring --hardlinks" "" 0
+}
+
+test_network_metrics() {
+    local out
+    out=$(mktemp -d)
+    local files="--metrics $out/metrics.json --trace $out/trace.json --metrics-stream $out/stream.ndjson"
+    run_network_transfer "Network transfer (--metrics, 2 streams)" \
+        "--uring --streams 2 $files" "--uring"
+    if ! check_metrics "$out" open read send; then
+        fail "Network metrics" "sender report missing or incomplete"
+    fi
+    rm -rf "$out"/*
+    separator
+    run_network_transfer "Network transfer (recv --metrics)" "--uring" "--uring $files"
+    if ! check_metrics "$out" recv write; then
+        fail "Network metrics" "receiver report missing or incomplete"
+    fi
+    rm -rf "$out"
+}
+
 # ============================================================
 # Main
 # ============================================================
@@ -352,7 +1242,41 @@ test_empty_directory; separator
 test_source_not_exists; separator
 test_workers_flag; separator
 test_verbose_flag; separator
-test_overwrite_existing
+test_overwrite_existing; separator
+test_incremental_local; separator
+test_verify_local; separator
+test_split_large_file; separator
+test_resume_local; separator
+test_pipeline_depths; separator
+test_ring_profiles; separator
+test_autotune; separator
+test_extent_order; separator
+test_max_memory; separator
+test_sparse_local; separator
+test_hardlinks_local; separator
+test_direct_local; separator
+test_affinity_local; separator
+test_metrics; separator
+test_network_streams; separator
+test_network_zero_copy; separator
+test_network_tls; separator
+test_network_mixed_engines; separator
+test_network_file_batch; separator
+test_network_compress; separator
+test_network_incremental; separator
+test_network_delta; separator
+test_network_resume; separator
+test_network_sparse_hardlinks; separator
+test_network_verify; separator
+test_network_extent_order; separator
+test_network_many_files; separator
+test_network_write_workers; separator
+test_network_direct; separator
+test_network_write_error; separator
+test_network_affinity; separator
+test_network_daemon; separator
+test_network_metrics; separator
+test_network_ring_profiles
 
 # Summary
 echo "========================================"
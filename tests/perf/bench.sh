@@ -7,6 +7,7 @@
 #   --runs N           Number of runs per test (default: 3)
 #   --cold             Drop caches between runs (requires sudo)
 #   --quick            Quick mode: 1 run, ml_small only
+#   --ring-profiles L  Sweep uring-sync ring setups, e.g. "default sqpoll coop defer"
 
 set -e
 
@@ -31,6 +32,7 @@ QUICK=false
 URING_WORKERS=1
 URING_QUEUE_DEPTH=64
 URING_SYNC=false
+RING_PROFILES=""
 
 # ============================================================
 # Argument Parsing
@@ -72,6 +74,10 @@ while [[ $# -gt 0 ]]; do
             URING_SYNC=true
             shift
             ;;
+        --ring-profiles)
+            RING_PROFILES="$2"
+            shift 2
+            ;;
         --data-dir=*)
             DATA_DIR="${1#*=}"
             shift
@@ -102,6 +108,7 @@ while [[ $# -gt 0 ]]; do
             echo "  -j, --uring-workers N  Number of uring-sync workers (default: 1)"
             echo "  -q, --uring-queue-depth N  Queue depth for uring-sync (default: 64)"
             echo "  --sync               Use sync mode for uring-sync (better for network storage)"
+            echo "  --ring-profiles LIST Run uring-sync once per ring profile (default sqpoll coop defer)"
             echo ""
             echo "Scenarios: ml_small, ml_small_aligned, ml_large, ml_large_aligned,"
             echo "           ml_images, large_files, mixed, deep_tree"
@@ -150,6 +157,19 @@ for s in $SCENARIOS; do
     fi
 done
 
+# Each ring profile is benchmarked as its own tool, uring:<profile>
+if [[ -n "$RING_PROFILES" ]]; then
+    expanded=""
+    for tool in $TOOLS; do
+        if [[ "$tool" == "uring" ]]; then
+            for p in $RING_PROFILES; do expanded="$expanded uring:$p"; done
+        else
+            expanded="$expanded $tool"
+        fi
+    done
+    TOOLS=$(echo "$expanded" | xargs)
+fi
+
 # ============================================================
 # Main Benchmark
 # ============================================================
@@ -205,7 +225,7 @@ for scenario in $SCENARIOS; do
         times=()
         for run in $(seq 1 $RUNS); do
             # Show progress
-            printf "  %-6s run %d/%d... " "$tool" "$run" "$RUNS"
+            printf "  %-13s run %d/%d... " "$tool" "$run" "$RUNS"
 
             # Drop caches if requested
             if $DROP_CACHES; then
@@ -218,6 +238,8 @@ for scenario in $SCENARIOS; do
                 rsync) t=$(time_cmd run_rsync "$src" "$dst") ;;
                 tar)   t=$(time_cmd run_tar "$src" "$dst") ;;
                 uring) t=$(time_cmd run_uring "$src" "$dst" "$URING_WORKERS" "$URING_QUEUE_DEPTH" "$URING_SYNC") ;;
+                uring:*)
+                    t=$(time_cmd run_uring "$src" "$dst" "$URING_WORKERS" "$URING_QUEUE_DEPTH" "$URING_SYNC" "${tool#uring:}") ;;
                 *)
                     warn "Unknown tool: $tool"
                     continue 2
@@ -240,7 +262,7 @@ for scenario in $SCENARIOS; do
         # Display summary for this tool
         throughput=$(echo "scale=2; $bytes / $median / 1048576" | bc)
         fps=$(echo "scale=0; $files / $median" | bc)
-        printf "  %-6s => %.3fs median, %s MB/s, %s files/s\n" "$tool" "$median" "$throughput" "$fps"
+        printf "  %-13s => %.3fs median, %s MB/s, %s files/s\n" "$tool" "$median" "$throughput" "$fps"
 
         # Track best
         if (( $(echo "$median < $best_time" | bc -l) )); then
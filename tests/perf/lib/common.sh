@@ -210,11 +210,165 @@ run_uring() {
     local workers="${3:-1}"
     local queue_depth="${4:-64}"
     local sync_mode="${5:-false}"
+    local ring="${6:-default}"
     rm -rf "$dst"
     mkdir -p "$dst"
     if [[ "$sync_mode" == "true" ]]; then
         "$URING_BINARY" --sync --quiet "$src" "$dst"
     else
-        "$URING_BINARY" -j "$workers" -q "$queue_depth" --quiet "$src" "$dst"
+        "$URING_BINARY" -j "$workers" -q "$queue_depth" --ring "$ring" --quiet "$src" "$dst"
     fi
 }
+
+# ============================================================
+# Regression Suite (regress.sh)
+# ============================================================
+
+# Empty the destination before a timed run, so the removal of the last
+# copy (and its writeback) stays out of the measurement
+reset_dst() {
+    local dst="$1"
+    rm -rf "$dst"
+    mkdir -p "$dst"
+    sync
+}
+
+# One uring-sync copy into a destination already reset by reset_dst
+uring_copy() {
+    local src="$1"
+    local dst="$2"
+    local workers="$3"
+    local queue_depth="$4"
+    "$URING_BINARY" -j "$workers" -q "$queue_depth" --quiet "$src" "$dst"
+}
+
+# Like time_cmd, from nanosecond timestamps (needs awk, not bc)
+time_cmd_ns() {
+    local start end
+    start=$(date +%s%N)
+    "$@" >/dev/null 2>&1
+    local exit_code=$?
+    end=$(date +%s%N)
+    awk -v s="$start" -v e="$end" 'BEGIN { printf "%.6f\n", (e - s) / 1e9 }'
+    return $exit_code
+}
+
+# Host fingerprint as key=value lines. Results are only comparable
+# between runs with the same host fields; date and binary are
+# informational.
+write_fingerprint() {
+    local file="$1"
+    local src_dev disk
+    src_dev=$(findmnt -no SOURCE -T "$DATA_DIR" 2>/dev/null | head -1)
+    disk=$(lsblk -ndo PKNAME "$src_dev" 2>/dev/null | head -1)
+    [[ -z "$disk" ]] && disk="${src_dev#/dev/}"
+    {
+        echo "kernel=$(uname -r)"
+        echo "cpu=$(grep 'model name' /proc/cpuinfo | head -1 | cut -d: -f2 | xargs)"
+        echo "cores=$(nproc)"
+        echo "memory=$(free -g | awk '/^Mem:/ {print $2 "G"}')"
+        echo "src_fs=$(findmnt -no FSTYPE -T "$DATA_DIR" 2>/dev/null || stat -f -c %T "$DATA_DIR")"
+        echo "dst_fs=$(findmnt -no FSTYPE -T "$(dirname "$DST_DIR")" 2>/dev/null || echo unknown)"
+        # Rotational flag, transport (nvme, sata, ...) and model of the source disk
+        echo "storage=$(lsblk -ndo ROTA,TRAN,MODEL "/dev/$disk" 2>/dev/null |
+                        awk '{ $1 = $1 ? "rotational" : "solid-state"; print }')"
+        echo "date=$(date -Iseconds)"
+        echo "binary=$(sha256sum "$URING_BINARY" 2>/dev/null | cut -c1-12)"
+    } > "$file"
+}
+
+# The fields that must match between a baseline and a run
+host_fields() {
+    grep -Ev '^(date|binary)=' "$1" 2>/dev/null
+}
+
+# Short name of a host fingerprint, names its baseline directory
+fingerprint_key() {
+    host_fields "$1" | sha256sum | cut -c1-12
+}
+
+init_regress_csv() {
+    echo "scenario,cache,workers,queue_depth,run,files,total_bytes,time_s,throughput_mbs,files_per_sec" > "$1"
+}
+
+# Compare two regress.sh CSVs, configuration by configuration, as a
+# markdown report on stdout. A configuration regresses when the median
+# MB/s or files/s drops by more than threshold% and a one-sided
+# permutation test on the runs gives p < alpha (the runs are few and not
+# normal, so no t-test). Returns 1 if any configuration regressed.
+compare_results() {
+    local baseline="$1" current="$2" threshold="$3" alpha="$4"
+    awk -F, -v threshold="$threshold" -v alpha="$alpha" '
+        function median(a, n,    i, j, t, s) {
+            for (i = 1; i <= n; i++) s[i] = a[i]
+            for (i = 2; i <= n; i++) {
+                t = s[i]
+                for (j = i - 1; j >= 1 && s[j] > t; j--) s[j + 1] = s[j]
+                s[j + 1] = t
+            }
+            return n % 2 ? s[(n + 1) / 2] : (s[n / 2] + s[n / 2 + 1]) / 2
+        }
+        # P(mean of base - mean of cur >= observed) under random relabelling
+        function p_lower(b, nb, c, nc,    v, n, i, j, t, k, sb, sc, d, hits, R) {
+            n = 0
+            for (i = 1; i <= nb; i++) { v[++n] = b[i]; sb += b[i] }
+            for (i = 1; i <= nc; i++) { v[++n] = c[i]; sc += c[i] }
+            d = sb / nb - sc / nc - 1e-9
+            R = 10000
+            for (k = 0; k < R; k++) {
+                for (i = n; i > 1; i--) {
+                    j = int(rand() * i) + 1
+                    t = v[i]; v[i] = v[j]; v[j] = t
+                }
+                sb = 0
+                for (i = 1; i <= nb; i++) sb += v[i]
+                sc = 0
+                for (i = nb + 1; i <= n; i++) sc += v[i]
+                if (sb / nb - sc / nc >= d) hits++
+            }
+            return (hits + 1) / (R + 1)
+        }
+        FNR == 1 { file++; next }
+        {
+            key = $1 SUBSEP $2 SUBSEP $3 SUBSEP $4
+            if (!(key in seen)) { seen[key] = 1; order[++keys] = key }
+            if (file == 1) { nb[key]++; bm[key, nb[key]] = $9; bf[key, nb[key]] = $10 }
+            else           { nc[key]++; cm[key, nc[key]] = $9; cf[key, nc[key]] = $10 }
+        }
+        END {
+            srand(1)
+            print "| Scenario | Cache | -j | -q | MB/s (base -> now) | files/s (base -> now) | p | Result |"
+            print "|----------|-------|----|----|--------------------|-----------------------|---|--------|"
+            for (k = 1; k <= keys; k++) {
+                key = order[k]
+                split(key, f, SUBSEP)
+                if (!nb[key] || !nc[key]) {
+                    printf "| %s | %s | %s | %s | | | | %s |\n", f[1], f[2], f[3], f[4],
+                           nb[key] ? "not run" : "new"
+                    continue
+                }
+                delete b1; delete c1; delete b2; delete c2
+                for (i = 1; i <= nb[key]; i++) { b1[i] = bm[key, i]; b2[i] = bf[key, i] }
+                for (i = 1; i <= nc[key]; i++) { c1[i] = cm[key, i]; c2[i] = cf[key, i] }
+                mb = median(b1, nb[key]); mc = median(c1, nc[key])
+                fb = median(b2, nb[key]); fc = median(c2, nc[key])
+                dm = mb > 0 ? (mc - mb) * 100 / mb : 0
+                df = fb > 0 ? (fc - fb) * 100 / fb : 0
+                pm = p_lower(b1, nb[key], c1, nc[key])
+                pf = p_lower(b2, nb[key], c2, nc[key])
+                p = pm < pf ? pm : pf
+                result = "ok"
+                if ((dm < -threshold && pm < alpha) || (df < -threshold && pf < alpha)) {
+                    result = "**REGRESSION**"
+                    regressions++
+                } else if (dm > threshold || df > threshold) {
+                    result = "faster"
+                }
+                printf "| %s | %s | %s | %s | %.1f -> %.1f (%+.1f%%) | %.0f -> %.0f (%+.1f%%) | %.3f | %s |\n",
+                       f[1], f[2], f[3], f[4], mb, mc, dm, fb, fc, df, p, result
+            }
+            printf "\n%d of %d configurations regressed (threshold %s%%, alpha %s)\n",
+                   regressions, keys, threshold, alpha
+            exit regressions > 0
+        }' "$baseline" "$current"
+}
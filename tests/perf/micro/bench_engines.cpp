@@ -0,0 +1,173 @@
+#include <benchmark/benchmark.h>
+#include "ring.hpp"
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+
+// ============================================================
+// In-Memory Copy Engines
+// ============================================================
+// One file copied between two memfds, so no device is involved and what
+// is measured is the engine: syscalls, ring round trips and copies
+// through user memory. Arg 0 is the file size, arg 1 the chunk.
+
+namespace {
+
+constexpr unsigned DEPTH = 16;     // Chunks in flight on the ring engines
+
+struct MemFiles {
+    int src = -1;
+    int dst = -1;
+    size_t size;
+
+    explicit MemFiles(size_t bytes) : size(bytes) {
+        src = memfd_create("bench_src", 0);
+        dst = memfd_create("bench_dst", 0);
+        std::vector<char> data(std::min<size_t>(bytes, 1 << 20), 'x');
+        for (size_t off = 0; src >= 0 && off < bytes; off += data.size()) {
+            if (pwrite(src, data.data(), std::min(data.size(), bytes - off), off) < 0) break;
+        }
+    }
+    ~MemFiles() {
+        if (src >= 0) close(src);
+        if (dst >= 0) close(dst);
+    }
+    bool ok() const { return src >= 0 && dst >= 0; }
+
+    // Each iteration writes a fresh destination
+    bool reset_dst() { return ftruncate(dst, 0) == 0; }
+};
+
+void finish(benchmark::State& state, const MemFiles& files) {
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(files.size));
+}
+
+}  // namespace
+
+// --sync: pread/pwrite on the calling thread
+static void BM_CopySync(benchmark::State& state) {
+    MemFiles files(static_cast<size_t>(state.range(0)));
+    size_t chunk = static_cast<size_t>(state.range(1));
+    std::vector<char> buf(chunk);
+    if (!files.ok()) return state.SkipWithError("memfd_create failed");
+
+    for (auto _ : state) {
+        if (!files.reset_dst()) return state.SkipWithError("ftruncate failed");
+        for (size_t off = 0; off < files.size; off += chunk) {
+            ssize_t n = pread(files.src, buf.data(), chunk, off);
+            if (n <= 0 || pwrite(files.dst, buf.data(), n, off) != n) {
+                return state.SkipWithError("pread/pwrite failed");
+            }
+        }
+    }
+    finish(state, files);
+}
+
+// copy_file_range: the kernel copies, one syscall per chunk
+static void BM_CopyFileRange(benchmark::State& state) {
+    MemFiles files(static_cast<size_t>(state.range(0)));
+    size_t chunk = static_cast<size_t>(state.range(1));
+    if (!files.ok()) return state.SkipWithError("memfd_create failed");
+
+    for (auto _ : state) {
+        if (!files.reset_dst()) return state.SkipWithError("ftruncate failed");
+        loff_t in = 0, out = 0;
+        while (static_cast<size_t>(in) < files.size) {
+            if (copy_file_range(files.src, &in, files.dst, &out, chunk, 0) <= 0) {
+                return state.SkipWithError("copy_file_range not supported on memfd");
+            }
+        }
+    }
+    finish(state, files);
+}
+
+// io_uring read/write: DEPTH chunks in flight, each a read linked to its
+// write, like the worker pipeline. Tag = slot * 2 + (1 for the write).
+static void BM_CopyUringReadWrite(benchmark::State& state) {
+    MemFiles files(static_cast<size_t>(state.range(0)));
+    unsigned chunk = static_cast<unsigned>(state.range(1));
+    if (!files.ok()) return state.SkipWithError("memfd_create failed");
+    RingManager ring(DEPTH * 2);
+    BufferPool pool(DEPTH, chunk);
+
+    for (auto _ : state) {
+        if (!files.reset_dst()) return state.SkipWithError("ftruncate failed");
+        uint64_t next = 0;
+        unsigned active = 0;
+        bool failed = false;
+        auto queue_chunk = [&](unsigned slot) {
+            unsigned len = static_cast<unsigned>(std::min<uint64_t>(chunk, files.size - next));
+            char* buf = pool.buffers()[slot];
+            ring.prepare_read(files.src, buf, len, next, nullptr, true, slot * 2);
+            ring.prepare_write(files.dst, buf, len, next, nullptr, false, slot * 2 + 1);
+            next += len;
+            active++;
+        };
+        for (unsigned slot = 0; slot < DEPTH && next < files.size; slot++) queue_chunk(slot);
+        ring.submit();
+
+        while (active > 0 && !failed) {
+            ring.wait_and_process([&](FileContext*, int res, unsigned tag) {
+                if (res < 0) failed = true;
+                if (!(tag & 1)) return;
+                active--;
+                if (next < files.size) queue_chunk(tag / 2);
+            });
+            ring.submit();
+        }
+        if (failed) return state.SkipWithError("io_uring read/write failed");
+    }
+    finish(state, files);
+}
+
+// io_uring splice: file -> pipe -> file, linked, DEPTH pipes in flight.
+// Tags as for read/write.
+static void BM_CopyUringSplice(benchmark::State& state) {
+    MemFiles files(static_cast<size_t>(state.range(0)));
+    unsigned chunk = static_cast<unsigned>(state.range(1));
+    if (!files.ok()) return state.SkipWithError("memfd_create failed");
+    RingManager ring(DEPTH * 2);
+    PipePool pipes(DEPTH, chunk);
+    std::vector<PipePool::PipeHandle> held(DEPTH);
+    for (auto& h : held) h = pipes.acquire();
+
+    for (auto _ : state) {
+        if (!files.reset_dst()) return state.SkipWithError("ftruncate failed");
+        uint64_t next = 0;
+        unsigned active = 0;
+        bool failed = false;
+        std::vector<unsigned> lens(DEPTH);
+        auto queue_chunk = [&](unsigned slot) {
+            unsigned len = static_cast<unsigned>(std::min<uint64_t>(chunk, files.size - next));
+            ring.prepare_splice(files.src, next, held[slot].write_fd, -1, len, 0, nullptr, true, slot * 2);
+            ring.prepare_splice(held[slot].read_fd, -1, files.dst, next, len, 0, nullptr, false, slot * 2 + 1);
+            lens[slot] = len;
+            next += len;
+            active++;
+        };
+        for (unsigned slot = 0; slot < DEPTH && next < files.size; slot++) queue_chunk(slot);
+        ring.submit();
+
+        while (active > 0 && !failed) {
+            ring.wait_and_process([&](FileContext*, int res, unsigned tag) {
+                // A short splice would leave bytes in the pipe: count it as failed
+                if (res < 0 || static_cast<unsigned>(res) != lens[tag / 2]) failed = true;
+                if (!(tag & 1)) return;
+                active--;
+                if (next < files.size && !failed) queue_chunk(tag / 2);
+            });
+            ring.submit();
+        }
+        if (failed) return state.SkipWithError("io_uring splice failed or came up short");
+    }
+    finish(state, files);
+}
+
+// Ring engines hand work to io-wq threads, so CPU time of ours alone would flatter them
+#define ENGINE_ARGS ArgsProduct({{64 << 10, 8 << 20, 64 << 20}, {64 << 10, 512 << 10}})->UseRealTime()
+BENCHMARK(BM_CopySync)->ENGINE_ARGS;
+BENCHMARK(BM_CopyFileRange)->ENGINE_ARGS;
+BENCHMARK(BM_CopyUringReadWrite)->ENGINE_ARGS;
+BENCHMARK(BM_CopyUringSplice)->ENGINE_ARGS;
@@ -0,0 +1,168 @@
+#include <benchmark/benchmark.h>
+#include "common.hpp"
+#include "scheduler.hpp"
+#include "protocol.hpp"
+#include <random>
+
+// Hot-path structures on their own: what one acquire, push/pop or
+// header round trip costs, and how the shared ones behave as threads
+// are added.
+
+// ============================================================
+// Buffer Pool
+// ============================================================
+
+// Each worker owns its pool, so threads measure per-worker cost side by
+// side (memory bandwidth and arena faults), not contention
+static void BM_BufferPoolAcquireRelease(benchmark::State& state) {
+    BufferPool pool(static_cast<size_t>(state.range(0)), 128 * 1024);
+    for (auto _ : state) {
+        auto [buf, index] = pool.acquire();
+        benchmark::DoNotOptimize(buf);
+        pool.release(index);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_BufferPoolAcquireRelease)->Arg(64)->Arg(1024)->ThreadRange(1, 8)->UseRealTime();
+
+// A worker's pattern: fill the queue depth, then drain it
+static void BM_BufferPoolDrainRefill(benchmark::State& state) {
+    size_t depth = static_cast<size_t>(state.range(0));
+    BufferPool pool(depth, 128 * 1024);
+    std::vector<int> held(depth);
+    for (auto _ : state) {
+        for (size_t i = 0; i < depth; i++) held[i] = pool.acquire().second;
+        for (size_t i = 0; i < depth; i++) pool.release(held[i]);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(depth));
+}
+BENCHMARK(BM_BufferPoolDrainRefill)->RangeMultiplier(4)->Range(4, 256);
+
+// ============================================================
+// Work Scheduler
+// ============================================================
+
+// A worker on its own deque: the lock-free bottom end, no thieves
+static void BM_ChaseLevOwnerPushPop(benchmark::State& state) {
+    ChaseLevDeque<FileWorkItem> deque;
+    FileWorkItem item{"some/dir/file_0001.bin", "/dst/some/dir/file_0001.bin", 1, 4096, 0644};
+    size_t burst = static_cast<size_t>(state.range(0));
+    for (auto _ : state) {
+        for (size_t i = 0; i < burst; i++) deque.push(&item);
+        while (FileWorkItem* out = deque.pop()) benchmark::DoNotOptimize(out);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(burst));
+}
+BENCHMARK(BM_ChaseLevOwnerPushPop)->Arg(1)->Arg(64)->Arg(1024);
+
+// Thread 0 owns the deque and pushes a burst then pops it back; every
+// other thread steals from the top meanwhile, so the last item of each
+// burst is a race between the owner's pop and the thieves' CAS
+static void BM_ChaseLevSteal(benchmark::State& state) {
+    static ChaseLevDeque<FileWorkItem>* deque = nullptr;
+    static FileWorkItem item{"some/dir/file_0001.bin", "/dst/some/dir/file_0001.bin", 1, 4096, 0644};
+    if (state.thread_index() == 0) deque = new ChaseLevDeque<FileWorkItem>();
+    // The loop starts and ends on a barrier of all threads, so the deque
+    // exists before any of them uses it and outlives all of them
+    int64_t taken = 0;
+    for (auto _ : state) {
+        if (state.thread_index() == 0) {
+            for (int i = 0; i < 64; i++) deque->push(&item);
+            while (deque->pop()) taken++;
+        } else if (deque->steal()) {
+            taken++;
+        }
+    }
+    state.SetItemsProcessed(taken);
+    if (state.thread_index() == 0) {
+        delete deque;
+        deque = nullptr;
+    }
+}
+BENCHMARK(BM_ChaseLevSteal)->ThreadRange(2, 16)->UseRealTime();
+
+// The scanner's batched hand-off, popped by one worker: one lock per
+// batch, then lock-free pops from the worker's own deque
+static void BM_WorkSchedulerBulk(benchmark::State& state) {
+    WorkScheduler<FileWorkItem> sched(1);
+    size_t batch = static_cast<size_t>(state.range(0));
+    std::vector<FileWorkItem> items;
+    for (auto _ : state) {
+        items.assign(batch, FileWorkItem{"a/b/c.txt", "/dst/a/b/c.txt", 1, 4096, 0644});
+        sched.push_bulk(items);
+        FileWorkItem out;
+        while (sched.try_pop(0, out)) benchmark::DoNotOptimize(out);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(batch));
+}
+BENCHMARK(BM_WorkSchedulerBulk)->RangeMultiplier(8)->Range(8, 4096);
+
+// Every thread is a worker; thread 0 is also the scanner. Whoever takes
+// a batch owns it and the rest steal halves of it, so this measures the
+// balance between the injection lock and the stealing as workers grow
+static void BM_WorkSchedulerStealing(benchmark::State& state) {
+    static WorkScheduler<FileWorkItem>* sched = nullptr;
+    if (state.thread_index() == 0) {
+        sched = new WorkScheduler<FileWorkItem>(static_cast<size_t>(state.threads()));
+    }
+    size_t w = static_cast<size_t>(state.thread_index());
+    std::vector<FileWorkItem> items;
+    int64_t taken = 0;
+    for (auto _ : state) {
+        if (w == 0 && sched->queued() < 4096) {
+            items.assign(256, FileWorkItem{"a/b/c.txt", "/dst/a/b/c.txt", 1, 4096, 0644});
+            sched->push_bulk(items);
+        }
+        FileWorkItem out;
+        if (sched->try_pop(w, out)) taken++;
+    }
+    state.SetItemsProcessed(taken);
+    if (w == 0) {
+        state.counters["steals"] = static_cast<double>(sched->steals());
+        delete sched;
+        sched = nullptr;
+    }
+}
+BENCHMARK(BM_WorkSchedulerStealing)->ThreadRange(1, 16)->UseRealTime();
+
+// ============================================================
+// Protocol
+// ============================================================
+
+static void BM_FileHdrRoundTrip(benchmark::State& state) {
+    std::string path(static_cast<size_t>(state.range(0)), 'p');
+    protocol::FileHdrMsg hdr;
+    for (auto _ : state) {
+        auto msg = protocol::make_file_hdr(1 << 20, 0644, path, true, 1700000000000000000);
+        bool ok = protocol::parse_file_hdr(msg.data() + protocol::MSG_HEADER_SIZE,
+                                           msg.size() - protocol::MSG_HEADER_SIZE, hdr);
+        benchmark::DoNotOptimize(ok);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FileHdrRoundTrip)->Arg(16)->Arg(64)->Arg(256);
+
+// ============================================================
+// Size Stats
+// ============================================================
+
+static void BM_SizeStatsPercentile(benchmark::State& state) {
+    SizeStats stats;
+    std::mt19937_64 rng(42);
+    for (int64_t i = 0; i < state.range(0); i++) stats.observe(rng() % (4 << 20));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(stats.percentile(90));
+    }
+    state.counters["samples"] = static_cast<double>(stats.samples.size());
+}
+BENCHMARK(BM_SizeStatsPercentile)->Arg(20)->Arg(1000)->Arg(1000000);
+
+static void BM_SizeStatsObserve(benchmark::State& state) {
+    SizeStats stats;
+    uint64_t size = 4096;
+    for (auto _ : state) {
+        stats.observe(size++);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SizeStatsObserve);
@@ -0,0 +1,48 @@
+#include <benchmark/benchmark.h>
+#include "ring.hpp"
+
+// ============================================================
+// Ring Round Trip
+// ============================================================
+// NOPs cost what the ring itself costs: SQE preparation, one
+// io_uring_enter per batch and the CQE reap, with no I/O behind them.
+// Arg 0 is the batch (queue depth).
+
+static void nop_round_trips(benchmark::State& state, RingProfile profile) {
+    unsigned depth = static_cast<unsigned>(state.range(0));
+    RingSetup setup;
+    setup.profile = profile;
+    RingManager ring(std::max(depth, 8u), setup);
+    if (ring.profile() != profile) {
+        state.SkipWithError("ring profile not supported here");
+        return;
+    }
+    unsigned completed = 0;
+    auto on_cqe = [&](FileContext*, int) { completed++; };
+
+    for (auto _ : state) {
+        for (unsigned i = 0; i < depth; i++) ring.prepare_nop(nullptr);
+        ring.submit();
+        completed = 0;
+        while (completed < depth) ring.wait_and_process(on_cqe);
+    }
+    state.SetItemsProcessed(state.iterations() * depth);
+}
+
+// Arg 1 is the RingProfile
+static void BM_RingNopRoundTrip(benchmark::State& state) {
+    auto profile = static_cast<RingProfile>(state.range(1));
+    state.SetLabel(ring_profile_name(profile));
+    nop_round_trips(state, profile);
+}
+BENCHMARK(BM_RingNopRoundTrip)
+    ->ArgsProduct({{1, 4, 16, 64, 256},
+                   {static_cast<int64_t>(RingProfile::DEFAULT),
+                    static_cast<int64_t>(RingProfile::COOP),
+                    static_cast<int64_t>(RingProfile::DEFER)}});
+
+// The SQPOLL thread works outside ours, so only real time is meaningful
+static void BM_RingNopSqpoll(benchmark::State& state) {
+    nop_round_trips(state, RingProfile::SQPOLL);
+}
+BENCHMARK(BM_RingNopSqpoll)->Arg(1)->Arg(16)->Arg(256)->UseRealTime();
@@ -0,0 +1,234 @@
+#!/bin/bash
+# Performance regression suite: runs uring-sync over a scenario matrix,
+# records the results with a host fingerprint, and compares them against
+# a stored baseline for the same host.
+# Usage: ./regress.sh [options]
+# Options:
+#   --matrix quick|full    Preset matrix (default: full)
+#   --scenarios LIST       Scenarios from gen_data.sh (overrides the preset)
+#   --workers LIST         Worker counts, e.g. "1 4"
+#   --queue-depths LIST    Queue depths, e.g. "32 64"
+#   --cache LIST           "warm", "cold" or both (cold requires sudo)
+#   --runs N               Measured runs per configuration (default: 5, min: 4)
+#   --threshold PCT        Median drop that counts as a regression (default: 5)
+#   --alpha P              Significance level of the comparison (default: 0.05)
+#   --baseline DIR         Compare against DIR (default: this host's stored baseline)
+#   --save-baseline        Store this run as the host's baseline
+#   --force                Compare even if the baseline's fingerprint differs
+# Exit status: 0 no regression, 1 regression, 2 usage or run error
+
+set -e
+
+BENCH_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "$BENCH_DIR/lib/common.sh"
+
+cleanup() {
+    echo ""
+    warn "Interrupted - cleaning up..."
+    rm -rf "$DST_BASE" 2>/dev/null || true
+    exit 130
+}
+trap cleanup INT TERM
+
+# Defaults
+MATRIX=full
+SCENARIOS=""
+WORKERS=""
+QUEUE_DEPTHS=""
+CACHES=""
+RUNS=5
+THRESHOLD=5
+ALPHA=0.05
+BASELINE=""
+SAVE_BASELINE=false
+FORCE=false
+BASELINES_DIR="$RESULTS_DIR_BASE/baselines"
+
+# ============================================================
+# Argument Parsing
+# ============================================================
+
+while [[ $# -gt 0 ]]; do
+    case $1 in
+        --matrix)        MATRIX="$2"; shift 2 ;;
+        --scenarios)     SCENARIOS="$2"; shift 2 ;;
+        --workers)       WORKERS="$2"; shift 2 ;;
+        --queue-depths)  QUEUE_DEPTHS="$2"; shift 2 ;;
+        --cache)         CACHES="$2"; shift 2 ;;
+        --runs)          RUNS="$2"; shift 2 ;;
+        --threshold)     THRESHOLD="$2"; shift 2 ;;
+        --alpha)         ALPHA="$2"; shift 2 ;;
+        --baseline)      BASELINE="$2"; shift 2 ;;
+        --save-baseline) SAVE_BASELINE=true; shift ;;
+        --force)         FORCE=true; shift ;;
+        --data-dir)      DATA_DIR="$2"; shift 2 ;;
+        --dst-dir)       DST_DIR="$2"; shift 2 ;;
+        -h|--help)
+            sed -n '2,18p' "$0" | sed 's/^# \{0,1\}//'
+            exit 0
+            ;;
+        *)
+            error "Unknown option: $1"
+            exit 2
+            ;;
+    esac
+done
+
+# Presets follow docs/notes/perf_test_plan.md: file count x size come from
+# the scenarios, then cache state x workers x queue depth
+case $MATRIX in
+    quick)
+        : "${SCENARIOS:=ml_small deep_tree}"
+        : "${WORKERS:=1 4}"
+        : "${QUEUE_DEPTHS:=64}"
+        : "${CACHES:=warm}"
+        ;;
+    full)
+        : "${SCENARIOS:=ml_small ml_large large_files mixed deep_tree}"
+        : "${WORKERS:=1 2 4 8}"
+        : "${QUEUE_DEPTHS:=32 64 128}"
+        : "${CACHES:=warm cold}"
+        ;;
+    *)
+        error "Unknown matrix: $MATRIX (quick or full)"
+        exit 2
+        ;;
+esac
+
+# The smallest p the permutation test can give is 1 / C(2n, n): 0.05 at
+# n = 3, so below 4 runs no drop can ever be significant at the default alpha
+if [[ ! "$RUNS" =~ ^[0-9]+$ ]] || (( RUNS < 4 )); then
+    error "--runs must be at least 4: with fewer the significance test can never fire"
+    exit 2
+fi
+if [[ ! -x "$URING_BINARY" ]]; then
+    error "Binary not found: $URING_BINARY (run make)"
+    exit 2
+fi
+
+# Cold runs need to drop the page cache; without sudo they are left out
+if [[ " $CACHES " == *" cold "* ]] && [[ $EUID -ne 0 ]] && ! sudo -n true 2>/dev/null; then
+    warn "Cannot drop caches without sudo, skipping cold-cache runs"
+    CACHES=$(echo " $CACHES " | sed 's/ cold / /' | xargs)
+fi
+if [[ -z "$CACHES" ]]; then
+    error "No cache state left to run"
+    exit 2
+fi
+
+for s in $SCENARIOS; do
+    if ! scenario_exists "$s"; then
+        info "Scenario '$s' not found, generating..."
+        "$BENCH_DIR/gen_data.sh" --data-dir "$DATA_DIR" "$s"
+    fi
+done
+
+# ============================================================
+# Run Matrix
+# ============================================================
+
+RESULTS_DIR=$(create_results_dir)
+CSV_FILE="$RESULTS_DIR/raw.csv"
+REPORT_FILE="$RESULTS_DIR/compare.md"
+write_system_info "$RESULTS_DIR/system.txt"
+write_fingerprint "$RESULTS_DIR/fingerprint.txt"
+HOST_KEY=$(fingerprint_key "$RESULTS_DIR/fingerprint.txt")
+init_regress_csv "$CSV_FILE"
+
+DST_BASE="$DST_DIR"
+mkdir -p "$DST_BASE"
+
+header "Performance Regression Suite"
+echo "Host: $HOST_KEY"
+echo "Scenarios: $SCENARIOS"
+echo "Cache: $CACHES  Workers: $WORKERS  Queue depths: $QUEUE_DEPTHS"
+echo "Runs per configuration: $RUNS (+1 warm-up)"
+echo ""
+info "Results will be saved to: $RESULTS_DIR"
+
+for scenario in $SCENARIOS; do
+    read files bytes <<< "$(scenario_info "$scenario")"
+    src="$DATA_DIR/$scenario"
+    dst="$DST_BASE/$scenario"
+    header "Scenario: $scenario ($files files, $(numfmt --to=iec "$bytes"))"
+
+    for cache in $CACHES; do
+        for workers in $WORKERS; do
+            for qd in $QUEUE_DEPTHS; do
+                printf "  %-5s -j %-2s -q %-4s" "$cache" "$workers" "$qd"
+                # Warm-up run: fills the page cache (warm) and settles the
+                # destination filesystem; not recorded
+                run_uring "$src" "$dst" "$workers" "$qd" >/dev/null 2>&1 || {
+                    echo ""
+                    error "uring-sync failed on $scenario -j $workers -q $qd"
+                    exit 2
+                }
+                for run in $(seq 1 "$RUNS"); do
+                    reset_dst "$dst"
+                    [[ "$cache" == "cold" ]] && drop_caches >/dev/null
+                    t=$(time_cmd_ns uring_copy "$src" "$dst" "$workers" "$qd") || {
+                        echo ""
+                        error "uring-sync failed on $scenario -j $workers -q $qd"
+                        exit 2
+                    }
+                    awk -v s="$scenario,$cache,$workers,$qd,$run,$files,$bytes" \
+                        -v t="$t" -v f="$files" -v b="$bytes" \
+                        'BEGIN { printf "%s,%.6f,%.2f,%.0f\n", s, t, b / t / 1048576, f / t }' >> "$CSV_FILE"
+                    printf " %.3fs" "$t"
+                done
+                echo ""
+            done
+        done
+    done
+done
+rm -rf "$DST_BASE"
+
+# ============================================================
+# Baseline
+# ============================================================
+
+if $SAVE_BASELINE; then
+    mkdir -p "$BASELINES_DIR/$HOST_KEY"
+    cp "$CSV_FILE" "$RESULTS_DIR/fingerprint.txt" "$BASELINES_DIR/$HOST_KEY/"
+    info "Saved baseline: $BASELINES_DIR/$HOST_KEY"
+fi
+
+# A baseline just saved is not compared against itself
+if [[ -z "$BASELINE" ]]; then
+    $SAVE_BASELINE && exit 0
+    BASELINE="$BASELINES_DIR/$HOST_KEY"
+fi
+if [[ ! -f "$BASELINE/raw.csv" ]]; then
+    warn "No baseline for this host at $BASELINE; rerun with --save-baseline to make one"
+    exit 0
+fi
+
+if ! diff -q <(host_fields "$BASELINE/fingerprint.txt") \
+             <(host_fields "$RESULTS_DIR/fingerprint.txt") >/dev/null; then
+    warn "Baseline was recorded on another host or setup:"
+    diff <(host_fields "$BASELINE/fingerprint.txt") \
+         <(host_fields "$RESULTS_DIR/fingerprint.txt") | grep '^[<>]' | sed 's/^/    /' || true
+    if ! $FORCE; then
+        error "Refusing to compare across hosts (use --force)"
+        exit 2
+    fi
+fi
+
+# ============================================================
+# Comparison
+# ============================================================
+
+header "Comparison against $BASELINE"
+status=0
+compare_results "$BASELINE/raw.csv" "$CSV_FILE" "$THRESHOLD" "$ALPHA" > "$REPORT_FILE" || status=$?
+cat "$REPORT_FILE"
+echo ""
+if (( status == 1 )); then
+    error "Performance regression (report: $REPORT_FILE)"
+elif (( status != 0 )); then
+    error "Comparison failed"
+    status=2
+else
+    info "No regression beyond ${THRESHOLD}% (report: $REPORT_FILE)"
+fi
+exit $status
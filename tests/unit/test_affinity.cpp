@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include "affinity.hpp"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+// A fake sysfs: an NVMe partition on node 1 and a dm volume over it
+class FakeSysfs : public ::testing::Test {
+protected:
+    void SetUp() override {
+        char tmpl[] = "/tmp/affinity_test_XXXXXX";
+        ASSERT_NE(mkdtemp(tmpl), nullptr);
+        root_ = tmpl;
+
+        std::string pci = root_ + "/devices/pci0000:3a/0000:3a:00.0/0000:3b:00.0";
+        std::string part = pci + "/nvme/nvme0/nvme0n1/nvme0n1p1";
+        std::string dm = root_ + "/devices/virtual/block/dm-0";
+        fs::create_directories(part);
+        fs::create_directories(dm + "/slaves");
+        fs::create_directories(root_ + "/dev/block");
+        fs::create_directories(root_ + "/devices/system/node/node1");
+        write(pci + "/numa_node", "1");
+        write(root_ + "/devices/system/node/node1/cpulist", "8-11,24-27");
+        fs::create_symlink(part, root_ + "/dev/block/259:1");
+        fs::create_symlink(dm, root_ + "/dev/block/253:0");
+        fs::create_symlink(part, dm + "/slaves/nvme0n1p1");
+    }
+
+    void TearDown() override { fs::remove_all(root_); }
+
+    static void write(const std::string& path, const std::string& text) {
+        std::ofstream(path) << text << "\n";
+    }
+
+    std::string root_;
+};
+
+TEST(AffinityTest, ParsesCpuLists) {
+    EXPECT_EQ(parse_cpu_list("0-3,8,10-11"), (std::vector<int>{0, 1, 2, 3, 8, 10, 11}));
+    EXPECT_EQ(parse_cpu_list("5"), (std::vector<int>{5}));
+    EXPECT_EQ(parse_cpu_list("4,2-3,2"), (std::vector<int>{2, 3, 4}));
+    EXPECT_TRUE(parse_cpu_list("").empty());
+    EXPECT_EQ(parse_cpu_list("x,3-1,7"), (std::vector<int>{7}));
+
+    EXPECT_EQ(format_cpu_list({0, 1, 2, 3, 8, 10, 11}), "0-3,8,10-11");
+    EXPECT_EQ(format_cpu_list({}), "");
+}
+
+TEST(AffinityTest, PlansOneCpuPerWorker) {
+    Placement p = plan_placement(1, {8, 9, 10, 11}, 3, false);
+    EXPECT_EQ(p.worker_cpu, (std::vector<int>{8, 9, 10}));
+    EXPECT_TRUE(p.sqpoll_cpu.empty());
+
+    // SQPOLL threads sit beside their workers, wrapping past the last CPU
+    p = plan_placement(1, {8, 9, 10, 11}, 3, true);
+    EXPECT_EQ(p.worker_cpu, (std::vector<int>{8, 10, 8}));
+    EXPECT_EQ(p.sqpoll_cpu, (std::vector<int>{9, 11, 9}));
+
+    // One CPU: everything shares it
+    p = plan_placement(0, {4}, 2, true);
+    EXPECT_EQ(p.worker_cpu, (std::vector<int>{4, 4}));
+    EXPECT_EQ(p.sqpoll_cpu, (std::vector<int>{4, 4}));
+
+    EXPECT_TRUE(plan_placement(-1, {}, 4, false).worker_cpu.empty());
+}
+
+TEST_F(FakeSysfs, BlockDeviceWalksUpToItsPciNode) {
+    EXPECT_EQ(block_device_node(makedev(259, 1), root_), 1);
+    EXPECT_EQ(block_device_node(makedev(253, 0), root_), 1);     // Through the dm slave
+    EXPECT_EQ(block_device_node(makedev(8, 0), root_), -1);      // Not in the tree
+    EXPECT_EQ(node_cpus(1, root_), (std::vector<int>{8, 9, 10, 11, 24, 25, 26, 27}));
+    EXPECT_TRUE(node_cpus(2, root_).empty());
+}
+
+TEST_F(FakeSysfs, NonNumaHostReportsUnknown) {
+    write(root_ + "/devices/pci0000:3a/0000:3a:00.0/0000:3b:00.0/numa_node", "-1");
+    EXPECT_EQ(block_device_node(makedev(259, 1), root_), -1);
+}
+
+TEST_F(FakeSysfs, InterfacesFollowTheirLowerLink) {
+    std::string nic = root_ + "/devices/pci0000:3a/0000:3a:00.0/0000:3b:00.1";
+    fs::create_directories(nic);
+    write(nic + "/numa_node", "1");
+    fs::create_directories(root_ + "/class/net/eth0");
+    fs::create_directories(root_ + "/class/net/bond0");
+    fs::create_symlink(nic, root_ + "/class/net/eth0/device");
+    fs::create_symlink(root_ + "/class/net/eth0", root_ + "/class/net/bond0/lower_eth0");
+
+    EXPECT_EQ(interface_node("eth0", root_), 1);
+    EXPECT_EQ(interface_node("bond0", root_), 1);
+    EXPECT_EQ(interface_node("lo", root_), -1);
+}
+
+TEST(AffinityTest, PinsToAllowedCpus) {
+    std::vector<int> allowed = allowed_cpus();
+    ASSERT_FALSE(allowed.empty());
+    EXPECT_EQ(placement_cpus(-1), allowed);
+
+    // On a thread of its own, so the test process keeps its mask
+    std::vector<int> seen;
+    std::thread([&] {
+        if (pin_thread({allowed.front()})) seen = allowed_cpus();
+    }).join();
+    EXPECT_EQ(seen, std::vector<int>{allowed.front()});
+    EXPECT_FALSE(pin_thread({}));
+}
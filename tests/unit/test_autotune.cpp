@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include "autotune.hpp"
+#include <algorithm>
+
+// ============================================================
+// Filesystem Classes
+// ============================================================
+
+TEST(FsClassTest, KnownMagics) {
+    EXPECT_EQ(fs_class(fs_magic::NFS), FsClass::NETWORK);
+    EXPECT_EQ(fs_class(fs_magic::SMB2), FsClass::NETWORK);
+    EXPECT_EQ(fs_class(fs_magic::CEPH), FsClass::NETWORK);
+    EXPECT_EQ(fs_class(fs_magic::FUSE), FsClass::FUSE);
+    EXPECT_EQ(fs_class(0xef53), FsClass::LOCAL);        // ext4
+    EXPECT_EQ(fs_class(0x58465342), FsClass::LOCAL);    // xfs
+}
+
+TEST(FsClassTest, MissingPathUsesParent) {
+    EXPECT_EQ(probe_fs_class("/proc/self"), FsClass::LOCAL);
+    EXPECT_EQ(probe_fs_class("/tmp/autotune_missing/a/b/"), probe_fs_class("/tmp"));
+    EXPECT_EQ(probe_fs_class("autotune_missing_relative"), probe_fs_class("."));
+}
+
+// ============================================================
+// Controller
+// ============================================================
+
+// A device that scales with depth up to knee requests, then only queues:
+// the window a worker pool at that depth would report
+static TuneWindow device_window(unsigned depth, unsigned knee, uint32_t chunk = 128 * 1024) {
+    const double service = 100e-6;        // Per request at no queue
+    double rate = std::min(depth, knee) / service;
+    TuneWindow w;
+    w.seconds = 0.1;
+    w.ops = static_cast<uint64_t>(rate * w.seconds);
+    w.bytes = w.ops * chunk;
+    w.in_flight = depth;
+    return w;
+}
+
+TEST(AutoTunerTest, FindsTheKnee) {
+    AutoTuner tuner(1, 128, 128 * 1024, 0);
+    EXPECT_EQ(tuner.depth(), AutoTuner::START_DEPTH);
+    for (int i = 0; i < 200; i++) tuner.update(device_window(tuner.depth(), 24));
+
+    // Sawtooth around the knee, never far above it
+    unsigned lo = tuner.depth(), hi = tuner.depth();
+    for (int i = 0; i < 50; i++) {
+        tuner.update(device_window(tuner.depth(), 24));
+        lo = std::min(lo, tuner.depth());
+        hi = std::max(hi, tuner.depth());
+    }
+    EXPECT_GE(lo, 12u);
+    EXPECT_LE(hi, 52u);
+}
+
+TEST(AutoTunerTest, GrowsToMaxWhileScaling) {
+    AutoTuner tuner(2, 96, 128 * 1024, 0);
+    for (int i = 0; i < 100; i++) tuner.update(device_window(tuner.depth() * 2, 1000));
+    EXPECT_EQ(tuner.depth(), 96u);
+}
+
+TEST(AutoTunerTest, IgnoresIdleWindows) {
+    AutoTuner tuner(1, 64, 128 * 1024, 512 * 1024);
+    TuneWindow idle;
+    idle.seconds = 0.1;
+    idle.ops = 3;
+    for (int i = 0; i < 50; i++) tuner.update(idle);
+    EXPECT_EQ(tuner.depth(), AutoTuner::START_DEPTH);
+    EXPECT_EQ(tuner.chunk(), 128u * 1024);
+}
+
+// Unused depth is not grown
+TEST(AutoTunerTest, HoldsWhenDepthUnused) {
+    AutoTuner tuner(1, 64, 128 * 1024, 0);
+    for (int i = 0; i < 50; i++) tuner.update(device_window(4, 1000));
+    EXPECT_EQ(tuner.depth(), AutoTuner::START_DEPTH);
+}
+
+TEST(AutoTunerTest, ChunkTrialKeptOnlyIfFaster) {
+    // Throughput follows the chunk: trials upward stick, up to the stride
+    AutoTuner grows(1, 8, 128 * 1024, 512 * 1024);
+    for (int i = 0; i < 100; i++) {
+        grows.update(device_window(grows.depth(), 1000, grows.chunk()));
+    }
+    EXPECT_EQ(grows.chunk(), 512u * 1024);
+
+    // Throughput independent of the chunk: every trial is undone
+    AutoTuner flat(1, 8, 128 * 1024, 512 * 1024);
+    int trials = 0;
+    for (int i = 0; i < 100; i++) {
+        flat.update(device_window(flat.depth(), 1000));
+        if (flat.chunk() != 128u * 1024) {
+            trials++;
+            flat.update(device_window(flat.depth(), 1000));
+            EXPECT_EQ(flat.chunk(), 128u * 1024) << "window " << i;
+        }
+    }
+    EXPECT_GT(trials, 0);
+
+    // Pinned chunk never moves
+    AutoTuner pinned(1, 8, 256 * 1024, 0);
+    for (int i = 0; i < 100; i++) {
+        pinned.update(device_window(pinned.depth(), 1000, pinned.chunk()));
+    }
+    EXPECT_EQ(pinned.chunk(), 256u * 1024);
+}
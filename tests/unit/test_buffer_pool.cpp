@@ -135,3 +135,117 @@ TEST_F(BufferPoolTest, BuffersAccessor) {
         EXPECT_NE(buf, nullptr);
     }
 }
+
+TEST_F(BufferPoolTest, BuffersShareOneContiguousArena) {
+    constexpr size_t oddSize = 5000;  // Rounded up to an 8192 stride
+    BufferPool pool(kDefaultCount, oddSize);
+
+    const auto& buffers = pool.buffers();
+    for (size_t i = 0; i < buffers.size(); i++) {
+        EXPECT_EQ(buffers[i], pool.arena() + i * 8192);
+    }
+    EXPECT_GE(pool.arena_size(), kDefaultCount * 8192);
+}
+
+TEST_F(BufferPoolTest, LargeArenaIsHugePageAligned) {
+    // 4MB total - big enough for huge pages or a THP-aligned mapping
+    BufferPool pool(4, 1024 * 1024);
+
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(pool.arena()) % HugePageArena::HUGE_PAGE_SIZE, 0u);
+    EXPECT_EQ(pool.arena_size() % HugePageArena::HUGE_PAGE_SIZE, 0u);
+
+    // Buffers are writable end to end
+    for (char* buf : pool.buffers()) {
+        buf[0] = 1;
+        buf[1024 * 1024 - 1] = 1;
+    }
+}
+
+TEST_F(BufferPoolTest, DoubleReleaseIgnored) {
+    BufferPool pool(kDefaultCount, kDefaultSize);
+
+    auto [ptr, index] = pool.acquire();
+    pool.release(index);
+    pool.release(index);
+
+    EXPECT_EQ(pool.available_count(), kDefaultCount);
+}
+
+TEST_F(BufferPoolTest, ReleasedBufferReusedFirst) {
+    BufferPool pool(kDefaultCount, kDefaultSize);
+
+    pool.acquire();
+    auto [ptr1, index1] = pool.acquire();
+    pool.acquire();
+
+    // LIFO: the most recently released (cache-warm) buffer comes back next
+    pool.release(index1);
+    auto [ptr2, index2] = pool.acquire();
+    EXPECT_EQ(index2, index1);
+    EXPECT_EQ(ptr2, ptr1);
+}
+
+TEST(PipePoolTest, AcquireAndRelease) {
+    PipePool pool(3);
+    EXPECT_EQ(pool.available_count(), 3u);
+
+    auto a = pool.acquire();
+    auto b = pool.acquire();
+    EXPECT_EQ(a.index, 0);
+    EXPECT_EQ(b.index, 1);
+    EXPECT_GE(a.read_fd, 0);
+    EXPECT_NE(a.write_fd, b.write_fd);
+    EXPECT_EQ(pool.available_count(), 1u);
+
+    pool.release(a.index);
+    EXPECT_EQ(pool.available_count(), 2u);
+    EXPECT_EQ(pool.acquire().index, a.index);
+}
+
+TEST(PipePoolTest, Exhausted) {
+    PipePool pool(1);
+    pool.acquire();
+
+    auto h = pool.acquire();
+    EXPECT_EQ(h.index, -1);
+    EXPECT_EQ(h.read_fd, -1);
+
+    pool.release(-1);
+    pool.release(5);
+    EXPECT_EQ(pool.available_count(), 0u);
+}
+
+TEST(DirectIoTest, RoundsAndPadsTheTail) {
+    EXPECT_TRUE(direct_aligned(0));
+    EXPECT_TRUE(direct_aligned(128 * 1024));
+    EXPECT_FALSE(direct_aligned(4097));
+    EXPECT_EQ(direct_round(1), DIRECT_ALIGN);
+    EXPECT_EQ(direct_round(DIRECT_ALIGN), DIRECT_ALIGN);
+    EXPECT_EQ(direct_round(3 * DIRECT_ALIGN + 5), 4 * DIRECT_ALIGN);
+
+    // A pool slot has room for the padded tail of a short chunk
+    BufferPool pool(1, 6000);
+    auto [buf, index] = pool.acquire();
+    std::fill(buf, buf + 2 * DIRECT_ALIGN, 'x');
+    ASSERT_EQ(pad_direct(buf, 6000), 2 * DIRECT_ALIGN);
+    EXPECT_EQ(buf[5999], 'x');
+    EXPECT_EQ(buf[6000], 0);
+    EXPECT_EQ(buf[2 * DIRECT_ALIGN - 1], 0);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(buf) % DIRECT_ALIGN, 0u);
+}
+
+TEST(DirectIoTest, SwitchesAnOpenFd) {
+    char path[] = "/tmp/direct_test_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    unlink(path);
+
+    if (!set_direct(fd, true)) {
+        close(fd);
+        GTEST_SKIP() << "filesystem has no O_DIRECT";
+    }
+    EXPECT_TRUE(fcntl(fd, F_GETFL) & O_DIRECT);
+    EXPECT_TRUE(set_direct(fd, false));
+    EXPECT_FALSE(fcntl(fd, F_GETFL) & O_DIRECT);
+    close(fd);
+}
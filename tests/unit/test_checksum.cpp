@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include "checksum.hpp"
+#include <random>
+#include <string>
+#include <vector>
+
+static std::vector<uint8_t> random_bytes(size_t n, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> out(n);
+    for (auto& b : out) b = static_cast<uint8_t>(rng());
+    return out;
+}
+
+TEST(Crc32cTest, KnownVectors) {
+    EXPECT_EQ(crc32c(0, "", 0), 0u);
+    EXPECT_EQ(crc32c(0, "123456789", 9), 0xe3069283u);
+    EXPECT_EQ(crc32c_portable(0, "123456789", 9), 0xe3069283u);
+
+    // RFC 3720 (iSCSI) test patterns
+    std::vector<uint8_t> zeros(32, 0), ones(32, 0xff), inc(32);
+    for (size_t i = 0; i < inc.size(); i++) inc[i] = static_cast<uint8_t>(i);
+    EXPECT_EQ(crc32c(0, zeros.data(), zeros.size()), 0x8a9136aau);
+    EXPECT_EQ(crc32c(0, ones.data(), ones.size()), 0x62a8ab43u);
+    EXPECT_EQ(crc32c(0, inc.data(), inc.size()), 0x46dd794eu);
+}
+
+TEST(Crc32cTest, MatchesPortableAtEveryLength) {
+    // Covers the tail bytes and the three-lane stripes (24KB each)
+    auto data = random_bytes(200000, 1);
+    for (size_t n : {1, 7, 8, 9, 63, 4096, 24575, 24576, 24577, 49160, 131072, 200000}) {
+        EXPECT_EQ(crc32c(0, data.data(), n), crc32c_portable(0, data.data(), n)) << n;
+    }
+    // Unaligned start
+    EXPECT_EQ(crc32c(0, data.data() + 3, 100000), crc32c_portable(0, data.data() + 3, 100000));
+}
+
+TEST(Crc32cTest, IncrementalAndCombine) {
+    auto data = random_bytes(300000, 2);
+    uint32_t whole = crc32c(0, data.data(), data.size());
+
+    uint32_t running = 0;
+    for (size_t off = 0; off < data.size(); off += 131072) {
+        size_t n = std::min<size_t>(131072, data.size() - off);
+        running = crc32c(running, data.data() + off, n);
+    }
+    EXPECT_EQ(running, whole);
+
+    // Chunk CRCs taken independently fold into the file's
+    for (size_t split : {0, 1, 1000, 131072, 299999, 300000}) {
+        uint32_t a = crc32c(0, data.data(), split);
+        uint32_t b = crc32c(0, data.data() + split, data.size() - split);
+        EXPECT_EQ(crc32c_combine(a, b, data.size() - split), whole) << split;
+    }
+}
+
+TEST(Crc32cTest, ZerosWithoutData) {
+    std::vector<uint8_t> zeros(200000, 0);
+    EXPECT_EQ(crc32c_zeros(0, 32), 0x8a9136aau);
+    EXPECT_EQ(crc32c_zeros(0, 0), 0u);
+
+    // Data, a hole, more data: as if the hole had been read
+    auto data = random_bytes(1000, 3);
+    uint32_t crc = crc32c(0, data.data(), data.size());
+    for (size_t n : {1, 4096, 131073, 200000}) {
+        EXPECT_EQ(crc32c_zeros(crc, n), crc32c(crc, zeros.data(), n)) << n;
+    }
+}
+
+TEST(Crc32cTest, SampleChunksSpreadOverFile) {
+    auto picked = [](uint64_t chunks, uint32_t samples) {
+        std::vector<uint64_t> out;
+        for (uint64_t k = 0; k < chunks; k++) {
+            if (sample_chunk(k, chunks, samples)) out.push_back(k);
+        }
+        return out;
+    };
+    EXPECT_EQ(picked(3, 4), (std::vector<uint64_t>{0, 1, 2}));
+    EXPECT_EQ(picked(5, 0), (std::vector<uint64_t>{0, 1, 2, 3, 4}));
+    EXPECT_EQ(picked(100, 1), (std::vector<uint64_t>{0}));
+    EXPECT_EQ(picked(100, 4), (std::vector<uint64_t>{0, 33, 66, 99}));
+    EXPECT_EQ(picked(10, 4), (std::vector<uint64_t>{0, 3, 6, 9}));
+    EXPECT_EQ(picked(5, 4).size(), 4u);
+    EXPECT_TRUE(picked(0, 4).empty());
+}
@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+#include "compress.hpp"
+
+#include <random>
+
+using protocol::Codec;
+
+class CompressTest : public ::testing::Test {
+protected:
+    static std::vector<uint8_t> text(size_t len) {
+        std::vector<uint8_t> data(len);
+        const char* words = "the quick brown fox jumps over the lazy dog ";
+        size_t n = strlen(words);
+        for (size_t i = 0; i < len; i++) data[i] = words[i % n];
+        return data;
+    }
+
+    static std::vector<uint8_t> noise(size_t len) {
+        std::mt19937 gen(42);
+        std::vector<uint8_t> data(len);
+        for (auto& b : data) b = static_cast<uint8_t>(gen());
+        return data;
+    }
+
+    // Compress and decompress src with codec; returns the compressed size
+    static size_t round_trip(Codec codec, int level, const std::vector<uint8_t>& src) {
+        ChunkCodec c;
+        std::vector<uint8_t> packed(compress_bound(codec, src.size()));
+        size_t n = c.compress(codec, level, src.data(), src.size(), packed.data(), packed.size());
+        EXPECT_GT(n, 0u);
+
+        std::vector<uint8_t> out(src.size());
+        EXPECT_TRUE(c.decompress(codec, packed.data(), n, out.data(), out.size()));
+        EXPECT_EQ(out, src);
+        return n;
+    }
+};
+
+TEST_F(CompressTest, ZstdRoundTrip) {
+    auto src = text(protocol::MAX_FRAME_RAW);
+    CodecLevels levels = codec_levels(Codec::ZSTD);
+    EXPECT_LT(round_trip(Codec::ZSTD, levels.min, src), src.size() / 8);
+    EXPECT_LT(round_trip(Codec::ZSTD, levels.max, src), src.size() / 8);
+}
+
+TEST_F(CompressTest, Lz4RoundTrip) {
+    auto src = text(protocol::MAX_FRAME_RAW);
+    CodecLevels levels = codec_levels(Codec::LZ4);
+    for (int level = levels.min; level <= levels.max; level++) {
+        EXPECT_LT(round_trip(Codec::LZ4, level, src), src.size() / 4);
+    }
+}
+
+TEST_F(CompressTest, IncompressibleDataIsNotWorthSending) {
+    auto src = noise(64 * 1024);
+    for (Codec codec : {Codec::ZSTD, Codec::LZ4}) {
+        size_t n = round_trip(codec, codec_levels(codec).initial, src);
+        EXPECT_LE(n, compress_bound(codec, src.size()));
+        EXPECT_GT(n, src.size() - src.size() / 8);
+    }
+}
+
+TEST_F(CompressTest, CorruptInputRejected) {
+    auto src = text(4096);
+    for (Codec codec : {Codec::ZSTD, Codec::LZ4}) {
+        ChunkCodec c;
+        std::vector<uint8_t> packed(compress_bound(codec, src.size()));
+        size_t n = c.compress(codec, 1, src.data(), src.size(), packed.data(), packed.size());
+        ASSERT_GT(n, 0u);
+
+        // Claiming more raw bytes than the frame holds must fail
+        std::vector<uint8_t> out(src.size() + 1);
+        EXPECT_FALSE(c.decompress(codec, packed.data(), n, out.data(), out.size()));
+
+        auto garbage = noise(n);
+        EXPECT_FALSE(c.decompress(codec, garbage.data(), n, out.data(), src.size()));
+    }
+}
+
+TEST_F(CompressTest, NextLevelFollowsBottleneck) {
+    CodecLevels levels = codec_levels(Codec::ZSTD);
+
+    // Compressor slower than the socket: back off
+    EXPECT_EQ(LevelController::next_level(5, 100, 200, levels), 4);
+    EXPECT_EQ(LevelController::next_level(levels.min, 100, 200, levels), levels.min);
+
+    // Plenty of headroom: compress harder
+    EXPECT_EQ(LevelController::next_level(5, 500, 200, levels), 6);
+    EXPECT_EQ(LevelController::next_level(levels.max, 500, 200, levels), levels.max);
+
+    // Balanced, or nothing measured yet: hold
+    EXPECT_EQ(LevelController::next_level(5, 300, 200, levels), 5);
+    EXPECT_EQ(LevelController::next_level(5, 0, 200, levels), 5);
+    EXPECT_EQ(LevelController::next_level(5, 100, 0, levels), 5);
+}
+
+TEST_F(CompressTest, ControllerAdaptsPerWindow) {
+    LevelController ctl(Codec::ZSTD, 1.0);
+    int start = ctl.level();
+
+    // Fast socket, slow compressor: one window lowers the level once
+    ctl.on_sent(1000000, 0.001);
+    for (size_t i = 0; i + 1 < LevelController::WINDOW_CHUNKS; i++) ctl.on_compressed(1000, 0.01);
+    EXPECT_EQ(ctl.level(), start);
+    ctl.on_compressed(1000, 0.01);
+    EXPECT_EQ(ctl.level(), start - 1);
+}
+
+TEST_F(CompressTest, PoolDeliversToSink) {
+    constexpr size_t kJobs = 16;
+    auto src = text(32 * 1024);
+    std::vector<std::vector<uint8_t>> dst(kJobs,
+                                          std::vector<uint8_t>(compress_bound(Codec::LZ4, src.size())));
+    CompressSink sink;
+    {
+        CompressPool pool(3);
+        EXPECT_EQ(pool.threads(), 3u);
+        for (size_t i = 0; i < kJobs; i++) {
+            CompressJob job;
+            job.seq = i;
+            job.codec = Codec::LZ4;
+            job.level = 1;
+            job.src = src.data();
+            job.len = static_cast<uint32_t>(src.size());
+            job.dst = dst[i].data();
+            job.cap = dst[i].size();
+            job.sink = &sink;
+            pool.submit(job);
+        }
+
+        // Each finished job bumps the eventfd
+        std::vector<CompressJob> done, batch;
+        while (done.size() < kJobs) {
+            uint64_t count;
+            ASSERT_EQ(read(sink.fd(), &count, sizeof(count)), (ssize_t)sizeof(count));
+            sink.drain(batch);
+            done.insert(done.end(), batch.begin(), batch.end());
+        }
+
+        std::vector<bool> seen(kJobs, false);
+        for (const auto& job : done) {
+            ASSERT_LT(job.seq, kJobs);
+            EXPECT_FALSE(seen[job.seq]);
+            seen[job.seq] = true;
+            EXPECT_GT(job.out_len, 0u);
+            EXPECT_LT(job.out_len, src.size());
+        }
+    }
+}
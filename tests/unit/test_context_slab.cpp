@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+#include "common.hpp"
+#include <set>
+
+TEST(FileContextSlabTest, HotContextIsOneCacheLine) {
+    EXPECT_EQ(sizeof(FileContext), 64u);
+    EXPECT_EQ(alignof(FileContext), 64u);
+}
+
+TEST(FileContextSlabTest, AcquireUntilFull) {
+    FileContextSlab slab(4);
+    std::set<FileContext*> seen;
+
+    for (size_t i = 0; i < 4; i++) {
+        FileContext* ctx = slab.acquire();
+        ASSERT_NE(ctx, nullptr);
+        EXPECT_EQ(slab.index_of(ctx), i);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(ctx) % 64, 0u);
+        EXPECT_NE(ctx->cold, nullptr);
+        seen.insert(ctx);
+    }
+
+    EXPECT_EQ(seen.size(), 4u);
+    EXPECT_EQ(slab.in_use(), 4u);
+    EXPECT_EQ(slab.acquire(), nullptr);
+}
+
+TEST(FileContextSlabTest, ReleaseMakesSlotReusable) {
+    FileContextSlab slab(2);
+    FileContext* a = slab.acquire();
+    FileContext* b = slab.acquire();
+
+    slab.release(a);
+    EXPECT_EQ(slab.in_use(), 1u);
+    EXPECT_EQ(slab.acquire(), a);
+
+    slab.release(b);
+    slab.release(a);
+    EXPECT_TRUE(slab.empty());
+}
+
+TEST(FileContextSlabTest, AcquireResetsState) {
+    FileContextSlab slab(1);
+    FileContext* ctx = slab.acquire();
+    ctx->state = FileState::WRITING;
+    ctx->src_fd = 7;
+    ctx->offset = 100;
+    ctx->pipe_index = 3;
+    ctx->cold->mode = 0600;
+    ctx->cold->chain_error = EIO;
+    ctx->cold->src_path = "/some/long/source/path/that/needs/heap/storage";
+    slab.release(ctx);
+
+    FileContext* again = slab.acquire();
+    ASSERT_EQ(again, ctx);
+    EXPECT_EQ(again->state, FileState::QUEUED);
+    EXPECT_EQ(again->src_fd, -1);
+    EXPECT_EQ(again->offset, 0u);
+    EXPECT_EQ(again->pipe_index, -1);
+    EXPECT_EQ(again->cold->mode, 0644u);
+    EXPECT_EQ(again->cold->chain_error, 0);
+
+    // Path capacity is kept so the next assign doesn't allocate
+    EXPECT_GE(again->cold->src_path.capacity(), 40u);
+}
@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include "common.hpp"
+#include <cerrno>
+#include <thread>
+#include <unistd.h>
+
+TEST(CopyOffloadCacheTest, StartsEmpty) {
+    CopyOffloadCache cache;
+    EXPECT_EQ(cache.size(), 0);
+}
+
+TEST(CopyOffloadCacheTest, LookupCreatesUnknownEntry) {
+    CopyOffloadCache cache;
+    auto* e = cache.lookup(1, 2);
+
+    ASSERT_NE(e, nullptr);
+    EXPECT_EQ(e->src_dev, 1u);
+    EXPECT_EQ(e->dst_dev, 2u);
+    EXPECT_EQ(e->clone, CopyOffloadCache::Support::UNKNOWN);
+    EXPECT_EQ(e->copy_range, CopyOffloadCache::Support::UNKNOWN);
+    EXPECT_EQ(cache.size(), 1);
+}
+
+TEST(CopyOffloadCacheTest, SamePairReturnsSameEntry) {
+    CopyOffloadCache cache;
+    auto* e1 = cache.lookup(1, 2);
+    e1->clone = CopyOffloadCache::Support::NO;
+
+    auto* e2 = cache.lookup(1, 2);
+    EXPECT_EQ(e1, e2);
+    EXPECT_EQ(e2->clone, CopyOffloadCache::Support::NO);
+    EXPECT_EQ(cache.size(), 1);
+}
+
+TEST(CopyOffloadCacheTest, PairsAreDirectional) {
+    CopyOffloadCache cache;
+    auto* a = cache.lookup(1, 2);
+    auto* b = cache.lookup(2, 1);
+    EXPECT_NE(a, b);
+    EXPECT_EQ(cache.size(), 2);
+}
+
+TEST(CopyOffloadCacheTest, EntriesStableAcrossGrowth) {
+    CopyOffloadCache cache;
+    auto* first = cache.lookup(0, 0);
+    first->copy_range = CopyOffloadCache::Support::YES;
+
+    for (dev_t d = 1; d < 100; d++) {
+        cache.lookup(d, d);
+    }
+
+    EXPECT_EQ(cache.lookup(0, 0), first);
+    EXPECT_EQ(first->copy_range, CopyOffloadCache::Support::YES);
+}
+
+TEST(CopyOffloadCacheTest, UnsupportedErrors) {
+    EXPECT_TRUE(CopyOffloadCache::is_unsupported(EXDEV));
+    EXPECT_TRUE(CopyOffloadCache::is_unsupported(EOPNOTSUPP));
+    EXPECT_TRUE(CopyOffloadCache::is_unsupported(EINVAL));
+
+    // Real I/O failures must not disable the fast path
+    EXPECT_FALSE(CopyOffloadCache::is_unsupported(EIO));
+    EXPECT_FALSE(CopyOffloadCache::is_unsupported(ENOSPC));
+}
+
+// The ring reads each slot's eventfd; here a blocking read stands in for it
+static int64_t read_result(const HelperThread& helper, size_t slot) {
+    uint64_t word = 0;
+    EXPECT_EQ(read(helper.fd(slot), &word, sizeof(word)), (ssize_t)sizeof(word));
+    return HelperThread::result(word);
+}
+
+TEST(HelperThreadTest, ResultsComeBackPerSlot) {
+    HelperThread helper(3);
+    ASSERT_TRUE(helper.ok());
+
+    helper.run(2, [] { return int64_t{-EXDEV}; });
+    helper.run(0, [] { return int64_t{0}; });
+    helper.run(1, [] { return int64_t{8 << 20}; });
+
+    EXPECT_EQ(read_result(helper, 0), 0);
+    EXPECT_EQ(read_result(helper, 1), 8 << 20);
+    EXPECT_EQ(read_result(helper, 2), -EXDEV);
+}
+
+TEST(HelperThreadTest, CallsRunOffTheCaller) {
+    HelperThread helper(1);
+    ASSERT_TRUE(helper.ok());
+
+    std::thread::id caller = std::this_thread::get_id(), ran;
+    helper.run(0, [&ran] {
+        ran = std::this_thread::get_id();
+        return int64_t{1};
+    });
+    EXPECT_EQ(read_result(helper, 0), 1);
+    EXPECT_NE(ran, caller);
+}
@@ -0,0 +1,139 @@
+#include <gtest/gtest.h>
+#include "daemon.hpp"
+
+#include <sstream>
+
+using protocol::SessionInfo;
+
+static SessionInfo session(uint64_t id, uint16_t index, uint16_t count) {
+    SessionInfo s;
+    s.id = id;
+    s.index = index;
+    s.count = count;
+    return s;
+}
+
+TEST(DaemonRoutesTest, ParsesRoutesAndSkipsComments) {
+    std::istringstream in(
+        "# secret    root\n"
+        "\n"
+        "alpha /data/alpha\n"
+        "  beta\t/data/with space   # trailing comment\n");
+    std::vector<DaemonRoute> routes;
+    std::string error;
+    ASSERT_TRUE(parse_daemon_routes(in, routes, error)) << error;
+
+    ASSERT_EQ(routes.size(), 2u);
+    EXPECT_EQ(routes[0].secret, "alpha");
+    EXPECT_EQ(routes[0].root, "/data/alpha");
+    EXPECT_EQ(routes[1].secret, "beta");
+    EXPECT_EQ(routes[1].root, "/data/with space");
+}
+
+TEST(DaemonRoutesTest, RejectsMissingRootAndRepeatedSecret) {
+    std::vector<DaemonRoute> routes;
+    std::string error;
+    std::istringstream missing("alpha /a\nbeta\n");
+    EXPECT_FALSE(parse_daemon_routes(missing, routes, error));
+    EXPECT_NE(error.find("line 2"), std::string::npos);
+
+    routes.clear();
+    std::istringstream twice("alpha /a\nalpha /b\n");
+    EXPECT_FALSE(parse_daemon_routes(twice, routes, error));
+    EXPECT_NE(error.find("twice"), std::string::npos);
+
+    routes.clear();
+    std::istringstream long_secret(std::string(protocol::MAX_SECRET_LEN + 1, 'x') + " /a\n");
+    EXPECT_FALSE(parse_daemon_routes(long_secret, routes, error));
+}
+
+TEST(DaemonRoutesTest, ExactSecretBeatsOpenRoute) {
+    std::vector<DaemonRoute> routes = {{"", "/open"}, {"alpha", "/alpha"}};
+
+    EXPECT_EQ(find_route(routes, "alpha")->root, "/alpha");
+    EXPECT_EQ(find_route(routes, "other")->root, "/open");
+    EXPECT_EQ(find_route(routes, "")->root, "/open");
+
+    routes.erase(routes.begin());
+    EXPECT_EQ(find_route(routes, "other"), nullptr);
+}
+
+TEST(SessionTableTest, SessionEndsWithItsLastStream) {
+    SessionTable table;
+    auto now = SessionTable::Clock::now();
+
+    EXPECT_EQ(table.join("/a", session(7, 0, 2), now), SessionTable::Join::FIRST);
+    EXPECT_EQ(table.join("/a", session(7, 1, 2), now), SessionTable::Join::JOINED);
+
+    SessionTable::Totals totals;
+    EXPECT_FALSE(table.finish("/a", 7, 10, 0, 0, false, totals));
+    ASSERT_TRUE(table.finish("/a", 7, 5, 1, 2, false, totals));
+    EXPECT_EQ(totals.id, 7u);
+    EXPECT_EQ(totals.root, "/a");
+    EXPECT_EQ(totals.received, 15u);
+    EXPECT_EQ(totals.corrupt, 1u);
+    EXPECT_EQ(totals.unwritten, 2u);
+    EXPECT_FALSE(totals.failed);
+    EXPECT_EQ(table.size(), 0u);
+}
+
+TEST(SessionTableTest, LinksGatherAcrossStreams) {
+    SessionTable table;
+    auto now = SessionTable::Clock::now();
+    table.join("/a", session(7, 0, 2), now);
+    table.join("/a", session(7, 1, 2), now);
+
+    SessionTable::Totals totals;
+    EXPECT_FALSE(table.finish("/a", 7, 2, 0, 0, false, totals, {{"b/y", "a/x"}}));
+    ASSERT_TRUE(table.finish("/a", 7, 1, 0, 0, false, totals));
+    ASSERT_EQ(totals.links.size(), 1u);
+    EXPECT_EQ(totals.links[0].first, "b/y");
+    EXPECT_EQ(totals.links[0].second, "a/x");
+}
+
+TEST(SessionTableTest, RoutesKeepEqualIdsApart) {
+    SessionTable table;
+    auto now = SessionTable::Clock::now();
+
+    EXPECT_EQ(table.join("/a", session(7, 0, 1), now), SessionTable::Join::FIRST);
+    EXPECT_EQ(table.join("/b", session(7, 0, 1), now), SessionTable::Join::FIRST);
+    EXPECT_EQ(table.size(), 2u);
+
+    SessionTable::Totals totals;
+    ASSERT_TRUE(table.finish("/b", 7, 1, 0, 0, true, totals));
+    EXPECT_TRUE(totals.failed);
+    EXPECT_EQ(table.size(), 1u);
+}
+
+TEST(SessionTableTest, RejectsRepeatedIndexAndOtherCount) {
+    SessionTable table;
+    auto now = SessionTable::Clock::now();
+
+    EXPECT_EQ(table.join("/a", session(7, 0, 3), now), SessionTable::Join::FIRST);
+    EXPECT_EQ(table.join("/a", session(7, 0, 3), now), SessionTable::Join::REJECTED);
+    EXPECT_EQ(table.join("/a", session(7, 1, 2), now), SessionTable::Join::REJECTED);
+    EXPECT_EQ(table.join("/a", session(7, 2, 3), now), SessionTable::Join::JOINED);
+}
+
+TEST(SessionTableTest, ExpiresIncompleteSessionsOnceIdle) {
+    SessionTable table;
+    auto now = SessionTable::Clock::now();
+    auto timeout = std::chrono::seconds(30);
+
+    table.join("/a", session(7, 0, 2), now);
+    SessionTable::Totals totals;
+    EXPECT_FALSE(table.finish("/a", 7, 3, 0, 0, false, totals));
+
+    // Too early, then idle and late: reported with what did arrive
+    EXPECT_TRUE(table.expire(now + std::chrono::seconds(10), timeout).empty());
+    auto expired = table.expire(now + timeout, timeout);
+    ASSERT_EQ(expired.size(), 1u);
+    EXPECT_EQ(expired[0].joined, 1u);
+    EXPECT_EQ(expired[0].count, 2u);
+    EXPECT_EQ(expired[0].received, 3u);
+    EXPECT_EQ(table.size(), 0u);
+
+    // A session with a stream still running is never expired
+    table.join("/a", session(8, 0, 2), now);
+    EXPECT_TRUE(table.expire(now + timeout * 10, timeout).empty());
+}
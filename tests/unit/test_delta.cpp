@@ -0,0 +1,233 @@
+#include <gtest/gtest.h>
+#include "delta.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <random>
+
+using protocol::Signature;
+
+static std::vector<uint8_t> random_bytes(size_t n, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> out(n);
+    for (auto& b : out) b = static_cast<uint8_t>(rng());
+    return out;
+}
+
+static void write_file(const std::string& path, const std::vector<uint8_t>& data) {
+    int fd = open(path.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(write(fd, data.data(), data.size()), (ssize_t)data.size());
+    close(fd);
+}
+
+static std::vector<uint8_t> read_file(const std::string& path) {
+    std::vector<uint8_t> out;
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return out;
+    uint8_t buf[65536];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) out.insert(out.end(), buf, buf + n);
+    close(fd);
+    return out;
+}
+
+static Signature signature_of(const std::string& path) {
+    Signature sig;
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    fstat(fd, &st);
+    EXPECT_TRUE(compute_signature(fd, st.st_size, sig));
+    close(fd);
+    return sig;
+}
+
+// Records the encoder's output and replays it against the old data
+struct RecordingSink {
+    const std::vector<uint8_t>& old_data;
+    uint32_t block_size;
+    std::vector<uint8_t> rebuilt;
+    uint64_t literal_bytes = 0;
+    size_t copies = 0;
+
+    void literal(const uint8_t* p, uint64_t len) {
+        rebuilt.insert(rebuilt.end(), p, p + len);
+        literal_bytes += len;
+    }
+
+    void copy(uint32_t first, uint32_t count) {
+        uint64_t off = static_cast<uint64_t>(first) * block_size;
+        uint64_t end = std::min<uint64_t>(off + static_cast<uint64_t>(count) * block_size,
+                                          old_data.size());
+        ASSERT_LT(off, end);
+        rebuilt.insert(rebuilt.end(), old_data.begin() + off, old_data.begin() + end);
+        copies++;
+    }
+};
+
+class DeltaTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        system("rm -rf /tmp/delta_test");
+        mkdir("/tmp/delta_test", 0755);
+    }
+    void TearDown() override { system("rm -rf /tmp/delta_test"); }
+};
+
+TEST(WeakChecksumTest, BlockSumMatchesScalar) {
+    auto data = random_bytes(200000, 1);
+    for (size_t n : {0, 1, 31, 32, 33, 1000, 4096, 65537, 200000}) {
+        uint32_t a1, b1, a2, b2;
+        weak_block(data.data(), n, a1, b1);
+        weak_block_scalar(data.data(), n, a2, b2);
+        EXPECT_EQ(a1, a2) << n;
+        EXPECT_EQ(b1, b2) << n;
+    }
+
+    // All-0xff bytes push every partial sum to its widest
+    std::vector<uint8_t> ones(131072, 0xff);
+    uint32_t a1, b1, a2, b2;
+    weak_block(ones.data(), ones.size(), a1, b1);
+    weak_block_scalar(ones.data(), ones.size(), a2, b2);
+    EXPECT_EQ(a1, a2);
+    EXPECT_EQ(b1, b2);
+}
+
+TEST(WeakChecksumTest, RollingMatchesFreshSum) {
+    auto data = random_bytes(20000, 2);
+    const size_t n = 4096;
+    RollingChecksum roll;
+    roll.reset(data.data(), n);
+    for (size_t pos = 0; pos + n < data.size(); pos++) {
+        uint32_t a, b;
+        weak_block_scalar(data.data() + pos, n, a, b);
+        ASSERT_EQ(roll.value(), weak_pack(a, b)) << pos;
+        roll.roll(data[pos], data[pos + n]);
+    }
+}
+
+TEST(WeakChecksumTest, BlockSizeTracksFileSize) {
+    EXPECT_EQ(choose_block_size(0), 4096u);
+    EXPECT_EQ(choose_block_size(1024 * 1024), 4096u);
+    EXPECT_EQ(choose_block_size(1ULL << 30), 32768u);
+    EXPECT_EQ(choose_block_size(1ULL << 40), 1u << 20);   // Capped by MAX_SIG_BLOCKS
+    EXPECT_LE((1ULL << 40) / choose_block_size(1ULL << 40), protocol::MAX_SIG_BLOCKS);
+}
+
+TEST_F(DeltaTest, SignatureCoversEveryBlock) {
+    auto data = random_bytes(3 * 1024 * 1024 + 123, 3);
+    write_file("/tmp/delta_test/f", data);
+    Signature sig = signature_of("/tmp/delta_test/f");
+
+    ASSERT_EQ(sig.file_size, data.size());
+    uint32_t bs = sig.block_size;
+    ASSERT_EQ(sig.blocks.size(), (data.size() + bs - 1) / bs);
+
+    StrongHasher hasher;
+    for (size_t i = 0; i < sig.blocks.size(); i++) {
+        size_t len = std::min<size_t>(bs, data.size() - i * bs);
+        uint32_t a, b;
+        weak_block_scalar(data.data() + i * bs, len, a, b);
+        ASSERT_EQ(sig.blocks[i].weak, weak_pack(a, b)) << i;
+        uint8_t strong[protocol::DELTA_STRONG_SIZE];
+        hasher.hash(data.data() + i * bs, len, strong);
+        ASSERT_EQ(memcmp(strong, sig.blocks[i].strong, sizeof(strong)), 0) << i;
+    }
+
+    // A file shorter than claimed gives no signature
+    int fd = open("/tmp/delta_test/f", O_RDONLY);
+    EXPECT_FALSE(compute_signature(fd, data.size() + 4096, sig));
+    EXPECT_TRUE(sig.blocks.empty());
+    close(fd);
+}
+
+TEST_F(DeltaTest, EncodeSendsOnlyChanges) {
+    auto old_data = random_bytes(2 * 1024 * 1024 + 777, 4);
+    write_file("/tmp/delta_test/old", old_data);
+    Signature sig = signature_of("/tmp/delta_test/old");
+
+    // Insert, overwrite and append, so later matches are off block alignment
+    auto new_data = old_data;
+    auto ins = random_bytes(100, 5);
+    new_data.insert(new_data.begin() + 10000, ins.begin(), ins.end());
+    new_data[1500000] ^= 0xff;
+    auto tail = random_bytes(5000, 6);
+    new_data.insert(new_data.end(), tail.begin(), tail.end());
+
+    RecordingSink sink{old_data, sig.block_size, {}};
+    encode_delta(new_data.data(), new_data.size(), sig, sink);
+    ASSERT_EQ(sink.rebuilt, new_data);
+    // Three dirty blocks plus the appended tail
+    EXPECT_LE(sink.literal_bytes, 3 * sig.block_size + tail.size() + ins.size());
+    EXPECT_LE(sink.copies, 4u);
+}
+
+TEST_F(DeltaTest, EncodeMatchesShortLastBlock) {
+    auto old_data = random_bytes(1024 * 1024 + 100, 7);
+    write_file("/tmp/delta_test/old", old_data);
+    Signature sig = signature_of("/tmp/delta_test/old");
+
+    auto new_data = old_data;
+    new_data[0] ^= 1;
+
+    RecordingSink sink{old_data, sig.block_size, {}};
+    encode_delta(new_data.data(), new_data.size(), sig, sink);
+    ASSERT_EQ(sink.rebuilt, new_data);
+    EXPECT_EQ(sink.literal_bytes, sig.block_size);
+    EXPECT_EQ(sink.copies, 1u);
+
+    // Without a signature everything is literal
+    RecordingSink whole{old_data, 0, {}};
+    encode_delta(new_data.data(), new_data.size(), Signature{}, whole);
+    EXPECT_EQ(whole.literal_bytes, new_data.size());
+}
+
+TEST_F(DeltaTest, PatcherRebuildsFile) {
+    auto old_data = random_bytes(3 * 4096 + 10, 8);
+    write_file("/tmp/delta_test/f", old_data);
+
+    DeltaPatcher patcher;
+    ASSERT_TRUE(patcher.open("/tmp/delta_test/f", 0644, 4096));
+    auto lit = random_bytes(50, 9);
+    ASSERT_TRUE(patcher.copy(2, 2));      // Block 3 is the 10-byte tail
+    ASSERT_TRUE(patcher.write(lit.data(), lit.size()));
+    ASSERT_TRUE(patcher.copy(0, 1));
+    EXPECT_FALSE(patcher.copy(4, 1));     // Past the old copy
+    EXPECT_EQ(patcher.copied(), 4096u + 10 + 4096);
+    ASSERT_TRUE(patcher.finish(4106 + 50 + 4096, 1700000000123456789LL));
+
+    std::vector<uint8_t> expected(old_data.begin() + 8192, old_data.end());
+    expected.insert(expected.end(), lit.begin(), lit.end());
+    expected.insert(expected.end(), old_data.begin(), old_data.begin() + 4096);
+    EXPECT_EQ(read_file("/tmp/delta_test/f"), expected);
+    EXPECT_TRUE(read_file("/tmp/delta_test/f.uring-sync.delta").empty());
+
+    struct stat st;
+    ASSERT_EQ(stat("/tmp/delta_test/f", &st), 0);
+    EXPECT_EQ(to_mtime_ns(st.st_mtim), 1700000000123456789LL);
+}
+
+TEST_F(DeltaTest, PatcherKeepsOldCopyOnFailure) {
+    auto old_data = random_bytes(8192, 10);
+    write_file("/tmp/delta_test/f", old_data);
+
+    {
+        DeltaPatcher patcher;
+        ASSERT_TRUE(patcher.open("/tmp/delta_test/f", 0644, 4096));
+        ASSERT_TRUE(patcher.copy(0, 1));
+        // Shorter than the header said
+        EXPECT_FALSE(patcher.finish(8192, 0));
+    }
+    {
+        DeltaPatcher patcher;
+        ASSERT_TRUE(patcher.open("/tmp/delta_test/f", 0644, 4096));
+        ASSERT_TRUE(patcher.copy(1, 1));
+        // Abandoned mid-file
+    }
+    EXPECT_EQ(read_file("/tmp/delta_test/f"), old_data);
+    struct stat st;
+    EXPECT_NE(stat("/tmp/delta_test/f.uring-sync.delta", &st), 0);
+
+    DeltaPatcher patcher;
+    EXPECT_FALSE(patcher.open("/tmp/delta_test/missing", 0644, 4096));
+}
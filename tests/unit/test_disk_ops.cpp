@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+#include "disk_ops.hpp"
+
+#include <string>
+#include <vector>
+
+static DiskOp op(DiskOp::Kind kind, uint64_t tag) {
+    DiskOp o{kind};
+    o.tag = tag;
+    return o;
+}
+
+TEST(DirCacheTest, AsksOnlyForParentsNotSeenMade) {
+    DirCache cache("/dst/");
+    std::vector<std::string> dirs;
+
+    cache.missing("/dst/a/b/c/file", dirs);
+    EXPECT_EQ(dirs, (std::vector<std::string>{"/dst/a", "/dst/a/b", "/dst/a/b/c"}));
+
+    // Made outermost first: only what lies below the deepest made one
+    cache.made("/dst/a");
+    cache.made("/dst/a/b");
+    cache.missing("/dst/a/b/c/file", dirs);
+    EXPECT_EQ(dirs, (std::vector<std::string>{"/dst/a/b/c"}));
+    cache.missing("/dst/a/b/other", dirs);
+    EXPECT_TRUE(dirs.empty());
+    cache.missing("/dst/a/x/file", dirs);
+    EXPECT_EQ(dirs, (std::vector<std::string>{"/dst/a/x"}));
+}
+
+TEST(DirCacheTest, RootAndItsFilesNeedNothing) {
+    DirCache cache("/dst");
+    std::vector<std::string> dirs{"stale"};
+    cache.missing("/dst/file", dirs);
+    EXPECT_TRUE(dirs.empty());
+
+    // A root that is a single file (send of one file)
+    DirCache file_root("/dst/file");
+    file_root.missing("/dst/file", dirs);
+    EXPECT_TRUE(dirs.empty());
+}
+
+TEST(DiskOutboxTest, FileOpsStayOnOneWorker) {
+    DiskOutbox outbox;
+    outbox.resize(3);
+
+    // Slots 1 and 4 share worker 1; each file's chains arrive over time
+    outbox.add(1, {op(DiskOp::MKDIR, 10), op(DiskOp::OPEN, 11)});
+    outbox.add(2, {op(DiskOp::OPEN, 20)});
+    outbox.add(4, {op(DiskOp::OPEN, 40)});
+    outbox.add(1, {op(DiskOp::WRITE, 12)});
+    outbox.add(1, {op(DiskOp::CLOSE, 13)});
+
+    ASSERT_EQ(DiskOutbox::worker_for(1, 3), DiskOutbox::worker_for(4, 3));
+    std::vector<uint64_t> tags;
+    for (const DiskOp& o : outbox[1]) tags.push_back(o.tag);
+    EXPECT_EQ(tags, (std::vector<uint64_t>{10, 11, 40, 12, 13}));
+    EXPECT_EQ(outbox[2].size(), 1u);
+    EXPECT_TRUE(outbox[0].empty());
+
+    // Every slot maps to the same worker each time
+    for (size_t slot = 0; slot < 64; slot++) {
+        EXPECT_EQ(DiskOutbox::worker_for(slot, 3), DiskOutbox::worker_for(slot, 3));
+        EXPECT_LT(DiskOutbox::worker_for(slot, 3), 3u);
+    }
+}
+
+TEST(HandoffTest, DoorbellOnlyWhenListWasEmpty) {
+    Handoff<DiskResult> list;
+    std::vector<DiskResult> items{{1, 0}, {2, -5}};
+    EXPECT_TRUE(list.post(items));
+    EXPECT_TRUE(items.empty());
+
+    items = {{3, 0}};
+    EXPECT_FALSE(list.post(items));     // Not yet taken: no second doorbell
+
+    std::vector<DiskResult> out;
+    list.take(out);
+    ASSERT_EQ(out.size(), 3u);
+    EXPECT_EQ(out[1].res, -5);
+    EXPECT_EQ(out[2].tag, 3u);
+
+    items = {{4, 0}};
+    EXPECT_TRUE(list.post(items));
+}
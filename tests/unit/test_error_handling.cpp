@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 #include "common.hpp"
 #include "ring.hpp"
+#include "scheduler.hpp"
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/stat.h>
@@ -97,10 +98,12 @@ TEST_F(ErrorHandlingTest, WriteToReadOnlyFd) {
 
 TEST_F(ErrorHandlingTest, StatxNonexistent) {
     RingManager ring(8);
+    FileContextCold cold;
     FileContext ctx;
+    ctx.cold = &cold;
 
     ring.prepare_statx(AT_FDCWD, "/tmp/error_test/no_such_file.txt",
-                       0, STATX_SIZE, &ctx.stx, &ctx);
+                       0, STATX_SIZE, &ctx.cold->stx, &ctx);
     ring.submit();
 
     int res;
@@ -202,21 +205,21 @@ TEST(BufferPoolErrorTest, ReleaseOutOfBounds) {
 }
 
 // ============================================================
-// WorkQueue Error Tests
+// WorkScheduler Error Tests
 // ============================================================
 
-TEST(WorkQueueErrorTest, PopFromEmpty) {
-    WorkQueue<int> queue;
+TEST(WorkSchedulerErrorTest, PopFromEmpty) {
+    WorkScheduler<int> queue(2);
 
     int value = 999;
-    bool result = queue.try_pop(value);
+    bool result = queue.try_pop(1, value);
 
     EXPECT_FALSE(result);
     EXPECT_EQ(value, 999);  // Unchanged
 }
 
-TEST(WorkQueueErrorTest, IsDoneWhenNotDone) {
-    WorkQueue<int> queue;
+TEST(WorkSchedulerErrorTest, IsDoneWhenNotDone) {
+    WorkScheduler<int> queue(1);
 
     EXPECT_FALSE(queue.is_done());
 
@@ -224,8 +227,8 @@ TEST(WorkQueueErrorTest, IsDoneWhenNotDone) {
     EXPECT_FALSE(queue.is_done());
 }
 
-TEST(WorkQueueErrorTest, SetDoneMultipleTimes) {
-    WorkQueue<int> queue;
+TEST(WorkSchedulerErrorTest, SetDoneMultipleTimes) {
+    WorkScheduler<int> queue(1);
 
     queue.set_done();
     queue.set_done();  // Should not crash
@@ -234,15 +237,17 @@ TEST(WorkQueueErrorTest, SetDoneMultipleTimes) {
     EXPECT_TRUE(queue.is_done());
 }
 
-TEST(WorkQueueErrorTest, PushAfterDone) {
-    WorkQueue<int> queue;
+TEST(WorkSchedulerErrorTest, PushAfterDone) {
+    WorkScheduler<int> queue(1);
 
     queue.set_done();
     queue.push(42);  // Should still work (implementation doesn't block)
+    EXPECT_FALSE(queue.is_done());
 
     int value;
-    EXPECT_TRUE(queue.try_pop(value));
+    EXPECT_TRUE(queue.try_pop(0, value));
     EXPECT_EQ(value, 42);
+    EXPECT_TRUE(queue.is_done());
 }
 
 // ============================================================
@@ -269,10 +274,12 @@ TEST(FileContextErrorTest, ZeroFileSize) {
 }
 
 TEST(FileContextErrorTest, EmptyPaths) {
-    FileContext ctx;
+    FileContextSlab slab(1);
+    FileContext* ctx = slab.acquire();
 
-    EXPECT_TRUE(ctx.src_path.empty());
-    EXPECT_TRUE(ctx.dst_path.empty());
+    ASSERT_NE(ctx, nullptr);
+    EXPECT_TRUE(ctx->cold->src_path.empty());
+    EXPECT_TRUE(ctx->cold->dst_path.empty());
 }
 
 // ============================================================
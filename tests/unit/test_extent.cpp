@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+#include "extent.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string>
+
+TEST(ExtentTest, SparseNeedsSizeAndMissingBlocks) {
+    EXPECT_FALSE(maybe_sparse(SPARSE_MIN_SIZE - 1, 0));
+    EXPECT_TRUE(maybe_sparse(SPARSE_MIN_SIZE, 0));
+    EXPECT_TRUE(maybe_sparse(8 * SPARSE_MIN_SIZE, SPARSE_MIN_SIZE / 512));
+    EXPECT_FALSE(maybe_sparse(SPARSE_MIN_SIZE, SPARSE_MIN_SIZE / 512));
+}
+
+TEST(ExtentTest, DataRunsSkipHoles) {
+    char path[] = "/tmp/extent_test_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    unlink(path);
+
+    // 64KB of data, a 4MB hole, 64KB of data, a trailing 1MB hole
+    const uint64_t mb = 1024 * 1024;
+    std::string data(65536, 'x');
+    ASSERT_EQ(pwrite(fd, data.data(), data.size(), 0), 65536);
+    ASSERT_EQ(pwrite(fd, data.data(), data.size(), 4 * mb), 65536);
+    ASSERT_EQ(ftruncate(fd, 6 * mb), 0);
+
+    std::vector<std::pair<uint64_t, uint64_t>> runs;
+    ASSERT_TRUE(data_runs(fd, 0, 6 * mb, runs));
+
+    if (runs.size() == 1 && runs[0].second == 6 * mb) {
+        close(fd);
+        GTEST_SKIP() << "filesystem reports no holes";
+    }
+
+    // Filesystems round runs out to their blocks
+    ASSERT_EQ(runs.size(), 2u);
+    EXPECT_EQ(runs[0].first, 0u);
+    EXPECT_GE(runs[0].second, 65536u);
+    EXPECT_LE(runs[1].first, 4 * mb);
+    EXPECT_GE(runs[1].first + runs[1].second, 4 * mb + 65536);
+    EXPECT_LT(runs[1].first + runs[1].second, 6 * mb);
+
+    // A window starting inside the hole
+    ASSERT_TRUE(data_runs(fd, mb, 6 * mb, runs));
+    ASSERT_EQ(runs.size(), 1u);
+    EXPECT_LE(runs[0].first, 4 * mb);
+
+    // Only the trailing hole
+    ASSERT_TRUE(data_runs(fd, 5 * mb, 6 * mb, runs));
+    EXPECT_TRUE(runs.empty());
+    close(fd);
+}
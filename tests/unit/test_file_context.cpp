@@ -7,10 +7,12 @@
 
 TEST(FileContextTest, DefaultConstruction) {
     FileContext ctx;
+    FileContextCold cold;
 
     // Check default values
-    EXPECT_TRUE(ctx.src_path.empty());
-    EXPECT_TRUE(ctx.dst_path.empty());
+    EXPECT_EQ(ctx.cold, nullptr);
+    EXPECT_TRUE(cold.src_path.empty());
+    EXPECT_TRUE(cold.dst_path.empty());
     EXPECT_EQ(ctx.src_fd, -1);
     EXPECT_EQ(ctx.dst_fd, -1);
     EXPECT_EQ(ctx.state, FileState::QUEUED);
@@ -18,18 +20,20 @@ TEST(FileContextTest, DefaultConstruction) {
     EXPECT_EQ(ctx.offset, 0);
     EXPECT_EQ(ctx.buffer, nullptr);
     EXPECT_EQ(ctx.buffer_index, -1);
-    EXPECT_EQ(ctx.last_read_size, 0);
+    EXPECT_EQ(ctx.read_ahead, 0);
     EXPECT_FALSE(ctx.use_splice);
-    EXPECT_FALSE(ctx.use_fixed_buffers);
 }
 
 TEST(FileContextTest, SetPaths) {
-    FileContext ctx;
-    ctx.src_path = "/source/file.txt";
-    ctx.dst_path = "/dest/file.txt";
-
-    EXPECT_EQ(ctx.src_path, "/source/file.txt");
-    EXPECT_EQ(ctx.dst_path, "/dest/file.txt");
+    // Paths live in the cold half, reached through the slab's context
+    FileContextSlab slab(1);
+    FileContext* ctx = slab.acquire();
+    ASSERT_NE(ctx, nullptr);
+    ctx->cold->src_path = "/source/file.txt";
+    ctx->cold->dst_path = "/dest/file.txt";
+
+    EXPECT_EQ(ctx->cold->src_path, "/source/file.txt");
+    EXPECT_EQ(ctx->cold->dst_path, "/dest/file.txt");
 }
 
 TEST(FileContextTest, SetFileDescriptors) {
@@ -52,8 +56,9 @@ TEST(FileStateTest, AllStatesExist) {
     EXPECT_NE(FileState::STATING, FileState::OPENING_DST);
     EXPECT_NE(FileState::OPENING_DST, FileState::READING);
     EXPECT_NE(FileState::READING, FileState::WRITING);
-    EXPECT_NE(FileState::WRITING, FileState::SPLICING);
-    EXPECT_NE(FileState::SPLICING, FileState::CLOSING_SRC);
+    EXPECT_NE(FileState::WRITING, FileState::SPLICE_IN);
+    EXPECT_NE(FileState::SPLICE_IN, FileState::SPLICE_OUT);
+    EXPECT_NE(FileState::SPLICE_OUT, FileState::CLOSING_SRC);
     EXPECT_NE(FileState::CLOSING_SRC, FileState::CLOSING_DST);
     EXPECT_NE(FileState::CLOSING_DST, FileState::DONE);
     EXPECT_NE(FileState::DONE, FileState::FAILED);
@@ -169,18 +174,18 @@ TEST(FileContextTest, ReadWriteTracking) {
     FileContext ctx;
     ctx.file_size = 10000;
     ctx.offset = 0;
-    ctx.last_read_size = 4096;
+    ctx.read_ahead = 4096;
 
     // Simulate progress
-    ctx.offset += ctx.last_read_size;
+    ctx.offset += ctx.read_ahead;
     EXPECT_EQ(ctx.offset, 4096);
 
-    ctx.last_read_size = 4096;
-    ctx.offset += ctx.last_read_size;
+    ctx.read_ahead = 4096;
+    ctx.offset += ctx.read_ahead;
     EXPECT_EQ(ctx.offset, 8192);
 
-    ctx.last_read_size = 1808;  // Last chunk
-    ctx.offset += ctx.last_read_size;
+    ctx.read_ahead = 1808;  // Last chunk
+    ctx.offset += ctx.read_ahead;
     EXPECT_EQ(ctx.offset, 10000);
     EXPECT_EQ(ctx.offset, ctx.file_size);  // Done!
 }
@@ -190,14 +195,16 @@ TEST(FileContextTest, ReadWriteTracking) {
 // ============================================================
 
 TEST(FileContextTest, StatxResult) {
-    FileContext ctx;
+    FileContextSlab slab(1);
+    FileContext* ctx = slab.acquire();
+    ASSERT_NE(ctx, nullptr);
 
     // Simulate statx result
-    ctx.stx.stx_size = 12345;
-    ctx.stx.stx_mode = S_IFREG | 0644;
+    ctx->cold->stx.stx_size = 12345;
+    ctx->cold->stx.stx_mode = S_IFREG | 0644;
 
-    EXPECT_EQ(ctx.stx.stx_size, 12345);
-    EXPECT_TRUE(S_ISREG(ctx.stx.stx_mode));
+    EXPECT_EQ(ctx->cold->stx.stx_size, 12345);
+    EXPECT_TRUE(S_ISREG(ctx->cold->stx.stx_mode));
 }
 
 // ============================================================
@@ -208,13 +215,10 @@ TEST(FileContextTest, OptimizationFlags) {
     FileContext ctx;
 
     EXPECT_FALSE(ctx.use_splice);
-    EXPECT_FALSE(ctx.use_fixed_buffers);
 
     ctx.use_splice = true;
-    ctx.use_fixed_buffers = true;
 
     EXPECT_TRUE(ctx.use_splice);
-    EXPECT_TRUE(ctx.use_fixed_buffers);
 }
 
 // ============================================================
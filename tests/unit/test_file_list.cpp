@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+#include "file_list.hpp"
+
+// ============================================================
+// FileList
+// ============================================================
+
+TEST(FileListTest, BuildsPathsFromDirectoryChain) {
+    FileList files("/src");
+    uint32_t a = files.add_dir(0, "a");
+    uint32_t b = files.add_dir(a, "b");
+    files.add_file(0, "top.txt");
+    files.add_file(b, "deep.bin");
+
+    ASSERT_EQ(files.size(), 2u);
+    EXPECT_EQ(files.rel_path(files[0]), "top.txt");
+    EXPECT_EQ(files.rel_path(files[1]), "a/b/deep.bin");
+    EXPECT_EQ(files.src_path(files[1]), "/src/a/b/deep.bin");
+}
+
+TEST(FileListTest, RefusesChainsPastMaxDepth) {
+    FileList files("/src");
+    uint32_t dir = 0;
+    for (size_t i = 0; i < FileList::MAX_DEPTH; i++) dir = files.add_dir(dir, "d");
+    ASSERT_NE(dir, FileList::TOO_DEEP);
+    EXPECT_EQ(files.add_dir(dir, "d"), FileList::TOO_DEEP);
+
+    // The deepest allowed chain still builds its whole path
+    files.add_file(dir, "f");
+    std::string path = files.rel_path(files[0]);
+    EXPECT_EQ(path.size(), 2 * FileList::MAX_DEPTH + 1);
+    EXPECT_EQ(path.substr(path.size() - 4), "/d/f");
+}
+
+TEST(FileListTest, RootGetsOneSeparator) {
+    FileList slash("src/");
+    slash.add_file(0, "f");
+    EXPECT_EQ(slash.src_path(slash[0]), "src/f");
+
+    FileList none("");
+    none.add_file(0, "f");
+    EXPECT_EQ(none.src_path(none[0]), "./f");
+}
+
+TEST(FileListTest, SortsByExtentThenInode) {
+    FileList files;
+    files.add_file(0, "late").extent = 9000;
+    files.add_file(0, "early").extent = 100;
+    auto& high = files.add_file(0, "unmapped-high");
+    high.inode = 50;
+    files.add_file(0, "unmapped-low").inode = 7;
+
+    files.sort_disk_order();
+    EXPECT_EQ(files.rel_path(files[0]), "unmapped-low");
+    EXPECT_EQ(files.rel_path(files[1]), "unmapped-high");
+    EXPECT_EQ(files.rel_path(files[2]), "early");
+    EXPECT_EQ(files.rel_path(files[3]), "late");
+}
+
+TEST(FileListTest, FilteredEntriesKeepTheirNames) {
+    FileList files("/src");
+    uint32_t d = files.add_dir(0, "d");
+    for (int i = 0; i < 4; i++) files.add_file(d, "f" + std::to_string(i)).size = i;
+
+    // Drop the even sizes in place, as the manifest merge does
+    auto& entries = files.entries();
+    size_t out = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (entries[i].size % 2) entries[out++] = entries[i];
+    }
+    entries.resize(out);
+
+    ASSERT_EQ(files.size(), 2u);
+    EXPECT_EQ(files.rel_path(files[0]), "d/f1");
+    EXPECT_EQ(files.rel_path(files[1]), "d/f3");
+}
+
+TEST(FileListTest, LinksLeaveTheListUntilRestored) {
+    FileList files("/src");
+    uint32_t d = files.add_dir(0, "d");
+    files.add_file(0, "first").inode = 5;
+    FileList::Entry second = files.add_file(d, "second");
+    second.inode = 5;
+    files.entries().pop_back();
+    files.add_link(second, files[0]);
+
+    ASSERT_EQ(files.size(), 1u);
+    ASSERT_EQ(files.links().size(), 1u);
+    EXPECT_EQ(files.rel_path(files.links()[0].first), "d/second");
+    EXPECT_EQ(files.rel_path(files.links()[0].second), "first");
+
+    files.restore_links();
+    EXPECT_TRUE(files.links().empty());
+    ASSERT_EQ(files.size(), 2u);
+    std::string names = files.rel_path(files[0]) + " " + files.rel_path(files[1]);
+    EXPECT_TRUE(names == "first d/second" || names == "d/second first") << names;
+}
+
+TEST(FileListTest, ResetStartsOver) {
+    FileList files("/a");
+    files.add_file(files.add_dir(0, "x"), "y");
+    files.reset("/b");
+    EXPECT_TRUE(files.empty());
+    files.add_file(0, "z");
+    EXPECT_EQ(files.src_path(files[0]), "/b/z");
+}
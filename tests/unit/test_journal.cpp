@@ -0,0 +1,166 @@
+#include <gtest/gtest.h>
+#include "journal.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+
+using Progress = CheckpointJournal::Progress;
+using State = CheckpointJournal::State;
+
+static std::string read_text(const std::string& path) {
+    std::ifstream in(path);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+TEST(JournalTest, RangesMergeAndCover) {
+    Progress p;
+    p.add(100, 200);
+    p.add(0, 50);
+    p.add(50, 100);     // Touching: all three merge
+    p.add(300, 400);
+    ASSERT_EQ(p.ranges.size(), 2u);
+    EXPECT_EQ(p.prefix(), 200u);
+    EXPECT_EQ(p.bytes(), 300u);
+
+    EXPECT_TRUE(p.covers(0, 200));
+    EXPECT_TRUE(p.covers(320, 80));
+    EXPECT_FALSE(p.covers(150, 200));
+    EXPECT_FALSE(p.covers(200, 1));
+
+    p.add(150, 350);
+    ASSERT_EQ(p.ranges.size(), 1u);
+    EXPECT_EQ(p.prefix(), 400u);
+}
+
+TEST(JournalTest, ParseSkipsTornLastLine) {
+    State state;
+    ASSERT_TRUE(CheckpointJournal::parse(
+        "uring-sync journal 1\n"
+        "R 1000 7 0 400 a/big file\n"
+        "R 1000 7 400 100 a/big file\n"
+        "R 2000 9 0 100 done\n"
+        "F done\n"
+        "R 1000 7 500 5", state));
+
+    ASSERT_EQ(state.size(), 1u);
+    const Progress& p = state.at("a/big file");
+    EXPECT_EQ(p.size, 1000u);
+    EXPECT_EQ(p.mtime_ns, 7);
+    EXPECT_EQ(p.prefix(), 500u);
+
+    State other;
+    EXPECT_FALSE(CheckpointJournal::parse("R 1 1 0 1 x\n", other));
+    EXPECT_TRUE(CheckpointJournal::parse("", other));
+}
+
+TEST(JournalTest, NewSourceVoidsOldRanges) {
+    State state;
+    EXPECT_TRUE(CheckpointJournal::apply(state, "R 1000 7 0 400 f"));
+    EXPECT_TRUE(CheckpointJournal::apply(state, "R 1000 8 600 100 f"));
+    EXPECT_EQ(state.at("f").mtime_ns, 8);
+    EXPECT_EQ(state.at("f").prefix(), 0u);
+    EXPECT_EQ(state.at("f").bytes(), 100u);
+
+    // Past the end of the file, or not a record
+    EXPECT_FALSE(CheckpointJournal::apply(state, "R 1000 8 900 200 f"));
+    EXPECT_FALSE(CheckpointJournal::apply(state, "R 1000 8 0 f"));
+    EXPECT_FALSE(CheckpointJournal::apply(state, "X f"));
+}
+
+TEST(JournalTest, FormatRoundTrips) {
+    State state;
+    CheckpointJournal::apply(state, "R 1000 -3 0 100 x");
+    CheckpointJournal::apply(state, "R 1000 -3 500 100 x");
+    State back;
+    ASSERT_TRUE(CheckpointJournal::parse(CheckpointJournal::format(state), back));
+    ASSERT_EQ(back.size(), 1u);
+    EXPECT_EQ(back.at("x").ranges, state.at("x").ranges);
+    EXPECT_EQ(back.at("x").mtime_ns, -3);
+}
+
+TEST(JournalTest, JournalSitsNextToDestination) {
+    EXPECT_EQ(CheckpointJournal::path_for("/data/backup"), "/data/.backup.uring-sync-journal");
+    EXPECT_EQ(CheckpointJournal::path_for("/data/backup/"), "/data/.backup.uring-sync-journal");
+    EXPECT_EQ(CheckpointJournal::path_for("/data/vm.img"), "/data/.vm.img.uring-sync-journal");
+}
+
+TEST(JournalTest, CompactsOnOpenAndGoesWhenComplete) {
+    char tmpl[] = "/tmp/journal_test_XXXXXX";
+    ASSERT_NE(mkdtemp(tmpl), nullptr);
+    std::string base = tmpl;
+    std::string dst = base + "/dst";
+    ASSERT_EQ(mkdir(dst.c_str(), 0755), 0);
+    {
+        std::ofstream(dst + "/part") << std::string(300, 'x');
+    }
+    std::string path = CheckpointJournal::path_for(dst);
+    {
+        // A partial copy, one of a file that is gone, and a torn line
+        std::ofstream(path) << "uring-sync journal 1\n"
+                               "R 1000 1 0 100 part\n"
+                               "R 1000 1 100 100 part\n"
+                               "R 1000 1 0 100 gone\n"
+                               "R 1000 1 200";
+    }
+
+    CheckpointJournal journal;
+    std::string error;
+    ASSERT_TRUE(journal.open(dst + "/", error)) << error;
+    EXPECT_EQ(read_text(path), "uring-sync journal 1\nR 1000 1 0 200 part\n");
+    EXPECT_EQ(journal.key(dst + "/part"), "part");
+    EXPECT_EQ(journal.key(dst + "//sub/f"), "sub/f");
+
+    Progress p;
+    ASSERT_TRUE(journal.find("part", p));
+    EXPECT_EQ(p.prefix(), 200u);
+    EXPECT_FALSE(journal.find("gone", p));
+    EXPECT_EQ(journal.partial().size(), 1u);
+
+    // Past the copy's length: the range no longer holds
+    journal.range("part", 1000, 1, 200, 400);
+    EXPECT_FALSE(journal.find("part", p));
+
+    journal.finish("part");
+    journal.close();
+    EXPECT_NE(access(path.c_str(), F_OK), 0);
+
+    // Records land on close, and a partial copy keeps the journal
+    CheckpointJournal again;
+    ASSERT_TRUE(again.open(dst, error)) << error;
+    again.range("part", 1000, 2, 0, 300);
+    again.close();
+    EXPECT_EQ(read_text(path), "uring-sync journal 1\nR 1000 2 0 300 part\n");
+
+    std::filesystem::remove_all(base);
+    unlink(path.c_str());
+}
+
+TEST(JournalTest, RangesOfUnsyncedFilesAreDropped) {
+    char tmpl[] = "/tmp/journal_test_XXXXXX";
+    ASSERT_NE(mkdtemp(tmpl), nullptr);
+    std::string dst = tmpl;
+    {
+        std::ofstream(dst + "/part") << std::string(300, 'x');
+    }
+    std::string path = CheckpointJournal::path_for(dst);
+
+    // "lost" can't be opened for its fdatasync: its range must not land
+    CheckpointJournal journal;
+    std::string error;
+    ASSERT_TRUE(journal.open(dst, error)) << error;
+    journal.range("part", 1000, 1, 0, 100);
+    journal.range("lost", 1000, 1, 0, 300);
+    journal.range("part", 1000, 1, 100, 200);
+    journal.close();
+    EXPECT_EQ(read_text(path), "uring-sync journal 1\n"
+                               "R 1000 1 0 100 part\n"
+                               "R 1000 1 100 200 part\n");
+
+    std::filesystem::remove_all(dst);
+    unlink(path.c_str());
+}
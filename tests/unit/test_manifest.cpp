@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include "manifest.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using protocol::ManifestEntry;
+
+TEST(ManifestTest, PathHashIsFnv1a) {
+    EXPECT_EQ(path_hash(""), 0xcbf29ce484222325ULL);
+    EXPECT_EQ(path_hash("a"), 0xaf63dc4c8601ec8cULL);
+    EXPECT_NE(path_hash("a/b"), path_hash("b/a"));
+}
+
+TEST(ManifestTest, MtimeNsRoundTrip) {
+    struct timespec ts = {1700000000, 123456789};
+    EXPECT_EQ(to_mtime_ns(ts), 1700000000123456789LL);
+    struct timespec back = from_mtime_ns(to_mtime_ns(ts));
+    EXPECT_EQ(back.tv_sec, ts.tv_sec);
+    EXPECT_EQ(back.tv_nsec, ts.tv_nsec);
+
+    // Pre-1970 times keep tv_nsec in range
+    back = from_mtime_ns(-1);
+    EXPECT_EQ(back.tv_sec, -1);
+    EXPECT_EQ(back.tv_nsec, 999999999);
+}
+
+TEST(ManifestTest, MergeMarksMatchesAcrossFrames) {
+    std::vector<ManifestEntry> local = {{1, 10, 100}, {3, 30, 300}, {5, 50, 500}, {7, 70, 700}};
+    ManifestMerge merge(local);
+
+    // Peer has 1 unchanged, 3 with another mtime, 4 (not ours), 7 unchanged
+    std::vector<ManifestEntry> first = {{1, 10, 100}, {3, 30, 301}};
+    std::vector<ManifestEntry> second = {{4, 40, 400}, {7, 70, 700}};
+    ASSERT_TRUE(merge.feed(first.data(), first.size()));
+    ASSERT_TRUE(merge.feed(second.data(), second.size()));
+
+    EXPECT_EQ(merge.unchanged(), (std::vector<uint8_t>{1, 0, 0, 1}));
+    EXPECT_EQ(merge.matched(), 2u);
+    // 3 changed but the peer has a copy (a delta candidate); 5 is new
+    EXPECT_EQ(merge.present(), (std::vector<uint8_t>{1, 1, 0, 1}));
+}
+
+TEST(ManifestTest, MergeChecksWholeHashGroup) {
+    // Two local paths share a hash; each can only match its own size/mtime
+    std::vector<ManifestEntry> local = {{2, 10, 100}, {2, 20, 200}, {2, 30, 300}};
+    ManifestMerge merge(local);
+
+    std::vector<ManifestEntry> peer = {{2, 20, 200}, {2, 30, 300}};
+    ASSERT_TRUE(merge.feed(peer.data(), peer.size()));
+    EXPECT_EQ(merge.unchanged(), (std::vector<uint8_t>{0, 1, 1}));
+}
+
+TEST(ManifestTest, MergeRejectsUnsortedManifest) {
+    std::vector<ManifestEntry> local = {{1, 0, 0}};
+    ManifestMerge merge(local);
+    std::vector<ManifestEntry> peer = {{5, 0, 0}};
+    ASSERT_TRUE(merge.feed(peer.data(), peer.size()));
+    std::vector<ManifestEntry> earlier = {{4, 0, 0}};
+    EXPECT_FALSE(merge.feed(earlier.data(), earlier.size()));
+}
+
+TEST(ManifestTest, BuildManifestSortedByHash) {
+    system("rm -rf /tmp/manifest_test");
+    mkdir("/tmp/manifest_test", 0755);
+    mkdir("/tmp/manifest_test/sub", 0755);
+    for (const char* name : {"a", "b", "sub/c"}) {
+        std::string path = std::string("/tmp/manifest_test/") + name;
+        int fd = open(path.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+        ASSERT_GE(fd, 0);
+        ASSERT_EQ(write(fd, name, strlen(name)), (ssize_t)strlen(name));
+        close(fd);
+    }
+
+    std::vector<ManifestEntry> entries;
+    ASSERT_TRUE(build_manifest("/tmp/manifest_test", entries));
+    ASSERT_EQ(entries.size(), 3u);
+    for (size_t i = 1; i < entries.size(); i++) {
+        EXPECT_LT(entries[i - 1].hash, entries[i].hash);
+    }
+
+    struct stat st;
+    ASSERT_EQ(stat("/tmp/manifest_test/sub/c", &st), 0);
+    auto it = std::find_if(entries.begin(), entries.end(),
+                           [](const ManifestEntry& e) { return e.hash == path_hash("sub/c"); });
+    ASSERT_NE(it, entries.end());
+    EXPECT_EQ(it->size, 5u);
+    EXPECT_EQ(it->mtime_ns, to_mtime_ns(st.st_mtim));
+
+    // A destination that doesn't exist yet has nothing to skip
+    ASSERT_TRUE(build_manifest("/tmp/manifest_test/missing", entries));
+    EXPECT_TRUE(entries.empty());
+    system("rm -rf /tmp/manifest_test");
+}
@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+#include "metrics.hpp"
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+// ============================================================
+// Histogram
+// ============================================================
+
+TEST(LatencyHistogramTest, BucketsBoundTheirValues) {
+    for (uint64_t v : {0ull, 1ull, 7ull, 8ull, 9ull, 15ull, 16ull, 1000ull, 123456789ull,
+                       ~0ull >> 1, ~0ull}) {
+        size_t b = LatencyHistogram::bucket(v);
+        ASSERT_LT(b, LatencyHistogram::BUCKETS) << v;
+        EXPECT_GE(LatencyHistogram::bucket_high(b), v) << v;
+        if (b > 0) {
+            EXPECT_LT(LatencyHistogram::bucket_high(b - 1), v) << v;
+        }
+    }
+    // Exact below SUB, within 1/SUB above
+    EXPECT_EQ(LatencyHistogram::bucket_high(LatencyHistogram::bucket(5)), 5u);
+    uint64_t high = LatencyHistogram::bucket_high(LatencyHistogram::bucket(1000000));
+    EXPECT_LE(high, 1000000u + 1000000u / LatencyHistogram::SUB);
+}
+
+TEST(LatencyHistogramTest, Percentiles) {
+    LatencyHistogram h;
+    EXPECT_EQ(h.percentile(0.5), 0u);
+    for (uint64_t v = 1; v <= 1000; v++) h.record(v * 1000);
+    EXPECT_EQ(h.count(), 1000u);
+    EXPECT_EQ(h.sum(), 500500u * 1000);
+    EXPECT_EQ(h.max(), 1000000u);
+
+    auto near = [](uint64_t got, uint64_t want) {
+        return got >= want && got <= want + want / LatencyHistogram::SUB;
+    };
+    EXPECT_TRUE(near(h.percentile(0.5), 500000)) << h.percentile(0.5);
+    EXPECT_TRUE(near(h.percentile(0.9), 900000)) << h.percentile(0.9);
+    EXPECT_TRUE(near(h.percentile(0.99), 990000)) << h.percentile(0.99);
+    EXPECT_EQ(h.percentile(1.0), 1000000u);     // Capped at the max
+}
+
+TEST(LatencyHistogramTest, Merge) {
+    LatencyHistogram a, b;
+    for (int i = 0; i < 90; i++) a.record(100);
+    for (int i = 0; i < 10; i++) b.record(1000000);
+    a.merge(b);
+    EXPECT_EQ(a.count(), 100u);
+    EXPECT_EQ(a.max(), 1000000u);
+    EXPECT_EQ(a.percentile(0.5), LatencyHistogram::bucket_high(LatencyHistogram::bucket(100)));
+    EXPECT_GE(a.percentile(0.95), 1000000u);
+}
+
+TEST(GaugeTest, TracksMaxAndMean) {
+    Gauge g;
+    EXPECT_EQ(g.mean(), 0.0);
+    g.set(4);
+    g.set(10);
+    g.set(1);
+    EXPECT_EQ(g.value(), 1u);
+    EXPECT_EQ(g.max(), 10u);
+    EXPECT_EQ(g.samples(), 3u);
+    EXPECT_DOUBLE_EQ(g.mean(), 5.0);
+}
+
+// ============================================================
+// Registry
+// ============================================================
+
+TEST(WorkerMetricsTest, IgnoresUnstampedOps) {
+    WorkerMetrics w("worker 0", 2, true);
+    w.record(0, 0, 500);        // Never stamped
+    w.record(5, 100, 200);      // Unknown op kind
+    w.record(1, 100, 300);
+    EXPECT_EQ(w.op(0).count(), 0u);
+    EXPECT_EQ(w.op(1).count(), 1u);
+    EXPECT_EQ(w.op(1).max(), 200u);
+    ASSERT_EQ(w.events().size(), 1u);
+    EXPECT_EQ(w.events()[0].op, 1);
+}
+
+TEST(MetricsRegistryTest, JsonMergesWorkers) {
+    MetricsRegistry registry("copy", {"read", "write"}, false);
+    WorkerMetrics& a = registry.add("worker 0");
+    WorkerMetrics& b = registry.add("worker 1");
+    a.record(0, 1000, 3000);
+    b.record(0, 1000, 5000);
+    b.record(1, 1000, 2000);
+    a.ring_in_flight.set(7);
+
+    std::string json = registry.json("\"files\":3");
+    EXPECT_EQ(json.rfind("{\"mode\":\"copy\"", 0), 0u) << json;
+    EXPECT_NE(json.find("\"counters\":{\"files\":3}"), std::string::npos) << json;
+    EXPECT_NE(json.find("\"read\":{\"count\":2"), std::string::npos) << json;
+    EXPECT_NE(json.find("\"write\":{\"count\":1"), std::string::npos) << json;
+    EXPECT_NE(json.find("\"name\":\"worker 1\""), std::string::npos) << json;
+    EXPECT_NE(json.find("\"ring_in_flight\":{\"current\":7"), std::string::npos) << json;
+    EXPECT_TRUE(a.events().empty());            // Tracing off
+}
+
+TEST(MetricsRegistryTest, WritesChromeTrace) {
+    MetricsRegistry registry("send", {"open", "send"}, true);
+    WorkerMetrics& w = registry.add("stream 0");
+    uint64_t t = now_ns();
+    w.record(0, t, t + 2000);
+    w.record(1, t + 2000, t + 9000);
+
+    std::string path = "/tmp/test_metrics_trace_" + std::to_string(getpid()) + ".json";
+    ASSERT_TRUE(registry.write_trace(path));
+    std::ifstream in(path);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    std::string trace = ss.str();
+    unlink(path.c_str());
+
+    EXPECT_EQ(trace.rfind("{\"traceEvents\":[", 0), 0u) << trace;
+    EXPECT_NE(trace.find("\"args\":{\"name\":\"stream 0\"}"), std::string::npos) << trace;
+    EXPECT_NE(trace.find("\"name\":\"open\",\"cat\":\"send\",\"ph\":\"X\""), std::string::npos) << trace;
+    EXPECT_NE(trace.find("\"name\":\"send\",\"cat\":\"send\",\"ph\":\"X\""), std::string::npos) << trace;
+    EXPECT_FALSE(registry.write_trace("/nonexistent_dir/trace.json"));
+}
@@ -0,0 +1,516 @@
+#include <gtest/gtest.h>
+#include "protocol.hpp"
+
+using namespace protocol;
+
+class ProtocolTest : public ::testing::Test {
+protected:
+    uint8_t nonce[NONCE_SIZE] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+
+    bool parse(const std::vector<uint8_t>& msg, HelloMsg& out) {
+        MsgType type;
+        uint32_t len;
+        parse_header(msg.data(), type, len);
+        EXPECT_EQ(type, MsgType::HELLO);
+        EXPECT_EQ(len, msg.size() - MSG_HEADER_SIZE);
+        return parse_hello(msg.data() + MSG_HEADER_SIZE, len, out);
+    }
+};
+
+TEST_F(ProtocolTest, HelloRoundTripWithSession) {
+    SessionInfo session;
+    session.id = 0x1122334455667788ULL;
+    session.index = 2;
+    session.count = 4;
+
+    HelloMsg hello;
+    ASSERT_TRUE(parse(make_hello("secret", nonce, session), hello));
+
+    EXPECT_EQ(hello.version, PROTOCOL_VERSION);
+    EXPECT_EQ(hello.secret, "secret");
+    EXPECT_EQ(memcmp(hello.nonce, nonce, NONCE_SIZE), 0);
+    EXPECT_EQ(hello.session.id, session.id);
+    EXPECT_EQ(hello.session.index, 2);
+    EXPECT_EQ(hello.session.count, 4);
+}
+
+TEST_F(ProtocolTest, DefaultSessionIsSingleStream) {
+    HelloMsg hello;
+    ASSERT_TRUE(parse(make_hello("", nonce), hello));
+
+    EXPECT_EQ(hello.session.index, 0);
+    EXPECT_EQ(hello.session.count, 1);
+}
+
+TEST_F(ProtocolTest, Version2HelloHasNoSession) {
+    // v2 layout: version + secret_len + secret + nonce
+    std::vector<uint8_t> payload = {2, 3, 'a', 'b', 'c'};
+    payload.insert(payload.end(), nonce, nonce + NONCE_SIZE);
+
+    HelloMsg hello;
+    ASSERT_TRUE(parse_hello(payload.data(), payload.size(), hello));
+    EXPECT_EQ(hello.version, 2);
+    EXPECT_EQ(hello.secret, "abc");
+    EXPECT_EQ(hello.session.id, 0u);
+    EXPECT_EQ(hello.session.count, 1);
+}
+
+TEST_F(ProtocolTest, RejectsInvalidStreamIndex) {
+    SessionInfo session;
+    session.index = 4;
+    session.count = 4;
+
+    HelloMsg hello;
+    EXPECT_FALSE(parse(make_hello("s", nonce, session), hello));
+
+    session.index = 0;
+    session.count = 0;
+    EXPECT_FALSE(parse(make_hello("s", nonce, session), hello));
+}
+
+TEST_F(ProtocolTest, TruncatedHelloRejected) {
+    auto msg = make_hello("secret", nonce);
+    HelloMsg hello;
+    EXPECT_FALSE(parse_hello(msg.data() + MSG_HEADER_SIZE, 2 + 6 + NONCE_SIZE - 1, hello));
+}
+
+TEST_F(ProtocolTest, HelloOkCarriesVersion) {
+    auto msg = make_hello_ok(nonce);
+    HelloOkMsg ok;
+    ASSERT_TRUE(parse_hello_ok(msg.data() + MSG_HEADER_SIZE, msg.size() - MSG_HEADER_SIZE, ok));
+    EXPECT_EQ(ok.version, PROTOCOL_VERSION);
+    EXPECT_EQ(memcmp(ok.nonce, nonce, NONCE_SIZE), 0);
+
+    // Pre-v4 receivers send only the nonce
+    ASSERT_TRUE(parse_hello_ok(nonce, NONCE_SIZE, ok));
+    EXPECT_LT(ok.version, BATCH_MIN_VERSION);
+}
+
+TEST_F(ProtocolTest, CodecNegotiation) {
+    HelloMsg hello;
+    ASSERT_TRUE(parse(make_hello("s", nonce, {}, Codec::LZ4), hello));
+    EXPECT_EQ(hello.codec, Codec::LZ4);
+    ASSERT_TRUE(parse(make_hello("s", nonce), hello));
+    EXPECT_EQ(hello.codec, Codec::NONE);
+
+    auto msg = make_hello_ok(nonce, PROTOCOL_VERSION, Codec::ZSTD);
+    HelloOkMsg ok;
+    ASSERT_TRUE(parse_hello_ok(msg.data() + MSG_HEADER_SIZE, msg.size() - MSG_HEADER_SIZE, ok));
+    EXPECT_EQ(ok.codec, Codec::ZSTD);
+
+    // A v4 receiver's HELLO_OK stops after the version byte
+    ASSERT_TRUE(parse_hello_ok(msg.data() + MSG_HEADER_SIZE, NONCE_SIZE + 1, ok));
+    EXPECT_EQ(ok.codec, Codec::NONE);
+
+    // Unknown codecs are rejected (the codec precedes the v6 flags byte)
+    auto bad = make_hello("s", nonce, {}, Codec::ZSTD);
+    bad[bad.size() - 2] = 0x7f;
+    EXPECT_FALSE(parse(bad, hello));
+}
+
+TEST_F(ProtocolTest, FlagsNegotiation) {
+    HelloMsg hello;
+    ASSERT_TRUE(parse(make_hello("s", nonce, {}, Codec::NONE, FLAG_INCREMENTAL), hello));
+    EXPECT_EQ(hello.flags, FLAG_INCREMENTAL);
+    ASSERT_TRUE(parse(make_hello("s", nonce), hello));
+    EXPECT_EQ(hello.flags, 0);
+
+    auto msg = make_hello_ok(nonce, PROTOCOL_VERSION, Codec::NONE, FLAG_INCREMENTAL);
+    HelloOkMsg ok;
+    ASSERT_TRUE(parse_hello_ok(msg.data() + MSG_HEADER_SIZE, msg.size() - MSG_HEADER_SIZE, ok));
+    EXPECT_EQ(ok.flags, FLAG_INCREMENTAL);
+
+    // A v5 receiver's HELLO_OK stops after the codec byte
+    msg[MSG_HEADER_SIZE + NONCE_SIZE] = 5;
+    ASSERT_TRUE(parse_hello_ok(msg.data() + MSG_HEADER_SIZE, NONCE_SIZE + 2, ok));
+    EXPECT_EQ(ok.flags, 0);
+}
+
+TEST_F(ProtocolTest, FileHdrMtime) {
+    auto plain = make_file_hdr(42, 0644, "a/b.txt");
+    FileHdrMsg hdr;
+    ASSERT_TRUE(parse_file_hdr(plain.data() + MSG_HEADER_SIZE, plain.size() - MSG_HEADER_SIZE, hdr));
+    EXPECT_FALSE(hdr.has_mtime);
+
+    auto timed = make_file_hdr(42, 0644, "a/b.txt", true, 1700000000123456789LL);
+    ASSERT_TRUE(parse_file_hdr(timed.data() + MSG_HEADER_SIZE, timed.size() - MSG_HEADER_SIZE, hdr));
+    EXPECT_EQ(hdr.path, "a/b.txt");
+    EXPECT_EQ(hdr.size, 42u);
+    EXPECT_TRUE(hdr.has_mtime);
+    EXPECT_EQ(hdr.mtime_ns, 1700000000123456789LL);
+}
+
+TEST_F(ProtocolTest, ManifestRoundTrip) {
+    std::vector<ManifestEntry> entries = {{1, 10, 100}, {5, 0, -1}, {9, 1ULL << 40, 123456789}};
+    auto msg = make_manifest(entries.data(), entries.size());
+
+    MsgType type;
+    uint32_t len;
+    parse_header(msg.data(), type, len);
+    EXPECT_EQ(type, MsgType::MANIFEST);
+    EXPECT_EQ(len, 2 + entries.size() * MANIFEST_ENTRY_SIZE);
+
+    std::vector<ManifestEntry> out;
+    ASSERT_TRUE(parse_manifest(msg.data() + MSG_HEADER_SIZE, len, out));
+    ASSERT_EQ(out.size(), 3u);
+    EXPECT_EQ(out[1].hash, 5u);
+    EXPECT_EQ(out[1].mtime_ns, -1);
+    EXPECT_EQ(out[2].size, 1ULL << 40);
+
+    // The count must match the payload exactly
+    EXPECT_FALSE(parse_manifest(msg.data() + MSG_HEADER_SIZE, len - 1, out));
+
+    // Frames are capped at MAX_MANIFEST_ENTRIES
+    std::vector<ManifestEntry> many(MAX_MANIFEST_ENTRIES + 10);
+    auto big = make_manifest(many.data(), many.size());
+    EXPECT_EQ(big.size(), MSG_HEADER_SIZE + 2 + MAX_MANIFEST_ENTRIES * MANIFEST_ENTRY_SIZE);
+}
+
+TEST_F(ProtocolTest, SignatureRoundTrip) {
+    Signature sig;
+    sig.file_size = 10000;
+    sig.block_size = 4096;
+    sig.blocks.resize(3);
+    for (uint32_t i = 0; i < 3; i++) {
+        sig.blocks[i].weak = 0xdead0000 + i;
+        memset(sig.blocks[i].strong, 'a' + i, DELTA_STRONG_SIZE);
+    }
+    auto msg = make_signature(sig);
+
+    MsgType type;
+    uint32_t len;
+    parse_header(msg.data(), type, len);
+    EXPECT_EQ(type, MsgType::SIGNATURE);
+    EXPECT_EQ(len, SIGNATURE_HDR_SIZE + 3 * BLOCK_SIG_SIZE);
+
+    Signature out;
+    ASSERT_TRUE(parse_signature(msg.data() + MSG_HEADER_SIZE, len, out));
+    EXPECT_EQ(out.file_size, 10000u);
+    EXPECT_EQ(out.block_size, 4096u);
+    ASSERT_EQ(out.blocks.size(), 3u);
+    EXPECT_EQ(out.blocks[2].weak, 0xdead0002u);
+    EXPECT_EQ(out.blocks[2].strong[15], 'c');
+
+    // The block count must cover the file size exactly
+    write_u32(msg.data() + MSG_HEADER_SIZE + 8, 8192);
+    EXPECT_FALSE(parse_signature(msg.data() + MSG_HEADER_SIZE, len, out));
+    EXPECT_FALSE(parse_signature(msg.data() + MSG_HEADER_SIZE, len - 1, out));
+
+    // An empty signature means "no usable copy"
+    auto empty = make_signature(Signature{});
+    ASSERT_TRUE(parse_signature(empty.data() + MSG_HEADER_SIZE, empty.size() - MSG_HEADER_SIZE, out));
+    EXPECT_TRUE(out.blocks.empty());
+}
+
+TEST_F(ProtocolTest, DeltaMessagesRoundTrip) {
+    auto req = make_sig_req("dir/model.ckpt");
+    std::string path;
+    ASSERT_TRUE(parse_sig_req(req.data() + MSG_HEADER_SIZE, req.size() - MSG_HEADER_SIZE, path));
+    EXPECT_EQ(path, "dir/model.ckpt");
+    EXPECT_FALSE(parse_sig_req(req.data() + MSG_HEADER_SIZE, req.size() - MSG_HEADER_SIZE - 1, path));
+
+    auto dhdr = make_delta_hdr(1ULL << 32, 0640, "dir/model.ckpt", 1700000000123456789LL, 65536);
+    MsgType type;
+    uint32_t len;
+    parse_header(dhdr.data(), type, len);
+    EXPECT_EQ(type, MsgType::DELTA_HDR);
+    FileHdrMsg hdr;
+    uint32_t block_size = 0;
+    ASSERT_TRUE(parse_delta_hdr(dhdr.data() + MSG_HEADER_SIZE, len, hdr, block_size));
+    EXPECT_EQ(hdr.size, 1ULL << 32);
+    EXPECT_EQ(hdr.mode, 0640u);
+    EXPECT_EQ(hdr.path, "dir/model.ckpt");
+    EXPECT_EQ(hdr.mtime_ns, 1700000000123456789LL);
+    EXPECT_EQ(block_size, 65536u);
+
+    // A plain FILE_HDR payload is not a DELTA_HDR
+    auto plain = make_file_hdr(10, 0644, "a", true, 1);
+    EXPECT_FALSE(parse_delta_hdr(plain.data() + MSG_HEADER_SIZE, plain.size() - MSG_HEADER_SIZE,
+                                 hdr, block_size));
+
+    uint8_t copy[DELTA_COPY_SIZE];
+    write_delta_copy(copy, 7, 42);
+    parse_header(copy, type, len);
+    EXPECT_EQ(type, MsgType::DELTA_COPY);
+    EXPECT_EQ(len, 8u);
+    EXPECT_EQ(read_u32(copy + 5), 7u);
+    EXPECT_EQ(read_u32(copy + 9), 42u);
+}
+
+// ============================================================
+// FILE_DATA frames
+// ============================================================
+
+TEST_F(ProtocolTest, DataFrameRoundTrip) {
+    uint8_t buf[DATA_FRAME_HDR_SIZE];
+    write_data_frame_header(buf, Codec::ZSTD, 100000, 1234);
+
+    MsgType type;
+    uint32_t payload_len;
+    parse_header(buf, type, payload_len);
+    EXPECT_EQ(type, MsgType::FILE_DATA);
+    EXPECT_EQ(payload_len, DATA_FRAME_HDR_SIZE - MSG_HEADER_SIZE + 1234);
+
+    DataFrame frame;
+    ASSERT_TRUE(parse_data_frame(buf + MSG_HEADER_SIZE, payload_len, 200000, frame));
+    EXPECT_EQ(frame.codec, Codec::ZSTD);
+    EXPECT_EQ(frame.raw_len, 100000u);
+    EXPECT_EQ(frame.data_len, 1234u);
+}
+
+TEST_F(ProtocolTest, BadDataFrameRejected) {
+    uint8_t buf[DATA_FRAME_HDR_SIZE];
+    DataFrame frame;
+    auto check = [&](Codec codec, uint32_t raw_len, uint32_t data_len, uint64_t remaining) {
+        write_data_frame_header(buf, codec, raw_len, data_len);
+        return parse_data_frame(buf + MSG_HEADER_SIZE, 5 + data_len, remaining, frame);
+    };
+
+    EXPECT_TRUE(check(Codec::NONE, 4096, 4096, 4096));
+    EXPECT_FALSE(check(Codec::NONE, 4096, 4000, 4096));           // Raw frame must match
+    EXPECT_FALSE(check(Codec::LZ4, 4096, 100, 4000));             // Past the end of the file
+    EXPECT_FALSE(check(Codec::LZ4, MAX_FRAME_RAW + 1, 100, ~0ULL));
+    EXPECT_FALSE(check(Codec::LZ4, 0, 100, 4096));
+    EXPECT_FALSE(check(Codec::LZ4, 4096, 0, 4096));
+
+    write_data_frame_header(buf, Codec::LZ4, 4096, 100);
+    buf[MSG_HEADER_SIZE] = 9;                                     // Unknown codec
+    EXPECT_FALSE(parse_data_frame(buf + MSG_HEADER_SIZE, 105, 4096, frame));
+    EXPECT_FALSE(parse_data_frame(buf + MSG_HEADER_SIZE, 4, 4096, frame));
+}
+
+// ============================================================
+// FILE_BATCH
+// ============================================================
+
+TEST_F(ProtocolTest, BatchRoundTrip) {
+    std::vector<uint8_t> buf(MAX_BATCH_FRAME);
+    BatchBuilder batch;
+    batch.reset(buf.data(), buf.size());
+    EXPECT_TRUE(batch.empty());
+
+    memcpy(batch.add(5, 0644, "a/one.txt"), "hello", 5);
+    batch.add(0, 0600, "empty");
+    memcpy(batch.add(3, 0755, "b/two.sh"), "abc", 3);
+    size_t len = batch.finish();
+
+    MsgType type;
+    uint32_t payload_len;
+    parse_header(buf.data(), type, payload_len);
+    EXPECT_EQ(type, MsgType::FILE_BATCH);
+    EXPECT_EQ(payload_len, len - MSG_HEADER_SIZE);
+
+    std::vector<BatchEntry> entries;
+    ASSERT_TRUE(parse_file_batch(buf.data() + MSG_HEADER_SIZE, payload_len, entries));
+    ASSERT_EQ(entries.size(), 3u);
+    EXPECT_EQ(entries[0].path, "a/one.txt");
+    EXPECT_EQ(entries[0].mode, 0644u);
+    EXPECT_EQ(std::string(reinterpret_cast<const char*>(entries[0].data), 5), "hello");
+    EXPECT_EQ(entries[1].path, "empty");
+    EXPECT_EQ(entries[1].size, 0u);
+    EXPECT_EQ(entries[2].path, "b/two.sh");
+    EXPECT_EQ(std::string(reinterpret_cast<const char*>(entries[2].data), 3), "abc");
+}
+
+TEST_F(ProtocolTest, BatchWithMtime) {
+    std::vector<uint8_t> buf(MAX_BATCH_FRAME);
+    BatchBuilder batch;
+    batch.reset(buf.data(), buf.size(), true);
+    memcpy(batch.add(5, 0644, "one", 111), "hello", 5);
+    batch.add(0, 0600, "empty", 222);
+    size_t len = batch.finish();
+    EXPECT_EQ(len, MSG_HEADER_SIZE + 2 + 2 * (BATCH_ENTRY_HDR_SIZE + MTIME_SIZE) + 3 + 5 + 5);
+
+    std::vector<BatchEntry> entries;
+    const uint8_t* payload = buf.data() + MSG_HEADER_SIZE;
+    ASSERT_TRUE(parse_file_batch(payload, len - MSG_HEADER_SIZE, entries, true));
+    ASSERT_EQ(entries.size(), 2u);
+    EXPECT_EQ(entries[0].mtime_ns, 111);
+    EXPECT_EQ(std::string(reinterpret_cast<const char*>(entries[0].data), 5), "hello");
+    EXPECT_EQ(entries[1].path, "empty");
+    EXPECT_EQ(entries[1].mtime_ns, 222);
+
+    // Without the session flag the layout doesn't line up
+    EXPECT_FALSE(parse_file_batch(payload, len - MSG_HEADER_SIZE, entries));
+}
+
+TEST_F(ProtocolTest, BatchWithMtimeAndCrc) {
+    std::vector<uint8_t> buf(MAX_BATCH_FRAME);
+    BatchBuilder batch;
+    batch.reset(buf.data(), buf.size(), true, true);
+    uint8_t* data = batch.add(5, 0644, "one", 111);
+    memcpy(data, "hello", 5);
+    write_u32(data - CRC_SIZE, 0xdeadbeef);
+    batch.add(0, 0600, "empty", 222);
+    size_t len = batch.finish();
+    EXPECT_EQ(len, MSG_HEADER_SIZE + 2 + 2 * (BATCH_ENTRY_HDR_SIZE + MTIME_SIZE + CRC_SIZE) +
+                       3 + 5 + 5);
+
+    std::vector<BatchEntry> entries;
+    const uint8_t* payload = buf.data() + MSG_HEADER_SIZE;
+    ASSERT_TRUE(parse_file_batch(payload, len - MSG_HEADER_SIZE, entries, true, true));
+    ASSERT_EQ(entries.size(), 2u);
+    EXPECT_EQ(entries[0].mtime_ns, 111);
+    EXPECT_EQ(entries[0].crc, 0xdeadbeefu);
+    EXPECT_EQ(std::string(reinterpret_cast<const char*>(entries[0].data), 5), "hello");
+    EXPECT_EQ(entries[1].mtime_ns, 222);
+    EXPECT_EQ(entries[1].crc, 0u);     // Empty entries start out zeroed
+
+    EXPECT_FALSE(parse_file_batch(payload, len - MSG_HEADER_SIZE, entries, true));
+}
+
+TEST_F(ProtocolTest, FileEndCarriesCrc) {
+    uint8_t end[FILE_END_CRC_SIZE];
+    write_file_end(end, 0x12345678);
+    MsgType type;
+    uint32_t len;
+    parse_header(end, type, len);
+    EXPECT_EQ(type, MsgType::FILE_END);
+    EXPECT_EQ(len, CRC_SIZE);
+    EXPECT_EQ(read_u32(end + MSG_HEADER_SIZE), 0x12345678u);
+
+    // Flag survives negotiation
+    auto msg = make_hello_ok(nonce, PROTOCOL_VERSION, Codec::NONE, FLAG_VERIFY);
+    HelloOkMsg ok;
+    ASSERT_TRUE(parse_hello_ok(msg.data() + MSG_HEADER_SIZE, msg.size() - MSG_HEADER_SIZE, ok));
+    EXPECT_EQ(ok.flags, FLAG_VERIFY);
+    EXPECT_EQ(KNOWN_FLAGS & FLAG_VERIFY, FLAG_VERIFY);
+}
+
+TEST_F(ProtocolTest, ResumeListRoundTrip) {
+    std::vector<ResumeEntry> entries = {{1, 1 << 30, 1700000000123456789LL, 64 << 20},
+                                        {9, 5000, -1, 4096}};
+    auto msg = make_resume(entries.data(), entries.size());
+    MsgType type;
+    uint32_t len;
+    parse_header(msg.data(), type, len);
+    EXPECT_EQ(type, MsgType::RESUME);
+    EXPECT_EQ(len, 2 + entries.size() * RESUME_ENTRY_SIZE);
+
+    std::vector<ResumeEntry> out;
+    ASSERT_TRUE(parse_resume(msg.data() + MSG_HEADER_SIZE, len, out));
+    ASSERT_EQ(out.size(), 2u);
+    EXPECT_EQ(out[0].offset, 64u << 20);
+    EXPECT_EQ(out[1].mtime_ns, -1);
+    EXPECT_FALSE(parse_resume(msg.data() + MSG_HEADER_SIZE, len - 1, out));
+
+    parse_header(make_resume_end().data(), type, len);
+    EXPECT_EQ(type, MsgType::RESUME_END);
+    EXPECT_EQ(len, 0u);
+}
+
+TEST_F(ProtocolTest, FileResumeCarriesOffset) {
+    auto msg = make_file_resume(1000, 0644, "dir/big.img", 42, 600);
+    MsgType type;
+    uint32_t len;
+    parse_header(msg.data(), type, len);
+    EXPECT_EQ(type, MsgType::FILE_RESUME);
+
+    FileHdrMsg hdr;
+    uint64_t offset = 0;
+    ASSERT_TRUE(parse_file_resume(msg.data() + MSG_HEADER_SIZE, len, hdr, offset));
+    EXPECT_EQ(hdr.path, "dir/big.img");
+    EXPECT_EQ(hdr.size, 1000u);
+    EXPECT_EQ(hdr.mtime_ns, 42);
+    EXPECT_EQ(offset, 600u);
+
+    // The offset must fall inside the file
+    auto at_end = make_file_resume(1000, 0644, "f", 42, 1000);
+    parse_header(at_end.data(), type, len);
+    EXPECT_FALSE(parse_file_resume(at_end.data() + MSG_HEADER_SIZE, len, hdr, offset));
+    auto at_start = make_file_resume(1000, 0644, "f", 42, 0);
+    EXPECT_FALSE(parse_file_resume(at_start.data() + MSG_HEADER_SIZE, len, hdr, offset));
+}
+
+TEST_F(ProtocolTest, SparseHeaderAndHoles) {
+    auto msg = make_file_sparse(1ull << 40, 0600, "vm/disk.img", true, 7);
+    MsgType type;
+    uint32_t len;
+    parse_header(msg.data(), type, len);
+    EXPECT_EQ(type, MsgType::FILE_SPARSE);
+    FileHdrMsg hdr;
+    ASSERT_TRUE(parse_file_hdr(msg.data() + MSG_HEADER_SIZE, len, hdr));
+    EXPECT_EQ(hdr.path, "vm/disk.img");
+    EXPECT_EQ(hdr.size, 1ull << 40);
+    EXPECT_EQ(hdr.mtime_ns, 7);
+
+    // A hole message is as long as a frame header; lengths use 40 bits
+    uint8_t buf[DATA_FRAME_HDR_SIZE];
+    write_file_hole(buf, MAX_HOLE);
+    parse_header(buf, type, len);
+    EXPECT_EQ(type, MsgType::FILE_HOLE);
+    EXPECT_EQ(MSG_HEADER_SIZE + len, DATA_FRAME_HDR_SIZE);
+    uint64_t hole = 0;
+    ASSERT_TRUE(parse_file_hole(buf + MSG_HEADER_SIZE, len, 1ull << 41, hole));
+    EXPECT_EQ(hole, MAX_HOLE);
+
+    // Never the file's end, never empty
+    write_file_hole(buf, 4096);
+    EXPECT_FALSE(parse_file_hole(buf + MSG_HEADER_SIZE, len, 4096, hole));
+    EXPECT_TRUE(parse_file_hole(buf + MSG_HEADER_SIZE, len, 4097, hole));
+    write_file_hole(buf, 0);
+    EXPECT_FALSE(parse_file_hole(buf + MSG_HEADER_SIZE, len, 4097, hole));
+}
+
+TEST_F(ProtocolTest, FileLinkRoundTrip) {
+    auto msg = make_file_link("b/second", "a/first");
+    MsgType type;
+    uint32_t len;
+    parse_header(msg.data(), type, len);
+    EXPECT_EQ(type, MsgType::FILE_LINK);
+
+    std::string path, target;
+    ASSERT_TRUE(parse_file_link(msg.data() + MSG_HEADER_SIZE, len, path, target));
+    EXPECT_EQ(path, "b/second");
+    EXPECT_EQ(target, "a/first");
+
+    EXPECT_FALSE(parse_file_link(msg.data() + MSG_HEADER_SIZE, len - 1, path, target));
+    auto empty = make_file_link("x", "");
+    parse_header(empty.data(), type, len);
+    EXPECT_FALSE(parse_file_link(empty.data() + MSG_HEADER_SIZE, len, path, target));
+}
+
+TEST_F(ProtocolTest, BatchFitsRespectsLimits) {
+    std::vector<uint8_t> buf(MAX_BATCH_FRAME);
+    BatchBuilder batch;
+    batch.reset(buf.data(), buf.size());
+
+    EXPECT_FALSE(batch.fits(4, MAX_BATCH_FILE_SIZE + 1));
+
+    // Fill by bytes: 16KB files until the frame is full
+    size_t added = 0;
+    while (batch.fits(4, MAX_BATCH_FILE_SIZE)) {
+        batch.add(MAX_BATCH_FILE_SIZE, 0644, "file");
+        added++;
+    }
+    EXPECT_EQ(added, (MAX_BATCH_FRAME - MSG_HEADER_SIZE - 2) /
+                     (BATCH_ENTRY_HDR_SIZE + 4 + MAX_BATCH_FILE_SIZE));
+    EXPECT_LE(batch.size(), MAX_BATCH_FRAME);
+
+    // Fill by count: empty files
+    batch.reset(buf.data(), buf.size());
+    while (batch.fits(1, 0)) batch.add(0, 0644, "e");
+    EXPECT_EQ(batch.count(), MAX_BATCH_FILES);
+}
+
+TEST_F(ProtocolTest, MalformedBatchRejected) {
+    std::vector<uint8_t> buf(MAX_BATCH_FRAME);
+    BatchBuilder batch;
+    batch.reset(buf.data(), buf.size());
+    memcpy(batch.add(4, 0644, "x"), "data", 4);
+    size_t len = batch.finish();
+    const uint8_t* payload = buf.data() + MSG_HEADER_SIZE;
+    size_t payload_len = len - MSG_HEADER_SIZE;
+
+    std::vector<BatchEntry> entries;
+    EXPECT_FALSE(parse_file_batch(payload, payload_len - 1, entries));   // Truncated data
+    EXPECT_FALSE(parse_file_batch(payload, 2 + BATCH_ENTRY_HDR_SIZE - 1, entries));
+
+    // Count larger than the entries present
+    write_u16(buf.data() + MSG_HEADER_SIZE, 2);
+    EXPECT_FALSE(parse_file_batch(payload, payload_len, entries));
+
+    // Empty batch
+    write_u16(buf.data() + MSG_HEADER_SIZE, 0);
+    EXPECT_FALSE(parse_file_batch(payload, 2, entries));
+}
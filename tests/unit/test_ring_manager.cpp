@@ -36,7 +36,6 @@ protected:
 TEST_F(RingManagerTest, Construction) {
     RingManager ring(kDefaultDepth);
     EXPECT_EQ(ring.depth(), kDefaultDepth);
-    EXPECT_FALSE(ring.buffers_registered());
 }
 
 TEST_F(RingManagerTest, ConstructionDifferentDepths) {
@@ -52,6 +51,43 @@ TEST_F(RingManagerTest, HasSqeSpace) {
     EXPECT_TRUE(ring.has_sqe_space());
 }
 
+// Each profile either works or falls back to one that does; a chain bigger
+// than the free SQ space still goes out whole
+TEST_F(RingManagerTest, RingProfilesFallBack) {
+    for (RingProfile profile : {RingProfile::DEFAULT, RingProfile::SQPOLL,
+                                RingProfile::COOP, RingProfile::DEFER}) {
+        RingSetup setup;
+        setup.profile = profile;
+        setup.sqpoll_cpu = 0;
+        RingManager ring(4, setup, 1);
+        RingProfile used = ring.profile();
+        EXPECT_TRUE(used == profile || used == RingProfile::DEFAULT ||
+                    (profile == RingProfile::DEFER && used == RingProfile::COOP))
+            << ring_profile_name(profile) << " -> " << ring_profile_name(used);
+        EXPECT_EQ(probe_ring_profile(setup), used);
+
+        FileContext ctx;
+        int done = 0;
+        for (int i = 0; i < 3; i++) ring.prepare_nop(&ctx);
+        ring.reserve(4);
+        EXPECT_GE(ring.sq_space_left(), 4u);
+        for (int i = 0; i < 4; i++) ring.prepare_nop(&ctx);
+        ring.submit();
+        while (done < 7) {
+            ring.wait_and_process([&](FileContext* c, int res) {
+                EXPECT_EQ(c, &ctx);
+                EXPECT_EQ(res, 0);
+                done++;
+            });
+        }
+    }
+
+    RingProfile parsed = RingProfile::DEFAULT;
+    EXPECT_TRUE(parse_ring_profile("defer", parsed));
+    EXPECT_EQ(parsed, RingProfile::DEFER);
+    EXPECT_FALSE(parse_ring_profile("fast", parsed));
+}
+
 // ============================================================
 // Read Tests
 // ============================================================
@@ -69,7 +105,6 @@ TEST_F(RingManagerTest, PrepareReadAndComplete) {
 
     // Prepare context
     FileContext ctx;
-    ctx.src_path = "/tmp/ring_test/read.txt";
     ctx.src_fd = fd;
     ctx.buffer = static_cast<char*>(aligned_alloc(4096, kBufferSize));
     memset(ctx.buffer, 0, kBufferSize);
@@ -230,18 +265,19 @@ TEST_F(RingManagerTest, PrepareOpenat) {
 
     create_test_file("/tmp/ring_test/open.txt", "test");
 
-    FileContext ctx;
-    ctx.src_path = "/tmp/ring_test/open.txt";
-    ctx.state = FileState::OPENING_SRC;
-    ctx.current_op = OpType::OPEN_SRC;
+    FileContextSlab slab(1);
+    FileContext* ctx = slab.acquire();
+    ctx->cold->src_path = "/tmp/ring_test/open.txt";
+    ctx->state = FileState::OPENING_SRC;
+    ctx->current_op = OpType::OPEN_SRC;
 
-    ring.prepare_openat(AT_FDCWD, ctx.src_path.c_str(), O_RDONLY, 0, &ctx);
+    ring.prepare_openat(AT_FDCWD, ctx->cold->src_path.c_str(), O_RDONLY, 0, ctx);
     ring.submit();
 
     int res;
     FileContext* completed = ring.wait_one(res);
 
-    EXPECT_EQ(completed, &ctx);
+    EXPECT_EQ(completed, ctx);
     EXPECT_GE(res, 0);  // res is the fd
 
     // Close the fd we got
@@ -277,20 +313,21 @@ TEST_F(RingManagerTest, PrepareStatx) {
     const char* content = "0123456789";  // 10 bytes
     create_test_file("/tmp/ring_test/statx.txt", content);
 
-    FileContext ctx;
-    ctx.src_path = "/tmp/ring_test/statx.txt";
+    FileContextSlab slab(1);
+    FileContext* ctx = slab.acquire();
+    ctx->cold->src_path = "/tmp/ring_test/statx.txt";
 
-    ring.prepare_statx(AT_FDCWD, ctx.src_path.c_str(), 0,
-                       STATX_SIZE | STATX_MODE, &ctx.stx, &ctx);
+    ring.prepare_statx(AT_FDCWD, ctx->cold->src_path.c_str(), 0,
+                       STATX_SIZE | STATX_MODE, &ctx->cold->stx, ctx);
     ring.submit();
 
     int res;
     FileContext* completed = ring.wait_one(res);
 
-    EXPECT_EQ(completed, &ctx);
+    EXPECT_EQ(completed, ctx);
     EXPECT_EQ(res, 0);
-    EXPECT_EQ(ctx.stx.stx_size, 10);
-    EXPECT_TRUE(S_ISREG(ctx.stx.stx_mode));
+    EXPECT_EQ(ctx->cold->stx.stx_size, 10);
+    EXPECT_TRUE(S_ISREG(ctx->cold->stx.stx_mode));
 }
 
 // ============================================================
@@ -367,31 +404,93 @@ TEST_F(RingManagerTest, ProcessCompletions) {
     free(ctx.buffer);
 }
 
-// ============================================================
-// Buffer Registration Tests
-// ============================================================
+// A read and a failing write in flight for one context: the tags say which is which
+TEST_F(RingManagerTest, TaggedCompletionsOfOneContext) {
+    int fd = open("/tmp/ring_test/tagged.txt", O_CREAT | O_RDWR | O_TRUNC, 0644);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(write(fd, "hello", 5), 5);
+    close(fd);
+    fd = open("/tmp/ring_test/tagged.txt", O_RDONLY);
 
-TEST_F(RingManagerTest, RegisterBuffers) {
     RingManager ring(kDefaultDepth);
+    FileContext ctx;
+    char rbuf[16], wbuf[16] = "data";
+    ring.prepare_read(fd, rbuf, sizeof(rbuf), 0, &ctx, false, 1);
+    ring.prepare_write(fd, wbuf, 4, 0, &ctx, false, 6);
+    ring.submit();
 
-    std::vector<char*> buffers(4);
-    for (auto& buf : buffers) {
-        buf = static_cast<char*>(aligned_alloc(4096, kBufferSize));
+    int seen = 0;
+    while (seen < 2) {
+        ring.wait_and_process([&](FileContext* c, int res, unsigned tag) {
+            EXPECT_EQ(c, &ctx);
+            if (tag == 1) {
+                EXPECT_EQ(res, 5);
+            } else {
+                EXPECT_EQ(tag, 6u);
+                EXPECT_EQ(res, -EBADF);   // Read-only fd
+            }
+            seen++;
+        });
     }
+    close(fd);
+
+    // Untagged callbacks still work and get the bare context
+    ring.prepare_nop(&ctx);
+    ring.submit();
+    ring.wait_and_process([&](FileContext* c, int res) {
+        EXPECT_EQ(c, &ctx);
+        EXPECT_EQ(res, 0);
+    });
+}
+
+// ============================================================
+// Fixed-File Slot Tests
+// ============================================================
 
-    EXPECT_FALSE(ring.buffers_registered());
+TEST_F(RingManagerTest, RegisterFileSlots) {
+    RingManager ring(kDefaultDepth);
 
-    bool result = ring.register_buffers(buffers, kBufferSize);
-    EXPECT_TRUE(result);
-    EXPECT_TRUE(ring.buffers_registered());
+    // Sparse table (5.15+); a kernel without it reports false
+    if (!ring.register_file_slots(4)) GTEST_SKIP() << "sparse file registration unsupported";
+    EXPECT_EQ(ring.file_slots(), 4u);
 
     // Can't register twice
-    bool result2 = ring.register_buffers(buffers, kBufferSize);
-    EXPECT_FALSE(result2);
+    EXPECT_FALSE(ring.register_file_slots(4));
+}
 
-    for (auto& buf : buffers) {
-        free(buf);
-    }
+// The worker's small-file chain reads the size the scan saw, then statx's
+// the path in the same chain: a file that grew meanwhile reads "fully" up
+// to the old size, and only the statx shows the copy would be cut
+TEST_F(RingManagerTest, LinkedStatxSeesGrowthPastRead) {
+    RingManager ring(kDefaultDepth);
+    if (!ring.register_file_slots(1)) GTEST_SKIP() << "sparse file registration unsupported";
+
+    const char* path = "/tmp/ring_test/grows.txt";
+    create_test_file(path, "0123456789");
+    uint64_t scanned = 10;
+    int fd = open(path, O_WRONLY | O_APPEND);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(write(fd, "ABCDEFGHIJ", 10), 10);
+    close(fd);
+
+    FileContextSlab slab(1);
+    FileContext* ctx = slab.acquire();
+    char buf[64] = {0};
+    ring.prepare_openat_direct(AT_FDCWD, path, O_RDONLY, 0, 0, ctx, true);
+    ring.prepare_read_direct(0, buf, scanned, 0, ctx, true);
+    ring.prepare_statx(AT_FDCWD, path, 0, STATX_SIZE, &ctx->cold->stx, ctx, true);
+    ring.prepare_close_direct(0, ctx);
+    ASSERT_EQ(ring.submit(), 4);
+
+    // Linked completions arrive in submission order
+    int res[4];
+    for (int& r : res) ASSERT_EQ(ring.wait_one(r), ctx);
+    EXPECT_EQ(res[0], 0);
+    EXPECT_EQ(res[1], 10);
+    EXPECT_EQ(res[2], 0);
+    EXPECT_EQ(res[3], 0);
+    EXPECT_EQ(ctx->cold->stx.stx_size, 20u);
+    EXPECT_NE(ctx->cold->stx.stx_size, scanned);
 }
 
 // ============================================================
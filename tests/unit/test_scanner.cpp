@@ -0,0 +1,383 @@
+#include <gtest/gtest.h>
+#include "scanner.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <set>
+#include <string>
+
+class ScannerTest : public ::testing::Test {
+protected:
+    static constexpr const char* kSrc = "/tmp/scanner_test/src";
+    static constexpr const char* kDst = "/tmp/scanner_test/dst";
+
+    void SetUp() override {
+        system("rm -rf /tmp/scanner_test");
+        mkdir("/tmp/scanner_test", 0755);
+        mkdir(kSrc, 0755);
+        mkdir(kDst, 0755);
+    }
+
+    void TearDown() override {
+        system("rm -rf /tmp/scanner_test");
+    }
+
+    void create_file(const std::string& path, size_t size) {
+        int fd = open(path.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+        ASSERT_GE(fd, 0);
+        std::string data(size, 'x');
+        write(fd, data.data(), data.size());
+        close(fd);
+    }
+
+    std::vector<FileWorkItem> drain(WorkScheduler<FileWorkItem>& queue) {
+        std::vector<FileWorkItem> items;
+        FileWorkItem item;
+        while (queue.wait_pop(0, item)) {
+            items.push_back(item);
+        }
+        return items;
+    }
+};
+
+TEST_F(ScannerTest, EmptyDirectory) {
+    WorkScheduler<FileWorkItem> queue(1);
+    Stats stats;
+    DirScanner scanner(kSrc, kDst, queue, stats, {});
+
+    scanner.start();
+    scanner.join();
+
+    EXPECT_TRUE(scanner.finished());
+    EXPECT_TRUE(queue.is_done());
+    EXPECT_EQ(scanner.files_found(), 0);
+    EXPECT_EQ(stats.files_total.load(), 0);
+}
+
+TEST_F(ScannerTest, NestedTreeFeedsQueue) {
+    std::string src = kSrc;
+    mkdir((src + "/a").c_str(), 0755);
+    mkdir((src + "/a/b").c_str(), 0755);
+    mkdir((src + "/empty").c_str(), 0755);
+    create_file(src + "/top.txt", 10);
+    create_file(src + "/a/one.txt", 20);
+    create_file(src + "/a/b/two.txt", 30);
+
+    WorkScheduler<FileWorkItem> queue(1);
+    Stats stats;
+    ScanOptions opts;
+    opts.threads = 3;
+    opts.batch_size = 1;
+    DirScanner scanner(kSrc, kDst, queue, stats, opts);
+
+    scanner.start();
+    auto items = drain(queue);
+    scanner.join();
+
+    std::set<std::string> dsts;
+    for (const auto& item : items) {
+        dsts.insert(item.dst_path);
+        EXPECT_NE(item.inode, 0u);
+    }
+
+    std::string dst = kDst;
+    EXPECT_EQ(items.size(), 3u);
+    EXPECT_EQ(stats.files_total.load(), 3u);
+    EXPECT_TRUE(dsts.count(dst + "/top.txt"));
+    EXPECT_TRUE(dsts.count(dst + "/a/one.txt"));
+    EXPECT_TRUE(dsts.count(dst + "/a/b/two.txt"));
+
+    // Destination directories exist before their files are handed out
+    struct stat st;
+    EXPECT_EQ(stat((dst + "/a/b").c_str(), &st), 0);
+    EXPECT_EQ(stat((dst + "/empty").c_str(), &st), 0);
+    EXPECT_EQ(stats.dirs_created.load(), 3u);
+}
+
+TEST_F(ScannerTest, BatchesAreInodeSorted) {
+    std::string src = kSrc;
+    for (int i = 0; i < 50; i++) {
+        create_file(src + "/f" + std::to_string(i), 1);
+    }
+
+    WorkScheduler<FileWorkItem> queue(1);
+    Stats stats;
+    ScanOptions opts;
+    opts.threads = 1;
+    opts.batch_size = 1000;
+    DirScanner scanner(kSrc, kDst, queue, stats, opts);
+
+    scanner.start();
+    scanner.join();
+    auto items = drain(queue);
+
+    ASSERT_EQ(items.size(), 50u);
+    for (size_t i = 1; i < items.size(); i++) {
+        EXPECT_LE(items[i - 1].inode, items[i].inode);
+    }
+}
+
+TEST_F(ScannerTest, HardlinksQueueOneName) {
+    std::string src = kSrc;
+    mkdir((src + "/a").c_str(), 0755);
+    create_file(src + "/a/first", 100);
+    ASSERT_EQ(link((src + "/a/first").c_str(), (src + "/second").c_str()), 0);
+    ASSERT_EQ(link((src + "/a/first").c_str(), (src + "/third").c_str()), 0);
+    create_file(src + "/single", 100);
+
+    WorkScheduler<FileWorkItem> queue(1);
+    Stats stats;
+    ScanOptions opts;
+    opts.threads = 2;
+    opts.hardlinks = true;
+    DirScanner scanner(kSrc, kDst, queue, stats, opts);
+
+    scanner.start();
+    auto items = drain(queue);
+    scanner.join();
+
+    // One of the three names is copied, the other two link to its copy
+    ASSERT_EQ(items.size(), 2u);
+    EXPECT_EQ(stats.files_total.load(), 2u);
+    auto links = scanner.take_links();
+    ASSERT_EQ(links.size(), 2u);
+    std::set<std::string> queued;
+    for (const auto& item : items) queued.insert(item.dst_path);
+    for (const auto& link : links) {
+        EXPECT_TRUE(queued.count(link.target)) << link.target;
+        EXPECT_FALSE(queued.count(link.dst_path)) << link.dst_path;
+    }
+}
+
+// Extent lookup must not change which files are found; where the
+// filesystem has FIEMAP, a batch is in physical order
+TEST_F(ScannerTest, BatchesFollowPhysicalExtents) {
+    std::string src = kSrc;
+    for (int i = 0; i < 50; i++) {
+        create_file(src + "/f" + std::to_string(i), 8192);
+    }
+    sync();  // Delayed allocation leaves fresh data without an address
+
+    WorkScheduler<FileWorkItem> queue(1);
+    Stats stats;
+    ScanOptions opts;
+    opts.threads = 1;
+    opts.batch_size = 1000;
+    opts.extent_order = true;
+    DirScanner scanner(kSrc, kDst, queue, stats, opts);
+
+    scanner.start();
+    scanner.join();
+    auto items = drain(queue);
+
+    ASSERT_EQ(items.size(), 50u);
+    if (!scanner.fiemap_supported()) {
+        for (size_t i = 1; i < items.size(); i++) {
+            EXPECT_EQ(items[i].extent, 0u);
+            EXPECT_LE(items[i - 1].inode, items[i].inode);
+        }
+        GTEST_SKIP() << "No FIEMAP on /tmp";
+    }
+    EXPECT_EQ(scanner.extents_mapped(), 50u);
+    for (size_t i = 1; i < items.size(); i++) {
+        EXPECT_LT(items[i - 1].extent, items[i].extent);
+    }
+}
+
+TEST(DiskOrderTest, UnmappedFirstByInodeThenByAddress) {
+    std::vector<std::pair<uint64_t, ino_t>> files = {
+        {4096 * 9, 1}, {0, 7}, {4096 * 2, 5}, {0, 3}, {4096 * 5, 2}};
+    std::sort(files.begin(), files.end(), [](const auto& a, const auto& b) {
+        return disk_order(a.first, a.second) < disk_order(b.first, b.second);
+    });
+    std::vector<std::pair<uint64_t, ino_t>> expected = {
+        {0, 3}, {0, 7}, {4096 * 2, 5}, {4096 * 5, 2}, {4096 * 9, 1}};
+    EXPECT_EQ(files, expected);
+}
+
+TEST_F(ScannerTest, SamplesFileSizes) {
+    std::string src = kSrc;
+    for (int i = 0; i < 10; i++) {
+        create_file(src + "/f" + std::to_string(i), 4096);
+    }
+
+    WorkScheduler<FileWorkItem> queue(1);
+    Stats stats;
+    ScanOptions opts;
+    opts.sample_files = 5;
+    DirScanner scanner(kSrc, kDst, queue, stats, opts);
+
+    scanner.start();
+    scanner.wait_for_samples();
+    SizeStats sizes = scanner.size_stats();
+    scanner.join();
+
+    EXPECT_EQ(sizes.samples.size(), 5u);
+    EXPECT_EQ(sizes.percentile(50), 4096u);
+}
+
+TEST_F(ScannerTest, UnreadableSourceCountsError) {
+    WorkScheduler<FileWorkItem> queue(1);
+    Stats stats;
+    DirScanner scanner("/tmp/scanner_test/missing", kDst, queue, stats, {});
+
+    scanner.start();
+    scanner.join();
+
+    EXPECT_TRUE(queue.is_done());
+    EXPECT_EQ(scanner.errors(), 1u);
+}
+
+TEST_F(ScannerTest, SkipsUnchangedFiles) {
+    std::string src = kSrc, dst = kDst;
+    mkdir((src + "/a").c_str(), 0755);
+    mkdir((dst + "/a").c_str(), 0755);
+    create_file(src + "/same.txt", 10);
+    create_file(src + "/a/touched.txt", 10);
+    create_file(src + "/resized.txt", 10);
+    create_file(src + "/new.txt", 10);
+
+    // Copies with the source mtime, except one whose mtime differs
+    auto copy_of = [](const std::string& from, const std::string& to, size_t size,
+                      long mtime_shift) {
+        int fd = open(to.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+        std::string data(size, 'x');
+        write(fd, data.data(), data.size());
+        struct stat st;
+        stat(from.c_str(), &st);
+        st.st_mtim.tv_sec += mtime_shift;
+        struct timespec times[2] = {{0, UTIME_OMIT}, st.st_mtim};
+        futimens(fd, times);
+        close(fd);
+    };
+    copy_of(src + "/same.txt", dst + "/same.txt", 10, 0);
+    copy_of(src + "/a/touched.txt", dst + "/a/touched.txt", 10, -5);
+    copy_of(src + "/resized.txt", dst + "/resized.txt", 9, 0);
+
+    WorkScheduler<FileWorkItem> queue(1);
+    Stats stats;
+    ScanOptions opts;
+    opts.skip_unchanged = true;
+    DirScanner scanner(kSrc, kDst, queue, stats, opts);
+
+    scanner.start();
+    auto items = drain(queue);
+    scanner.join();
+
+    std::set<std::string> dsts;
+    for (const auto& item : items) {
+        dsts.insert(item.dst_path);
+        EXPECT_NE(item.mtime.tv_nsec, UTIME_OMIT);   // Carried for the copy
+    }
+    EXPECT_EQ(dsts, (std::set<std::string>{dst + "/a/touched.txt", dst + "/resized.txt",
+                                           dst + "/new.txt"}));
+    EXPECT_EQ(stats.files_skipped.load(), 1u);
+    EXPECT_EQ(stats.files_total.load(), 3u);
+}
+
+TEST_F(ScannerTest, SplitsLargeFiles) {
+    std::string src = kSrc;
+    create_file(src + "/small.txt", 10);
+    // Sparse is enough: only the size matters
+    int fd = open((src + "/big.bin").c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(ftruncate(fd, 3 * SPLIT_SEGMENT), 0);
+    close(fd);
+
+    WorkScheduler<FileWorkItem> queue(1);
+    Stats stats;
+    ScanOptions opts;
+    opts.stat_files = true;
+    opts.split_size = 2 * SPLIT_SEGMENT;
+    DirScanner scanner(kSrc, kDst, queue, stats, opts);
+
+    scanner.start();
+    auto items = drain(queue);
+    scanner.join();
+
+    ASSERT_EQ(items.size(), 4u);
+    size_t segments = 0;
+    for (const auto& item : items) {
+        if (!item.split) continue;
+        EXPECT_EQ(item.range_offset, segments * SPLIT_SEGMENT);  // In file order
+        segments++;
+    }
+    EXPECT_EQ(segments, 3u);
+    EXPECT_EQ(stats.files_total.load(), 2u);   // Files, not segments
+    EXPECT_EQ(scanner.files_found(), 2u);
+}
+
+TEST(AppendSplitTest, SplitsLargeFiles) {
+    std::vector<FileWorkItem> batch;
+    uint64_t size = 2 * SPLIT_SEGMENT + 100;
+    append_split(batch, {"/src/big", "/dst/big", 7, size, 0644}, SPLIT_SEGMENT);
+    append_split(batch, {"/src/small", "/dst/small", 8, 100, 0644}, SPLIT_SEGMENT);
+    append_split(batch, {"/src/unknown", "/dst/unknown", 9}, SPLIT_SEGMENT);
+
+    ASSERT_EQ(batch.size(), 5u);
+    auto split = batch[0].split;
+    ASSERT_NE(split, nullptr);
+    EXPECT_EQ(split->size, size);
+    EXPECT_EQ(split->segments_left.load(), 3u);
+
+    uint64_t next = 0;
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(batch[i].split, split);
+        EXPECT_EQ(batch[i].src_path, "/src/big");
+        EXPECT_EQ(batch[i].range_offset, next);
+        next += batch[i].range_len;
+    }
+    EXPECT_EQ(next, size);              // Ranges cover the file
+    EXPECT_EQ(batch[2].range_len, 100u);
+    EXPECT_EQ(batch[3].split, nullptr);
+    EXPECT_EQ(batch[4].split, nullptr);
+}
+
+TEST(AppendSplitTest, NeedsThresholdAndSize) {
+    std::vector<FileWorkItem> batch;
+    uint64_t size = 4 * SPLIT_SEGMENT;
+    append_split(batch, {"/src/a", "/dst/a", 1, size, 0644}, 0);           // Disabled
+    append_split(batch, {"/src/b", "/dst/b", 2, size, 0644}, size + 1);    // Below
+    append_split(batch, {"/src/c", "/dst/c", 3, SPLIT_SEGMENT, 0644}, 1);  // One segment
+    ASSERT_EQ(batch.size(), 3u);
+    for (const auto& item : batch) EXPECT_EQ(item.split, nullptr);
+}
+
+TEST(AppendSplitTest, ResumeLeavesOutJournaledSegments) {
+    system("rm -rf /tmp/append_split_test && mkdir -p /tmp/append_split_test/dst");
+    const std::string dst = "/tmp/append_split_test/dst";
+    uint64_t size = 4 * SPLIT_SEGMENT;
+    int fd = open((dst + "/big").c_str(), O_WRONLY | O_CREAT, 0644);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(ftruncate(fd, size), 0);
+    close(fd);
+
+    CheckpointJournal journal;
+    std::string error;
+    ASSERT_TRUE(journal.open(dst, error)) << error;
+    struct timespec mtime = {1700000000, 5};
+    journal.range("big", size, to_mtime_ns(mtime), 0, 2 * SPLIT_SEGMENT);
+    journal.range("big", size, to_mtime_ns(mtime), 3 * SPLIT_SEGMENT, SPLIT_SEGMENT);
+
+    // The last segment goes even though it is on disk
+    std::vector<FileWorkItem> batch;
+    EXPECT_EQ(append_split(batch, {"/src/big", dst + "/big", 7, size, 0644, mtime},
+                           SPLIT_SEGMENT, &journal), 2 * SPLIT_SEGMENT);
+    ASSERT_EQ(batch.size(), 2u);
+    EXPECT_EQ(batch[0].range_offset, 2 * SPLIT_SEGMENT);
+    EXPECT_EQ(batch[1].range_offset, 3 * SPLIT_SEGMENT);
+    EXPECT_TRUE(batch[0].split->resumed);
+    EXPECT_EQ(batch[0].split->segments_left.load(), 2u);
+
+    // Another source mtime: copied whole
+    batch.clear();
+    struct timespec newer = {1700000001, 0};
+    EXPECT_EQ(append_split(batch, {"/src/big", dst + "/big", 7, size, 0644, newer},
+                           SPLIT_SEGMENT, &journal), 0u);
+    ASSERT_EQ(batch.size(), 4u);
+    EXPECT_FALSE(batch[0].split->resumed);
+
+    journal.close();
+    system("rm -rf /tmp/append_split_test");
+    unlink(CheckpointJournal::path_for(dst).c_str());
+}
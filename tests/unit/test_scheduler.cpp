@@ -0,0 +1,242 @@
+#include <gtest/gtest.h>
+#include "scheduler.hpp"
+#include <thread>
+#include <vector>
+#include <set>
+#include <atomic>
+#include <mutex>
+
+// ============================================================
+// ChaseLevDeque
+// ============================================================
+
+TEST(ChaseLevDequeTest, PopIsLifo) {
+    ChaseLevDeque<int> d;
+    int a = 1, b = 2, c = 3;
+    d.push(&a);
+    d.push(&b);
+    d.push(&c);
+
+    EXPECT_EQ(d.size(), 3u);
+    EXPECT_EQ(d.pop(), &c);
+    EXPECT_EQ(d.pop(), &b);
+    EXPECT_EQ(d.pop(), &a);
+    EXPECT_EQ(d.pop(), nullptr);
+    EXPECT_TRUE(d.empty());
+}
+
+TEST(ChaseLevDequeTest, StealIsFifo) {
+    ChaseLevDeque<int> d;
+    int a = 1, b = 2;
+    d.push(&a);
+    d.push(&b);
+
+    EXPECT_EQ(d.steal(), &a);
+    EXPECT_EQ(d.steal(), &b);
+    EXPECT_EQ(d.steal(), nullptr);
+}
+
+TEST(ChaseLevDequeTest, GrowsPastInitialCapacity) {
+    ChaseLevDeque<int> d(4);
+    std::vector<int> values(100);
+    for (auto& v : values) d.push(&v);
+
+    EXPECT_EQ(d.size(), 100u);
+    for (int i = 99; i >= 0; i--) {
+        EXPECT_EQ(d.pop(), &values[i]);
+    }
+}
+
+TEST(ChaseLevDequeTest, ConcurrentStealsTakeEachItemOnce) {
+    constexpr int kItems = 20000;
+    ChaseLevDeque<int> d(16);
+    std::vector<int> values(kItems);
+    std::vector<std::atomic<int>> seen(kItems);
+
+    std::atomic<bool> producing{true};
+    std::vector<std::thread> thieves;
+    for (int t = 0; t < 3; t++) {
+        thieves.emplace_back([&]() {
+            while (producing || !d.empty()) {
+                if (int* p = d.steal()) seen[p - values.data()]++;
+            }
+        });
+    }
+
+    // Owner pushes and pops interleaved with the thieves
+    for (int i = 0; i < kItems; i++) {
+        d.push(&values[i]);
+        if (i % 3 == 0) {
+            if (int* p = d.pop()) seen[p - values.data()]++;
+        }
+    }
+    while (int* p = d.pop()) seen[p - values.data()]++;
+    producing = false;
+    for (auto& t : thieves) t.join();
+
+    for (int i = 0; i < kItems; i++) {
+        EXPECT_EQ(seen[i].load(), 1) << "item " << i;
+    }
+}
+
+// ============================================================
+// WorkScheduler
+// ============================================================
+
+TEST(WorkSchedulerTest, BatchPopsInOrder) {
+    WorkScheduler<int> sched(2);
+    std::vector<int> batch = {1, 2, 3, 4, 5};
+    sched.push_bulk(batch);
+    sched.set_done();
+
+    int value;
+    for (int expected = 1; expected <= 5; expected++) {
+        ASSERT_TRUE(sched.try_pop(0, value));
+        EXPECT_EQ(value, expected);
+    }
+    EXPECT_FALSE(sched.try_pop(0, value));
+    EXPECT_TRUE(sched.is_done());
+}
+
+TEST(WorkSchedulerTest, IdleWorkerStealsHalfAsRange) {
+    WorkScheduler<int> sched(2);
+    std::vector<int> batch = {1, 2, 3, 4, 5, 6, 7, 8};
+    sched.push_bulk(batch);
+
+    // Worker 0 takes the whole batch
+    int value;
+    ASSERT_TRUE(sched.try_pop(0, value));
+    EXPECT_EQ(value, 1);
+
+    // Worker 1 has nothing queued, so it steals the tail half (5..8) and
+    // walks it in ascending order
+    std::vector<int> stolen;
+    while (sched.try_pop(1, value)) {
+        stolen.push_back(value);
+        if (stolen.size() == 4) break;
+    }
+    EXPECT_EQ(stolen, (std::vector<int>{5, 6, 7, 8}));
+    EXPECT_EQ(sched.steals(), 1u);
+
+    // Worker 0 keeps its contiguous head
+    for (int expected = 2; expected <= 4; expected++) {
+        ASSERT_TRUE(sched.try_pop(0, value));
+        EXPECT_EQ(value, expected);
+    }
+}
+
+TEST(WorkSchedulerTest, PushLocalIsPoppedNext) {
+    WorkScheduler<int> sched(1);
+    std::vector<int> batch = {1, 2};
+    sched.push_bulk(batch);
+
+    int value;
+    ASSERT_TRUE(sched.try_pop(0, value));
+    sched.push_local(0, value);
+    ASSERT_TRUE(sched.try_pop(0, value));
+    EXPECT_EQ(value, 1);
+}
+
+TEST(WorkSchedulerTest, NotDoneUntilDrained) {
+    WorkScheduler<int> sched(2);
+    sched.push(7);
+    sched.set_done();
+    EXPECT_FALSE(sched.is_done());
+
+    int value;
+    ASSERT_TRUE(sched.wait_pop(1, value));
+    EXPECT_EQ(value, 7);
+    EXPECT_TRUE(sched.is_done());
+    EXPECT_FALSE(sched.wait_pop(0, value));
+}
+
+TEST(WorkSchedulerTest, WorkersConsumeStreamedBatchesExactlyOnce) {
+    constexpr int kWorkers = 4;
+    constexpr int kBatches = 200;
+    constexpr int kBatchSize = 50;
+    WorkScheduler<int> sched(kWorkers);
+
+    std::mutex mutex;
+    std::multiset<int> consumed;
+    std::vector<std::thread> workers;
+    for (int w = 0; w < kWorkers; w++) {
+        workers.emplace_back([&, w]() {
+            int value;
+            std::vector<int> local;
+            while (sched.wait_pop(w, value)) local.push_back(value);
+            std::lock_guard<std::mutex> lock(mutex);
+            consumed.insert(local.begin(), local.end());
+        });
+    }
+
+    for (int b = 0; b < kBatches; b++) {
+        std::vector<int> batch;
+        for (int i = 0; i < kBatchSize; i++) batch.push_back(b * kBatchSize + i);
+        sched.push_bulk(batch);
+    }
+    sched.set_done();
+    for (auto& t : workers) t.join();
+
+    ASSERT_EQ(consumed.size(), (size_t)kBatches * kBatchSize);
+    for (int i = 0; i < kBatches * kBatchSize; i++) {
+        EXPECT_EQ(consumed.count(i), 1u) << "item " << i;
+    }
+}
+
+TEST(WorkSchedulerTest, ReleasesUnconsumedItems) {
+    // Leftover items are freed by the destructor (checked under ASan)
+    WorkScheduler<std::string> sched(2);
+    std::vector<std::string> batch = {"a", "b", "c"};
+    sched.push_bulk(batch);
+
+    std::string value;
+    ASSERT_TRUE(sched.try_pop(0, value));
+    EXPECT_EQ(value, "a");
+}
+
+TEST(WorkSchedulerTest, QueuedCountsPushesAndPops) {
+    WorkScheduler<int> sched(1);
+    std::vector<int> batch = {1, 2, 3};
+    sched.push_bulk(batch);
+    EXPECT_EQ(sched.queued(), 3u);
+
+    int value;
+    ASSERT_TRUE(sched.try_pop(0, value));
+    EXPECT_EQ(sched.queued(), 2u);
+    sched.push_local(0, value);
+    EXPECT_EQ(sched.queued(), 3u);
+}
+
+TEST(WorkSchedulerTest, PushWaitsForRoomUnderLimit) {
+    WorkScheduler<int> sched(1);
+    sched.set_limits(4, 0);
+    std::vector<int> first = {1, 2, 3, 4};
+    sched.push_bulk(first);
+
+    // Full: the next batch waits until a worker pops
+    std::atomic<bool> pushed{false};
+    std::thread producer([&] {
+        std::vector<int> second = {5, 6};
+        sched.push_bulk(second);
+        pushed = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_FALSE(pushed);
+
+    int value;
+    ASSERT_TRUE(sched.try_pop(0, value));
+    producer.join();
+    EXPECT_TRUE(pushed);
+    EXPECT_EQ(sched.queued(), 5u);
+    EXPECT_EQ(sched.throttled(), 1u);
+}
+
+TEST(WorkSchedulerTest, NeverWaitsOnAnEmptyQueue) {
+    // An RSS cap below anything possible still lets one batch at a time in
+    WorkScheduler<int> sched(1);
+    sched.set_limits(0, 1);
+    std::vector<int> batch = {1, 2};
+    sched.push_bulk(batch);
+    EXPECT_EQ(sched.queued(), 2u);
+    EXPECT_EQ(sched.throttled(), 0u);
+}